@@ -104,7 +104,7 @@ void communicate_task(void const *argument)
   if (app == CHASSIS_APP)
   {
     protocol_local_init(CHASSIS_ADDRESS);
-    protocol_can_interface_register("gimbal_can2", 4096, 1, PROTOCOL_CAN_PORT2, GIMBAL_CAN_ID, CHASSIS_CAN_ID, can2_send_data);
+    protocol_can_tp_interface_register("gimbal_can2", 4096, 1, PROTOCOL_CAN_PORT2, GIMBAL_CAN_ID, CHASSIS_CAN_ID, can2_send_data);
     protocol_uart_interface_register("manifold2", 4096, 1, PROTOCOL_USB_PORT, usb_interface_send);
     protocol_set_route(GIMBAL_ADDRESS, "gimbal_can2");
     protocol_set_route(MANIFOLD2_ADDRESS, "manifold2");
@@ -112,29 +112,71 @@ void communicate_task(void const *argument)
   else
   {
     protocol_local_init(GIMBAL_ADDRESS);
-    protocol_can_interface_register("chassis_can2", 4096, 1, PROTOCOL_CAN_PORT2, CHASSIS_CAN_ID, GIMBAL_CAN_ID, can2_send_data);
+    protocol_can_tp_interface_register("chassis_can2", 4096, 1, PROTOCOL_CAN_PORT2, CHASSIS_CAN_ID, GIMBAL_CAN_ID, can2_send_data);
     protocol_set_route(CHASSIS_ADDRESS, "chassis_can2");
     protocol_set_route(MANIFOLD2_ADDRESS, "chassis_can2");
     protocol_rcv_cmd_register(CMD_RC_DATA_FORWORD, dr16_rx_data_by_can);
   }
 
+  /* control commands, including the ones forwarded between boards, go out before telemetry */
+  protocol_send_cmd_config(CMD_RC_DATA_FORWORD, 1, 0, 0, PROTOCOL_PRIORITY_CTRL, NULL, NULL);
+  protocol_send_cmd_config(CMD_SET_GIMBAL_ANGLE, 1, 0, 0, PROTOCOL_PRIORITY_CTRL, NULL, NULL);
+  protocol_send_cmd_config(CMD_SET_FRICTION_SPEED, 1, 0, 0, PROTOCOL_PRIORITY_CTRL, NULL, NULL);
+  protocol_send_cmd_config(CMD_SET_SHOOT_FREQUENTCY, 1, 0, 0, PROTOCOL_PRIORITY_CTRL, NULL, NULL);
+  protocol_send_cmd_config(CMD_GIMBAL_ADJUST, 1, 0, 0, PROTOCOL_PRIORITY_CTRL, NULL, NULL);
+  protocol_send_cmd_config(CMD_PUSH_CHASSIS_INFO, 1, 0, 0, PROTOCOL_PRIORITY_BULK, NULL, NULL);
+  protocol_send_cmd_config(CMD_PUSH_GIMBAL_INFO, 1, 0, 0, PROTOCOL_PRIORITY_BULK, NULL, NULL);
+  protocol_send_cmd_config(CMD_PUSH_UWB_INFO, 1, 0, 0, PROTOCOL_PRIORITY_BULK, NULL, NULL);
+  protocol_send_cmd_config(CMD_PUSH_CAN_HEALTH, 1, 0, 0, PROTOCOL_PRIORITY_BULK, NULL, NULL);
+  protocol_send_cmd_config(CMD_STUDENT_DATA, 1, 0, 0, PROTOCOL_PRIORITY_BULK, NULL, NULL);
+
+  /* periodic setpoints only need the latest value, a newer frame replaces the queued one */
+  protocol_send_cmd_coalesce(CMD_RC_DATA_FORWORD, 1);
+  protocol_send_cmd_coalesce(CMD_SET_GIMBAL_ANGLE, 1);
+  protocol_send_cmd_coalesce(CMD_SET_FRICTION_SPEED, 1);
+  protocol_send_cmd_coalesce(CMD_SET_SHOOT_FREQUENTCY, 1);
+
   protocol_rcv_cmd_register(CMD_MANIFOLD2_HEART, manifold2_heart_package);
   protocol_rcv_cmd_register(CMD_REPORT_VERSION, report_firmware_version);
 
+  /* telemetry timestamps follow the manifold clock, the gimbal board gets it through the chassis board */
+  if (app == CHASSIS_APP)
+  {
+    protocol_time_sync_start(MANIFOLD2_ADDRESS, 1000);
+  }
+  else
+  {
+    protocol_time_sync_start(CHASSIS_ADDRESS, 1000);
+  }
+
   usb_vcp_rx_callback_register(usb_rcv_callback);
   soft_timer_register(usb_tx_flush, NULL, 1);
+  soft_timer_register(can_health_push_info, NULL, 100);
 	protocol_send_list_add_callback_reg(protocol_send_success_callback);
 
-  can_fifo0_rx_callback_register(&can2_manage, uwb_rcv_callback);
-  can_fifo0_rx_callback_register(&can2_manage, can2_rcv_callback);
+  can_fifo0_rx_callback_register_id(&can2_manage, uwb_rcv_callback, 0x259, 0x259);
+  /* the rx id of the can2 interface registered above */
+  if (app == CHASSIS_APP)
+  {
+    can_fifo0_rx_callback_register_id(&can2_manage, can2_rcv_callback, CHASSIS_CAN_ID, CHASSIS_CAN_ID);
+  }
+  else
+  {
+    can_fifo0_rx_callback_register_id(&can2_manage, can2_rcv_callback, GIMBAL_CAN_ID, GIMBAL_CAN_ID);
+  }
 
   while (1)
   {
     osEvent event;
 
-    event = osSignalWait(SEND_PROTOCOL_SIGNAL | RECV_PROTOCOL_SIGNAL | REFEREE_SIGNAL, osWaitForever);
+    /* sleep until the next resend deadline at most */
+    event = osSignalWait(SEND_PROTOCOL_SIGNAL | RECV_PROTOCOL_SIGNAL | REFEREE_SIGNAL, protocol_send_wait_time());
 
-    if (event.status == osEventSignal)
+    if ((event.status == osEventTimeout) || (event.status == osOK))
+    {
+      protocol_send_flush();
+    }
+    else if (event.status == osEventSignal)
     {
       if (event.value.signals & SEND_PROTOCOL_SIGNAL)
       {
@@ -190,7 +190,7 @@ void send_gimbal_current(int16_t iq1, int16_t iq2, int16_t iq3)
   tx_data[4] = iq3 >> 8;
   tx_data[5] = iq3;
 
-  can_msg_bytes_send(&hcan1, tx_data, 6, 0x1FF);
+  can_msg_rt_send(&hcan1, tx_data, 6, 0x1FF);
 }
 
 struct pid pid_pit = {0};
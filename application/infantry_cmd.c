@@ -29,11 +29,15 @@
 #include "protocol.h"
 #include "referee_system.h"
 
-#define MANIFOLD2_CHASSIS_SIGNAL (1 << 0)
-#define MANIFOLD2_GIMBAL_SIGNAL (1 << 1)
-#define MANIFOLD2_SHOOT_SIGNAL (1 << 2)
-#define MANIFOLD2_FRICTION_SIGNAL (1 << 3)
-#define MANIFOLD2_CHASSIS_ACC_SIGNAL (1 << 4)
+/* one signal bit per manifold command, in MANIFOLD_CMD_TABLE order */
+#define MANIFOLD_CMD_IDX(cmd, member, board) MANIFOLD_CMD_IDX_##member,
+enum { MANIFOLD_CMD_TABLE(MANIFOLD_CMD_IDX) MANIFOLD_CMD_NUM };
+
+#define MANIFOLD_CMD_SIGNAL(member) (1 << MANIFOLD_CMD_IDX_##member)
+#define MANIFOLD_CMD_SIGNAL_ALL ((1 << MANIFOLD_CMD_NUM) - 1)
+
+/* bit 7 is PROTOCOL_WAIT_SIGNAL */
+typedef char manifold_cmd_signal_check[(MANIFOLD_CMD_NUM <= 7) ? 1 : -1];
 
 extern osThreadId cmd_task_t;
 
@@ -48,16 +52,29 @@ struct manifold_cmd *get_manifold_cmd(void)
 }
 /* by rzf 妙算控制云台   */
 int32_t gimbal_info_rcv(uint8_t *buff, uint16_t len);
-/* by rzf  底盘速度控制  */
-int32_t chassis_speed_ctrl(uint8_t *buff, uint16_t len);
-/* by rzf 底盘 加速度控制   */
-int32_t chassis_spd_acc_ctrl(uint8_t *buff, uint16_t len);
-/* by rzf  下面几个都用不上 有时间再学习  */
-int32_t shoot_firction_ctrl(uint8_t *buff, uint16_t len);
-int32_t gimbal_angle_ctrl(uint8_t *buff, uint16_t len);
-int32_t shoot_ctrl(uint8_t *buff, uint16_t len);
 int32_t student_data_transmit(uint8_t *buff, uint16_t len);
 
+/* manifold commands: check the length, latch into manifold_cmd and wake the command task */
+#define MANIFOLD_CMD_RCV(cmd, member, board)                           \
+  static int32_t member##_rcv(uint8_t *buff, uint16_t len)             \
+  {                                                                    \
+    if (len == sizeof(struct cmd_##member))                            \
+    {                                                                  \
+      memcpy(&manifold_cmd.member, buff, sizeof(struct cmd_##member)); \
+      osSignalSet(cmd_task_t, MANIFOLD_CMD_SIGNAL(member));            \
+    }                                                                  \
+    return 0;                                                          \
+  }
+
+MANIFOLD_CMD_TABLE(MANIFOLD_CMD_RCV)
+
+/* expanded in infantry_cmd_task, registers the commands of the board running app */
+#define MANIFOLD_CMD_REGISTER(cmd, member, board)  \
+  if (app == (board))                             \
+  {                                               \
+    protocol_rcv_cmd_register(cmd, member##_rcv); \
+  }
+
 int32_t rc_data_forword_by_can(uint8_t *buff, uint16_t len)
 {
   protocol_send(GIMBAL_ADDRESS, CMD_RC_DATA_FORWORD, buff, len);
@@ -90,17 +107,13 @@ void infantry_cmd_task(void const *argument)
     prc_dev = rc_device_find("uart_rc");
     protocol_rcv_cmd_register(CMD_STUDENT_DATA, student_data_transmit);
     protocol_rcv_cmd_register(CMD_PUSH_GIMBAL_INFO, gimbal_info_rcv);
-    protocol_rcv_cmd_register(CMD_SET_CHASSIS_SPEED, chassis_speed_ctrl);
-    protocol_rcv_cmd_register(CMD_SET_CHASSIS_SPD_ACC, chassis_spd_acc_ctrl);
   }
   else
   {
     prc_dev = rc_device_find("can_rc");
-    protocol_rcv_cmd_register(CMD_SET_GIMBAL_ANGLE, gimbal_angle_ctrl);
-    protocol_rcv_cmd_register(CMD_SET_FRICTION_SPEED, shoot_firction_ctrl);
-    protocol_rcv_cmd_register(CMD_SET_SHOOT_FREQUENTCY, shoot_ctrl);
     protocol_rcv_cmd_register(CMD_GIMBAL_ADJUST, gimbal_adjust_cmd);
   }
+  MANIFOLD_CMD_TABLE(MANIFOLD_CMD_REGISTER)
 
   while (1)
   {
@@ -113,53 +126,51 @@ void infantry_cmd_task(void const *argument)
     }
     else
     {
-      event = osSignalWait(MANIFOLD2_CHASSIS_SIGNAL | MANIFOLD2_GIMBAL_SIGNAL |
-                               MANIFOLD2_SHOOT_SIGNAL | MANIFOLD2_FRICTION_SIGNAL | MANIFOLD2_CHASSIS_ACC_SIGNAL,
-                           500);
+      event = osSignalWait(MANIFOLD_CMD_SIGNAL_ALL, 500);
 
       if (event.status == osEventSignal)
       {
-        if (event.value.signals & MANIFOLD2_CHASSIS_SIGNAL)
+        if (event.value.signals & MANIFOLD_CMD_SIGNAL(chassis_speed))
         {
           struct cmd_chassis_speed *pspeed;
           pspeed = &manifold_cmd.chassis_speed;
           chassis_set_offset(pchassis, pspeed->rotate_x_offset, pspeed->rotate_x_offset);
           chassis_set_acc(pchassis, 0, 0, 0);
-          chassis_set_speed(pchassis, pspeed->vx, pspeed->vy, pspeed->vw / 10.0f);
+          chassis_set_speed(pchassis, pspeed->vx, pspeed->vy, CMD_DECODE(cmd_chassis_speed, vw, pspeed->vw));
         }
 
-        if (event.value.signals & MANIFOLD2_CHASSIS_ACC_SIGNAL)
+        if (event.value.signals & MANIFOLD_CMD_SIGNAL(chassis_spd_acc))
         {
           struct cmd_chassis_spd_acc *pacc;
           pacc = &manifold_cmd.chassis_spd_acc;
           chassis_set_offset(pchassis, pacc->rotate_x_offset, pacc->rotate_x_offset);
-          chassis_set_acc(pchassis, pacc->ax, pacc->ay, pacc->wz / 10.0f);
-          chassis_set_speed(pchassis, pacc->vx, pacc->vy, pacc->vw / 10.0f);
+          chassis_set_acc(pchassis, pacc->ax, pacc->ay, CMD_DECODE(cmd_chassis_spd_acc, wz, pacc->wz));
+          chassis_set_speed(pchassis, pacc->vx, pacc->vy, CMD_DECODE(cmd_chassis_spd_acc, vw, pacc->vw));
         }
 
-        if (event.value.signals & MANIFOLD2_GIMBAL_SIGNAL)
+        if (event.value.signals & MANIFOLD_CMD_SIGNAL(gimbal_angle))
         {
           struct cmd_gimbal_angle *pangle;
           pangle = &manifold_cmd.gimbal_angle;
-          if (pangle->ctrl.bit.pitch_mode == 0)
+          if ((pangle->ctrl & CMD_GIMBAL_CTRL_PITCH_SPEED) == 0)
           {
-            gimbal_set_pitch_angle(pgimbal, pangle->pitch / 10.0f);
+            gimbal_set_pitch_angle(pgimbal, CMD_DECODE(cmd_gimbal_angle, pitch, pangle->pitch));
           }
           else
           {
-            gimbal_set_pitch_speed(pgimbal, pangle->pitch / 10.0f);
+            gimbal_set_pitch_speed(pgimbal, CMD_DECODE(cmd_gimbal_angle, pitch, pangle->pitch));
           }
-          if (pangle->ctrl.bit.yaw_mode == 0)
+          if ((pangle->ctrl & CMD_GIMBAL_CTRL_YAW_SPEED) == 0)
           {
-            gimbal_set_yaw_angle(pgimbal, pangle->yaw / 10.0f, 0);
+            gimbal_set_yaw_angle(pgimbal, CMD_DECODE(cmd_gimbal_angle, yaw, pangle->yaw), 0);
           }
           else
           {
-            gimbal_set_yaw_speed(pgimbal, pangle->yaw / 10.0f);
+            gimbal_set_yaw_speed(pgimbal, CMD_DECODE(cmd_gimbal_angle, yaw, pangle->yaw));
           }
         }
 
-        if (event.value.signals & MANIFOLD2_SHOOT_SIGNAL)
+        if (event.value.signals & MANIFOLD_CMD_SIGNAL(shoot_num))
         {
           struct cmd_shoot_num *pctrl;
           pctrl = &manifold_cmd.shoot_num;
@@ -167,7 +178,7 @@ void infantry_cmd_task(void const *argument)
           shoot_set_turn_speed(pshoot, pctrl->shoot_freq);
         }
 
-        if (event.value.signals & MANIFOLD2_FRICTION_SIGNAL)
+        if (event.value.signals & MANIFOLD_CMD_SIGNAL(firction_speed))
         {
           struct cmd_firction_speed *pctrl;
           pctrl = &manifold_cmd.firction_speed;
@@ -191,61 +202,11 @@ int32_t student_data_transmit(uint8_t *buff, uint16_t len)
   return 0;
 }
 
-int32_t chassis_speed_ctrl(uint8_t *buff, uint16_t len)
-{
-  if (len == sizeof(struct cmd_chassis_speed))
-  {
-    memcpy(&manifold_cmd.chassis_speed, buff, len);
-    osSignalSet(cmd_task_t, MANIFOLD2_CHASSIS_SIGNAL);
-  }
-  return 0;
-}
-
-int32_t chassis_spd_acc_ctrl(uint8_t *buff, uint16_t len)
-{
-  if (len == sizeof(struct cmd_chassis_spd_acc))
-  {
-    memcpy(&manifold_cmd.chassis_spd_acc, buff, len);
-    osSignalSet(cmd_task_t, MANIFOLD2_CHASSIS_ACC_SIGNAL);
-  }
-  return 0;
-}
-
-int32_t gimbal_angle_ctrl(uint8_t *buff, uint16_t len)
-{
-  if (len == sizeof(struct cmd_gimbal_angle))
-  {
-    memcpy(&manifold_cmd.gimbal_angle, buff, len);
-    osSignalSet(cmd_task_t, MANIFOLD2_GIMBAL_SIGNAL);
-  }
-  return 0;
-}
-
-int32_t shoot_firction_ctrl(uint8_t *buff, uint16_t len)
-{
-  if (len == sizeof(struct cmd_firction_speed))
-  {
-    memcpy(&manifold_cmd.firction_speed, buff, len);
-    osSignalSet(cmd_task_t, MANIFOLD2_FRICTION_SIGNAL);
-  }
-  return 0;
-}
-
-int32_t shoot_ctrl(uint8_t *buff, uint16_t len)
-{
-  if (len == sizeof(struct cmd_shoot_num))
-  {
-    memcpy(&manifold_cmd.shoot_num, buff, len);
-    osSignalSet(cmd_task_t, MANIFOLD2_SHOOT_SIGNAL);
-  }
-  return 0;
-}
-
 int32_t gimbal_info_rcv(uint8_t *buff, uint16_t len)
 {
   struct cmd_gimbal_info *info;
   info = (struct cmd_gimbal_info *)buff;
-  chassis_set_relative_angle(info->yaw_ecd_angle / 10.0f);
+  chassis_set_relative_angle(CMD_DECODE(cmd_gimbal_info, yaw_ecd_angle, info->yaw_ecd_angle));
   return 0;
 }
 
@@ -254,14 +215,15 @@ int32_t gimbal_push_info(void *argc)
   struct gimbal_info info;
   gimbal_t pgimbal = (gimbal_t)argc;
   gimbal_get_info(pgimbal, &info);
+  cmd_gimbal_info.time_us = (uint32_t)protocol_time_now_us();
 
   cmd_gimbal_info.mode = info.mode;
-  cmd_gimbal_info.pitch_ecd_angle = info.pitch_ecd_angle * 10;
-  cmd_gimbal_info.pitch_gyro_angle = info.pitch_gyro_angle * 10;
-  cmd_gimbal_info.pitch_rate = info.pitch_rate * 10;
-  cmd_gimbal_info.yaw_ecd_angle = info.yaw_ecd_angle * 10;
-  cmd_gimbal_info.yaw_gyro_angle = info.yaw_gyro_angle * 10;
-  cmd_gimbal_info.yaw_rate = info.yaw_rate * 10;
+  cmd_gimbal_info.pitch_ecd_angle = CMD_ENCODE(cmd_gimbal_info, pitch_ecd_angle, info.pitch_ecd_angle);
+  cmd_gimbal_info.pitch_gyro_angle = CMD_ENCODE(cmd_gimbal_info, pitch_gyro_angle, info.pitch_gyro_angle);
+  cmd_gimbal_info.pitch_rate = CMD_ENCODE(cmd_gimbal_info, pitch_rate, info.pitch_rate);
+  cmd_gimbal_info.yaw_ecd_angle = CMD_ENCODE(cmd_gimbal_info, yaw_ecd_angle, info.yaw_ecd_angle);
+  cmd_gimbal_info.yaw_gyro_angle = CMD_ENCODE(cmd_gimbal_info, yaw_gyro_angle, info.yaw_gyro_angle);
+  cmd_gimbal_info.yaw_rate = CMD_ENCODE(cmd_gimbal_info, yaw_rate, info.yaw_rate);
 
   if (get_gimbal_init_state() == 0)
   {
@@ -278,11 +240,12 @@ int32_t chassis_push_info(void *argc)
   struct chassis_info info;
   chassis_t pchassis = (chassis_t)argc;
   chassis_get_info(pchassis, &info);
+  cmd_chassis_info.time_us = (uint32_t)protocol_time_now_us();
 
 	cmd_chassis_info.angle_deg =10;
-  //cmd_chassis_info.angle_deg = info.angle_deg * 10;
-  cmd_chassis_info.gyro_angle = info.yaw_gyro_angle * 10;
-  cmd_chassis_info.gyro_palstance = info.yaw_gyro_rate * 10;
+  //cmd_chassis_info.angle_deg = CMD_ENCODE(cmd_chassis_info, angle_deg, info.angle_deg);
+  cmd_chassis_info.gyro_angle = CMD_ENCODE(cmd_chassis_info, gyro_angle, info.yaw_gyro_angle);
+  cmd_chassis_info.gyro_palstance = CMD_ENCODE(cmd_chassis_info, gyro_palstance, info.yaw_gyro_rate);
   cmd_chassis_info.position_x_mm = info.position_x_mm;
   cmd_chassis_info.position_y_mm = info.position_y_mm;
 //  cmd_chassis_info.v_x_mm = info.v_x_mm;
@@ -293,3 +256,47 @@ int32_t chassis_push_info(void *argc)
 
   return 0;
 }
+
+/* error state and counters of can1 and can2, one message per bus */
+int32_t can_health_push_info(void *argc)
+{
+  can_manage_obj_t bus[2] = {&can1_manage, &can2_manage};
+  struct cmd_can_health info;
+  struct can_health health;
+  struct can_tx_stats bulk;
+
+  for (int i = 0; i < 2; i++)
+  {
+    can_health_get(bus[i], &health);
+    can_tx_stats_get(bus[i], CAN_TX_CLASS_BULK, &bulk);
+
+    info.bus = i + 1;
+    info.state = health.state;
+    info.tec = health.tec;
+    info.rec = health.rec;
+    info.tec_max = health.tec_max;
+    info.rec_max = health.rec_max;
+    info.last_error_code = health.last_error_code;
+    /* per mille is percent * CMD_SCALE(cmd_can_health, load) on the wire */
+    info.load = health.load_permille;
+    info.load_max = health.load_max_permille;
+    info.stuff_err = health.lec_cnt[1];
+    info.form_err = health.lec_cnt[2];
+    info.ack_err = health.lec_cnt[3];
+    info.bit_recessive_err = health.lec_cnt[4];
+    info.bit_dominant_err = health.lec_cnt[5];
+    info.crc_err = health.lec_cnt[6];
+    info.warning_cnt = health.warning_cnt;
+    info.passive_cnt = health.passive_cnt;
+    info.busoff_cnt = health.busoff_cnt;
+    info.recover_cnt = health.recover_cnt;
+    info.arb_lost = health.arb_lost;
+    info.tx_fifo_full = health.tx_fifo_full;
+    info.tx_bulk_drop = bulk.drop;
+    info.rx_overrun = health.rx_overrun;
+
+    protocol_send(MANIFOLD2_ADDRESS, CMD_PUSH_CAN_HEALTH, &info, sizeof(info));
+  }
+
+  return 0;
+}
@@ -25,6 +25,7 @@
 #endif
 
 #include "sys.h"
+#include "infantry_cmd_schema.h"
 
 #define FIRMWARE_VERSION_0 6u
 #define FIRMWARE_VERSION_1 1u
@@ -60,106 +61,49 @@
 #define CMD_RC_DATA_FORWORD                 (0x0401u)
 #define CMD_PUSH_UWB_INFO                   (0x0402u)
 #define CMD_GIMBAL_ADJUST                   (0x0403u)
+#define CMD_PUSH_CAN_HEALTH                 (0x0404u)
 
-#pragma pack(push,1)
-
-struct cmd_chassis_param
-{
-  uint16_t wheel_perimeter; /* the perimeter(mm) of wheel */
-  uint16_t wheel_track;     /* wheel track distance(mm) */
-  uint16_t wheel_base;      /* wheelbase distance(mm) */
-  int16_t rotate_x_offset;
-  int16_t rotate_y_offset;
-};
+/* generated from infantry_cmd_schema.h, see CMD_ENCODE/CMD_DECODE for the scales */
+#define CMD_FIELD_MEMBER(S, type, field, scale) type field;
+#define CMD_FIELD_SIZE(S, type, field, scale) + sizeof(type)
+#define CMD_FIELD_SCALE(S, type, field, scale) S##_##field##_scale = (scale),
 
-struct cmd_chassis_info
-{
-  int16_t gyro_angle;
-  int16_t gyro_palstance;
-  int32_t position_x_mm;
-  int32_t position_y_mm;
-  int16_t angle_deg;
-  int16_t v_x_mm;
-  int16_t v_y_mm;
-};
+#define CMD_MSG_STRUCT(cmd, name, FIELDS) struct name { FIELDS(CMD_FIELD_MEMBER, name) };
+#define CMD_MSG_SCALE(cmd, name, FIELDS) enum { FIELDS(CMD_FIELD_SCALE, name) };
+#define CMD_MSG_SIZE_CHECK(cmd, name, FIELDS) \
+  typedef char name##_size_check[(sizeof(struct name) == (0 FIELDS(CMD_FIELD_SIZE, name))) ? 1 : -1];
 
-struct cmd_gimbal_info
-{
-  uint8_t   mode;
-  /* unit: degree */
-  int16_t pitch_ecd_angle;
-  int16_t yaw_ecd_angle;
-  int16_t pitch_gyro_angle;
-  int16_t yaw_gyro_angle;
-  /* uint: degree/s */
-  int16_t yaw_rate;
-  int16_t pitch_rate;
-};
+#pragma pack(push,1)
 
-struct cmd_gimbal_angle
-{
-  union{
-    uint8_t flag;
-    struct{
-        uint8_t yaw_mode:1;  // 0 code angle
-        uint8_t pitch_mode:1;
-    }bit;
-  } ctrl;
-  int16_t pitch;
-  int16_t yaw;
-};
+INFANTRY_CMD_TABLE(CMD_MSG_STRUCT)
 
-struct cmd_chassis_speed
-{
-  int16_t vx; // forward/back
-  int16_t vy; // left/right
-  int16_t vw; // anticlockwise/clockwise
-  int16_t rotate_x_offset;
-  int16_t rotate_y_offset;
-};
+#pragma pack(pop)
 
-struct cmd_chassis_spd_acc
-{
-  int16_t   vx; 
-  int16_t   vy;
-  int16_t   vw; 
-
-  int16_t   ax; 
-  int16_t   ay; 
-  int16_t   wz; 
-  
-  int16_t rotate_x_offset;
-  int16_t rotate_y_offset;
-};
+/* under pack(1) there is no padding to catch; this fails to compile if the pack pragma
+   is not honored or a field type changes size, so firmware and host layouts agree */
+INFANTRY_CMD_TABLE(CMD_MSG_SCALE)
+INFANTRY_CMD_TABLE(CMD_MSG_SIZE_CHECK)
 
-struct cmd_firction_speed
-{
-  uint16_t left;
-  uint16_t right;
-};
+/* cmd_gimbal_angle.ctrl, a set bit means speed control instead of angle control */
+#define CMD_GIMBAL_CTRL_YAW_SPEED   (1u << 0)
+#define CMD_GIMBAL_CTRL_PITCH_SPEED (1u << 1)
 
-struct cmd_shoot_num
-{
-  uint8_t  shoot_cmd;
-  uint32_t shoot_add_num;
-  uint16_t shoot_freq;
-};
+#define CMD_SCALE(name, field) (name##_##field##_scale)
+#define CMD_ENCODE(name, field, value) ((value) * CMD_SCALE(name, field))
+#define CMD_DECODE(name, field, value) ((value) / (float)CMD_SCALE(name, field))
 
-#pragma pack(pop)
+#define MANIFOLD_CMD_MEMBER(cmd, member, app) struct cmd_##member member;
 
 struct manifold_cmd
 {
-  struct cmd_gimbal_angle gimbal_angle;
-  struct cmd_chassis_speed chassis_speed;
-  struct cmd_chassis_spd_acc chassis_spd_acc;
-  struct cmd_firction_speed firction_speed;
-  struct cmd_shoot_num shoot_num; 
+  MANIFOLD_CMD_TABLE(MANIFOLD_CMD_MEMBER)
 };
 
 int32_t rc_data_forword_by_can(uint8_t *buff, uint16_t len);
 void infantry_cmd_task(void const * argument);
 int32_t gimbal_push_info(void *argc);
 int32_t chassis_push_info(void *argc);
+int32_t can_health_push_info(void *argc);
 struct manifold_cmd *get_manifold_cmd(void);
 
 #endif // __INFANTRY_H__
@@ -0,0 +1,139 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef __INFANTRY_CMD_SCHEMA_H__
+#define __INFANTRY_CMD_SCHEMA_H__
+
+/*
+ * Payload schema of every fixed length command, the single source for
+ *   - the packed structs and their compile time size checks (infantry_cmd.h)
+ *   - the scale between wire integers and physical units (CMD_ENCODE/CMD_DECODE)
+ *   - the length checked receive handlers of manifold commands (infantry_cmd.c)
+ *   - the host decoders in tools/, run tools/gen_cmd_schema.py after editing
+ *
+ * Field list:   F(S, type, field, scale), wire value = physical value * scale
+ * Command list: M(cmd, name, FIELDS), struct name carries the payload of cmd
+ * Keep one entry per line, the host generator parses this file.
+ */
+
+#define CMD_CHASSIS_PARAM_FIELDS(F, S) \
+  F(S, uint16_t, wheel_perimeter, 1)   \
+  F(S, uint16_t, wheel_track, 1)       \
+  F(S, uint16_t, wheel_base, 1)        \
+  F(S, int16_t, rotate_x_offset, 1)    \
+  F(S, int16_t, rotate_y_offset, 1)
+
+#define CMD_CHASSIS_INFO_FIELDS(F, S) \
+  F(S, int16_t, gyro_angle, 10)       \
+  F(S, int16_t, gyro_palstance, 10)   \
+  F(S, int32_t, position_x_mm, 1)     \
+  F(S, int32_t, position_y_mm, 1)     \
+  F(S, int16_t, angle_deg, 10)        \
+  F(S, int16_t, v_x_mm, 1)            \
+  F(S, int16_t, v_y_mm, 1)            \
+  F(S, uint32_t, time_us, 1)
+
+#define CMD_GIMBAL_INFO_FIELDS(F, S)  \
+  F(S, uint8_t, mode, 1)              \
+  F(S, int16_t, pitch_ecd_angle, 10)  \
+  F(S, int16_t, yaw_ecd_angle, 10)    \
+  F(S, int16_t, pitch_gyro_angle, 10) \
+  F(S, int16_t, yaw_gyro_angle, 10)   \
+  F(S, int16_t, yaw_rate, 10)         \
+  F(S, int16_t, pitch_rate, 10)       \
+  F(S, uint32_t, time_us, 1)
+
+#define CMD_GIMBAL_ANGLE_FIELDS(F, S) \
+  F(S, uint8_t, ctrl, 1)              \
+  F(S, int16_t, pitch, 10)            \
+  F(S, int16_t, yaw, 10)
+
+#define CMD_CHASSIS_SPEED_FIELDS(F, S) \
+  F(S, int16_t, vx, 1)                 \
+  F(S, int16_t, vy, 1)                 \
+  F(S, int16_t, vw, 10)                \
+  F(S, int16_t, rotate_x_offset, 1)    \
+  F(S, int16_t, rotate_y_offset, 1)
+
+#define CMD_CHASSIS_SPD_ACC_FIELDS(F, S) \
+  F(S, int16_t, vx, 1)                   \
+  F(S, int16_t, vy, 1)                   \
+  F(S, int16_t, vw, 10)                  \
+  F(S, int16_t, ax, 1)                   \
+  F(S, int16_t, ay, 1)                   \
+  F(S, int16_t, wz, 10)                  \
+  F(S, int16_t, rotate_x_offset, 1)      \
+  F(S, int16_t, rotate_y_offset, 1)
+
+#define CMD_FIRCTION_SPEED_FIELDS(F, S) \
+  F(S, uint16_t, left, 1)               \
+  F(S, uint16_t, right, 1)
+
+#define CMD_SHOOT_NUM_FIELDS(F, S) \
+  F(S, uint8_t, shoot_cmd, 1)      \
+  F(S, uint32_t, shoot_add_num, 1) \
+  F(S, uint16_t, shoot_freq, 1)
+
+#define CMD_CAN_HEALTH_FIELDS(F, S)    \
+  F(S, uint8_t, bus, 1)                \
+  F(S, uint8_t, state, 1)              \
+  F(S, uint8_t, tec, 1)                \
+  F(S, uint8_t, rec, 1)                \
+  F(S, uint8_t, tec_max, 1)            \
+  F(S, uint8_t, rec_max, 1)            \
+  F(S, uint8_t, last_error_code, 1)    \
+  F(S, uint16_t, load, 10)             \
+  F(S, uint16_t, load_max, 10)         \
+  F(S, uint32_t, stuff_err, 1)         \
+  F(S, uint32_t, form_err, 1)          \
+  F(S, uint32_t, ack_err, 1)           \
+  F(S, uint32_t, bit_recessive_err, 1) \
+  F(S, uint32_t, bit_dominant_err, 1)  \
+  F(S, uint32_t, crc_err, 1)           \
+  F(S, uint32_t, warning_cnt, 1)       \
+  F(S, uint32_t, passive_cnt, 1)       \
+  F(S, uint32_t, busoff_cnt, 1)        \
+  F(S, uint32_t, recover_cnt, 1)       \
+  F(S, uint32_t, arb_lost, 1)          \
+  F(S, uint32_t, tx_fifo_full, 1)      \
+  F(S, uint32_t, tx_bulk_drop, 1)      \
+  F(S, uint32_t, rx_overrun, 1)
+
+#define INFANTRY_CMD_TABLE(M)                                                 \
+  M(CMD_GET_CHASSIS_PARAM, cmd_chassis_param, CMD_CHASSIS_PARAM_FIELDS)       \
+  M(CMD_PUSH_CHASSIS_INFO, cmd_chassis_info, CMD_CHASSIS_INFO_FIELDS)         \
+  M(CMD_PUSH_GIMBAL_INFO, cmd_gimbal_info, CMD_GIMBAL_INFO_FIELDS)            \
+  M(CMD_SET_GIMBAL_ANGLE, cmd_gimbal_angle, CMD_GIMBAL_ANGLE_FIELDS)          \
+  M(CMD_SET_CHASSIS_SPEED, cmd_chassis_speed, CMD_CHASSIS_SPEED_FIELDS)       \
+  M(CMD_SET_CHASSIS_SPD_ACC, cmd_chassis_spd_acc, CMD_CHASSIS_SPD_ACC_FIELDS) \
+  M(CMD_SET_FRICTION_SPEED, cmd_firction_speed, CMD_FIRCTION_SPEED_FIELDS)    \
+  M(CMD_SET_SHOOT_FREQUENTCY, cmd_shoot_num, CMD_SHOOT_NUM_FIELDS)            \
+  M(CMD_PUSH_CAN_HEALTH, cmd_can_health, CMD_CAN_HEALTH_FIELDS)
+
+/*
+ * Manifold commands latched into struct manifold_cmd: R(cmd, member, app).
+ * The payload struct is cmd_<member>, the command task is signalled with
+ * MANIFOLD_CMD_SIGNAL(member) and only the board running app registers it.
+ */
+#define MANIFOLD_CMD_TABLE(R)                           \
+  R(CMD_SET_CHASSIS_SPEED, chassis_speed, CHASSIS_APP)  \
+  R(CMD_SET_GIMBAL_ANGLE, gimbal_angle, GIMBAL_APP)     \
+  R(CMD_SET_SHOOT_FREQUENTCY, shoot_num, GIMBAL_APP)    \
+  R(CMD_SET_FRICTION_SPEED, firction_speed, GIMBAL_APP) \
+  R(CMD_SET_CHASSIS_SPD_ACC, chassis_spd_acc, CHASSIS_APP)
+
+#endif // __INFANTRY_CMD_SCHEMA_H__
@@ -89,8 +89,8 @@ void offline_init(void)
 //	}
 
   soft_timer_register(offline_check, NULL, 20);
-  can_fifo0_rx_callback_register(&can1_manage, can1_detect_update);
-  can_fifo0_rx_callback_register(&can2_manage, can2_detect_update);
+  can_fifo0_rx_callback_register_id(&can1_manage, can1_detect_update, 0x201, 0x207);
+  can_fifo0_rx_callback_register_id(&can2_manage, can2_detect_update, 0x401, 0x401);
 }
 
 int32_t offline_check(void *argc)
@@ -18,6 +18,12 @@
 /* Includes ------------------------------------------------------------------*/
 #include "protocol.h"
 #include "protocol_transmit.h"
+#include "protocol_stream.h"
+#include "protocol_frag.h"
+#include "protocol_trace.h"
+#include "protocol_wait.h"
+#include "protocol_time.h"
+#include "protocol_cantp.h"
 #include "protocol_cfg.h"
 #include "protocol_log.h"
 #include "board.h"
@@ -34,35 +40,256 @@ local_info_t protocol_local_info =
 /* Private function prototypes -----------------------------------------------*/
 /* Exported functions --------------------------------------------------------*/
 
+/* Fibonacci hashing of the 16-bit cmd into PROTOCOL_CMD_HASH_BITS bits */
+static uint32_t protocol_cmd_hash(uint16_t cmd)
+{
+  return ((uint16_t)(cmd * 40503u)) >> (16 - PROTOCOL_CMD_HASH_BITS);
+}
+
+static void protocol_cmd_index_clear(struct cmd_index_slot *index)
+{
+  for (uint32_t i = 0; i < PROTOCOL_CMD_HASH_SIZE; i++)
+  {
+    index[i].cmd = PROTOCOL_CMD_INVALID;
+    index[i].idx = 0;
+  }
+}
+
+//查找命令所在的哈希槽，未找到返回-1
+static int32_t protocol_cmd_index_slot(struct cmd_index_slot *index, uint16_t cmd)
+{
+  uint32_t slot;
+
+  slot = protocol_cmd_hash(cmd);
+  for (uint32_t i = 0; i < PROTOCOL_CMD_HASH_SIZE; i++)
+  {
+    if (index[slot].cmd == cmd)
+    {
+      return slot;
+    }
+    if (index[slot].cmd == PROTOCOL_CMD_INVALID)
+    {
+      return -1;
+    }
+    slot = (slot + 1) & PROTOCOL_CMD_HASH_MASK;
+  }
+  return -1;
+}
+
+//查找命令对应的信息表序号，未找到返回-1
+static int32_t protocol_cmd_index_find(struct cmd_index_slot *index, uint16_t cmd)
+{
+  int32_t slot;
+
+  slot = protocol_cmd_index_slot(index, cmd);
+  if (slot < 0)
+  {
+    return -1;
+  }
+  return index[slot].idx;
+}
+
+static int32_t protocol_cmd_index_insert(struct cmd_index_slot *index, uint16_t cmd, uint8_t idx)
+{
+  uint32_t slot;
+
+  slot = protocol_cmd_hash(cmd);
+  for (uint32_t i = 0; i < PROTOCOL_CMD_HASH_SIZE; i++)
+  {
+    if (index[slot].cmd == PROTOCOL_CMD_INVALID)
+    {
+      index[slot].idx = idx;
+      index[slot].cmd = cmd;
+      return 0;
+    }
+    slot = (slot + 1) & PROTOCOL_CMD_HASH_MASK;
+  }
+  return -1;
+}
+
+//删除命令，后移删除保持线性探测链完整
+static void protocol_cmd_index_remove(struct cmd_index_slot *index, uint16_t cmd)
+{
+  int32_t hole;
+  uint32_t next, home;
+
+  hole = protocol_cmd_index_slot(index, cmd);
+  if (hole < 0)
+  {
+    return;
+  }
+
+  next = hole;
+  while (1)
+  {
+    next = (next + 1) & PROTOCOL_CMD_HASH_MASK;
+    if (index[next].cmd == PROTOCOL_CMD_INVALID)
+    {
+      break;
+    }
+
+    home = protocol_cmd_hash(index[next].cmd);
+    //home在(hole, next]区间内的节点不能前移
+    if (((uint32_t)hole <= next) ? ((home > (uint32_t)hole) && (home <= next))
+                                 : ((home > (uint32_t)hole) || (home <= next)))
+    {
+      continue;
+    }
+
+    index[hole] = index[next];
+    hole = next;
+  }
+
+  index[hole].cmd = PROTOCOL_CMD_INVALID;
+  index[hole].idx = 0;
+}
+
 struct send_cmd_info *protocol_get_send_cmd_info(uint16_t cmd)
 {
-  for (int i = 0; i < PROTOCOL_CMD_MAX_NUM; i++)
+  int32_t idx;
+
+  idx = protocol_cmd_index_find(protocol_local_info.send_cmd_index, cmd);
+  if (idx < 0)
   {
-    if ((protocol_local_info.send_cmd_info[i].cmd == cmd) && (protocol_local_info.send_cmd_info[i].used == 1))
+    return NULL;
+  }
+  return &protocol_local_info.send_cmd_info[idx];
+}
+
+struct rcv_cmd_info *protocol_get_rcv_cmd_info(uint16_t cmd)
+{
+  int32_t idx;
+
+  idx = protocol_cmd_index_find(protocol_local_info.rcv_cmd_index, cmd);
+  if (idx < 0)
+  {
+    return NULL;
+  }
+  return &protocol_local_info.rcv_cmd_info[idx];
+}
+
+//回复各接口的RTT估计与重发统计
+static void protocol_rtt_info_reply(uint8_t reciver)
+{
+  struct protocol_rtt_info info[PROTOCOL_INTERFACE_MAX];
+  struct protocol_rtt *rtt;
+  uint8_t num = 0;
+
+  for (uint8_t i = 0; i < PROTOCOL_INTERFACE_MAX; i++)
+  {
+    if (protocol_local_info.interface[i].is_valid)
     {
-      return &protocol_local_info.send_cmd_info[i];
+      rtt = &protocol_local_info.interface[i].send.rtt;
+      info[num].idx = i;
+      info[num].srtt = rtt->srtt >> 3;
+      info[num].rttvar = rtt->rttvar >> 2;
+      info[num].rto = rtt->rto;
+      info[num].sample_cnt = rtt->sample_cnt;
+      info[num].spurious_cnt = rtt->spurious_cnt;
+      info[num].needed_cnt = rtt->needed_cnt;
+      info[num].no_ack_cnt = rtt->no_ack_cnt;
+      num++;
     }
   }
-  return NULL;
+
+  protocol_send(reciver, PROTOCOL_CMD_RTT_INFO, info, num * sizeof(struct protocol_rtt_info));
 }
 
+#if (PROTOCOL_STATS_ENABLE == PROTOCOL_ENABLE)
+//每个接口回复一帧统计信息，reset不为0时回复后清零
+static void protocol_stats_info_reply(uint8_t reciver, uint8_t reset)
+{
+  struct protocol_stats_info info;
+
+  for (uint8_t i = 0; i < PROTOCOL_INTERFACE_MAX; i++)
+  {
+    if (protocol_local_info.interface[i].is_valid)
+    {
+      info.idx = i;
+      memcpy(&info.stats, &protocol_local_info.interface[i].stats, sizeof(info.stats));
+      protocol_send(reciver, PROTOCOL_CMD_STATS_INFO, &info, sizeof(info));
+    }
+  }
+
+  if (reset)
+  {
+    protocol_stats_reset();
+  }
+}
+#endif
+
 static void protocol_rcv_pack_handle(uint8_t *pack_data, uint16_t cmd, uint8_t session, uint8_t source_add)
 {
   protocol_pack_desc_t *pack;
+  struct rcv_cmd_info *cmd_info;
   uint16_t rcv_seq;
   int32_t err;
-  rcv_seq = pack->seq_num;
+  int32_t idx;
+
   pack = (protocol_pack_desc_t *)(pack_data);
+  rcv_seq = pack->seq_num;
 
-  for (int i = 0; i < PROTOCOL_CMD_MAX_NUM; i++)
+  if (cmd == PROTOCOL_CMD_RTT_QUERY)
   {
-    if ((protocol_local_info.rcv_cmd_info[i].cmd == cmd) && (protocol_local_info.rcv_cmd_info[i].rcv_callback != NULL) && (protocol_local_info.rcv_cmd_info[i].used == 1))
+    protocol_rtt_info_reply(source_add);
+    return;
+  }
+
+#if (PROTOCOL_TRACE_ENABLE == PROTOCOL_ENABLE)
+  if (cmd == PROTOCOL_CMD_TRACE_QUERY)
+  {
+    protocol_trace_reply(source_add);
+    return;
+  }
+#endif
+
+#if (PROTOCOL_STATS_ENABLE == PROTOCOL_ENABLE)
+  if (cmd == PROTOCOL_CMD_STATS_QUERY)
+  {
+    protocol_stats_info_reply(source_add, (pack->data_len > PACK_HEADER_TAIL_LEN) ? pack->pdata[2] : 0);
+    return;
+  }
+#endif
+
+#if (PROTOCOL_TIME_ENABLE == PROTOCOL_ENABLE)
+  if ((cmd == PROTOCOL_CMD_TIME_REQ) || (cmd == PROTOCOL_CMD_TIME_RESP))
+  {
+    protocol_time_rcv(cmd, source_add, pack->pdata + 2, pack->data_len - PACK_HEADER_TAIL_LEN);
+    return;
+  }
+#endif
+
+#if (PROTOCOL_STREAM_ENABLE == PROTOCOL_ENABLE)
+  //流数据与流ACK由流模块处理，需要知道发送方地址
+  if ((cmd == PROTOCOL_CMD_STREAM_DATA) || (cmd == PROTOCOL_CMD_STREAM_ACK))
+  {
+    protocol_stream_rcv(cmd, source_add, pack->pdata + 2, pack->data_len - PACK_HEADER_TAIL_LEN);
+    return;
+  }
+#endif
+
+#if (PROTOCOL_FRAG_ENABLE == PROTOCOL_ENABLE)
+  //分片重组完成后再交给命令的接收回调
+  if (cmd == PROTOCOL_CMD_FRAG)
+  {
+    protocol_frag_rcv(source_add, pack->pdata + 2, pack->data_len - PACK_HEADER_TAIL_LEN);
+    return;
+  }
+#endif
+
+  idx = protocol_cmd_index_find(protocol_local_info.rcv_cmd_index, cmd);
+  if (idx < 0)
+  {
+    return;
+  }
+
+  cmd_info = &protocol_local_info.rcv_cmd_info[idx];
+  if (cmd_info->rcv_callback != NULL)
+  {
+    err = cmd_info->rcv_callback(pack->pdata + 2, pack->data_len - PACK_HEADER_TAIL_LEN);
+    if (session != 0)
     {
-      err = protocol_local_info.rcv_cmd_info[i].rcv_callback(pack->pdata + 2, pack->data_len - PACK_HEADER_TAIL_LEN);
-      if (session != 0)
-      {
-        protocol_ack(source_add, session, &err, sizeof(err), rcv_seq);
-      }
+      protocol_ack(source_add, session, &err, sizeof(err), rcv_seq);
     }
   }
 
@@ -71,6 +298,14 @@ static void protocol_rcv_pack_handle(uint8_t *pack_data, uint16_t cmd, uint8_t s
 
 int32_t protocol_rcv_cmd_register(uint16_t cmd, rcv_handle_fn_t rcv_callback)
 {
+  if ((cmd == PROTOCOL_CMD_INVALID) ||
+      (protocol_cmd_index_find(protocol_local_info.rcv_cmd_index, cmd) >= 0))
+  {
+    //命令已注册
+    PROTOCOL_ERR_INFO_PRINTF(PROTOCOL_ERR_REGISTER_FAILED, __FILE__, __LINE__);
+    return -1;
+  }
+
   for (int i = 0; i < PROTOCOL_CMD_MAX_NUM; i++)
   {
     if (protocol_local_info.rcv_cmd_info[i].used == 0)
@@ -78,6 +313,8 @@ int32_t protocol_rcv_cmd_register(uint16_t cmd, rcv_handle_fn_t rcv_callback)
       protocol_local_info.rcv_cmd_info[i].used = 1;
       protocol_local_info.rcv_cmd_info[i].cmd = cmd;
       protocol_local_info.rcv_cmd_info[i].rcv_callback = rcv_callback;
+      protocol_local_info.rcv_cmd_info[i].stream_callback = NULL;
+      protocol_cmd_index_insert(protocol_local_info.rcv_cmd_index, cmd, i);
       return 0;
     }
   }
@@ -89,9 +326,18 @@ int32_t protocol_send_cmd_config(uint16_t cmd,
                                  uint8_t resend_times,
                                  uint16_t resend_timeout,
                                  uint8_t ack_enable,
+                                 uint8_t priority,
                                  ack_handle_fn_t ack_callback,
                                  no_ack_handle_fn_t no_ack_callback)
 {
+  if ((cmd == PROTOCOL_CMD_INVALID) || (priority >= PROTOCOL_PRIORITY_NUM) ||
+      (protocol_cmd_index_find(protocol_local_info.send_cmd_index, cmd) >= 0))
+  {
+    //命令已配置
+    PROTOCOL_ERR_INFO_PRINTF(PROTOCOL_ERR_REGISTER_FAILED, __FILE__, __LINE__);
+    return -1;
+  }
+
   for (int i = 0; i < PROTOCOL_CMD_MAX_NUM; i++)
   {
     if (protocol_local_info.send_cmd_info[i].used == 0)
@@ -101,8 +347,11 @@ int32_t protocol_send_cmd_config(uint16_t cmd,
       protocol_local_info.send_cmd_info[i].resend_times = resend_times;
       protocol_local_info.send_cmd_info[i].resend_timeout = resend_timeout;
       protocol_local_info.send_cmd_info[i].ack_enable = ack_enable;
+      protocol_local_info.send_cmd_info[i].priority = priority;
+      protocol_local_info.send_cmd_info[i].coalesce = 0;
       protocol_local_info.send_cmd_info[i].ack_callback = ack_callback;
       protocol_local_info.send_cmd_info[i].no_ack_callback = no_ack_callback;
+      protocol_cmd_index_insert(protocol_local_info.send_cmd_index, cmd, i);
       return 0;
     }
   }
@@ -110,30 +359,57 @@ int32_t protocol_send_cmd_config(uint16_t cmd,
   return -1;
 }
 
+/**
+  * @brief  设置命令的最新值语义，用于周期发送的控制命令
+  * @param  cmd 已通过protocol_send_cmd_config配置的命令
+  *         enable 为1时，发送列表中尚未发出的同命令、同收发地址的帧被新帧原位替换，
+  *                转发的帧同样处理；只对不需要ACK的帧生效
+  * @retval 0 成功，-1 命令未配置
+  */
+int32_t protocol_send_cmd_coalesce(uint16_t cmd, uint8_t enable)
+{
+  int32_t idx;
+
+  idx = protocol_cmd_index_find(protocol_local_info.send_cmd_index, cmd);
+  if (idx < 0)
+  {
+    return -1;
+  }
+
+  protocol_local_info.send_cmd_info[idx].coalesce = (enable != 0);
+  return 0;
+}
+
 int32_t protocol_rcv_cmd_unregister(uint16_t cmd)
 {
-  for (int i = 0; i < PROTOCOL_CMD_MAX_NUM; i++)
+  int32_t idx;
+
+  idx = protocol_cmd_index_find(protocol_local_info.rcv_cmd_index, cmd);
+  if (idx < 0)
   {
-    if ((protocol_local_info.rcv_cmd_info[i].cmd == cmd) && (protocol_local_info.rcv_cmd_info[i].used == 1))
-    {
-      protocol_local_info.rcv_cmd_info[i].used = 0;
-      return 0;
-    }
+    return -1;
   }
-  return -1;
+
+  protocol_cmd_index_remove(protocol_local_info.rcv_cmd_index, cmd);
+  protocol_local_info.rcv_cmd_info[idx].used = 0;
+  protocol_local_info.rcv_cmd_info[idx].cmd = PROTOCOL_CMD_INVALID;
+  return 0;
 }
 
 int32_t protocol_send_cmd_unregister(uint16_t cmd)
 {
-  for (int i = 0; i < PROTOCOL_CMD_MAX_NUM; i++)
+  int32_t idx;
+
+  idx = protocol_cmd_index_find(protocol_local_info.send_cmd_index, cmd);
+  if (idx < 0)
   {
-    if ((protocol_local_info.send_cmd_info[i].cmd == cmd) && (protocol_local_info.send_cmd_info[i].used == 1))
-    {
-      protocol_local_info.send_cmd_info[i].used = 0;
-      return 0;
-    }
+    return -1;
   }
-  return -1;
+
+  protocol_cmd_index_remove(protocol_local_info.send_cmd_index, cmd);
+  protocol_local_info.send_cmd_info[idx].used = 0;
+  protocol_local_info.send_cmd_info[idx].cmd = PROTOCOL_CMD_INVALID;
+  return 0;
 }
 
 /**
@@ -161,28 +437,59 @@ uint32_t protocol_local_init(uint8_t address)
   }
 
   MUTEX_INIT(protocol_local_info.mutex_lock);
+
+  protocol_p_mem_init();
+  protocol_p_cycles_init();
   
   memset(protocol_local_info.route_table, 0xFF, PROTOCOL_ROUTE_TABLE_MAX_NUM);
 	
-	for(int i; i < PROTOCOL_INTERFACE_MAX; i++)
+	for(int i = 0; i < PROTOCOL_INTERFACE_MAX; i++)
 	{
 		/* initalization user data is 0xFF */
 		memset(&protocol_local_info.interface[i].user_data, 0xFF, sizeof(union interface_user_data));
 	}
 
-  for(int i; i < PROTOCOL_CMD_MAX_NUM; i++)
+  for(int i = 0; i < PROTOCOL_CMD_MAX_NUM; i++)
 	{
-		/* initalization cmd is 0xFF */
-		memset(&protocol_local_info.send_cmd_info[i].cmd, 0xFFFF, 2);
-    memset(&protocol_local_info.rcv_cmd_info[i].cmd, 0xFFFF, 2);
+		/* initalization cmd is 0xFFFF */
+		protocol_local_info.send_cmd_info[i].cmd = PROTOCOL_CMD_INVALID;
+		protocol_local_info.rcv_cmd_info[i].cmd = PROTOCOL_CMD_INVALID;
 	}
 
+  protocol_cmd_index_clear(protocol_local_info.send_cmd_index);
+  protocol_cmd_index_clear(protocol_local_info.rcv_cmd_index);
+
   protocol_local_info.address = address;
   protocol_local_info.rcv_nor_callBack = protocol_rcv_pack_handle;
 
   MUTEX_INIT(boardcast_object.mutex_lock);
   INIT_LIST_HEAD(&boardcast_object.send_list_header);
   boardcast_object.is_valid = 1;
+
+#if (PROTOCOL_STREAM_ENABLE == PROTOCOL_ENABLE)
+  protocol_stream_init();
+#endif
+
+#if (PROTOCOL_FRAG_ENABLE == PROTOCOL_ENABLE)
+  protocol_frag_init();
+#endif
+
+#if (PROTOCOL_TRACE_ENABLE == PROTOCOL_ENABLE)
+  protocol_trace_init();
+#endif
+
+#if (PROTOCOL_WAIT_ENABLE == PROTOCOL_ENABLE)
+  protocol_wait_init();
+#endif
+
+#if (PROTOCOL_TIME_ENABLE == PROTOCOL_ENABLE)
+  protocol_time_init();
+#endif
+
+#if (PROTOCOL_CANTP_ENABLE == PROTOCOL_ENABLE)
+  protocol_cantp_init();
+#endif
+
   protocol_local_info.is_valid = 1;
   PROTOCOL_OTHER_INFO_PRINTF("Local info has been initialized.");
 
@@ -196,10 +503,34 @@ uint32_t protocol_local_init(uint8_t address)
   *         相同的会话号
   *         cmd 命令值
   *         p_data 发送数据指针
-  *         data_len 发送数据长度
+  *         data_len 发送数据长度，超过PROTOCOL_MAX_DATA_LEN时分片发送且不要求Ack，最大为PROTOCOL_SEND_MAX_LEN
   * @retval 协议返回状态
   */
 uint32_t protocol_send(uint8_t reciver, uint16_t cmd, void *p_data, uint32_t data_len)
+{
+  struct protocol_iov iov;
+
+  if (data_len > PROTOCOL_SEND_MAX_LEN)
+  {
+    PROTOCOL_ERR_INFO_PRINTF(PROTOCOL_ERR_DATA_TOO_LONG, __FILE__, __LINE__);
+    return PROTOCOL_ERR_DATA_TOO_LONG;
+  }
+
+  iov.base = p_data;
+  iov.len = data_len;
+
+  return protocol_sendv(reciver, cmd, &iov, 1);
+}
+
+/**
+  * @brief  协议分段发送正常帧，各数据片段按顺序直接写入帧内存，无需调用者先拼接成结构体。
+  * @param  reciver 接收设备地址
+  *         cmd 命令值
+  *         iov 数据片段数组
+  *         iov_num 数据片段数量
+  * @retval 协议返回状态
+  */
+uint32_t protocol_sendv(uint8_t reciver, uint16_t cmd, const struct protocol_iov *iov, uint8_t iov_num)
 {
   uint32_t status;
   uint8_t session = 0;
@@ -216,18 +547,29 @@ uint32_t protocol_send(uint8_t reciver, uint16_t cmd, void *p_data, uint32_t dat
     ack = cmd_info->ack_enable;
   }
 
+#if (PROTOCOL_FRAG_ENABLE == PROTOCOL_ENABLE)
+  if (protocol_s_iov_len(iov, iov_num) > PROTOCOL_MAX_DATA_LEN)
+  {
+    //超长数据分片发送，分片不要求Ack
+    status = protocol_frag_send(reciver, cmd, iov, iov_num);
+  }
+  else
+#endif
   if (reciver == PROTOCOL_BROADCAST_ADDR)
   {
-    status = protocol_s_broadcast_add_node(p_data, data_len, cmd);
+    status = protocol_s_broadcast_add_node(iov, iov_num, cmd);
   }
   else
   {
-    if (ack == 1)
+    if ((ack == 1) && (int_obj != NULL))
     {
+      //应用任务可能同时发送，session分配需互斥
+      MUTEX_LOCK(int_obj->send.mutex_lock);
       session = protocol_get_session(int_obj);
+      MUTEX_UNLOCK(int_obj->send.mutex_lock);
     }
-    status = protocol_s_add_sendnode(reciver, session, PROTOCOL_PACK_NOR, p_data,
-                                     data_len, cmd, 0);
+    status = protocol_s_add_sendnode(reciver, session, PROTOCOL_PACK_NOR, iov,
+                                     iov_num, cmd, 0);
   }
   if (status == PROTOCOL_SUCCESS)
   {
@@ -238,7 +580,7 @@ uint32_t protocol_send(uint8_t reciver, uint16_t cmd, void *p_data, uint32_t dat
   }
   else
   {
-    if (ack == 1)
+    if (session != 0)
     {
       protocol_release_session(int_obj, session);
     }
@@ -261,8 +603,19 @@ uint32_t protocol_send(uint8_t reciver, uint16_t cmd, void *p_data, uint32_t dat
 uint32_t protocol_ack(uint8_t reciver, uint8_t session, void *p_data, uint32_t data_len, uint16_t ack_seq)
 {
   uint32_t status;
-  status = protocol_s_add_sendnode(reciver, session, PROTOCOL_PACK_ACK, p_data,
-                                   data_len, 0, ack_seq);
+  struct protocol_iov iov;
+
+  if (data_len > PROTOCOL_MAX_DATA_LEN)
+  {
+    PROTOCOL_ERR_INFO_PRINTF(PROTOCOL_ERR_DATA_TOO_LONG, __FILE__, __LINE__);
+    return PROTOCOL_ERR_DATA_TOO_LONG;
+  }
+
+  iov.base = p_data;
+  iov.len = data_len;
+
+  status = protocol_s_add_sendnode(reciver, session, PROTOCOL_PACK_ACK, &iov,
+                                   1, 0, ack_seq);
   if (status == PROTOCOL_SUCCESS)
   {
     if (protocol_local_info.send_list_add_callBack != NULL)
@@ -280,18 +633,40 @@ uint32_t protocol_ack(uint8_t reciver, uint8_t session, void *p_data, uint32_t d
   */
 uint32_t protocol_send_flush(void)
 {
+#if (PROTOCOL_STREAM_ENABLE == PROTOCOL_ENABLE)
+  //流的新块、重发块与ACK先加入发送列表，随本次刷新一起发出
+  protocol_stream_flush();
+#endif
+
+#if (PROTOCOL_TIME_ENABLE == PROTOCOL_ENABLE)
+  //时间请求在发送前一刻打时间戳
+  protocol_time_flush(protocol_p_get_time());
+#endif
+
   for (uint8_t i = 0; i < PROTOCOL_INTERFACE_MAX; i++)
   {
     if (protocol_local_info.interface[i].is_valid)
     {
+      //严格优先级：控制命令最先发送，其次ACK，再依次发送普通与大块数据
       if (protocol_local_info.interface[i].send.normal_node_num > 0)
       {
-        protocol_s_interface_normal_send_flush(protocol_local_info.interface + i);
+        protocol_s_interface_normal_send_flush(protocol_local_info.interface + i, PROTOCOL_PRIORITY_CTRL);
+      }
+      if (protocol_local_info.interface[i].send.resend_num > 0)
+      {
+        protocol_s_interface_resend_flush(protocol_local_info.interface + i);
       }
       if (protocol_local_info.interface[i].send.ack_node_num > 0)
       {
         protocol_s_interface_ack_send_flush(protocol_local_info.interface + i);
       }
+      for (uint8_t prio = PROTOCOL_PRIORITY_CTRL + 1; prio < PROTOCOL_PRIORITY_NUM; prio++)
+      {
+        if (protocol_local_info.interface[i].send.normal_node_num > 0)
+        {
+          protocol_s_interface_normal_send_flush(protocol_local_info.interface + i, prio);
+        }
+      }
     }
   }
 
@@ -302,9 +677,90 @@ uint32_t protocol_send_flush(void)
       protocol_s_broadcast_send_flush();
     }
   }
+
+  //本次刷新的帧合并后一次发出
+  for (uint8_t i = 0; i < PROTOCOL_INTERFACE_MAX; i++)
+  {
+    if (protocol_local_info.interface[i].is_valid)
+    {
+      protocol_s_interface_batch_flush(protocol_local_info.interface + i);
+    }
+  }
+
+#if (PROTOCOL_CANTP_ENABLE == PROTOCOL_ENABLE)
+  //继续发送因驱动队列满或等待流控停下的分段报文
+  protocol_cantp_flush();
+#endif
   return 0;
 }
 
+/**
+  * @brief  清零各接口的收发统计与延迟直方图，也可以通过PROTOCOL_CMD_STATS_QUERY远程清零
+  * @param  void
+  * @retval void
+  */
+void protocol_stats_reset(void)
+{
+#if (PROTOCOL_STATS_ENABLE == PROTOCOL_ENABLE)
+  for (uint8_t i = 0; i < PROTOCOL_INTERFACE_MAX; i++)
+  {
+    memset(&protocol_local_info.interface[i].stats, 0, sizeof(struct protocol_stats));
+  }
+#endif
+}
+
+/**
+  * @brief  获取距下一次超时重发的时间，通信任务可据此休眠
+  * @param  void
+  * @retval 等待时间(ms)，没有等待重发的帧时返回PROTOCOL_WAIT_FOREVER
+  */
+uint32_t protocol_send_wait_time(void)
+{
+  uint32_t now;
+  uint32_t wait;
+  uint32_t wait_time = PROTOCOL_WAIT_FOREVER;
+
+  now = protocol_p_get_time();
+
+  for (uint8_t i = 0; i < PROTOCOL_INTERFACE_MAX; i++)
+  {
+    if (protocol_local_info.interface[i].is_valid)
+    {
+      wait = protocol_s_interface_resend_wait_time(protocol_local_info.interface + i, now);
+      if (wait < wait_time)
+      {
+        wait_time = wait;
+      }
+    }
+  }
+
+#if (PROTOCOL_STREAM_ENABLE == PROTOCOL_ENABLE)
+  wait = protocol_stream_wait_time(now);
+  if (wait < wait_time)
+  {
+    wait_time = wait;
+  }
+#endif
+
+#if (PROTOCOL_TIME_ENABLE == PROTOCOL_ENABLE)
+  wait = protocol_time_wait_time(now);
+  if (wait < wait_time)
+  {
+    wait_time = wait;
+  }
+#endif
+
+#if (PROTOCOL_CANTP_ENABLE == PROTOCOL_ENABLE)
+  wait = protocol_cantp_wait_time(now);
+  if (wait < wait_time)
+  {
+    wait_time = wait;
+  }
+#endif
+
+  return wait_time;
+}
+
 /**
   * @brief  协议刷新接收缓冲区，调用此函数将接收缓冲区内的数据解包。在接收数据之后或者定时调用
   * @param  void
@@ -319,6 +775,27 @@ uint32_t protocol_unpack_flush(void)
       protocol_s_extract(&(protocol_local_info.interface[i]));
     }
   }
+
+#if (PROTOCOL_CUT_THROUGH_ENABLE == PROTOCOL_ENABLE)
+  //直通转发的帧合并后立即发出，不等待下一次发送刷新
+  for (uint8_t i = 0; i < PROTOCOL_INTERFACE_MAX; i++)
+  {
+    if (protocol_local_info.interface[i].is_valid)
+    {
+      protocol_s_interface_batch_flush(protocol_local_info.interface + i);
+    }
+  }
+#endif
+
+#if (PROTOCOL_FRAG_ENABLE == PROTOCOL_ENABLE)
+  //释放超时未收齐的重组缓冲区
+  protocol_frag_expire(protocol_p_get_time());
+#endif
+
+#if (PROTOCOL_CANTP_ENABLE == PROTOCOL_ENABLE)
+  //解包腾出空间后补发延后的流控帧
+  protocol_cantp_flush();
+#endif
   return 0;
 }
 
@@ -357,6 +834,9 @@ uint32_t protocol_rcv_data(void *p_data, uint32_t data_len, struct perph_interfa
   //TODO:取消了这里的保护，因为考虑到此函数对于同一个协议接口没有重入，需要仔细思考
   //添加保护，高速传输仍然可能出现嵌套重入
   rcv_length = fifo_s_puts_noprotect(&(obj->rcvd.fifo), p_data, data_len);
+  obj->rcvd.rcv_time_us = PROTOCOL_STATS_TIME_US();
+  PROTOCOL_STATS_ADD(obj, rx_bytes, rcv_length);
+  PROTOCOL_STATS_ADD(obj, rx_overflow, data_len - rcv_length);
 
   if (rcv_length < data_len)
   {
@@ -30,9 +30,12 @@ int32_t protocol_send_cmd_config(uint16_t cmd,
                                  uint8_t resend_times,
                                  uint16_t resend_timeout,
                                  uint8_t ack_enable,
+                                 uint8_t priority,
                                  ack_handle_fn_t ack_callback,
                                  no_ack_handle_fn_t no_ack_callback);
 
+int32_t protocol_send_cmd_coalesce(uint16_t cmd, uint8_t enable);
+
 int32_t protocol_rcv_cmd_register(uint16_t cmd, rcv_handle_fn_t rcv_callback);
 
 int32_t protocol_rcv_cmd_unregister(uint16_t cmd);
@@ -42,11 +45,36 @@ uint32_t protocol_local_init(uint8_t address);
 
 uint32_t protocol_send(uint8_t reciver, uint16_t cmd, void *p_data, uint32_t data_len);
 
+uint32_t protocol_sendv(uint8_t reciver, uint16_t cmd, const struct protocol_iov *iov, uint8_t iov_num);
+
+uint32_t protocol_stream_send(uint8_t reciver, uint16_t cmd, const void *p_data, uint32_t data_len,
+                              uint8_t window, stream_done_fn_t done_callback);
+
+int32_t protocol_stream_rcv_register(uint16_t cmd, stream_rcv_fn_t rcv_callback);
+
+uint32_t protocol_send_reliable(uint8_t reciver, uint16_t cmd, void *p_data, uint32_t data_len);
+
+uint32_t protocol_wait(uint32_t token, uint32_t timeout);
+
+uint32_t protocol_poll(uint32_t token);
+
+void protocol_wait_release(uint32_t token);
+
+int32_t protocol_time_sync_start(uint8_t master, uint32_t period);
+
+uint64_t protocol_time_local_us(void);
+
+uint64_t protocol_time_now_us(void);
+
 uint32_t protocol_ack(uint8_t reciver, uint8_t session, void *p_data,
                       uint32_t data_len, uint16_t ack_seq);
 
 uint32_t protocol_send_flush(void);
 
+uint32_t protocol_send_wait_time(void);
+
+void protocol_stats_reset(void);
+
 uint32_t protocol_unpack_flush(void);
 
 uint32_t protocol_rcv_data(void *p_data, uint32_t data_len, struct perph_interface *perph);
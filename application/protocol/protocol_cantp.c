@@ -0,0 +1,697 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "protocol.h"
+#include "protocol_cantp.h"
+#include "protocol_transmit.h"
+#include "protocol_log.h"
+
+#if (PROTOCOL_CANTP_ENABLE == PROTOCOL_ENABLE)
+
+/*
+ * CAN分段传输
+ *
+ * 每次接口发送(单帧或合并后的多帧)作为一个报文，不超过7字节用单帧(SF)发送，
+ * 更长的先发首帧(FF，带12位总长度与前6字节)，等接收方回复流控帧(FC)后
+ * 再发连续帧(CF，每帧7字节，带4位序号)。
+ *
+ * 接收方收到首帧时确认接收缓冲区放得下整个报文才回复继续发送(CTS)，否则回复等待(WAIT)，
+ * 解包腾出空间后再补发CTS。空间不足期间每CANTP_WAIT_PERIOD重发WAIT，使发送方的流控超时
+ * 不断延长，双方都以PROTOCOL_CANTP_WAIT_MAX个WAIT为上限。
+ * 报文收齐后整包写入接收缓冲区，序号不连续、中途收到新的首帧或超时都只丢弃当前报文，
+ * 解包器看到的始终是完整的帧，不需要靠帧头搜索重新同步。
+ *
+ * 每个CAN帧通过接口的can_send_fn发送，发送函数需返回驱动接受的字节数，
+ * 驱动队列满时报文停在当前位置，下次刷新继续发送。持有cantp_mutex(关中断)时每次最多发送
+ * PROTOCOL_CANTP_TX_BURST帧，批与批之间开中断。驱动拒收的流控帧保留，由刷新重发。
+ */
+
+/* Private define ------------------------------------------------------------*/
+#define CANTP_SF_DATA_MAX (7u)
+#define CANTP_FF_DATA (6u)
+#define CANTP_CF_DATA (7u)
+#define CANTP_LEN_MAX (0xFFFu)
+#define CANTP_WAIT_PERIOD (PROTOCOL_CANTP_TIMEOUT / 2) /*!< WAIT Resend Period, Below The Sender Timeout */
+
+enum cantp_tx_state
+{
+  CANTP_TX_IDLE = 0,
+  CANTP_TX_FIRST,   /*!< Message Loaded, SF Or FF Not Yet Accepted By The Driver */
+  CANTP_TX_WAIT_FC, /*!< FF Or A Block Sent, Waiting For Flow Control */
+  CANTP_TX_CF,      /*!< Sending Consecutive Frames */
+};
+
+/* Private typedef -----------------------------------------------------------*/
+struct cantp_link
+{
+  struct perph_interface *perph;
+
+  fifo_s_t tx_fifo; /*!< Queued Messages, 2 Byte Length Then Data */
+  uint8_t tx_fifo_buf[PROTOCOL_CANTP_TX_BUF_SIZE];
+  uint8_t tx_msg[PROTOCOL_CANTP_MSG_MAX_LEN];
+  uint16_t tx_len;
+  uint16_t tx_off;
+  uint8_t tx_state;
+  uint8_t tx_sn;
+  uint8_t tx_bs;        /*!< Frames Left In The Block, 0 For No Limit */
+  uint8_t tx_stmin;     /*!< Gap Between Consecutive Frames(ms) */
+  uint8_t tx_wait_cnt;  /*!< Flow Control Waits Of The Current Message */
+  uint32_t tx_time;     /*!< Flow Control Deadline Or Next Consecutive Frame Time(ms) */
+
+  uint8_t rx_msg[PROTOCOL_CANTP_MSG_MAX_LEN];
+  uint16_t rx_len;
+  uint16_t rx_off;
+  uint8_t rx_active;
+  uint8_t rx_fc_pending; /*!< CTS Deferred Until The Receive FIFO Has Room */
+  uint8_t rx_fc_retry;   /*!< Flow Control Refused By The Driver, Resent From Flush */
+  uint8_t rx_fc_fs;      /*!< Flow Status Of The Refused Flow Control */
+  uint8_t rx_wait_cnt;   /*!< Flow Control Waits Sent For The Current Message */
+  uint8_t rx_sn;
+  uint8_t rx_bs;
+  uint32_t rx_time;      /*!< Last Frame Or Flow Control Wait Of The Current Message(ms) */
+
+  struct protocol_cantp_stats stats;
+};
+
+/* Private variables ---------------------------------------------------------*/
+static struct cantp_link cantp_link[PROTOCOL_CANTP_MAX];
+static MUTEX_DECLARE(cantp_mutex);
+
+extern local_info_t protocol_local_info;
+
+/* Private functions ---------------------------------------------------------*/
+
+static struct cantp_link *protocol_cantp_find(struct perph_interface *perph)
+{
+  if (perph == NULL)
+  {
+    return NULL;
+  }
+
+  for (int i = 0; i < PROTOCOL_CANTP_MAX; i++)
+  {
+    if (cantp_link[i].perph == perph)
+    {
+      return &cantp_link[i];
+    }
+  }
+  return NULL;
+}
+
+//发送一个CAN帧，驱动接受整帧时返回1
+static uint8_t protocol_cantp_frame_send(struct cantp_link *link, uint8_t *frame, uint8_t len)
+{
+  struct perph_interface *perph = link->perph;
+
+  if (perph->send_callback.can_send_fn(perph->user_data.can.send_id, frame, len) != len)
+  {
+    return 0;
+  }
+  link->stats.tx_frames++;
+  return 1;
+}
+
+//回复流控帧，驱动队列满时保留，由protocol_cantp_flush重发
+static void protocol_cantp_fc_send(struct cantp_link *link, uint8_t fs)
+{
+  uint8_t frame[8] = {0};
+
+  frame[0] = PROTOCOL_CANTP_PCI_FC | fs;
+  frame[1] = PROTOCOL_CANTP_BS;
+  frame[2] = PROTOCOL_CANTP_STMIN;
+  if (protocol_cantp_frame_send(link, frame, 3))
+  {
+    link->rx_fc_retry = 0;
+  }
+  else
+  {
+    link->rx_fc_retry = 1;
+    link->rx_fc_fs = fs;
+  }
+}
+
+//接收缓冲区放得下len字节
+static uint8_t protocol_cantp_rx_room(struct cantp_link *link, uint16_t len)
+{
+  return fifo_s_free(&(link->perph->rcvd.fifo)) >= len;
+}
+
+//推进发送，最多发送burst帧，驱动队列满、等待流控或帧间隔未到时提前返回，返回发送的帧数，调用者需持有cantp_mutex
+static uint8_t protocol_cantp_tx_run(struct cantp_link *link, uint32_t now, uint8_t burst)
+{
+  uint8_t frame[8] = {0};
+  uint8_t len_buf[2];
+  uint8_t sent = 0;
+  uint16_t n;
+
+  while (sent < burst)
+  {
+    switch (link->tx_state)
+    {
+    case CANTP_TX_IDLE:
+      if (fifo_s_used(&link->tx_fifo) < 2)
+      {
+        return sent;
+      }
+      fifo_s_gets_noprotect(&link->tx_fifo, (char *)len_buf, 2);
+      link->tx_len = len_buf[0] | (len_buf[1] << 8);
+      fifo_s_gets_noprotect(&link->tx_fifo, (char *)link->tx_msg, link->tx_len);
+      link->tx_off = 0;
+      link->tx_wait_cnt = 0;
+      link->tx_state = CANTP_TX_FIRST;
+      break;
+
+    case CANTP_TX_FIRST:
+      if (link->tx_len <= CANTP_SF_DATA_MAX)
+      {
+        frame[0] = PROTOCOL_CANTP_PCI_SF | link->tx_len;
+        memcpy(frame + 1, link->tx_msg, link->tx_len);
+        if (!protocol_cantp_frame_send(link, frame, link->tx_len + 1))
+        {
+          return sent;
+        }
+        sent++;
+        link->stats.tx_msgs++;
+        link->tx_state = CANTP_TX_IDLE;
+      }
+      else
+      {
+        frame[0] = PROTOCOL_CANTP_PCI_FF | (link->tx_len >> 8);
+        frame[1] = link->tx_len & 0xFF;
+        memcpy(frame + 2, link->tx_msg, CANTP_FF_DATA);
+        if (!protocol_cantp_frame_send(link, frame, 8))
+        {
+          return sent;
+        }
+        sent++;
+        link->tx_off = CANTP_FF_DATA;
+        link->tx_sn = 1;
+        link->tx_time = now + PROTOCOL_CANTP_TIMEOUT;
+        link->tx_state = CANTP_TX_WAIT_FC;
+      }
+      break;
+
+    case CANTP_TX_WAIT_FC:
+      if ((int32_t)(now - link->tx_time) >= 0)
+      {
+        link->stats.tx_timeout++;
+        link->tx_state = CANTP_TX_IDLE;
+        break;
+      }
+      return sent;
+
+    case CANTP_TX_CF:
+      if ((link->tx_stmin > 0) && ((int32_t)(now - link->tx_time) < 0))
+      {
+        return sent;
+      }
+      n = link->tx_len - link->tx_off;
+      if (n > CANTP_CF_DATA)
+      {
+        n = CANTP_CF_DATA;
+      }
+      frame[0] = PROTOCOL_CANTP_PCI_CF | (link->tx_sn & 0x0F);
+      memcpy(frame + 1, link->tx_msg + link->tx_off, n);
+      if (!protocol_cantp_frame_send(link, frame, n + 1))
+      {
+        return sent;
+      }
+      sent++;
+      link->tx_off += n;
+      link->tx_sn++;
+
+      if (link->tx_off >= link->tx_len)
+      {
+        link->stats.tx_msgs++;
+        link->tx_state = CANTP_TX_IDLE;
+      }
+      else if ((link->tx_bs > 0) && (--link->tx_bs == 0))
+      {
+        link->tx_time = now + PROTOCOL_CANTP_TIMEOUT;
+        link->tx_state = CANTP_TX_WAIT_FC;
+      }
+      else if (link->tx_stmin > 0)
+      {
+        link->tx_time = now + link->tx_stmin;
+      }
+      break;
+
+    default:
+      link->tx_state = CANTP_TX_IDLE;
+      break;
+    }
+  }
+
+  return sent;
+}
+
+//分批推进发送，每批持有cantp_mutex发送最多PROTOCOL_CANTP_TX_BURST帧，批与批之间开中断，在任务中调用
+static void protocol_cantp_tx_pump(struct cantp_link *link, uint32_t now)
+{
+  uint8_t sent;
+
+  do
+  {
+    MUTEX_LOCK(cantp_mutex);
+    sent = protocol_cantp_tx_run(link, now, PROTOCOL_CANTP_TX_BURST);
+    MUTEX_UNLOCK(cantp_mutex);
+  } while (sent == PROTOCOL_CANTP_TX_BURST);
+}
+
+//收到流控帧，调用者需持有cantp_mutex
+static void protocol_cantp_fc_rcv(struct cantp_link *link, uint8_t *p_data, uint32_t len, uint32_t now)
+{
+  if ((link->tx_state != CANTP_TX_WAIT_FC) || (len < 3))
+  {
+    return;
+  }
+
+  switch (p_data[0] & 0x0F)
+  {
+  case PROTOCOL_CANTP_FS_CTS:
+    link->tx_bs = p_data[1];
+    //0xF1~0xF9为百微秒级间隔，按不等待处理
+    link->tx_stmin = (p_data[2] <= 0x7F) ? p_data[2] : 0;
+    link->tx_time = now;
+    link->tx_state = CANTP_TX_CF;
+    break;
+
+  case PROTOCOL_CANTP_FS_WAIT:
+    link->stats.fc_wait++;
+    if (++link->tx_wait_cnt > PROTOCOL_CANTP_WAIT_MAX)
+    {
+      link->stats.tx_timeout++;
+      link->tx_state = CANTP_TX_IDLE;
+    }
+    else
+    {
+      link->tx_time = now + PROTOCOL_CANTP_TIMEOUT;
+    }
+    break;
+
+  default:
+    link->stats.tx_overflow++;
+    link->tx_state = CANTP_TX_IDLE;
+    break;
+  }
+
+  //中断中只发一批，其余由发送刷新继续
+  protocol_cantp_tx_run(link, now, PROTOCOL_CANTP_TX_BURST);
+}
+
+//丢弃正在接收的报文，未发出的流控帧也不再重发
+static void protocol_cantp_rx_abort(struct cantp_link *link)
+{
+  link->rx_fc_retry = 0;
+  if (link->rx_active)
+  {
+    link->rx_active = 0;
+    link->rx_fc_pending = 0;
+    link->stats.rx_abort++;
+  }
+}
+
+//报文整包写入接收缓冲区
+static void protocol_cantp_rx_deliver(struct cantp_link *link, uint8_t *p_data, uint16_t len)
+{
+  if (!protocol_cantp_rx_room(link, len))
+  {
+    link->stats.rx_overflow++;
+    return;
+  }
+  protocol_rcv_data(p_data, len, link->perph);
+  link->stats.rx_msgs++;
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  分段传输模块初始化，在protocol_local_init中调用
+  * @param  void
+  * @retval void
+  */
+void protocol_cantp_init(void)
+{
+  MUTEX_INIT(cantp_mutex);
+  memset(cantp_link, 0, sizeof(cantp_link));
+}
+
+/**
+  * @brief  为CAN_TP_PORT类型的接口分配收发状态，在protocol_interface_init中调用
+  * @param  perph 接口
+  * @retval 0 成功，-1 没有空闲的分段传输状态
+  */
+int32_t protocol_cantp_attach(struct perph_interface *perph)
+{
+  for (int i = 0; i < PROTOCOL_CANTP_MAX; i++)
+  {
+    if (cantp_link[i].perph == NULL)
+    {
+      memset(&cantp_link[i], 0, sizeof(struct cantp_link));
+      fifo_s_init(&cantp_link[i].tx_fifo, cantp_link[i].tx_fifo_buf, PROTOCOL_CANTP_TX_BUF_SIZE);
+      cantp_link[i].perph = perph;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/**
+  * @brief  报文加入接口的发送队列并立即尽量发出，由protocol_interface_send_data调用
+  * @param  perph 接口
+  *         p_data 报文
+  *         len 报文长度，不可以超过PROTOCOL_CANTP_MSG_MAX_LEN
+  * @retval 协议返回状态，队列满时丢弃整个报文
+  */
+uint32_t protocol_cantp_send(struct perph_interface *perph, uint8_t *p_data, uint16_t len)
+{
+  struct cantp_link *link;
+  uint8_t len_buf[2];
+  uint32_t status = PROTOCOL_SUCCESS;
+
+  link = protocol_cantp_find(perph);
+  if ((link == NULL) || (len == 0))
+  {
+    return PROTOCOL_ERR_INTER_NOT_FOUND;
+  }
+
+  MUTEX_LOCK(cantp_mutex);
+
+  if ((len > PROTOCOL_CANTP_MSG_MAX_LEN) || (len > CANTP_LEN_MAX))
+  {
+    link->stats.tx_drop++;
+    status = PROTOCOL_ERR_DATA_TOO_LONG;
+  }
+  else if (fifo_s_free(&link->tx_fifo) < len + 2)
+  {
+    link->stats.tx_drop++;
+    status = PROTOCOL_ERR_FIFO_FULL;
+  }
+  else
+  {
+    len_buf[0] = len & 0xFF;
+    len_buf[1] = len >> 8;
+    fifo_s_puts_noprotect(&link->tx_fifo, (char *)len_buf, 2);
+    fifo_s_puts_noprotect(&link->tx_fifo, (char *)p_data, len);
+  }
+
+  MUTEX_UNLOCK(cantp_mutex);
+
+  if (status != PROTOCOL_SUCCESS)
+  {
+    PROTOCOL_ERR_INFO_PRINTF(status, __FILE__, __LINE__);
+    return status;
+  }
+
+  protocol_cantp_tx_pump(link, protocol_p_get_time());
+  return status;
+}
+
+/**
+  * @brief  收到分段传输接口的一个CAN帧，由protocol_can_rcv_data在中断中调用
+  * @param  perph 接口
+  *         p_data CAN帧数据
+  *         len CAN帧长度
+  * @retval void
+  */
+void protocol_cantp_rcv(struct perph_interface *perph, uint8_t *p_data, uint32_t len)
+{
+  struct cantp_link *link;
+  uint32_t now;
+  uint16_t n;
+
+  link = protocol_cantp_find(perph);
+  if ((link == NULL) || (len == 0))
+  {
+    return;
+  }
+
+  now = protocol_p_get_time();
+
+  MUTEX_LOCK(cantp_mutex);
+
+  link->stats.rx_frames++;
+
+  switch (p_data[0] & 0xF0)
+  {
+  case PROTOCOL_CANTP_PCI_SF:
+    n = p_data[0] & 0x0F;
+    protocol_cantp_rx_abort(link);
+    if ((n > 0) && (n <= CANTP_SF_DATA_MAX) && (n + 1u <= len))
+    {
+      protocol_cantp_rx_deliver(link, p_data + 1, n);
+    }
+    break;
+
+  case PROTOCOL_CANTP_PCI_FF:
+    if (len < 8)
+    {
+      break;
+    }
+    protocol_cantp_rx_abort(link);
+    n = ((p_data[0] & 0x0F) << 8) | p_data[1];
+    if (n <= CANTP_SF_DATA_MAX)
+    {
+      break;
+    }
+    if (n > PROTOCOL_CANTP_MSG_MAX_LEN)
+    {
+      link->stats.rx_overflow++;
+      link->rx_time = now;
+      protocol_cantp_fc_send(link, PROTOCOL_CANTP_FS_OVFLW);
+      break;
+    }
+    memcpy(link->rx_msg, p_data + 2, CANTP_FF_DATA);
+    link->rx_len = n;
+    link->rx_off = CANTP_FF_DATA;
+    link->rx_sn = 1;
+    link->rx_bs = PROTOCOL_CANTP_BS;
+    link->rx_time = now;
+    link->rx_active = 1;
+    if (protocol_cantp_rx_room(link, n))
+    {
+      protocol_cantp_fc_send(link, PROTOCOL_CANTP_FS_CTS);
+    }
+    else
+    {
+      link->rx_fc_pending = 1;
+      link->rx_wait_cnt = 1;
+      protocol_cantp_fc_send(link, PROTOCOL_CANTP_FS_WAIT);
+    }
+    break;
+
+  case PROTOCOL_CANTP_PCI_CF:
+    if ((!link->rx_active) || (link->rx_fc_pending))
+    {
+      break;
+    }
+    if (((p_data[0] & 0x0F) != (link->rx_sn & 0x0F)) || ((uint32_t)(now - link->rx_time) > PROTOCOL_CANTP_TIMEOUT))
+    {
+      //丢帧或交织，丢弃本报文，等待下一个首帧
+      protocol_cantp_rx_abort(link);
+      break;
+    }
+    n = link->rx_len - link->rx_off;
+    if (n > CANTP_CF_DATA)
+    {
+      n = CANTP_CF_DATA;
+    }
+    if (len < n + 1u)
+    {
+      protocol_cantp_rx_abort(link);
+      break;
+    }
+    memcpy(link->rx_msg + link->rx_off, p_data + 1, n);
+    link->rx_off += n;
+    link->rx_sn++;
+    link->rx_time = now;
+
+    if (link->rx_off >= link->rx_len)
+    {
+      link->rx_active = 0;
+      protocol_cantp_rx_deliver(link, link->rx_msg, link->rx_len);
+    }
+    else if ((link->rx_bs > 0) && (--link->rx_bs == 0))
+    {
+      link->rx_bs = PROTOCOL_CANTP_BS;
+      protocol_cantp_fc_send(link, PROTOCOL_CANTP_FS_CTS);
+    }
+    break;
+
+  case PROTOCOL_CANTP_PCI_FC:
+    protocol_cantp_fc_rcv(link, p_data, len, now);
+    break;
+
+  default:
+    break;
+  }
+
+  MUTEX_UNLOCK(cantp_mutex);
+
+  //流控帧放行了报文但驱动队列已满，唤醒发送刷新继续
+  if ((link->tx_state == CANTP_TX_CF) && (protocol_local_info.send_list_add_callBack != NULL))
+  {
+    protocol_local_info.send_list_add_callBack();
+  }
+}
+
+/**
+  * @brief  继续发送各接口未发完的报文，接收缓冲区腾出空间后补发CTS，在protocol_send_flush与protocol_unpack_flush中调用
+  * @param  void
+  * @retval void
+  */
+void protocol_cantp_flush(void)
+{
+  uint32_t now;
+
+  now = protocol_p_get_time();
+
+  for (int i = 0; i < PROTOCOL_CANTP_MAX; i++)
+  {
+    struct cantp_link *link = &cantp_link[i];
+
+    if (link->perph == NULL)
+    {
+      continue;
+    }
+
+    MUTEX_LOCK(cantp_mutex);
+
+    if (link->rx_fc_retry)
+    {
+      if ((uint32_t)(now - link->rx_time) > PROTOCOL_CANTP_TIMEOUT)
+      {
+        //发送方已超时，不再回复
+        link->rx_fc_retry = 0;
+      }
+      else
+      {
+        protocol_cantp_fc_send(link, link->rx_fc_fs);
+      }
+    }
+
+    if ((link->rx_active) && (link->rx_fc_pending))
+    {
+      if (protocol_cantp_rx_room(link, link->rx_len))
+      {
+        link->rx_fc_pending = 0;
+        link->rx_time = now;
+        protocol_cantp_fc_send(link, PROTOCOL_CANTP_FS_CTS);
+      }
+      else if (link->rx_wait_cnt >= PROTOCOL_CANTP_WAIT_MAX)
+      {
+        //发送方在最后一个WAIT之后超时，放弃本报文
+        if ((uint32_t)(now - link->rx_time) > PROTOCOL_CANTP_TIMEOUT)
+        {
+          protocol_cantp_rx_abort(link);
+        }
+      }
+      else if ((uint32_t)(now - link->rx_time) >= CANTP_WAIT_PERIOD)
+      {
+        //发送方超时前重发WAIT
+        link->rx_wait_cnt++;
+        link->rx_time = now;
+        protocol_cantp_fc_send(link, PROTOCOL_CANTP_FS_WAIT);
+      }
+    }
+
+    MUTEX_UNLOCK(cantp_mutex);
+
+    protocol_cantp_tx_pump(link, now);
+  }
+}
+
+/**
+  * @brief  获取距下一次需要调用protocol_cantp_flush的时间
+  * @param  now 当前时间(ms)
+  * @retval 等待时间(ms)，没有未发完的报文时返回PROTOCOL_WAIT_FOREVER
+  */
+uint32_t protocol_cantp_wait_time(uint32_t now)
+{
+  uint32_t wait_time = PROTOCOL_WAIT_FOREVER;
+  uint32_t wait;
+  uint32_t tx_wait;
+
+  for (int i = 0; i < PROTOCOL_CANTP_MAX; i++)
+  {
+    struct cantp_link *link = &cantp_link[i];
+
+    if (link->perph == NULL)
+    {
+      continue;
+    }
+
+    if (link->rx_fc_retry)
+    {
+      wait = 1;
+    }
+    else if ((link->rx_active) && (link->rx_fc_pending))
+    {
+      //解包腾出空间时会调用刷新，这里只需等到下一次重发WAIT或放弃报文
+      wait = (link->rx_wait_cnt >= PROTOCOL_CANTP_WAIT_MAX) ? PROTOCOL_CANTP_TIMEOUT + 1 : CANTP_WAIT_PERIOD;
+      wait = ((int32_t)(link->rx_time + wait - now) > 0) ? (link->rx_time + wait - now) : 0;
+    }
+    else
+    {
+      wait = PROTOCOL_WAIT_FOREVER;
+    }
+
+    if ((link->tx_state == CANTP_TX_WAIT_FC) || ((link->tx_state == CANTP_TX_CF) && (link->tx_stmin > 0)))
+    {
+      tx_wait = ((int32_t)(link->tx_time - now) > 0) ? (link->tx_time - now) : 0;
+      wait = (tx_wait < wait) ? tx_wait : wait;
+    }
+    else if ((link->tx_state != CANTP_TX_IDLE) || (fifo_s_used(&link->tx_fifo) > 0))
+    {
+      //驱动队列满，稍后重试
+      wait = (wait > 1) ? 1 : wait;
+    }
+
+    if (wait < wait_time)
+    {
+      wait_time = wait;
+    }
+  }
+
+  return wait_time;
+}
+
+/**
+  * @brief  读取分段传输接口的统计
+  * @param  name 接口名
+  *         stats 统计输出
+  * @retval 0 成功，-1 接口不存在或不是分段传输接口
+  */
+int32_t protocol_cantp_get_stats(const char *name, struct protocol_cantp_stats *stats)
+{
+  struct cantp_link *link;
+
+  link = protocol_cantp_find(protocol_get_interface(name));
+  if (link == NULL)
+  {
+    return -1;
+  }
+
+  MUTEX_LOCK(cantp_mutex);
+  memcpy(stats, &link->stats, sizeof(struct protocol_cantp_stats));
+  MUTEX_UNLOCK(cantp_mutex);
+
+  return 0;
+}
+
+#endif /* PROTOCOL_CANTP_ENABLE */
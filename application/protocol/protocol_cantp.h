@@ -0,0 +1,77 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef _PROTOCOL_CANTP_H_
+#define _PROTOCOL_CANTP_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "protocol_common.h"
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Counters Of One Segmented CAN Interface */
+struct protocol_cantp_stats
+{
+  uint32_t tx_msgs;     /*!< Messages Sent Completely */
+  uint32_t tx_frames;   /*!< CAN Frames Accepted By The Driver */
+  uint32_t tx_drop;     /*!< Messages Dropped, Queue Full Or Too Long */
+  uint32_t tx_timeout;  /*!< Messages Aborted Waiting For Flow Control */
+  uint32_t tx_overflow; /*!< Messages Refused By The Receiver */
+  uint32_t fc_wait;     /*!< Flow Control Wait Frames Received */
+  uint32_t rx_msgs;     /*!< Messages Reassembled And Handed To The Unpacker */
+  uint32_t rx_frames;   /*!< CAN Frames Received */
+  uint32_t rx_abort;    /*!< Messages Dropped On Lost Or Interleaved Frames */
+  uint32_t rx_overflow; /*!< Messages Refused, Too Long Or No Room In The Receive FIFO */
+};
+
+/* Exported constants --------------------------------------------------------*/
+/* Protocol Control Information, High Nibble Of The First Byte */
+#define PROTOCOL_CANTP_PCI_SF (0x00u) /*!< Single Frame, Low Nibble Is Length */
+#define PROTOCOL_CANTP_PCI_FF (0x10u) /*!< First Frame, 12 Bit Length */
+#define PROTOCOL_CANTP_PCI_CF (0x20u) /*!< Consecutive Frame, Low Nibble Is Sequence Number */
+#define PROTOCOL_CANTP_PCI_FC (0x30u) /*!< Flow Control, Low Nibble Is Flow Status */
+
+#define PROTOCOL_CANTP_FS_CTS (0u)    /*!< Continue To Send */
+#define PROTOCOL_CANTP_FS_WAIT (1u)   /*!< Wait For Another Flow Control */
+#define PROTOCOL_CANTP_FS_OVFLW (2u)  /*!< Message Too Long, Abort */
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported functions --------------------------------------------------------*/
+
+//分段传输初始化
+void protocol_cantp_init(void);
+
+//为分段传输接口分配收发状态
+int32_t protocol_cantp_attach(struct perph_interface *perph);
+
+//报文加入接口的发送队列
+uint32_t protocol_cantp_send(struct perph_interface *perph, uint8_t *p_data, uint16_t len);
+
+//收到一个CAN帧
+void protocol_cantp_rcv(struct perph_interface *perph, uint8_t *p_data, uint32_t len);
+
+//继续发送未发完的报文，回复延后的流控帧
+void protocol_cantp_flush(void);
+
+//距下一次超时检查或继续发送的时间
+uint32_t protocol_cantp_wait_time(uint32_t now);
+
+//读取接口统计
+int32_t protocol_cantp_get_stats(const char *name, struct protocol_cantp_stats *stats);
+
+#endif /* _PROTOCOL_CANTP_H_ */
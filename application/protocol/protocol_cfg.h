@@ -22,7 +22,8 @@
 
 #define PROTOCOL_VERSION                (0)                 /*协议版本*/
 
-#define PROTOCOL_CMD_MAX_NUM            (50)
+#define PROTOCOL_CMD_MAX_NUM            (100)               /*收发命令各自最大注册数量(不可以超过254)*/
+#define PROTOCOL_CMD_HASH_BITS          (8)                 /*命令索引哈希表位数，表长需大于PROTOCOL_CMD_MAX_NUM的两倍*/
 
 #define PROTOCOL_DEV_VERSION            ("V0.0.6")          /*协议开发版本号*/
 
@@ -32,15 +33,84 @@
 #define PROTOCOL_OBJ_NAME_MAX_LEN       (32)                /*协议接口名字符串最大长度*/
 #define PROTOCOL_ROUTE_TABLE_MAX_NUM    (254)               /*协议路由最大条数(不可以超过255)*/ 
 
-#define PROTOCOL_SEND_DBG_PRINTF_SET    PROTOCOL_ENABLE     /*协议发送信息输出使能*/
-#define PROTOCOL_SEND_ERR_PRINTF_SET    PROTOCOL_ENABLE     /*协议发送信息输出使能*/
-#define PROTOCOL_RCV_DBG_PRINTF_SET     PROTOCOL_ENABLE     /*协议接收信息输出使能*/
-#define PROTOCOL_RCV_ERR_PRINTF_SET     PROTOCOL_ENABLE     /*协议接收信息输出使能*/
-#define PROTOCOL_ERR_INFO_PRINTF_SET    PROTOCOL_ENABLE     /*协议错误信息输出使能*/
-#define PROTOCOL_OTHER_INFO_PRINTF_SET  PROTOCOL_ENABLE     /*协议其他信息输出使能*/
+/* 文本日志等级，高于等级的日志在编译时去除，不产生任何代码；文本日志经ulog格式化输出，收发日志调试时才打开 */
+#define PROTOCOL_SEND_LOG_LVL           PROTOCOL_LOG_LVL_NONE /*协议发送日志等级*/
+#define PROTOCOL_RCV_LOG_LVL            PROTOCOL_LOG_LVL_NONE /*协议接收与转发日志等级*/
+#define PROTOCOL_COMMON_LOG_LVL         PROTOCOL_LOG_LVL_ERR  /*协议错误状态与接口等其他日志等级，默认保留错误状态输出*/
+
+/* 二进制事件跟踪，只记录事件号与整数参数，不做格式化，可在比赛中保持开启 */
+#define PROTOCOL_TRACE_ENABLE           PROTOCOL_ENABLE     /*协议事件跟踪使能*/
+#define PROTOCOL_TRACE_SIZE             (64)                /*事件环形缓冲区大小，必须为2的幂*/
+#define PROTOCOL_TRACE_RATE             (8)                 /*每约1ms最多记录的事件数量*/
+
+/* 发送节点与接收帧内存池，每块大小需覆盖PROTOCOL_SEND_NODE_SIZE + PROTOCOL_PACK_HEAD_TAIL_SIZE + 命令码 + 数据 */
+#define PROTOCOL_MEM_POOL_ENABLE        PROTOCOL_ENABLE     /*协议内存池使能，关闭时全部使用heap_malloc*/
+#define PROTOCOL_MEM_POOL_S_SIZE        (64)                /*小包内存块大小*/
+#define PROTOCOL_MEM_POOL_S_NUM         (32)                /*小包内存块数量*/
+#define PROTOCOL_MEM_POOL_M_SIZE        (128)
+#define PROTOCOL_MEM_POOL_M_NUM         (32)
+#define PROTOCOL_MEM_POOL_L_SIZE        (256)
+#define PROTOCOL_MEM_POOL_L_NUM         (8)
+#define PROTOCOL_MEM_POOL_XL_SIZE       (PROTOCOL_SEND_NODE_SIZE + PROTOCOL_FRAME_MAX_SIZE) /*最大包: 发送节点 + 满长帧，STM32上为582*/
+#define PROTOCOL_MEM_POOL_XL_NUM        (4)
+
+/* 发送刷新时将同一接口的多个帧合并为一次发送，减少USB传输与CAN不满8字节的尾帧 */
+#define PROTOCOL_TX_BATCH_ENABLE        PROTOCOL_ENABLE     /*协议发送帧合并使能*/
+#define PROTOCOL_TX_BATCH_SIZE          (256)               /*每个接口合并发送缓冲区大小*/
+
+/* 自适应重发超时，resend_timeout配置为PROTOCOL_RESEND_TIMEOUT_AUTO的命令按接口RTT估计重发 */
+#define PROTOCOL_RTO_INIT               (100)               /*尚无RTT样本时的重发超时(ms)*/
+#define PROTOCOL_RTO_MIN                (5)                 /*重发超时下限(ms)*/
+#define PROTOCOL_RTO_MAX                (1000)              /*重发超时上限，包括退避后(ms)*/
+
+/* 滑动窗口可靠流，用于标定表、日志等多帧数据的连续传输 */
+#define PROTOCOL_STREAM_ENABLE          PROTOCOL_ENABLE     /*协议可靠流使能*/
+#define PROTOCOL_STREAM_TX_MAX          (2)                 /*同时发送的流数量*/
+#define PROTOCOL_STREAM_RX_MAX          (2)                 /*同时接收的流数量*/
+#define PROTOCOL_STREAM_WINDOW_MAX      (32)                /*最大发送窗口(块)，不可以超过32*/
+#define PROTOCOL_STREAM_CHUNK_SIZE      (128)               /*每块数据长度，不可以超过PROTOCOL_MAX_DATA_LEN - 6*/
+#define PROTOCOL_STREAM_TIMEOUT         (100)               /*未配置命令时每块的重发超时(ms)*/
+#define PROTOCOL_STREAM_RETRY_MAX       (10)                /*未配置命令时每块的最大重发次数*/
+
+/* 超过PROTOCOL_MAX_DATA_LEN的数据自动分片发送，接收方重组后整包交给接收回调 */
+#define PROTOCOL_FRAG_ENABLE            PROTOCOL_ENABLE     /*协议分片使能*/
+#define PROTOCOL_FRAG_MAX_LEN           (4096)              /*分片发送的最大数据长度，不可以超过32 * (PROTOCOL_MAX_DATA_LEN - 6)*/
+#define PROTOCOL_FRAG_RX_MAX            (2)                 /*同时重组的数据包数量，每个占用一块数据长度的内存*/
+#define PROTOCOL_FRAG_TIMEOUT           (100)               /*收到首个分片后等待其余分片的时间(ms)*/
+
+/* 接口收发计数与log2延迟直方图，只有加法与查表，比赛时可保持开启 */
+#define PROTOCOL_STATS_ENABLE           PROTOCOL_ENABLE     /*协议接口统计使能*/
+#define PROTOCOL_STATS_HIST_NUM         (16)                /*延迟直方图桶数，第i桶为[2^(i-1), 2^i)us，最后一桶包含更长的延迟*/
+
+/* 可靠发送令牌：protocol_send_reliable返回令牌，任务用protocol_wait阻塞等待Ack或用protocol_poll查询 */
+#define PROTOCOL_WAIT_ENABLE            PROTOCOL_ENABLE     /*协议可靠发送令牌使能*/
+#define PROTOCOL_WAIT_MAX               (16)                /*同时未取回结果的令牌数量，不可以超过255*/
+#define PROTOCOL_WAIT_SIGNAL            (1 << 7)            /*唤醒等待任务的信号位，调用protocol_wait的任务不可以另作他用*/
+
+/* 时间同步：周期向主设备发送时间请求，按往返时间戳估计本地时钟相对主设备的偏移与频偏 */
+#define PROTOCOL_TIME_ENABLE            PROTOCOL_ENABLE     /*协议时间同步使能*/
+#define PROTOCOL_TIME_FILTER            (8)                 /*保留最近样本的往返延迟数量，用于挑选排队最少的样本*/
+#define PROTOCOL_TIME_JITTER            (200)               /*往返延迟超过最近最小值该值以上的样本丢弃(us)*/
+#define PROTOCOL_TIME_STEP              (10000)             /*偏差超过该值时直接跳变，不做平滑(us)*/
+#define PROTOCOL_TIME_DRIFT_MAX         (500)               /*频偏估计上限(ppm)*/
+
+/* CAN分段传输：CAN_TP_PORT接口的每次发送作为一个报文，按单帧/首帧/连续帧/流控帧发送，丢帧或交织只丢弃当前报文 */
+#define PROTOCOL_CANTP_ENABLE           PROTOCOL_ENABLE     /*协议CAN分段传输使能*/
+#define PROTOCOL_CANTP_MAX              (1)                 /*分段传输接口数量，每个接口约占5.8KB*/
+#define PROTOCOL_CANTP_MSG_MAX_LEN      (600)               /*最大报文长度，不可以小于PROTOCOL_FRAME_MAX_SIZE与PROTOCOL_TX_BATCH_SIZE，不可以超过4095*/
+#define PROTOCOL_CANTP_TX_BUF_SIZE      (4608)              /*每个接口发送队列大小，需放得下一次刷新发出的全部报文(PROTOCOL_FRAG_MAX_LEN分片后约4.3KB)，放不下的报文整个丢弃*/
+#define PROTOCOL_CANTP_BS               (0)                 /*接收方允许连续发送的帧数，0为不限*/
+#define PROTOCOL_CANTP_STMIN            (0)                 /*接收方要求的连续帧间隔(ms)*/
+#define PROTOCOL_CANTP_TIMEOUT          (20)                /*等待流控帧或下一连续帧的时间(ms)*/
+#define PROTOCOL_CANTP_WAIT_MAX         (8)                 /*每个报文最多接受的等待流控帧数量*/
+#define PROTOCOL_CANTP_TX_BURST         (8)                 /*每次关中断最多交给驱动的CAN帧数量，流控帧中断中只发一批，其余由发送刷新分批发出*/
 
 #define PROTOCOL_AUTO_LOOKBACK          PROTOCOL_ENABLE     /*协议自动回环使能*/
 
 #define PROTOCOL_ROUTE_FOWARD           PROTOCOL_ENABLE     /*协议路由转发使能*/
 
+/* 直通转发：目标接口没有排队的帧时，转发帧直接从接收缓冲区发出，不分配内存、不进入发送列表，
+   需要在同一任务中调用protocol_unpack_flush与protocol_send_flush */
+#define PROTOCOL_CUT_THROUGH_ENABLE     PROTOCOL_ENABLE     /*协议直通转发使能*/
+
 #endif /* _PROTOCOL_CFG_H_ */
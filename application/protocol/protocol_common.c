@@ -24,14 +24,52 @@
 /******************USER INCLUDE************************/
 #include "cmsis_os.h"
 
+/* Private variables ---------------------------------------------------------*/
+#if (PROTOCOL_MEM_POOL_ENABLE == PROTOCOL_ENABLE)
+static struct mem_pool protocol_mem_pool;
+static MEM_POOL_STORAGE_DECLARE(pool_s_buf, PROTOCOL_MEM_POOL_S_SIZE, PROTOCOL_MEM_POOL_S_NUM);
+static MEM_POOL_STORAGE_DECLARE(pool_m_buf, PROTOCOL_MEM_POOL_M_SIZE, PROTOCOL_MEM_POOL_M_NUM);
+static MEM_POOL_STORAGE_DECLARE(pool_l_buf, PROTOCOL_MEM_POOL_L_SIZE, PROTOCOL_MEM_POOL_L_NUM);
+static MEM_POOL_STORAGE_DECLARE(pool_xl_buf, PROTOCOL_MEM_POOL_XL_SIZE, PROTOCOL_MEM_POOL_XL_NUM);
+
+/* 最大类必须放得下满长帧的发送节点，否则满长帧会退回heap_malloc */
+typedef char protocol_mem_pool_xl_size_check[(PROTOCOL_MEM_POOL_XL_SIZE >= PROTOCOL_SEND_NODE_SIZE + PROTOCOL_FRAME_MAX_SIZE) ? 1 : -1];
+#endif
+
 /* Exported functions --------------------------------------------------------*/
+/**
+  * @brief  协议内存池初始化，在protocol_local_init中调用，需在任何protocol_p_malloc之前完成
+  * @param  void
+  * @retval void
+  */
+void protocol_p_mem_init(void)
+{
+#if (PROTOCOL_MEM_POOL_ENABLE == PROTOCOL_ENABLE)
+  mem_pool_init(&protocol_mem_pool);
+  mem_pool_add_class(&protocol_mem_pool, pool_s_buf, PROTOCOL_MEM_POOL_S_SIZE, PROTOCOL_MEM_POOL_S_NUM);
+  mem_pool_add_class(&protocol_mem_pool, pool_m_buf, PROTOCOL_MEM_POOL_M_SIZE, PROTOCOL_MEM_POOL_M_NUM);
+  mem_pool_add_class(&protocol_mem_pool, pool_l_buf, PROTOCOL_MEM_POOL_L_SIZE, PROTOCOL_MEM_POOL_L_NUM);
+  mem_pool_add_class(&protocol_mem_pool, pool_xl_buf, PROTOCOL_MEM_POOL_XL_SIZE, PROTOCOL_MEM_POOL_XL_NUM);
+#endif
+}
+
 /**
   * @brief  协议内存分配接口函数，用户可以根据实际情况对本函数进行修改
+  *         发送节点和数据帧优先从定长内存池分配(O(1)，无碎片)，内存池不足或超出最大块时退回heap_malloc
   * @param  size 需要分配内存大小，单位为字节
   * @retval 若分配成功返回分配内存的首地址指针，否则返回NULL
   */
 void *protocol_p_malloc(uint32_t size)
 {
+#if (PROTOCOL_MEM_POOL_ENABLE == PROTOCOL_ENABLE)
+  void *ptr;
+
+  ptr = mem_pool_alloc(&protocol_mem_pool, size);
+  if (ptr != NULL)
+  {
+    return ptr;
+  }
+#endif
   return heap_malloc(size);
 }
 
@@ -42,9 +80,29 @@ void *protocol_p_malloc(uint32_t size)
   */
 void protocol_p_free(void *ptr)
 {
+#if (PROTOCOL_MEM_POOL_ENABLE == PROTOCOL_ENABLE)
+  if (mem_pool_free(&protocol_mem_pool, ptr) == 0)
+  {
+    return;
+  }
+#endif
   heap_free(ptr);
 }
 
+/**
+  * @brief  获取协议内存池，可读取每个块大小的使用量和历史最大使用量
+  * @param  void
+  * @retval 内存池指针，未使能内存池时返回NULL
+  */
+struct mem_pool *protocol_p_get_mem_pool(void)
+{
+#if (PROTOCOL_MEM_POOL_ENABLE == PROTOCOL_ENABLE)
+  return &protocol_mem_pool;
+#else
+  return NULL;
+#endif
+}
+
 /**
   * @brief  协议获取系统时间接口函数(毫秒)，用户可以根据实际情况对本函数进行修改
   * @param  void
@@ -54,3 +112,67 @@ uint32_t protocol_p_get_time(void)
 {
   return osKernelSysTick() / portTICK_PERIOD_MS;
 }
+
+/**
+  * @brief  协议获取系统时间接口函数(微秒)，用于延迟统计，用户可以根据实际情况对本函数进行修改
+  * @param  void
+  * @retval 当前系统时间,单位为微秒，约71分钟回绕一次
+  */
+uint32_t protocol_p_get_time_us(void)
+{
+  //板级时间戳已处理读取期间的毫秒进位和关中断时未执行的毫秒中断
+  return get_time_stamp_us();
+}
+
+/**
+  * @brief  协议CPU周期计数初始化，在protocol_local_init中调用，用于统计关中断时长
+  * @param  void
+  * @retval void
+  */
+void protocol_p_cycles_init(void)
+{
+#if (PROTOCOL_STATS_ENABLE == PROTOCOL_ENABLE)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+/**
+  * @brief  协议获取CPU周期计数接口函数，用于统计关中断时长，用户可以根据实际情况对本函数进行修改
+  * @param  void
+  * @retval DWT周期计数，168MHz下约25秒回绕一次
+  */
+uint32_t protocol_p_get_cycles(void)
+{
+  return DWT->CYCCNT;
+}
+
+/**
+  * @brief  协议获取当前任务接口函数，用于可靠发送令牌的等待，用户可以根据实际情况对本函数进行修改
+  * @param  void
+  * @retval 当前任务句柄
+  */
+void *protocol_p_get_thread(void)
+{
+  return osThreadGetId();
+}
+
+/**
+  * @brief  协议唤醒等待任务接口函数，发送PROTOCOL_WAIT_SIGNAL任务通知，用户可以根据实际情况对本函数进行修改
+  * @param  thread protocol_p_get_thread取得的任务句柄
+  * @retval void
+  */
+void protocol_p_signal(void *thread)
+{
+  osSignalSet((osThreadId)thread, PROTOCOL_WAIT_SIGNAL);
+}
+
+/**
+  * @brief  协议任务等待接口函数，阻塞到收到PROTOCOL_WAIT_SIGNAL或超时，用户可以根据实际情况对本函数进行修改
+  * @param  timeout 最长等待时间(ms)，PROTOCOL_WAIT_FOREVER时一直等待
+  * @retval void
+  */
+void protocol_p_signal_wait(uint32_t timeout)
+{
+  osSignalWait(PROTOCOL_WAIT_SIGNAL, timeout);
+}
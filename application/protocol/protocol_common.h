@@ -23,23 +23,81 @@
 #include <stdint.h>
 #include <string.h>
 
-#include "protocol_cfg.h"
-#include "protocol_interface.h"
-
 /* Exported define -----------------------------------------------------------*/
 /********************DEFINE COMMON************************/
+//需在配置与接口头文件之前定义，头文件中的PROTOCOL_XXX_ENABLE条件才有效
 #define PROTOCOL_DISENABLE (0)
 #define PROTOCOL_ENABLE (1)
 
+#define PROTOCOL_LOG_LVL_NONE (0) /*!< No Text Log */
+#define PROTOCOL_LOG_LVL_ERR (1)  /*!< Errors Only */
+#define PROTOCOL_LOG_LVL_INFO (2) /*!< Errors And Infos */
+#define PROTOCOL_LOG_LVL_DBG (3)  /*!< Everything, Including Per Frame Logs */
+
+#include "protocol_cfg.h"
+#include "protocol_interface.h"
+
 /********************DEFINE PACK**************************/
 #define PROTOCOL_PACK_HEAD_TAIL_SIZE (sizeof(protocol_pack_desc_t) + sizeof(crc32_t))
 #define PROTOCOL_PACK_HEAD_SIZE (sizeof(protocol_pack_desc_t))
 #define PROTOCOL_PACK_CMD_SIZE (2)
 #define PROTOCOL_PACK_TAIL_SIZE (sizeof(crc32_t))
 #define PROTOCOL_SEND_NODE_SIZE (sizeof(send_list_node_t))
+#define PROTOCOL_FRAME_MAX_SIZE (PROTOCOL_MAX_DATA_LEN + PROTOCOL_PACK_HEAD_TAIL_SIZE + PROTOCOL_PACK_CMD_SIZE)
+
+#if (PROTOCOL_FRAG_ENABLE == PROTOCOL_ENABLE)
+#define PROTOCOL_SEND_MAX_LEN (PROTOCOL_FRAG_MAX_LEN)
+#else
+#define PROTOCOL_SEND_MAX_LEN (PROTOCOL_MAX_DATA_LEN)
+#endif
 
 #define PROTOCOL_BROADCAST_ADDR (0xFF)
 
+#define PROTOCOL_WAIT_FOREVER (0xFFFFFFFFu)
+#define PROTOCOL_RESEND_TIMEOUT_AUTO (0xFFFFu) /*!< resend_timeout Follows The Interface RTT Estimate */
+#define PROTOCOL_HEAP_IDX_NONE (0xFFu)
+#define PROTOCOL_WAIT_TOKEN_NONE (0u) /*!< Invalid Reliable Send Token */
+
+/********************DEFINE CMD INDEX**********************/
+#define PROTOCOL_CMD_HASH_SIZE (1u << PROTOCOL_CMD_HASH_BITS)
+#define PROTOCOL_CMD_HASH_MASK (PROTOCOL_CMD_HASH_SIZE - 1)
+#define PROTOCOL_CMD_INVALID (0xFFFFu)
+
+/********************DEFINE STREAM CMD*********************/
+#define PROTOCOL_CMD_STREAM_DATA (0xFFF0u) /*!< Reserved, Stream Data Chunk */
+#define PROTOCOL_CMD_STREAM_ACK (0xFFF1u)  /*!< Reserved, Stream Cumulative/Selective Ack */
+#define PROTOCOL_CMD_FRAG (0xFFF2u)        /*!< Reserved, Fragment Of A Payload Beyond PROTOCOL_MAX_DATA_LEN */
+#define PROTOCOL_CMD_RTT_QUERY (0xFFF3u)   /*!< Reserved, Request RTT Estimate Of Every Interface */
+#define PROTOCOL_CMD_RTT_INFO (0xFFF4u)    /*!< Reserved, Reply Of PROTOCOL_CMD_RTT_QUERY */
+#define PROTOCOL_CMD_STATS_QUERY (0xFFF5u) /*!< Reserved, Request Statistics, Optional uint8_t Reset Flag */
+#define PROTOCOL_CMD_STATS_INFO (0xFFF6u)  /*!< Reserved, Reply Of PROTOCOL_CMD_STATS_QUERY, One Per Interface */
+#define PROTOCOL_CMD_TRACE_QUERY (0xFFF7u) /*!< Reserved, Request And Remove Buffered Trace Events */
+#define PROTOCOL_CMD_TRACE_INFO (0xFFF8u)  /*!< Reserved, Reply Of PROTOCOL_CMD_TRACE_QUERY */
+#define PROTOCOL_CMD_TIME_REQ (0xFFF9u)    /*!< Reserved, Time Sync Request */
+#define PROTOCOL_CMD_TIME_RESP (0xFFFAu)   /*!< Reserved, Reply Of PROTOCOL_CMD_TIME_REQ */
+
+/********************DEFINE STATS**************************/
+#if (PROTOCOL_STATS_ENABLE == PROTOCOL_ENABLE)
+#define PROTOCOL_STATS_ADD(obj, field, n) ((obj)->stats.field += (n))
+#define PROTOCOL_STATS_MAX(obj, field, v) \
+  do                                      \
+  {                                       \
+    if ((v) > (obj)->stats.field)         \
+    {                                     \
+      (obj)->stats.field = (v);           \
+    }                                     \
+  } while (0)
+#define PROTOCOL_STATS_HIST(obj, hist, us) protocol_s_stats_hist((obj)->stats.hist, (us))
+#define PROTOCOL_STATS_TIME_US() protocol_p_get_time_us()
+#define PROTOCOL_STATS_CYCLES() protocol_p_get_cycles()
+#else
+#define PROTOCOL_STATS_ADD(obj, field, n)
+#define PROTOCOL_STATS_MAX(obj, field, v)
+#define PROTOCOL_STATS_HIST(obj, hist, us)
+#define PROTOCOL_STATS_TIME_US() (0u)
+#define PROTOCOL_STATS_CYCLES() (0u)
+#endif
+
 /********************DEFINE ERROR**************************/
 #define PROTOCOL_SUCCESS (0u)
 #define PROTOCOL_ERR_DATA_TOO_LONG (1u)
@@ -60,6 +118,11 @@
 #define PROTOCOL_ERR_PROTOCOL_NOT_INIT (16u)
 #define PROTOCOL_ERR_SESSION_ERROR (17u)
 #define PROTOCOL_ERR_REGISTER_FAILED (18u)
+#define PROTOCOL_ERR_STREAM_TIMEOUT (19u)
+#define PROTOCOL_ERR_NO_ACK (20u)
+#define PROTOCOL_ERR_WAIT_PENDING (21u)
+#define PROTOCOL_ERR_TOKEN_INVALID (22u)
+#define PROTOCOL_ERR_WAIT_FULL (23u)
 
 /* Exported types ------------------------------------------------------------*/
 /********************CALLBACK TYPEDEF**********************/
@@ -69,12 +132,15 @@ typedef void (*void_fn_t)(void);
 typedef int32_t (*ack_handle_fn_t)(int32_t err);
 typedef int32_t (*no_ack_handle_fn_t)(uint16_t cmd);
 typedef int32_t (*rcv_handle_fn_t)(uint8_t *buff, uint16_t len);
+typedef void (*stream_done_fn_t)(uint16_t cmd, uint32_t status);
+typedef int32_t (*stream_rcv_fn_t)(uint8_t *buff, uint16_t len, uint32_t offset, uint8_t is_last);
 
 struct rcv_cmd_info
 {
   uint8_t used;
   uint16_t cmd;
   rcv_handle_fn_t rcv_callback;
+  stream_rcv_fn_t stream_callback; /*!< Stream Chunks With Offset, rcv_callback Used When NULL */
 };
 
 struct send_cmd_info
@@ -82,12 +148,21 @@ struct send_cmd_info
   uint8_t used;
   uint16_t cmd;
   uint8_t ack_enable;
+  uint8_t priority;        /*!< Send Priority, PROTOCOL_PRIORITY_XXX */
   uint8_t resend_times;    /*!< Send Times */
   uint16_t resend_timeout; /*!< Time Interval */
+  uint8_t coalesce;        /*!< Newer Frame Replaces The Queued One Of Same Cmd And Address */
   ack_handle_fn_t ack_callback;
   no_ack_handle_fn_t no_ack_callback;
 };
 
+/* Open addressed index slot, maps a cmd to its rcv_cmd_info/send_cmd_info entry */
+struct cmd_index_slot
+{
+  uint16_t cmd; /*!< PROTOCOL_CMD_INVALID When Empty */
+  uint8_t idx;  /*!< Entry Index In The Cmd Info Table */
+};
+
 /********************FRAME STRUCT**************************/
 #ifdef __CC_ARM /* for keil compiler */
 #pragma anon_unions
@@ -144,6 +219,28 @@ typedef struct
   uint8_t pdata[];
 } protocol_pack_desc_t;
 
+/* Payload Of PROTOCOL_CMD_RTT_INFO, One Entry For Each Valid Interface */
+struct protocol_rtt_info
+{
+  uint8_t idx;           /*!< Interface Index */
+  uint16_t srtt;         /*!< Smoothed RTT(ms) */
+  uint16_t rttvar;       /*!< RTT Variation(ms) */
+  uint16_t rto;          /*!< Retransmission Timeout(ms) */
+  uint32_t sample_cnt;   /*!< RTT Samples */
+  uint32_t spurious_cnt; /*!< Unnecessary Resends */
+  uint32_t needed_cnt;   /*!< Necessary Resends */
+  uint32_t no_ack_cnt;   /*!< Frames Given Up */
+};
+
+#if (PROTOCOL_STATS_ENABLE == PROTOCOL_ENABLE)
+/* Payload Of PROTOCOL_CMD_STATS_INFO */
+struct protocol_stats_info
+{
+  uint8_t idx;                 /*!< Interface Index */
+  struct protocol_stats stats; /*!< All Fields Are uint32_t, No Padding */
+};
+#endif
+
 typedef uint32_t crc32_t;
 
 #pragma pack(pop)
@@ -174,8 +271,6 @@ typedef struct send_list_node
   uint8_t *p_data;                         /*!< Pointer To Data Include Pack Header */
   uint16_t len;                            /*!< Length Of Data Include Pack Header */
   uint8_t seq;                             /*!< Sequence Number */
-  uint8_t is_got_ack;                      /*!< Is Got Ack */
-  uint8_t is_ready_realse;                 /*!< Is Ready Realse */
   uint8_t session;                         /*!< Session Number */
   uint8_t address;                         /*!< Address */
   uint16_t cmd;                            /*!< CMD */
@@ -183,7 +278,10 @@ typedef struct send_list_node
   uint8_t rest_cnt;                        /*!< The Remaining Number Of Transmissions */
   uint16_t timeout;                        /*!< Time Interval Between Each Transmissions*/
   uint32_t pre_timestamp;                  /*!< Last Sent Timestamp */
-  uint8_t is_first_send;                   /*!< Is First Send */
+  uint32_t deadline;                       /*!< Next Resend Timestamp */
+  uint32_t enqueue_time;                   /*!< Timestamp(us) When Added To The Send List */
+  uint8_t heap_idx;                        /*!< Index In Resend Heap */
+  uint8_t send_cnt;                        /*!< Transmissions So Far */
   struct perph_interface *forward_src_obj; /*!< Foward Src Interface Object */
   ack_handle_fn_t ack_callback;
   no_ack_handle_fn_t no_ack_callback;
@@ -201,6 +299,8 @@ typedef struct
 
   struct rcv_cmd_info rcv_cmd_info[PROTOCOL_CMD_MAX_NUM];
   struct send_cmd_info send_cmd_info[PROTOCOL_CMD_MAX_NUM];
+  struct cmd_index_slot rcv_cmd_index[PROTOCOL_CMD_HASH_SIZE];
+  struct cmd_index_slot send_cmd_index[PROTOCOL_CMD_HASH_SIZE];
   
   struct perph_interface interface[PROTOCOL_INTERFACE_MAX];
 
@@ -208,6 +308,13 @@ typedef struct
   MUTEX_DECLARE(mutex_lock);
 } local_info_t;
 
+/* This Struct Is Used To Describe One Payload Fragment Of protocol_sendv */
+struct protocol_iov
+{
+  const void *base; /*!< Fragment Data */
+  uint16_t len;     /*!< Fragment Length */
+};
+
 /* This Struct Is Used To Describe Send Information When Sending */
 typedef struct
 {
@@ -220,9 +327,17 @@ typedef struct
 } send_ctx_t;
 
 /* Exported functions --------------------------------------------------------*/
+void protocol_p_mem_init(void);
 void *protocol_p_malloc(uint32_t size);
 void protocol_p_free(void *ptr);
+struct mem_pool *protocol_p_get_mem_pool(void);
 uint32_t protocol_p_get_time(void);
+uint32_t protocol_p_get_time_us(void);
+void protocol_p_cycles_init(void);
+uint32_t protocol_p_get_cycles(void);
+void *protocol_p_get_thread(void);
+void protocol_p_signal(void *thread);
+void protocol_p_signal_wait(uint32_t timeout);
 void protocol_p_printf(const char *format, ...);
 
 #endif /* PROTOCOL_COMMON_H_ */
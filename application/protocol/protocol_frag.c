@@ -0,0 +1,315 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "protocol.h"
+#include "protocol_frag.h"
+#include "protocol_transmit.h"
+#include "protocol_log.h"
+
+#if (PROTOCOL_FRAG_ENABLE == PROTOCOL_ENABLE)
+
+/*
+ * 分片与重组
+ *
+ * 超过PROTOCOL_MAX_DATA_LEN的数据按PROTOCOL_FRAG_PIECE_SIZE切片，每片作为一个
+ * PROTOCOL_CMD_FRAG帧发送，帧内先是frag_head。切片直接引用调用者的数据片段，
+ * 不额外拷贝。未超长的数据仍按原来的单帧发送，没有额外开销。
+ *
+ * 接收方按(发送方, 命令, id)分配重组缓冲区，收齐后整包交给该命令的接收回调。
+ * 重组缓冲区最多PROTOCOL_FRAG_RX_MAX个，超时未收齐或被更新的数据包挤占时释放。
+ */
+
+/* Private define ------------------------------------------------------------*/
+#define FRAG_IOV_MAX (8) /*!< Header Plus User Fragments In One Fragment Frame */
+#define FRAG_NUM(len) (((len) + PROTOCOL_FRAG_PIECE_SIZE - 1) / PROTOCOL_FRAG_PIECE_SIZE)
+
+/* Private typedef -----------------------------------------------------------*/
+struct frag_rx
+{
+  uint8_t used;
+  uint8_t sender;
+  uint8_t id;
+  uint8_t frag_num;
+  uint16_t cmd;
+  uint16_t total_len;
+  uint32_t rcvd_mask;  /*!< Bit i Set When Fragment i Received */
+  uint32_t start_time; /*!< First Fragment Timestamp */
+  uint8_t *p_buf;
+};
+
+/* Private variables ---------------------------------------------------------*/
+static struct frag_rx frag_rx[PROTOCOL_FRAG_RX_MAX];
+static uint8_t frag_id;
+static MUTEX_DECLARE(frag_mutex);
+
+/* Private functions ---------------------------------------------------------*/
+
+//释放重组缓冲区
+static void protocol_frag_rx_release(struct frag_rx *rx)
+{
+  if (rx->p_buf != NULL)
+  {
+    protocol_p_free(rx->p_buf);
+    rx->p_buf = NULL;
+  }
+  rx->used = 0;
+}
+
+//查找重组缓冲区，没有时占用空闲的或最早开始的一个
+static struct frag_rx *protocol_frag_rx_get(uint8_t sender, struct frag_head *head, uint32_t now)
+{
+  struct frag_rx *rx;
+  struct frag_rx *idle = NULL;
+
+  for (int i = 0; i < PROTOCOL_FRAG_RX_MAX; i++)
+  {
+    rx = &frag_rx[i];
+    if (rx->used == 0)
+    {
+      if ((idle == NULL) || (idle->used))
+      {
+        idle = rx;
+      }
+      continue;
+    }
+
+    if ((rx->sender == sender) && (rx->cmd == head->cmd) && (rx->id == head->id))
+    {
+      return rx;
+    }
+
+    if ((idle == NULL) || ((idle->used) && ((int32_t)(rx->start_time - idle->start_time) < 0)))
+    {
+      idle = rx;
+    }
+  }
+
+  if (idle->used)
+  {
+    PROTOCOL_RCV_ERR_PRINTF("Fragment reassembly of cmd 0x%04X from 0x%02X dropped.", idle->cmd, idle->sender);
+    protocol_frag_rx_release(idle);
+  }
+
+  idle->p_buf = protocol_p_malloc(head->total_len);
+  if (idle->p_buf == NULL)
+  {
+    PROTOCOL_ERR_INFO_PRINTF(PROTOCOL_ERR_NOT_ENOUGH_MEM, __FILE__, __LINE__);
+    return NULL;
+  }
+
+  idle->used = 1;
+  idle->sender = sender;
+  idle->id = head->id;
+  idle->cmd = head->cmd;
+  idle->total_len = head->total_len;
+  idle->frag_num = FRAG_NUM(head->total_len);
+  idle->rcvd_mask = 0;
+  idle->start_time = now;
+
+  return idle;
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  分片模块初始化，在protocol_local_init中调用
+  * @param  void
+  * @retval void
+  */
+void protocol_frag_init(void)
+{
+  MUTEX_INIT(frag_mutex);
+  memset(frag_rx, 0, sizeof(frag_rx));
+
+  //超长数据按大块数据发送
+  protocol_send_cmd_config(PROTOCOL_CMD_FRAG, 0, 0, 0, PROTOCOL_PRIORITY_BULK, NULL, NULL);
+}
+
+/**
+  * @brief  超长数据分片加入发送列表，由protocol_sendv在数据超过PROTOCOL_MAX_DATA_LEN时调用
+  * @param  reciver 接收设备地址，可以为广播地址
+  *         cmd 命令值
+  *         iov 数据片段数组，每个分片最多引用FRAG_IOV_MAX - 1个数据片段
+  *         iov_num 数据片段数量
+  * @retval 协议返回状态，中途失败时已加入的分片仍会发出，接收方超时后丢弃
+  */
+uint32_t protocol_frag_send(uint8_t reciver, uint16_t cmd, const struct protocol_iov *iov, uint8_t iov_num)
+{
+  struct frag_head head;
+  struct protocol_iov frag_iov[FRAG_IOV_MAX];
+  uint32_t total_len;
+  uint32_t offset;
+  uint32_t piece;
+  uint32_t remain;
+  uint32_t take;
+  uint32_t status;
+  uint8_t src_idx = 0;
+  uint16_t src_off = 0;
+  uint8_t n;
+
+  total_len = protocol_s_iov_len(iov, iov_num);
+  if (total_len > PROTOCOL_FRAG_MAX_LEN)
+  {
+    PROTOCOL_ERR_INFO_PRINTF(PROTOCOL_ERR_DATA_TOO_LONG, __FILE__, __LINE__);
+    return PROTOCOL_ERR_DATA_TOO_LONG;
+  }
+
+  head.cmd = cmd;
+  head.total_len = total_len;
+  MUTEX_LOCK(frag_mutex);
+  head.id = ++frag_id;
+  MUTEX_UNLOCK(frag_mutex);
+
+  for (offset = 0, head.index = 0; offset < total_len; offset += piece, head.index++)
+  {
+    piece = total_len - offset;
+    if (piece > PROTOCOL_FRAG_PIECE_SIZE)
+    {
+      piece = PROTOCOL_FRAG_PIECE_SIZE;
+    }
+
+    frag_iov[0].base = &head;
+    frag_iov[0].len = sizeof(head);
+    n = 1;
+
+    //从调用者的数据片段中截取本片
+    for (remain = piece; remain > 0;)
+    {
+      take = iov[src_idx].len - src_off;
+      if (take > remain)
+      {
+        take = remain;
+      }
+
+      if (take > 0)
+      {
+        if (n == FRAG_IOV_MAX)
+        {
+          PROTOCOL_ERR_INFO_PRINTF(PROTOCOL_ERR_DATA_TOO_LONG, __FILE__, __LINE__);
+          return PROTOCOL_ERR_DATA_TOO_LONG;
+        }
+        frag_iov[n].base = (const uint8_t *)iov[src_idx].base + src_off;
+        frag_iov[n].len = take;
+        n++;
+      }
+
+      src_off += take;
+      remain -= take;
+      if (src_off == iov[src_idx].len)
+      {
+        src_idx++;
+        src_off = 0;
+      }
+    }
+
+    if (reciver == PROTOCOL_BROADCAST_ADDR)
+    {
+      status = protocol_s_broadcast_add_node(frag_iov, n, PROTOCOL_CMD_FRAG);
+    }
+    else
+    {
+      status = protocol_s_add_sendnode(reciver, 0, PROTOCOL_PACK_NOR, frag_iov, n, PROTOCOL_CMD_FRAG, 0);
+    }
+
+    if (status != PROTOCOL_SUCCESS)
+    {
+      return status;
+    }
+  }
+
+  return PROTOCOL_SUCCESS;
+}
+
+/**
+  * @brief  处理收到的分片帧，在解包回调中调用，收齐后调用命令的接收回调
+  * @param  source_add 发送方地址
+  *         p_data 帧数据
+  *         len 帧数据长度
+  * @retval void
+  */
+void protocol_frag_rcv(uint8_t source_add, uint8_t *p_data, uint16_t len)
+{
+  struct frag_head *head;
+  struct frag_rx *rx;
+  struct rcv_cmd_info *cmd_info;
+  uint32_t offset;
+  uint32_t piece;
+
+  if (len <= sizeof(struct frag_head))
+  {
+    return;
+  }
+  head = (struct frag_head *)p_data;
+
+  //校验分片位置与长度
+  offset = (uint32_t)head->index * PROTOCOL_FRAG_PIECE_SIZE;
+  if ((head->total_len > PROTOCOL_FRAG_MAX_LEN) || (offset >= head->total_len))
+  {
+    return;
+  }
+  piece = head->total_len - offset;
+  if (piece > PROTOCOL_FRAG_PIECE_SIZE)
+  {
+    piece = PROTOCOL_FRAG_PIECE_SIZE;
+  }
+  if (len - sizeof(struct frag_head) != piece)
+  {
+    return;
+  }
+
+  rx = protocol_frag_rx_get(source_add, head, protocol_p_get_time());
+  if ((rx == NULL) || (rx->total_len != head->total_len))
+  {
+    return;
+  }
+
+  if ((rx->rcvd_mask & (1u << head->index)) == 0)
+  {
+    memcpy(rx->p_buf + offset, p_data + sizeof(struct frag_head), piece);
+    rx->rcvd_mask |= 1u << head->index;
+  }
+
+  if (rx->rcvd_mask == ((rx->frag_num >= 32) ? 0xFFFFFFFFu : ((1u << rx->frag_num) - 1)))
+  {
+    cmd_info = protocol_get_rcv_cmd_info(rx->cmd);
+    if ((cmd_info != NULL) && (cmd_info->rcv_callback != NULL))
+    {
+      cmd_info->rcv_callback(rx->p_buf, rx->total_len);
+    }
+    protocol_frag_rx_release(rx);
+  }
+}
+
+/**
+  * @brief  释放超时未收齐的重组缓冲区，在protocol_unpack_flush中调用
+  * @param  now 当前时间(ms)
+  * @retval void
+  */
+void protocol_frag_expire(uint32_t now)
+{
+  for (int i = 0; i < PROTOCOL_FRAG_RX_MAX; i++)
+  {
+    if ((frag_rx[i].used) && ((uint32_t)(now - frag_rx[i].start_time) >= PROTOCOL_FRAG_TIMEOUT))
+    {
+      PROTOCOL_RCV_ERR_PRINTF("Fragment reassembly of cmd 0x%04X from 0x%02X timeout.", frag_rx[i].cmd, frag_rx[i].sender);
+      protocol_frag_rx_release(&frag_rx[i]);
+    }
+  }
+}
+
+#endif /* PROTOCOL_FRAG_ENABLE */
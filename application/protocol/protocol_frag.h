@@ -0,0 +1,58 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef _PROTOCOL_FRAG_H_
+#define _PROTOCOL_FRAG_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "protocol_common.h"
+
+/* Exported types ------------------------------------------------------------*/
+#pragma pack(push)
+#pragma pack(1)
+
+/* Fragment Frame Payload: Header Followed By One Piece Of The User Data */
+struct frag_head
+{
+  uint16_t cmd;       /*!< User Cmd Of The Whole Payload */
+  uint16_t total_len; /*!< Length Of The Whole Payload */
+  uint8_t id;         /*!< Payload Id, Changes For Every Fragmented Send */
+  uint8_t index;      /*!< Fragment Index, Piece Offset Is index * PROTOCOL_FRAG_PIECE_SIZE */
+};
+
+#pragma pack(pop)
+
+/* Exported constants --------------------------------------------------------*/
+#define PROTOCOL_FRAG_PIECE_SIZE (PROTOCOL_MAX_DATA_LEN - sizeof(struct frag_head))
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported functions --------------------------------------------------------*/
+
+//分片模块初始化
+void protocol_frag_init(void);
+
+//超长数据分片加入发送列表
+uint32_t protocol_frag_send(uint8_t reciver, uint16_t cmd, const struct protocol_iov *iov, uint8_t iov_num);
+
+//收到分片帧
+void protocol_frag_rcv(uint8_t source_add, uint8_t *p_data, uint16_t len);
+
+//释放超时的重组缓冲区
+void protocol_frag_expire(uint32_t now);
+
+#endif /* _PROTOCOL_FRAG_H_ */
@@ -19,6 +19,7 @@
 #include "protocol_common.h"
 #include "protocol_transmit.h"
 #include "protocol_log.h"
+#include "protocol_cantp.h"
 
 extern local_info_t protocol_local_info;
 
@@ -75,7 +76,14 @@ int32_t protocol_interface_init(struct perph_interface *perph,
     strcpy(interface->object_name, "NULL");
   }
 
-  //初始化接收缓存区
+  //初始化接收缓存区，需至少容纳一个完整帧以便原地解包
+  if (rcv_buf_size < PROTOCOL_FRAME_MAX_SIZE)
+  {
+    status = PROTOCOL_ERR_REGISTER_FAILED;
+    PROTOCOL_ERR_INFO_PRINTF(status, __FILE__, __LINE__);
+    return status;
+  }
+
   uint8_t *rcv_buf = protocol_p_malloc(rcv_buf_size);
   if (rcv_buf == NULL)
   {
@@ -86,9 +94,23 @@ int32_t protocol_interface_init(struct perph_interface *perph,
   fifo_s_init(&interface->rcvd.fifo, rcv_buf, rcv_buf_size);
 
   //初始化发送结构体
-  INIT_LIST_HEAD(&interface->send.normal_list_header);
+  for (uint8_t prio = 0; prio < PROTOCOL_PRIORITY_NUM; prio++)
+  {
+    INIT_LIST_HEAD(&interface->send.normal_list_header[prio]);
+  }
   INIT_LIST_HEAD(&interface->send.ack_list_header);
   MUTEX_INIT(interface->send.mutex_lock);
+  interface->send.rtt.rto = PROTOCOL_RTO_INIT;
+
+#if (PROTOCOL_CANTP_ENABLE == PROTOCOL_ENABLE)
+  if ((interface->type == CAN_TP_PORT) && (protocol_cantp_attach(interface) != 0))
+  {
+    protocol_p_free(rcv_buf);
+    status = PROTOCOL_ERR_REGISTER_FAILED;
+    PROTOCOL_ERR_INFO_PRINTF(status, __FILE__, __LINE__);
+    return status;
+  }
+#endif
 
   interface->broadcast_output_enable = boardcast_output_enable;
   interface->idx = idx;
@@ -122,6 +144,41 @@ int32_t protocol_can_interface_register(char *interface_name,
   return status;
 }
 
+/**
+  * @brief  注册带分段传输的CAN接口，每次发送作为一个报文分段发出，接收方收齐后整包解包
+  * @param  interface_name 接口名
+  *         rcv_buf_size 接收缓冲区容量，需大于PROTOCOL_CANTP_MSG_MAX_LEN
+  *         boardcast_output_enable 该接口是否发送广播包
+  *         can_port CAN端口
+  *         can_tx_id 发送数据帧与流控帧使用的标准ID
+  *         can_rx_id 对端使用的标准ID
+  *         can_send_fn 发送函数，每次调用发送一个CAN帧，需返回驱动接受的字节数
+  * @retval 协议返回状态
+  */
+int32_t protocol_can_tp_interface_register(char *interface_name,
+                                           uint16_t rcv_buf_size,
+                                           uint8_t boardcast_output_enable,
+                                           uint8_t can_port,
+                                           uint32_t can_tx_id,
+                                           uint32_t can_rx_id,
+                                           int32_t (*can_send_fn)(uint32_t std_id, uint8_t *p_data, uint32_t len))
+{
+#if (PROTOCOL_CANTP_ENABLE == PROTOCOL_ENABLE)
+  struct perph_interface interface = {0};
+
+  interface.type = CAN_TP_PORT;
+  interface.send_callback.can_send_fn = can_send_fn;
+  interface.user_data.can.can_port = can_port;
+  interface.user_data.can.send_id = can_tx_id;
+  interface.user_data.can.rcv_id = can_rx_id;
+
+  return protocol_interface_init(&interface, interface_name, boardcast_output_enable, rcv_buf_size);
+#else
+  return protocol_can_interface_register(interface_name, rcv_buf_size, boardcast_output_enable,
+                                         can_port, can_tx_id, can_rx_id, can_send_fn);
+#endif
+}
+
 int32_t protocol_uart_interface_register(char *interface_name,
                                         uint16_t rcv_buf_size,
                                         uint8_t boardcast_output_enable,
@@ -164,6 +221,12 @@ int32_t protocol_interface_send_data(struct perph_interface *perph, uint8_t *buf
       PROTOCOL_ERR_INFO_PRINTF(status, __FILE__, __LINE__);
     }
   }
+#if (PROTOCOL_CANTP_ENABLE == PROTOCOL_ENABLE)
+  else if (perph->type == CAN_TP_PORT)
+  {
+    status = protocol_cantp_send(perph, buff, len);
+  }
+#endif
   else if (perph->type == COM_PORT)
   {
     if (perph->send_callback.com_send_fn != NULL)
@@ -191,6 +254,14 @@ uint32_t protocol_can_rcv_data(uint8_t can_port, uint32_t rcv_id, void *p_data,
     {
       protocol_rcv_data(p_data, data_len, &protocol_local_info.interface[i]);
     }
+#if (PROTOCOL_CANTP_ENABLE == PROTOCOL_ENABLE)
+    else if((protocol_local_info.interface[i].type == CAN_TP_PORT)
+     &&(protocol_local_info.interface[i].user_data.can.rcv_id == rcv_id)
+     &&(protocol_local_info.interface[i].user_data.can.can_port == can_port))
+    {
+      protocol_cantp_rcv(&protocol_local_info.interface[i], p_data, data_len);
+    }
+#endif
   } 
   return status;
 }
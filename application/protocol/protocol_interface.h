@@ -27,6 +27,7 @@
 #include "fifo.h"
 #include "linux_list.h"
 #include "mem_mang.h"
+#include "mem_pool.h"
 #include "macro_mutex.h"
 #include "MF_CRC.h"
 
@@ -36,31 +37,91 @@
 #define PROTOCOL_USB_PORT  0
 #define PROTOCOL_COM1_PORT 1
 
+#define PROTOCOL_SESSION_MAX (31)
+
+/* Send Priority, Lower Value Is Sent First */
+#define PROTOCOL_PRIORITY_CTRL (0u)   /*!< Control Command */
+#define PROTOCOL_PRIORITY_NORMAL (1u) /*!< Default */
+#define PROTOCOL_PRIORITY_BULK (2u)   /*!< Telemetry And Bulk Data */
+#define PROTOCOL_PRIORITY_NUM (3u)
+
+struct send_list_node;
+
 enum interface_type
 {
   COM_PORT = 0,
   CAN_PORT,
   SOCKET,
+  CAN_TP_PORT, /*!< CAN With Segmented Transport, See protocol_cantp.c */
 };
 
 typedef struct
 {
   fifo_s_t fifo;         /*!< Receive Buffer */
-  uint8_t *p_data;       /*!< Pointer To A Temp Memory When Unpack */
+  uint8_t *p_data;       /*!< Pointer To Current Frame, In FIFO Or Bounce Buffer */
   uint16_t rcvd_num;     /*!< The Length Of Data That Has Been Received */
   uint16_t total_num;    /*!< The Total Data Length Of Current Package */
   uint8_t state;         /*!< Current Unpack state */
   uint16_t last_rcv_seq; /*!< Last Recvice Seq Num */
   uint32_t last_rcv_crc; /*!< Last Recvice CRC Num */
+  uint32_t rcv_time_us;  /*!< Timestamp Of The Latest protocol_rcv_data */
+  uint32_t frame_time_us; /*!< rcv_time_us When The Header Of Current Frame Was Found */
 } rcvd_desc_t;
 
+/* Counters And Latency Histograms Of One Interface, Bucket i Of A Histogram Counts [2^(i-1), 2^i)us */
+struct protocol_stats
+{
+  uint32_t rx_frames;    /*!< Frames Passed CRC32 */
+  uint32_t rx_bytes;     /*!< Bytes Written To The Receive FIFO */
+  uint32_t rx_overflow;  /*!< Bytes Dropped Because The Receive FIFO Was Full */
+  uint32_t tx_frames;    /*!< Frames Handed To The Send Function */
+  uint32_t tx_bytes;     /*!< Bytes Handed To The Send Function */
+  uint32_t crc16_err;    /*!< Header Auth Failures, CRC16, Length Or Version */
+  uint32_t crc32_err;    /*!< Frame CRC32 Failures */
+  uint32_t resync_bytes; /*!< Bytes Skipped While Searching For A Header */
+  uint32_t resend_cnt;   /*!< Frames Resent After Ack Timeout */
+  uint32_t ack_timeout;  /*!< Frames Given Up After All Resends */
+  uint32_t alloc_fail;   /*!< Frames Dropped For Lack Of Memory */
+  uint32_t queue_max;    /*!< High-Water Mark Of Queued Normal And Ack Frames */
+  uint32_t session_lock_max; /*!< Longest IRQ-Off Session Lookup Or Release, DWT Cycles */
+  uint32_t tx_lat_hist[PROTOCOL_STATS_HIST_NUM]; /*!< Enqueue To Wire */
+  uint32_t rx_lat_hist[PROTOCOL_STATS_HIST_NUM]; /*!< Receive To Callback Dispatch */
+};
+
+/* Round Trip Time Estimate Of One Interface, Used By Cmds With PROTOCOL_RESEND_TIMEOUT_AUTO */
+struct protocol_rtt
+{
+  uint32_t srtt;         /*!< Smoothed RTT(ms) * 8 */
+  uint32_t rttvar;       /*!< RTT Variation(ms) * 4 */
+  uint32_t rto;          /*!< Retransmission Timeout(ms) */
+  uint32_t sample_cnt;   /*!< RTT Samples, Taken From Frames Acked Without Resend */
+  uint32_t spurious_cnt; /*!< Resends Whose Earlier Transmission Was Acked */
+  uint32_t needed_cnt;   /*!< Resends Of Frames Or Acks That Were Lost */
+  uint32_t no_ack_cnt;   /*!< Frames Given Up After All Resends */
+};
+
 typedef struct
 {
-  list_t normal_list_header; /*!< Noramal Pack List Header */
+  list_t normal_list_header[PROTOCOL_PRIORITY_NUM];
+                             /*!< Noramal Pack List Header Of Each Priority */
   list_t ack_list_header;    /*!< Ack Pack List Header */
   uint16_t send_seq;         /*!< Send Sequence */
   uint8_t normal_node_num;   /*!< Current Node Num In Normal List */
   uint8_t ack_node_num;      /*!< Current Node Num In Ack List */
+  struct send_list_node *session_node[PROTOCOL_SESSION_MAX];
+                             /*!< Pending Normal Node Of Each Session */
+  struct send_list_node *resend_heap[PROTOCOL_SESSION_MAX];
+                             /*!< Sent Nodes Waiting Ack, Min Heap Of Deadline */
+  uint8_t resend_num;        /*!< Current Node Num In Resend Heap */
+#if (PROTOCOL_WAIT_ENABLE == PROTOCOL_ENABLE)
+  uint32_t session_wait[PROTOCOL_SESSION_MAX];
+                             /*!< Reliable Send Token Of Each Session */
+#endif
+  struct protocol_rtt rtt;   /*!< Round Trip Time Estimate */
+#if (PROTOCOL_TX_BATCH_ENABLE == PROTOCOL_ENABLE)
+  uint8_t batch_buf[PROTOCOL_TX_BATCH_SIZE]; /*!< Frames Coalesced In One Flush */
+  uint16_t batch_len;                        /*!< Used Length Of batch_buf */
+#endif
   MUTEX_DECLARE(mutex_lock);
 } send_desc_t;
 
@@ -99,7 +160,10 @@ struct perph_interface
   uint8_t idx;                                 /*!< interface */
   uint8_t is_valid;                            /*!< Valid */
   uint8_t broadcast_output_enable;             /*!< Broadcast Output Enable */
-  uint8_t session[31];
+#if (PROTOCOL_STATS_ENABLE == PROTOCOL_ENABLE)
+  struct protocol_stats stats;                 /*!< Counters And Latency Histograms */
+#endif
+  uint8_t session[PROTOCOL_SESSION_MAX];
   enum interface_type type;
   
   union interface_send_fn_u send_callback;
@@ -117,6 +181,13 @@ int32_t protocol_can_interface_register(char *interface_name,
                                         uint32_t can_tx_id,
                                         uint32_t can_rx_id,
                                         int (*can_send_fn)(uint32_t std_id, uint8_t *p_data, uint32_t len));
+int32_t protocol_can_tp_interface_register(char *interface_name,
+                                           uint16_t rcv_buf_size,
+                                           uint8_t boardcast_output_enable,
+                                           uint8_t can_port,
+                                           uint32_t can_tx_id,
+                                           uint32_t can_rx_id,
+                                           int (*can_send_fn)(uint32_t std_id, uint8_t *p_data, uint32_t len));
 int32_t protocol_uart_interface_register(char *interface_name,
                                         uint16_t rcv_buf_size,
                                         uint8_t boardcast_output_enable,
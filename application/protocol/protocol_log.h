@@ -25,18 +25,27 @@
 #endif
 
 #define LOG_TAG "protocol"
-#define LOG_LVL 0
+#define LOG_LVL LOG_LVL_DBG /* filtered by PROTOCOL_XXX_LOG_LVL below */
 #include "ulog.h"
 
 #define protocol_log_d(...)  log_d(__VA_ARGS__);
 #define protocol_log_i(...)  log_i(__VA_ARGS__);
 #define protocol_log_e(...)  log_e(__VA_ARGS__);
 
-#include "protocol_cfg.h"
+#include "protocol_common.h"
+#include "protocol_trace.h"
+
+/********************DEFINE TRACE***************************/
+
+#if (PROTOCOL_TRACE_ENABLE == PROTOCOL_ENABLE)
+#define PROTOCOL_TRACE(ID, ARG0, ARG1) protocol_trace_write((ID), (uint16_t)(ARG0), (uint32_t)(ARG1))
+#else
+#define PROTOCOL_TRACE(ID, ARG0, ARG1)
+#endif
 
 /********************DEFINE PRINTF**************************/
 
-#if (PROTOCOL_SEND_DBG_PRINTF_SET == PROTOCOL_ENABLE)
+#if (PROTOCOL_SEND_LOG_LVL >= PROTOCOL_LOG_LVL_DBG)
 #ifndef PROTOCOL_SEND_DBG_PRINTF
 #define PROTOCOL_SEND_DBG_PRINTF(...) protocol_log_d(__VA_ARGS__);
 #endif
@@ -46,7 +55,7 @@
 #endif
 #endif
 
-#if (PROTOCOL_SEND_ERR_PRINTF_SET == PROTOCOL_ENABLE)
+#if (PROTOCOL_SEND_LOG_LVL >= PROTOCOL_LOG_LVL_ERR)
 #ifndef PROTOCOL_SEND_ERR_PRINTF
 #define PROTOCOL_SEND_ERR_PRINTF(...) protocol_log_e(__VA_ARGS__);
 #endif
@@ -56,7 +65,7 @@
 #endif
 #endif
 
-#if (PROTOCOL_RCV_DBG_PRINTF_SET == PROTOCOL_ENABLE)
+#if (PROTOCOL_RCV_LOG_LVL >= PROTOCOL_LOG_LVL_DBG)
 #ifndef PROTOCOL_RCV_DBG_PRINTF
 #define PROTOCOL_RCV_DBG_PRINTF(...) protocol_log_d(__VA_ARGS__);
 #endif
@@ -66,7 +75,7 @@
 #endif
 #endif
 
-#if (PROTOCOL_RCV_ERR_PRINTF_SET == PROTOCOL_ENABLE)
+#if (PROTOCOL_RCV_LOG_LVL >= PROTOCOL_LOG_LVL_ERR)
 #ifndef PROTOCOL_RCV_ERR_PRINTF
 #define PROTOCOL_RCV_ERR_PRINTF(...) protocol_log_e(__VA_ARGS__);
 #endif
@@ -76,17 +85,23 @@
 #endif
 #endif
 
-#if (PROTOCOL_ERR_INFO_PRINTF_SET == PROTOCOL_ENABLE)
+//错误状态总是记录到事件跟踪，文本只在等级允许时输出
+#if (PROTOCOL_COMMON_LOG_LVL >= PROTOCOL_LOG_LVL_ERR)
 #ifndef PROTOCOL_ERR_INFO_PRINTF
-#define PROTOCOL_ERR_INFO_PRINTF(STA, FILE, LINE) protocol_s_error_info_printf(STA, FILE, LINE);
+#define PROTOCOL_ERR_INFO_PRINTF(STA, FILE, LINE)  \
+  do                                               \
+  {                                                \
+    PROTOCOL_TRACE(PROTOCOL_TRACE_ERR, STA, LINE); \
+    protocol_s_error_info_printf(STA, FILE, LINE); \
+  } while (0)
 #endif
 #else
 #ifndef PROTOCOL_ERR_INFO_PRINTF
-#define PROTOCOL_ERR_INFO_PRINTF(STA, FILE, LINE)
+#define PROTOCOL_ERR_INFO_PRINTF(STA, FILE, LINE) PROTOCOL_TRACE(PROTOCOL_TRACE_ERR, STA, LINE)
 #endif
 #endif
 
-#if (PROTOCOL_OTHER_INFO_PRINTF_SET == PROTOCOL_ENABLE)
+#if (PROTOCOL_COMMON_LOG_LVL >= PROTOCOL_LOG_LVL_INFO)
 #ifndef PROTOCOL_OTHER_INFO_PRINTF
 #define PROTOCOL_OTHER_INFO_PRINTF(...) protocol_log_i(__VA_ARGS__);
 #endif
@@ -0,0 +1,730 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "protocol.h"
+#include "protocol_stream.h"
+#include "protocol_transmit.h"
+#include "protocol_log.h"
+
+#if (PROTOCOL_STREAM_ENABLE == PROTOCOL_ENABLE)
+
+/*
+ * 滑动窗口可靠流
+ *
+ * 数据按PROTOCOL_STREAM_CHUNK_SIZE切块，每块作为一个session为0的普通帧发送，
+ * 帧内先是stream_data_head，块序号从0开始。发送方最多同时有window个未确认的块，
+ * 接收方按序把块交给该命令注册的流接收回调(附带块偏移与最后一块标记)，乱序到达的块暂存，每次刷新回复一个
+ * 累计确认(next)加32位选择确认(sack)的ACK。
+ *
+ * 超时重发按块计时；ACK显示后发送的块已到达而先发送的块仍缺失时，缺失块立即重发，
+ * 不必等待超时。流状态只在通信任务中(刷新与解包)修改，protocol_stream_send只占用空闲槽位。
+ */
+
+/* Private define ------------------------------------------------------------*/
+#define STREAM_SLOT(seq) ((seq) % PROTOCOL_STREAM_WINDOW_MAX)
+#define STREAM_MASK(n) (((n) >= 32) ? 0xFFFFFFFFu : ((1u << (n)) - 1))
+
+/* Private typedef -----------------------------------------------------------*/
+struct stream_tx
+{
+  uint8_t used;
+  uint8_t id;
+  uint8_t address;
+  uint8_t window;
+  uint8_t retry_max;
+  uint16_t cmd;
+  uint16_t timeout;
+  const uint8_t *p_data;
+  uint32_t data_len;
+  uint16_t chunk_num;
+  uint16_t base;       /*!< Oldest Unacked Chunk */
+  uint16_t next;       /*!< Next Chunk Never Sent */
+  uint16_t send_order; /*!< Transmission Counter, Orders Sent Chunks */
+  uint32_t acked;      /*!< Bit i Set When Chunk base + i Acked */
+  uint32_t send_time[PROTOCOL_STREAM_WINDOW_MAX];
+  uint16_t order[PROTOCOL_STREAM_WINDOW_MAX];
+  uint8_t retry[PROTOCOL_STREAM_WINDOW_MAX];
+  stream_done_fn_t done_callback;
+};
+
+struct stream_rx
+{
+  uint8_t used;
+  uint8_t id;
+  uint8_t address;
+  uint8_t ack_pending;
+  uint8_t is_done;
+  uint16_t cmd;
+  uint16_t next; /*!< Next Chunk To Deliver */
+  uint16_t end;  /*!< Chunk Number Once The Last Chunk Is Seen, Else 0 */
+  uint32_t sack; /*!< Bit i Set When Chunk next + i Is Buffered */
+  uint8_t *ooo_buf[PROTOCOL_STREAM_WINDOW_MAX];
+  uint16_t ooo_len[PROTOCOL_STREAM_WINDOW_MAX];
+};
+
+/* Private variables ---------------------------------------------------------*/
+extern local_info_t protocol_local_info;
+
+static struct stream_tx stream_tx[PROTOCOL_STREAM_TX_MAX];
+static struct stream_rx stream_rx[PROTOCOL_STREAM_RX_MAX];
+static uint8_t stream_id;
+static MUTEX_DECLARE(stream_mutex);
+
+/* Private functions ---------------------------------------------------------*/
+
+//结束发送流并通知调用者
+static void protocol_stream_tx_complete(struct stream_tx *tx, uint32_t status)
+{
+  stream_done_fn_t done_callback;
+  uint16_t cmd;
+
+  done_callback = tx->done_callback;
+  cmd = tx->cmd;
+  tx->used = 0;
+
+  if (done_callback != NULL)
+  {
+    done_callback(cmd, status);
+  }
+}
+
+//发送一块数据
+static uint32_t protocol_stream_tx_send_chunk(struct stream_tx *tx, uint16_t seq, uint32_t now)
+{
+  struct stream_data_head head;
+  struct protocol_iov iov[2];
+  uint32_t offset;
+  uint32_t status;
+
+  offset = (uint32_t)seq * PROTOCOL_STREAM_CHUNK_SIZE;
+
+  head.cmd = tx->cmd;
+  head.id = tx->id;
+  head.flags = (seq == tx->chunk_num - 1) ? PROTOCOL_STREAM_FLAG_LAST : 0;
+  head.seq = seq;
+
+  iov[0].base = &head;
+  iov[0].len = sizeof(head);
+  iov[1].base = tx->p_data + offset;
+  iov[1].len = (tx->data_len - offset < PROTOCOL_STREAM_CHUNK_SIZE) ? (tx->data_len - offset) : PROTOCOL_STREAM_CHUNK_SIZE;
+
+  status = protocol_s_add_sendnode(tx->address, 0, PROTOCOL_PACK_NOR, iov, 2, PROTOCOL_CMD_STREAM_DATA, 0);
+  if (status == PROTOCOL_SUCCESS)
+  {
+    tx->send_time[STREAM_SLOT(seq)] = now;
+    tx->order[STREAM_SLOT(seq)] = tx->send_order++;
+  }
+
+  return status;
+}
+
+//块的重发超时，命令配置为自适应超时时按接口RTT估计，并随重发次数加倍
+static uint32_t protocol_stream_tx_timeout(struct stream_tx *tx, uint8_t retry)
+{
+  struct perph_interface *int_obj;
+  uint32_t timeout;
+
+  if (tx->timeout != PROTOCOL_RESEND_TIMEOUT_AUTO)
+  {
+    return tx->timeout;
+  }
+
+  int_obj = protocol_s_get_route(tx->address);
+  timeout = (int_obj != NULL) ? int_obj->send.rtt.rto : PROTOCOL_RTO_INIT;
+  timeout = (retry >= 8) ? PROTOCOL_RTO_MAX : (timeout << retry);
+  if (timeout > PROTOCOL_RTO_MAX)
+  {
+    timeout = PROTOCOL_RTO_MAX;
+  }
+  return timeout;
+}
+
+//重发超时块，并在窗口允许时发送新块
+static void protocol_stream_tx_flush(struct stream_tx *tx, uint32_t now)
+{
+  uint16_t seq;
+  uint8_t slot;
+
+  for (seq = tx->base; seq < tx->next; seq++)
+  {
+    slot = STREAM_SLOT(seq);
+    if ((tx->acked & (1u << (seq - tx->base))) ||
+        ((uint32_t)(now - tx->send_time[slot]) < protocol_stream_tx_timeout(tx, tx->retry[slot])))
+    {
+      continue;
+    }
+
+    if (tx->retry[slot] >= tx->retry_max)
+    {
+      PROTOCOL_ERR_INFO_PRINTF(PROTOCOL_ERR_STREAM_TIMEOUT, __FILE__, __LINE__);
+      protocol_stream_tx_complete(tx, PROTOCOL_ERR_STREAM_TIMEOUT);
+      return;
+    }
+
+    if (protocol_stream_tx_send_chunk(tx, seq, now) != PROTOCOL_SUCCESS)
+    {
+      return;
+    }
+    tx->retry[slot]++;
+  }
+
+  while ((tx->next < tx->chunk_num) && (tx->next - tx->base < tx->window))
+  {
+    if (protocol_stream_tx_send_chunk(tx, tx->next, now) != PROTOCOL_SUCCESS)
+    {
+      return;
+    }
+    tx->retry[STREAM_SLOT(tx->next)] = 0;
+    tx->next++;
+  }
+}
+
+//收到ACK，滑动窗口并标记丢失的块
+static void protocol_stream_rcv_ack(uint8_t source_add, uint8_t *p_data, uint16_t len)
+{
+  struct stream_ack *ack;
+  struct stream_tx *tx = NULL;
+  struct perph_interface *int_obj;
+  uint32_t sack;
+  uint32_t now;
+  uint16_t high_seq;
+  uint16_t seq;
+  uint8_t high;
+
+  if (len < sizeof(struct stream_ack))
+  {
+    return;
+  }
+  ack = (struct stream_ack *)p_data;
+
+  for (int i = 0; i < PROTOCOL_STREAM_TX_MAX; i++)
+  {
+    if ((stream_tx[i].used) && (stream_tx[i].address == source_add) &&
+        (stream_tx[i].cmd == ack->cmd) && (stream_tx[i].id == ack->id))
+    {
+      tx = &stream_tx[i];
+      break;
+    }
+  }
+
+  if ((tx == NULL) || (ack->next > tx->next))
+  {
+    return;
+  }
+
+  now = protocol_p_get_time();
+
+  //累计确认，最后确认的块未重发过且未被选择确认时作为RTT样本
+  if (ack->next > tx->base)
+  {
+    seq = ack->next - 1;
+    int_obj = protocol_s_get_route(tx->address);
+    if ((int_obj != NULL) && (tx->retry[STREAM_SLOT(seq)] == 0) &&
+        ((seq - tx->base >= 32) || ((tx->acked & (1u << (seq - tx->base))) == 0)))
+    {
+      protocol_s_rtt_sample(int_obj, now - tx->send_time[STREAM_SLOT(seq)]);
+    }
+
+    tx->acked = (ack->next - tx->base >= 32) ? 0 : (tx->acked >> (ack->next - tx->base));
+    tx->base = ack->next;
+  }
+
+  //选择确认，换算为相对base的位图，旧ACK可能落后于base
+  if (tx->base - ack->next >= 32)
+  {
+    return;
+  }
+  sack = (ack->sack >> (tx->base - ack->next)) & STREAM_MASK(tx->next - tx->base);
+  tx->acked |= sack;
+
+  while ((tx->base < tx->next) && (tx->acked & 1u))
+  {
+    tx->acked >>= 1;
+    tx->base++;
+  }
+
+  if (tx->base == tx->chunk_num)
+  {
+    protocol_stream_tx_complete(tx, PROTOCOL_SUCCESS);
+  }
+  else if (tx->acked != 0)
+  {
+    //已确认的块中只发送过一次的最后一块，之前发出的未确认块视为丢失，下次刷新立即重发。
+    //重发过的块无法区分确认的是哪一次发送，不作为依据
+    for (high = 32; high > 0; high--)
+    {
+      if ((tx->acked & (1u << (high - 1))) && (tx->retry[STREAM_SLOT(tx->base + high - 1)] == 0))
+      {
+        break;
+      }
+    }
+
+    if (high > 0)
+    {
+      high_seq = tx->base + high - 1;
+      for (seq = tx->base; seq < high_seq; seq++)
+      {
+        if (((tx->acked & (1u << (seq - tx->base))) == 0) &&
+            ((int16_t)(tx->order[STREAM_SLOT(seq)] - tx->order[STREAM_SLOT(high_seq)]) < 0))
+        {
+          tx->send_time[STREAM_SLOT(seq)] = now - protocol_stream_tx_timeout(tx, tx->retry[STREAM_SLOT(seq)]);
+        }
+      }
+    }
+  }
+
+  if (protocol_local_info.send_list_add_callBack != NULL)
+  {
+    protocol_local_info.send_list_add_callBack();
+  }
+}
+
+//释放接收流暂存的乱序块
+static void protocol_stream_rx_reset(struct stream_rx *rx)
+{
+  for (int i = 0; i < PROTOCOL_STREAM_WINDOW_MAX; i++)
+  {
+    if (rx->ooo_buf[i] != NULL)
+    {
+      protocol_p_free(rx->ooo_buf[i]);
+      rx->ooo_buf[i] = NULL;
+    }
+  }
+  rx->next = 0;
+  rx->end = 0;
+  rx->sack = 0;
+  rx->ack_pending = 0;
+  rx->is_done = 0;
+}
+
+//查找接收流，新的流只能从第0块开始
+static struct stream_rx *protocol_stream_rx_get(uint8_t address, uint16_t cmd, uint8_t id, uint16_t seq)
+{
+  struct stream_rx *rx;
+  struct stream_rx *idle = NULL;
+
+  for (int i = 0; i < PROTOCOL_STREAM_RX_MAX; i++)
+  {
+    rx = &stream_rx[i];
+    if ((rx->used) && (rx->address == address) && (rx->cmd == cmd))
+    {
+      if (rx->id == id)
+      {
+        return rx;
+      }
+      idle = rx;
+      break;
+    }
+    if ((idle == NULL) && ((rx->used == 0) || (rx->is_done)))
+    {
+      idle = rx;
+    }
+  }
+
+  if ((idle == NULL) || (seq != 0))
+  {
+    return NULL;
+  }
+
+  protocol_stream_rx_reset(idle);
+  idle->used = 1;
+  idle->id = id;
+  idle->address = address;
+  idle->cmd = cmd;
+
+  return idle;
+}
+
+//按序交付第rx->next块数据，流回调附带块在流中的偏移与是否为最后一块
+static void protocol_stream_rx_deliver(struct stream_rx *rx, uint8_t *p_data, uint16_t len)
+{
+  struct rcv_cmd_info *cmd_info;
+  uint32_t offset;
+  uint8_t is_last;
+
+  cmd_info = protocol_get_rcv_cmd_info(rx->cmd);
+  if (cmd_info == NULL)
+  {
+    return;
+  }
+
+  if (cmd_info->stream_callback != NULL)
+  {
+    offset = (uint32_t)rx->next * PROTOCOL_STREAM_CHUNK_SIZE;
+    is_last = ((rx->end != 0) && (rx->next + 1 == rx->end)) ? 1 : 0;
+    cmd_info->stream_callback(p_data, len, offset, is_last);
+  }
+  else if (cmd_info->rcv_callback != NULL)
+  {
+    cmd_info->rcv_callback(p_data, len);
+  }
+}
+
+//收到数据块
+static void protocol_stream_rcv_data(uint8_t source_add, uint8_t *p_data, uint16_t len)
+{
+  struct stream_data_head *head;
+  struct stream_rx *rx;
+  uint8_t *p_chunk;
+  uint16_t chunk_len;
+  uint16_t offset;
+  uint8_t slot;
+
+  if (len <= sizeof(struct stream_data_head))
+  {
+    return;
+  }
+  head = (struct stream_data_head *)p_data;
+  p_chunk = p_data + sizeof(struct stream_data_head);
+  chunk_len = len - sizeof(struct stream_data_head);
+
+  rx = protocol_stream_rx_get(source_add, head->cmd, head->id, head->seq);
+  if (rx == NULL)
+  {
+    return;
+  }
+
+  if (head->seq >= rx->next)
+  {
+    offset = head->seq - rx->next;
+    if (offset >= PROTOCOL_STREAM_WINDOW_MAX)
+    {
+      //超出接收窗口，不回复
+      return;
+    }
+
+    //先记录结束位置，交付最后一块时才能标记
+    if (head->flags & PROTOCOL_STREAM_FLAG_LAST)
+    {
+      rx->end = head->seq + 1;
+    }
+
+    if (offset == 0)
+    {
+      protocol_stream_rx_deliver(rx, p_chunk, chunk_len);
+    }
+    else if ((rx->sack & (1u << offset)) == 0)
+    {
+      slot = STREAM_SLOT(head->seq);
+      rx->ooo_buf[slot] = protocol_p_malloc(chunk_len);
+      if (rx->ooo_buf[slot] == NULL)
+      {
+        //内存不足时不确认，等待发送方重发
+        return;
+      }
+      memcpy(rx->ooo_buf[slot], p_chunk, chunk_len);
+      rx->ooo_len[slot] = chunk_len;
+      rx->sack |= 1u << offset;
+    }
+
+    //交付已连续的暂存块
+    while ((offset == 0) || (rx->sack & 1u))
+    {
+      if (offset != 0)
+      {
+        slot = STREAM_SLOT(rx->next);
+        protocol_stream_rx_deliver(rx, rx->ooo_buf[slot], rx->ooo_len[slot]);
+        protocol_p_free(rx->ooo_buf[slot]);
+        rx->ooo_buf[slot] = NULL;
+      }
+      offset = 1;
+      rx->sack >>= 1;
+      rx->next++;
+    }
+
+    if ((rx->end != 0) && (rx->next == rx->end))
+    {
+      rx->is_done = 1;
+    }
+  }
+
+  //重复块也回复ACK，发送方的ACK可能丢失
+  rx->ack_pending = 1;
+  if (protocol_local_info.send_list_add_callBack != NULL)
+  {
+    protocol_local_info.send_list_add_callBack();
+  }
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  流模块初始化，在protocol_local_init中调用
+  * @param  void
+  * @retval void
+  */
+void protocol_stream_init(void)
+{
+  MUTEX_INIT(stream_mutex);
+  memset(stream_tx, 0, sizeof(stream_tx));
+  memset(stream_rx, 0, sizeof(stream_rx));
+
+  //数据块按大块数据发送，ACK不排在大块数据之后
+  protocol_send_cmd_config(PROTOCOL_CMD_STREAM_DATA, 0, 0, 0, PROTOCOL_PRIORITY_BULK, NULL, NULL);
+  protocol_send_cmd_config(PROTOCOL_CMD_STREAM_ACK, 0, 0, 0, PROTOCOL_PRIORITY_NORMAL, NULL, NULL);
+}
+
+/**
+  * @brief  可靠流发送，数据切块后以滑动窗口发送，接收方按序交给cmd注册的接收回调。
+  *         p_data在完成回调之前必须保持有效。每块的重发超时与次数使用protocol_send_cmd_config
+  *         对cmd的配置(可以为PROTOCOL_RESEND_TIMEOUT_AUTO)，未配置时使用PROTOCOL_STREAM_TIMEOUT与PROTOCOL_STREAM_RETRY_MAX
+  * @param  reciver 接收设备地址，不支持广播
+  *         cmd 命令值
+  *         p_data 发送数据指针
+  *         data_len 发送数据长度
+  *         window 最多未确认的块数，范围为1~PROTOCOL_STREAM_WINDOW_MAX
+  *         done_callback 全部确认或某块重发次数用尽时调用，可以为NULL
+  * @retval 协议返回状态
+  */
+uint32_t protocol_stream_send(uint8_t reciver, uint16_t cmd, const void *p_data, uint32_t data_len,
+                              uint8_t window, stream_done_fn_t done_callback)
+{
+  struct send_cmd_info *cmd_info;
+  struct stream_tx *tx = NULL;
+  uint32_t chunk_num;
+
+  if ((p_data == NULL) || (data_len == 0))
+  {
+    return PROTOCOL_ERR_DATA_NOT_ENOUGH;
+  }
+
+  chunk_num = (data_len + PROTOCOL_STREAM_CHUNK_SIZE - 1) / PROTOCOL_STREAM_CHUNK_SIZE;
+  if (chunk_num > 0xFFFFu)
+  {
+    PROTOCOL_ERR_INFO_PRINTF(PROTOCOL_ERR_DATA_TOO_LONG, __FILE__, __LINE__);
+    return PROTOCOL_ERR_DATA_TOO_LONG;
+  }
+
+  if (reciver == PROTOCOL_BROADCAST_ADDR)
+  {
+    PROTOCOL_ERR_INFO_PRINTF(PROTOCOL_ERR_SESSION_ERROR, __FILE__, __LINE__);
+    return PROTOCOL_ERR_SESSION_ERROR;
+  }
+
+  if (protocol_s_get_route(reciver) == NULL)
+  {
+    PROTOCOL_ERR_INFO_PRINTF(PROTOCOL_ERR_ROUTE_NOT_FOUND, __FILE__, __LINE__);
+    return PROTOCOL_ERR_ROUTE_NOT_FOUND;
+  }
+
+  if (window == 0)
+  {
+    window = 1;
+  }
+  else if (window > PROTOCOL_STREAM_WINDOW_MAX)
+  {
+    window = PROTOCOL_STREAM_WINDOW_MAX;
+  }
+
+  cmd_info = protocol_get_send_cmd_info(cmd);
+
+  MUTEX_LOCK(stream_mutex);
+  for (int i = 0; i < PROTOCOL_STREAM_TX_MAX; i++)
+  {
+    if (stream_tx[i].used == 0)
+    {
+      tx = &stream_tx[i];
+      break;
+    }
+  }
+
+  if (tx != NULL)
+  {
+    tx->id = ++stream_id;
+    tx->address = reciver;
+    tx->window = window;
+    tx->cmd = cmd;
+    tx->timeout = PROTOCOL_STREAM_TIMEOUT;
+    tx->retry_max = PROTOCOL_STREAM_RETRY_MAX;
+    if ((cmd_info != NULL) && (cmd_info->resend_timeout != 0))
+    {
+      tx->timeout = cmd_info->resend_timeout;
+      tx->retry_max = cmd_info->resend_times;
+    }
+    tx->p_data = (const uint8_t *)p_data;
+    tx->data_len = data_len;
+    tx->chunk_num = chunk_num;
+    tx->base = 0;
+    tx->next = 0;
+    tx->send_order = 0;
+    tx->acked = 0;
+    tx->done_callback = done_callback;
+    tx->used = 1;
+  }
+  MUTEX_UNLOCK(stream_mutex);
+
+  if (tx == NULL)
+  {
+    PROTOCOL_ERR_INFO_PRINTF(PROTOCOL_ERR_SESSION_FULL, __FILE__, __LINE__);
+    return PROTOCOL_ERR_SESSION_FULL;
+  }
+
+  if (protocol_local_info.send_list_add_callBack != NULL)
+  {
+    protocol_local_info.send_list_add_callBack();
+  }
+
+  return PROTOCOL_SUCCESS;
+}
+
+/**
+  * @brief  注册流接收回调，每块按序交付时附带该块在流中的字节偏移，最后一块is_last为1，
+  *         接收方据此定位写入位置并确认整个流已完整。未注册流回调的命令仍按块调用protocol_rcv_cmd_register的回调
+  * @param  cmd 命令值，未注册时同时注册该接收命令
+  *         rcv_callback 流接收回调
+  * @retval 0成功，-1失败
+  */
+int32_t protocol_stream_rcv_register(uint16_t cmd, stream_rcv_fn_t rcv_callback)
+{
+  struct rcv_cmd_info *cmd_info;
+
+  cmd_info = protocol_get_rcv_cmd_info(cmd);
+  if (cmd_info == NULL)
+  {
+    if (protocol_rcv_cmd_register(cmd, NULL) < 0)
+    {
+      return -1;
+    }
+    cmd_info = protocol_get_rcv_cmd_info(cmd);
+  }
+
+  cmd_info->stream_callback = rcv_callback;
+  return 0;
+}
+
+/**
+  * @brief  处理收到的流数据帧或流ACK帧，在解包回调中调用
+  * @param  cmd PROTOCOL_CMD_STREAM_DATA或PROTOCOL_CMD_STREAM_ACK
+  *         source_add 发送方地址
+  *         p_data 帧数据
+  *         len 帧数据长度
+  * @retval void
+  */
+void protocol_stream_rcv(uint16_t cmd, uint8_t source_add, uint8_t *p_data, uint16_t len)
+{
+  if (cmd == PROTOCOL_CMD_STREAM_DATA)
+  {
+    protocol_stream_rcv_data(source_add, p_data, len);
+  }
+  else
+  {
+    protocol_stream_rcv_ack(source_add, p_data, len);
+  }
+}
+
+/**
+  * @brief  把待发送的块与ACK加入发送列表，在protocol_send_flush开头调用
+  * @param  void
+  * @retval void
+  */
+void protocol_stream_flush(void)
+{
+  struct stream_ack ack;
+  struct protocol_iov iov;
+  uint32_t now;
+
+  now = protocol_p_get_time();
+
+  for (int i = 0; i < PROTOCOL_STREAM_RX_MAX; i++)
+  {
+    if ((stream_rx[i].used) && (stream_rx[i].ack_pending))
+    {
+      ack.cmd = stream_rx[i].cmd;
+      ack.id = stream_rx[i].id;
+      ack.res = 0;
+      ack.next = stream_rx[i].next;
+      ack.sack = stream_rx[i].sack;
+
+      iov.base = &ack;
+      iov.len = sizeof(ack);
+
+      if (protocol_s_add_sendnode(stream_rx[i].address, 0, PROTOCOL_PACK_NOR, &iov, 1,
+                                  PROTOCOL_CMD_STREAM_ACK, 0) == PROTOCOL_SUCCESS)
+      {
+        stream_rx[i].ack_pending = 0;
+      }
+    }
+  }
+
+  for (int i = 0; i < PROTOCOL_STREAM_TX_MAX; i++)
+  {
+    if (stream_tx[i].used)
+    {
+      protocol_stream_tx_flush(&stream_tx[i], now);
+    }
+  }
+}
+
+/**
+  * @brief  获取距流中最早一块重发时刻的时间
+  * @param  now 当前时间(ms)
+  * @retval 等待时间(ms)，没有流时返回PROTOCOL_WAIT_FOREVER
+  */
+uint32_t protocol_stream_wait_time(uint32_t now)
+{
+  struct stream_tx *tx;
+  uint32_t elapsed;
+  uint32_t timeout;
+  uint32_t wait_time = PROTOCOL_WAIT_FOREVER;
+
+  for (int i = 0; i < PROTOCOL_STREAM_RX_MAX; i++)
+  {
+    if ((stream_rx[i].used) && (stream_rx[i].ack_pending))
+    {
+      //上次刷新时内存不足，稍后再试
+      wait_time = 1;
+    }
+  }
+
+  for (int i = 0; i < PROTOCOL_STREAM_TX_MAX; i++)
+  {
+    tx = &stream_tx[i];
+    if (tx->used == 0)
+    {
+      continue;
+    }
+
+    if ((tx->next < tx->chunk_num) && (tx->next - tx->base < tx->window) && (wait_time > 1))
+    {
+      wait_time = 1;
+    }
+
+    for (uint16_t seq = tx->base; seq < tx->next; seq++)
+    {
+      if (tx->acked & (1u << (seq - tx->base)))
+      {
+        continue;
+      }
+
+      elapsed = now - tx->send_time[STREAM_SLOT(seq)];
+      timeout = protocol_stream_tx_timeout(tx, tx->retry[STREAM_SLOT(seq)]);
+      if (elapsed >= timeout)
+      {
+        return 0;
+      }
+      if (timeout - elapsed < wait_time)
+      {
+        wait_time = timeout - elapsed;
+      }
+    }
+  }
+
+  return wait_time;
+}
+
+#endif /* PROTOCOL_STREAM_ENABLE */
@@ -0,0 +1,68 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef _PROTOCOL_STREAM_H_
+#define _PROTOCOL_STREAM_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "protocol_common.h"
+
+/* Exported types ------------------------------------------------------------*/
+#pragma pack(push)
+#pragma pack(1)
+
+/* Stream Data Frame Payload: Header Followed By One Chunk */
+struct stream_data_head
+{
+  uint16_t cmd;  /*!< User Cmd The Chunk Is Delivered To */
+  uint8_t id;    /*!< Stream Id, Changes For Every New Stream */
+  uint8_t flags; /*!< PROTOCOL_STREAM_FLAG_XXX */
+  uint16_t seq;  /*!< Chunk Index, Starts From 0 */
+};
+
+/* Stream Ack Frame Payload */
+struct stream_ack
+{
+  uint16_t cmd;  /*!< User Cmd */
+  uint8_t id;    /*!< Stream Id */
+  uint8_t res;   /*!< Reserve */
+  uint16_t next; /*!< Cumulative Ack, All Chunks Before next Received */
+  uint32_t sack; /*!< Selective Ack, Bit i Set When Chunk next + i Received */
+};
+
+#pragma pack(pop)
+
+/* Exported constants --------------------------------------------------------*/
+#define PROTOCOL_STREAM_FLAG_LAST (0x01u) /*!< Last Chunk Of The Stream */
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported functions --------------------------------------------------------*/
+
+//流模块初始化
+void protocol_stream_init(void);
+
+//收到流数据帧或流ACK帧
+void protocol_stream_rcv(uint16_t cmd, uint8_t source_add, uint8_t *p_data, uint16_t len);
+
+//发送窗口内的新块、到期重发块与待回复的ACK
+void protocol_stream_flush(void);
+
+//距最早块重发时刻的时间
+uint32_t protocol_stream_wait_time(uint32_t now);
+
+#endif /* _PROTOCOL_STREAM_H_ */
@@ -0,0 +1,382 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "protocol.h"
+#include "protocol_time.h"
+#include "protocol_log.h"
+
+#if (PROTOCOL_TIME_ENABLE == PROTOCOL_ENABLE)
+
+/*
+ * 时间同步
+ *
+ * 从设备周期向主设备发送带本地发送时刻t1的请求，主设备回复收到时刻t2与回复时刻t3，
+ * 从设备在收到回复的时刻t4计算一个样本：
+ *   往返延迟 delay = (t4 - t1) - (t3 - t2)
+ *   时钟偏移 offset = ((t2 - t1) + (t3 - t4)) / 2
+ * 往返延迟明显大于最近最小值的样本在某个方向上排队过，偏移不可信，直接丢弃。
+ * 接受的样本驱动一个比例积分环：比例项修正偏移，积分项估计两个时钟的频偏，
+ * 两次样本之间按频偏外推，请求周期可以取得较长。
+ * 主设备回复的是它自己的同步时间，因此可以逐级同步，例如云台同步到底盘、底盘同步到妙算。
+ */
+
+/* Private define ------------------------------------------------------------*/
+#define TIME_KP_SHIFT (2)    /*!< Offset Correction, err / 4 */
+#define TIME_KI_SHIFT (6)    /*!< Drift Correction, err / dt / 64 */
+#define TIME_DRIFT_Q (32)    /*!< Drift Is Q32, Master Minus Local Per Local Microsecond */
+#define TIME_DRIFT_LIMIT ((int64_t)PROTOCOL_TIME_DRIFT_MAX * ((int64_t)1 << TIME_DRIFT_Q) / 1000000)
+
+/* Private variables ---------------------------------------------------------*/
+static uint32_t time_high;           /*!< Wraps Of protocol_p_get_time_us */
+static uint32_t time_last_low;
+static uint8_t time_master = PROTOCOL_BROADCAST_ADDR;
+static uint8_t time_synced;
+static uint32_t time_period;
+static uint32_t time_next;           /*!< Next Request Time(ms) */
+static uint64_t time_pending_t1;     /*!< t1 Of The Outstanding Request, 0 For None */
+static uint64_t time_ref;            /*!< Local Time Of The Last Accepted Sample(us) */
+static int64_t time_offset;          /*!< Master Minus Local At time_ref(us) */
+static int64_t time_drift;           /*!< Q32 */
+static uint32_t time_delay[PROTOCOL_TIME_FILTER];
+static uint8_t time_delay_idx;
+static uint32_t time_delay_num;
+static struct protocol_time_info time_stats;
+static MUTEX_DECLARE(time_mutex);
+
+extern local_info_t protocol_local_info;
+
+/* Private functions ---------------------------------------------------------*/
+
+//本地时刻t对应的主设备时间偏移，调用者需持有time_mutex
+static int64_t protocol_time_offset_at(uint64_t t)
+{
+  return time_offset + (((int64_t)(t - time_ref) * time_drift) >> TIME_DRIFT_Q);
+}
+
+//往返延迟不超过最近最小值加PROTOCOL_TIME_JITTER时接受样本
+static uint8_t protocol_time_delay_filter(uint32_t delay)
+{
+  uint32_t min_delay = delay;
+
+  for (uint32_t i = 0; i < time_delay_num; i++)
+  {
+    if (time_delay[i] < min_delay)
+    {
+      min_delay = time_delay[i];
+    }
+  }
+
+  time_delay[time_delay_idx] = delay;
+  time_delay_idx = (time_delay_idx + 1) % PROTOCOL_TIME_FILTER;
+  if (time_delay_num < PROTOCOL_TIME_FILTER)
+  {
+    time_delay_num++;
+  }
+
+  return (delay <= min_delay + PROTOCOL_TIME_JITTER);
+}
+
+//按样本更新偏移与频偏，t为样本的本地时刻
+static void protocol_time_update(int64_t offset, uint64_t t, uint32_t delay)
+{
+  int64_t err;
+  int64_t dt;
+
+  MUTEX_LOCK(time_mutex);
+
+  dt = (int64_t)(t - time_ref);
+  err = offset - protocol_time_offset_at(t);
+
+  if ((time_synced == 0) || (err > PROTOCOL_TIME_STEP) || (err < -PROTOCOL_TIME_STEP))
+  {
+    //首个样本或主设备时间跳变，直接对齐，频偏保留
+    if (time_synced)
+    {
+      time_stats.step_cnt++;
+    }
+    time_offset = offset;
+    time_ref = t;
+    time_synced = 1;
+  }
+  else if (dt > 0)
+  {
+    time_offset = protocol_time_offset_at(t) + (err >> TIME_KP_SHIFT);
+    time_drift += ((err * ((int64_t)1 << TIME_DRIFT_Q)) / dt) >> TIME_KI_SHIFT;
+    if (time_drift > TIME_DRIFT_LIMIT)
+    {
+      time_drift = TIME_DRIFT_LIMIT;
+    }
+    else if (time_drift < -TIME_DRIFT_LIMIT)
+    {
+      time_drift = -TIME_DRIFT_LIMIT;
+    }
+    time_ref = t;
+  }
+
+  time_stats.delay = delay;
+  time_stats.sample_cnt++;
+
+  MUTEX_UNLOCK(time_mutex);
+}
+
+//处理时间回复
+static void protocol_time_rcv_resp(uint8_t source_add, struct protocol_time_resp *resp)
+{
+  uint64_t t4;
+  int64_t delay;
+  int64_t offset;
+
+  t4 = protocol_time_local_us();
+
+  //只接受当前主设备对最近一次请求的回复，迟到的旧回复丢弃
+  if ((source_add != time_master) || (time_pending_t1 == 0) || (resp->t1 != time_pending_t1))
+  {
+    return;
+  }
+  time_pending_t1 = 0;
+
+  delay = (int64_t)(t4 - resp->t1) - (int64_t)(resp->t3 - resp->t2);
+  if ((delay < 0) || (delay > 0xFFFFFFFF))
+  {
+    return;
+  }
+  offset = ((int64_t)(resp->t2 - resp->t1) + (int64_t)(resp->t3 - t4)) / 2;
+
+  if (protocol_time_delay_filter((uint32_t)delay) == 0)
+  {
+    time_stats.reject_cnt++;
+    return;
+  }
+
+  protocol_time_update(offset, resp->t1 + (t4 - resp->t1) / 2, (uint32_t)delay);
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  时间同步初始化，在protocol_local_init中调用
+  * @param  void
+  * @retval void
+  */
+void protocol_time_init(void)
+{
+  MUTEX_INIT(time_mutex);
+  time_master = PROTOCOL_BROADCAST_ADDR;
+  time_synced = 0;
+  time_pending_t1 = 0;
+  time_offset = 0;
+  time_drift = 0;
+  time_delay_num = 0;
+  memset(&time_stats, 0, sizeof(time_stats));
+
+  //时间请求与回复不能排在大块数据之后，否则样本都带着排队延迟
+  protocol_send_cmd_config(PROTOCOL_CMD_TIME_REQ, 0, 0, 0, PROTOCOL_PRIORITY_CTRL, NULL, NULL);
+  protocol_send_cmd_config(PROTOCOL_CMD_TIME_RESP, 0, 0, 0, PROTOCOL_PRIORITY_CTRL, NULL, NULL);
+}
+
+/**
+  * @brief  开始向主设备同步时间，之后protocol_time_now_us返回主设备的时间。
+  *         开始后的PROTOCOL_TIME_FILTER次请求按1/4周期发送，以便尽快收敛
+  * @param  master 主设备地址，PROTOCOL_BROADCAST_ADDR时停止同步并回到本地时间
+  *         period 请求周期(ms)
+  * @retval 0 成功，-1 参数错误
+  */
+int32_t protocol_time_sync_start(uint8_t master, uint32_t period)
+{
+  if ((period == 0) || (master == protocol_local_info.address))
+  {
+    return -1;
+  }
+
+  MUTEX_LOCK(time_mutex);
+  time_master = master;
+  time_synced = 0;
+  time_offset = 0;
+  time_drift = 0;
+  MUTEX_UNLOCK(time_mutex);
+
+  time_period = period;
+  time_next = protocol_p_get_time();
+  time_pending_t1 = 0;
+  time_delay_num = 0;
+  memset(&time_stats, 0, sizeof(time_stats));
+
+  return 0;
+}
+
+/**
+  * @brief  本地单调时间，将protocol_p_get_time_us扩展为64位，需要至少每71分钟调用一次
+  * @param  void
+  * @retval 本地时间(us)
+  */
+uint64_t protocol_time_local_us(void)
+{
+  uint32_t low;
+  uint32_t high;
+  uint64_t t;
+
+  //在关中断之前取时间，关中断期间毫秒中断无法执行
+  low = protocol_p_get_time_us();
+
+  MUTEX_LOCK(time_mutex);
+  //回退超过半个周期才是回绕，回退较少的是其他任务抢先更新后本次较早取到的时间
+  if ((int32_t)(low - time_last_low) >= 0)
+  {
+    if (low < time_last_low)
+    {
+      time_high++;
+    }
+    time_last_low = low;
+    high = time_high;
+  }
+  else
+  {
+    //较早的时间取在回绕之前
+    high = (low > time_last_low) ? (time_high - 1) : time_high;
+  }
+  t = ((uint64_t)high << 32) | low;
+  MUTEX_UNLOCK(time_mutex);
+
+  return t;
+}
+
+/**
+  * @brief  共享时间基准，同步后为主设备的时间，未同步或本机为主设备时为本地时间。
+  *         各板卡推送的遥测时间戳均取自本函数，上位机可以直接比较
+  * @param  void
+  * @retval 当前时间(us)
+  */
+uint64_t protocol_time_now_us(void)
+{
+  uint64_t t;
+
+  t = protocol_time_local_us();
+
+  MUTEX_LOCK(time_mutex);
+  if (time_synced)
+  {
+    t += protocol_time_offset_at(t);
+  }
+  MUTEX_UNLOCK(time_mutex);
+
+  return t;
+}
+
+/**
+  * @brief  读取时间同步状态
+  * @param  info 同步状态
+  * @retval void
+  */
+void protocol_time_get_info(struct protocol_time_info *info)
+{
+  uint64_t t;
+
+  t = protocol_time_local_us();
+
+  MUTEX_LOCK(time_mutex);
+  memcpy(info, &time_stats, sizeof(*info));
+  info->master = time_master;
+  info->synced = time_synced;
+  info->offset = time_synced ? protocol_time_offset_at(t) : 0;
+  info->drift_ppb = (int32_t)((time_drift * 1000000000) >> TIME_DRIFT_Q);
+  MUTEX_UNLOCK(time_mutex);
+}
+
+/**
+  * @brief  处理时间请求与时间回复，在解包回调中调用
+  * @param  cmd PROTOCOL_CMD_TIME_REQ或PROTOCOL_CMD_TIME_RESP
+  *         source_add 发送方地址
+  *         p_data 帧数据
+  *         len 帧数据长度
+  * @retval void
+  */
+void protocol_time_rcv(uint16_t cmd, uint8_t source_add, uint8_t *p_data, uint16_t len)
+{
+  struct protocol_time_resp resp;
+
+  if (cmd == PROTOCOL_CMD_TIME_REQ)
+  {
+    if (len < sizeof(struct protocol_time_req))
+    {
+      return;
+    }
+    //任何设备都回复自己的同步时间
+    resp.t2 = protocol_time_now_us();
+    memcpy(&resp.t1, p_data, sizeof(resp.t1));
+    resp.t3 = protocol_time_now_us();
+    protocol_send(source_add, PROTOCOL_CMD_TIME_RESP, &resp, sizeof(resp));
+  }
+  else if (len >= sizeof(struct protocol_time_resp))
+  {
+    memcpy(&resp, p_data, sizeof(resp));
+    protocol_time_rcv_resp(source_add, &resp);
+  }
+}
+
+/**
+  * @brief  到期时向主设备发送时间请求，在protocol_send_flush中调用。上一次请求没有回复时视为丢失
+  * @param  now 当前时间(ms)
+  * @retval void
+  */
+void protocol_time_flush(uint32_t now)
+{
+  struct protocol_time_req req;
+
+  if ((time_master == PROTOCOL_BROADCAST_ADDR) || ((int32_t)(now - time_next) < 0))
+  {
+    protocol_time_local_us();
+    return;
+  }
+
+  if (time_stats.sample_cnt < PROTOCOL_TIME_FILTER)
+  {
+    time_next = now + (time_period + 3) / 4;
+  }
+  else
+  {
+    time_next = now + time_period;
+  }
+
+  req.t1 = protocol_time_local_us();
+  if (protocol_send(time_master, PROTOCOL_CMD_TIME_REQ, &req, sizeof(req)) == PROTOCOL_SUCCESS)
+  {
+    time_pending_t1 = req.t1;
+  }
+}
+
+/**
+  * @brief  距下一次时间请求的时间，在protocol_send_wait_time中调用
+  * @param  now 当前时间(ms)
+  * @retval 等待时间(ms)，未同步时返回PROTOCOL_WAIT_FOREVER
+  */
+uint32_t protocol_time_wait_time(uint32_t now)
+{
+  if (time_master == PROTOCOL_BROADCAST_ADDR)
+  {
+    return PROTOCOL_WAIT_FOREVER;
+  }
+
+  if ((int32_t)(time_next - now) <= 0)
+  {
+    return 0;
+  }
+
+  return time_next - now;
+}
+
+#endif /* PROTOCOL_TIME_ENABLE */
@@ -0,0 +1,77 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef _PROTOCOL_TIME_H_
+#define _PROTOCOL_TIME_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "protocol_common.h"
+
+/* Exported types ------------------------------------------------------------*/
+#pragma pack(push)
+#pragma pack(1)
+
+/* Payload Of PROTOCOL_CMD_TIME_REQ */
+struct protocol_time_req
+{
+  uint64_t t1; /*!< Request Send Time, Requester Timebase(us) */
+};
+
+/* Payload Of PROTOCOL_CMD_TIME_RESP */
+struct protocol_time_resp
+{
+  uint64_t t1; /*!< Echo Of Request t1 */
+  uint64_t t2; /*!< Request Receive Time, Responder Timebase(us) */
+  uint64_t t3; /*!< Response Send Time, Responder Timebase(us) */
+};
+
+#pragma pack(pop)
+
+/* Synchronisation State */
+struct protocol_time_info
+{
+  uint8_t master;       /*!< Address Synchronised To, PROTOCOL_BROADCAST_ADDR When Not Syncing */
+  uint8_t synced;       /*!< At Least One Sample Accepted */
+  int64_t offset;       /*!< Master Time Minus Local Time Now(us) */
+  int32_t drift_ppb;    /*!< Master Clock Rate Relative To Local, Parts Per Billion */
+  uint32_t delay;       /*!< Round Trip Delay Of Last Accepted Sample(us) */
+  uint32_t sample_cnt;  /*!< Accepted Samples */
+  uint32_t reject_cnt;  /*!< Samples Dropped For Queueing Delay */
+  uint32_t step_cnt;    /*!< Offset Steps Beyond PROTOCOL_TIME_STEP */
+};
+
+/* Exported constants --------------------------------------------------------*/
+/* Exported macro ------------------------------------------------------------*/
+/* Exported functions --------------------------------------------------------*/
+
+//时间同步初始化
+void protocol_time_init(void);
+
+//收到时间请求或时间回复
+void protocol_time_rcv(uint16_t cmd, uint8_t source_add, uint8_t *p_data, uint16_t len);
+
+//到期时发送时间请求
+void protocol_time_flush(uint32_t now);
+
+//距下一次时间请求的时间
+uint32_t protocol_time_wait_time(uint32_t now);
+
+//读取同步状态
+void protocol_time_get_info(struct protocol_time_info *info);
+
+#endif /* _PROTOCOL_TIME_H_ */
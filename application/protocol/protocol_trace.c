@@ -0,0 +1,179 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "protocol.h"
+#include "protocol_trace.h"
+
+#if (PROTOCOL_TRACE_ENABLE == PROTOCOL_ENABLE)
+
+/*
+ * 二进制事件跟踪
+ *
+ * 发送、接收、转发、重发等事件只记录事件号、两个整数参数和微秒时间戳，写入环形缓冲区，
+ * 不做字符串格式化，可在比赛中保持开启。缓冲区满时覆盖最早的事件；每约1ms最多记录
+ * PROTOCOL_TRACE_RATE个事件，超出的丢弃，避免异常时事件刷满缓冲区。
+ * 事件可通过protocol_trace_read在本地读取，或由对端发送PROTOCOL_CMD_TRACE_QUERY取回。
+ */
+
+/* Private define ------------------------------------------------------------*/
+#define TRACE_REPLY_MAX ((PROTOCOL_MAX_DATA_LEN - sizeof(struct protocol_trace_info)) / sizeof(struct protocol_trace_event))
+
+/* Private variables ---------------------------------------------------------*/
+static struct protocol_trace_event trace_ring[PROTOCOL_TRACE_SIZE];
+static uint16_t trace_head;     /*!< Next Write Index */
+static uint16_t trace_num;      /*!< Events In Ring */
+static uint16_t trace_dropped;  /*!< Events Lost Since Last Read */
+static uint32_t trace_window;   /*!< Rate Limit Window, Time(us) >> 10 */
+static uint16_t trace_window_cnt;
+static uint32_t trace_mask = PROTOCOL_TRACE_MASK_ALL;
+static MUTEX_DECLARE(trace_mutex);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  事件跟踪初始化，在protocol_local_init中调用
+  * @param  void
+  * @retval void
+  */
+void protocol_trace_init(void)
+{
+  MUTEX_INIT(trace_mutex);
+  trace_head = 0;
+  trace_num = 0;
+  trace_dropped = 0;
+  trace_window_cnt = 0;
+}
+
+/**
+  * @brief  记录一个事件，通过PROTOCOL_TRACE宏调用
+  * @param  id 事件号，PROTOCOL_TRACE_XXX
+  *         arg0 arg1 事件参数，含义见事件号定义
+  * @retval void
+  */
+void protocol_trace_write(uint16_t id, uint16_t arg0, uint32_t arg1)
+{
+  struct protocol_trace_event *event;
+  uint32_t now;
+
+  if ((trace_mask & (1u << id)) == 0)
+  {
+    return;
+  }
+
+  now = protocol_p_get_time_us();
+
+  MUTEX_LOCK(trace_mutex);
+
+  //限速
+  if ((now >> 10) != trace_window)
+  {
+    trace_window = now >> 10;
+    trace_window_cnt = 0;
+  }
+  if (trace_window_cnt >= PROTOCOL_TRACE_RATE)
+  {
+    trace_dropped++;
+    MUTEX_UNLOCK(trace_mutex);
+    return;
+  }
+  trace_window_cnt++;
+
+  event = &trace_ring[trace_head];
+  event->time = now;
+  event->id = id;
+  event->arg0 = arg0;
+  event->arg1 = arg1;
+  trace_head = (trace_head + 1) & (PROTOCOL_TRACE_SIZE - 1);
+
+  if (trace_num < PROTOCOL_TRACE_SIZE)
+  {
+    trace_num++;
+  }
+  else
+  {
+    //覆盖最早的事件
+    trace_dropped++;
+  }
+
+  MUTEX_UNLOCK(trace_mutex);
+}
+
+/**
+  * @brief  设置记录的事件，运行时可随时修改
+  * @param  mask 第i位为1时记录事件号为i的事件，默认PROTOCOL_TRACE_MASK_ALL
+  * @retval void
+  */
+void protocol_trace_set_mask(uint32_t mask)
+{
+  trace_mask = mask;
+}
+
+/**
+  * @brief  按时间顺序取出事件，取出的事件从缓冲区移除
+  * @param  event 事件输出数组
+  *         max_num 最多取出的事件数量
+  *         dropped 输出上次读取以来丢失的事件数量，可以为NULL
+  * @retval 取出的事件数量
+  */
+uint16_t protocol_trace_read(struct protocol_trace_event *event, uint16_t max_num, uint16_t *dropped)
+{
+  uint16_t tail;
+  uint16_t num;
+
+  MUTEX_LOCK(trace_mutex);
+
+  num = (trace_num < max_num) ? trace_num : max_num;
+  tail = (trace_head - trace_num) & (PROTOCOL_TRACE_SIZE - 1);
+  for (uint16_t i = 0; i < num; i++)
+  {
+    event[i] = trace_ring[(tail + i) & (PROTOCOL_TRACE_SIZE - 1)];
+  }
+  trace_num -= num;
+
+  if (dropped != NULL)
+  {
+    *dropped = trace_dropped;
+  }
+  trace_dropped = 0;
+
+  MUTEX_UNLOCK(trace_mutex);
+
+  return num;
+}
+
+/**
+  * @brief  回复PROTOCOL_CMD_TRACE_QUERY，一帧最多带TRACE_REPLY_MAX个事件，剩余的事件由对端再次查询
+  * @param  reciver 查询方地址
+  * @retval void
+  */
+void protocol_trace_reply(uint8_t reciver)
+{
+  uint8_t buf[sizeof(struct protocol_trace_info) + TRACE_REPLY_MAX * sizeof(struct protocol_trace_event)];
+  struct protocol_trace_info *info;
+  uint16_t dropped;
+
+  info = (struct protocol_trace_info *)buf;
+  info->num = protocol_trace_read((struct protocol_trace_event *)(buf + sizeof(struct protocol_trace_info)),
+                                  TRACE_REPLY_MAX, &dropped);
+  info->dropped = dropped;
+
+  protocol_send(reciver, PROTOCOL_CMD_TRACE_INFO, buf,
+                sizeof(struct protocol_trace_info) + info->num * sizeof(struct protocol_trace_event));
+}
+
+#endif /* PROTOCOL_TRACE_ENABLE */
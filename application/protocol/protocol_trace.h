@@ -0,0 +1,79 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef _PROTOCOL_TRACE_H_
+#define _PROTOCOL_TRACE_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "protocol_common.h"
+
+/* Exported types ------------------------------------------------------------*/
+#pragma pack(push)
+#pragma pack(1)
+
+/* One Binary Trace Event, Also The Element Of PROTOCOL_CMD_TRACE_INFO */
+struct protocol_trace_event
+{
+  uint32_t time; /*!< Timestamp(us) */
+  uint16_t id;   /*!< PROTOCOL_TRACE_XXX */
+  uint16_t arg0;
+  uint32_t arg1;
+};
+
+/* Payload Head Of PROTOCOL_CMD_TRACE_INFO, Followed By num Events, Oldest First */
+struct protocol_trace_info
+{
+  uint16_t dropped; /*!< Events Lost To Rate Limit Or Overwrite Since Last Read */
+  uint16_t num;     /*!< Events In This Reply */
+};
+
+#pragma pack(pop)
+
+/* Exported constants --------------------------------------------------------*/
+/* Event Id, arg0 And arg1 Meaning */
+#define PROTOCOL_TRACE_ERR (0u)      /*!< Error Status, Source Line */
+#define PROTOCOL_TRACE_SEND (1u)     /*!< Cmd, Reciver | Session << 8 */
+#define PROTOCOL_TRACE_RCV (2u)      /*!< Cmd, Sender | Session << 8 */
+#define PROTOCOL_TRACE_ACK_RCV (3u)  /*!< Cmd, Sender | Session << 8 */
+#define PROTOCOL_TRACE_FORWARD (4u)  /*!< Frame Length, Reciver | Cut Through << 8 */
+#define PROTOCOL_TRACE_RESEND (5u)   /*!< Cmd, Transmissions So Far */
+#define PROTOCOL_TRACE_NO_ACK (6u)   /*!< Cmd, Reciver */
+#define PROTOCOL_TRACE_RCV_ERR (7u)  /*!< Interface Index, 0 Header Auth Failure Or 1 CRC32 Failure */
+#define PROTOCOL_TRACE_ID_NUM (8u)
+
+#define PROTOCOL_TRACE_MASK_ALL ((1u << PROTOCOL_TRACE_ID_NUM) - 1)
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported functions --------------------------------------------------------*/
+
+//事件跟踪初始化
+void protocol_trace_init(void);
+
+//记录一个事件
+void protocol_trace_write(uint16_t id, uint16_t arg0, uint32_t arg1);
+
+//设置记录的事件
+void protocol_trace_set_mask(uint32_t mask);
+
+//按时间顺序取出事件
+uint16_t protocol_trace_read(struct protocol_trace_event *event, uint16_t max_num, uint16_t *dropped);
+
+//回复事件查询
+void protocol_trace_reply(uint8_t reciver);
+
+#endif /* _PROTOCOL_TRACE_H_ */
@@ -18,6 +18,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include "protocol.h"
 #include "protocol_transmit.h"
+#include "protocol_wait.h"
 #include "protocol_log.h"
 
 /* Private typedef -----------------------------------------------------------*/
@@ -27,12 +28,15 @@
 extern local_info_t protocol_local_info;
 extern boardcast_object_t boardcast_object;
 
+/* 帧跨越FIFO回绕时使用的回弹缓冲区，仅在通信任务中解包使用 */
+static uint32_t protocol_rcv_bounce_buf[(PROTOCOL_FRAME_MAX_SIZE + 3) / 4];
+
 /* Private function prototypes -----------------------------------------------*/
 /* Exported functions --------------------------------------------------------*/
 
 uint8_t protocol_get_session(struct perph_interface * interface)
 {
-  for (int i = 0; i < 31; i++)
+  for (int i = 0; i < PROTOCOL_SESSION_MAX; i++)
   {
     if (interface->session[i] == 0)
     {
@@ -45,7 +49,7 @@ uint8_t protocol_get_session(struct perph_interface * interface)
 
 int32_t protocol_release_session(struct perph_interface * interface, uint8_t id)
 {
-  if ((id > 0) && (id < 32))
+  if ((id > 0) && (id <= PROTOCOL_SESSION_MAX))
   {
     interface->session[id - 1] = 0;
     return 0;
@@ -53,22 +57,56 @@ int32_t protocol_release_session(struct perph_interface * interface, uint8_t id)
   return -1;
 }
 
+//最新值命令：在发送列表中用新帧原位替换尚未发出的同命令、同收发地址的旧帧，
+//返回被替换的旧帧，没有可替换的帧时返回NULL，调用时需持有接口锁
+static send_list_node_t *protocol_s_coalesce_replace(list_t *head_node, send_list_node_t *new_node)
+{
+  list_t *cur_node;
+  send_list_node_t *old_node;
+  protocol_pack_desc_t *old_pack;
+  protocol_pack_desc_t *new_pack;
+
+  new_pack = (protocol_pack_desc_t *)(new_node->p_data);
+
+  list_for_each(cur_node, head_node)
+  {
+    old_node = (send_list_node_t *)cur_node;
+    old_pack = (protocol_pack_desc_t *)(old_node->p_data);
+
+    if ((old_pack->pack_type == PROTOCOL_PACK_NOR) && (old_pack->session == 0) &&
+        (old_pack->sender == new_pack->sender) && (old_pack->reciver == new_pack->reciver) &&
+        (*(uint16_t *)(old_pack->pdata) == *(uint16_t *)(new_pack->pdata)))
+    {
+      list_replace(cur_node, &(new_node->send_list));
+      return old_node;
+    }
+  }
+
+  return NULL;
+}
+
 //添加协议帧
 uint32_t protocol_s_add_sendnode(uint8_t reciver, uint8_t session, uint8_t pack_type,
-                                 void *p_data, uint32_t data_len, uint16_t cmd, uint16_t ack_seq)
+                                 const struct protocol_iov *iov, uint8_t iov_num,
+                                 uint16_t cmd, uint16_t ack_seq)
 {
   send_ctx_t ctx = {0};
   struct perph_interface *int_obj;
   uint32_t status;
+  uint32_t data_len;
   uint32_t malloc_size;
   uint8_t *malloc_zone;
   uint32_t pack_head_offset;
   protocol_pack_desc_t *pack_head;
   send_list_node_t *send_node;
+  send_list_node_t *old_node = NULL;
   uint16_t seq;
+  uint8_t priority;
+  uint8_t coalesce;
 
   status = PROTOCOL_SUCCESS;
 
+  data_len = protocol_s_iov_len(iov, iov_num);
   if (data_len > PROTOCOL_MAX_DATA_LEN)
   {
     status = PROTOCOL_ERR_DATA_TOO_LONG;
@@ -118,6 +156,7 @@ uint32_t protocol_s_add_sendnode(uint8_t reciver, uint8_t session, uint8_t pack_
   malloc_zone = protocol_p_malloc(malloc_size);
   if (malloc_zone == NULL)
   {
+    PROTOCOL_STATS_ADD(int_obj, alloc_fail, 1);
     status = PROTOCOL_ERR_NOT_ENOUGH_MEM;
     PROTOCOL_ERR_INFO_PRINTF(status, __FILE__, __LINE__);
     return status;
@@ -139,18 +178,19 @@ uint32_t protocol_s_add_sendnode(uint8_t reciver, uint8_t session, uint8_t pack_
   send_node = (send_list_node_t *)&malloc_zone[0];
 
   //填充帧数据部分
-  protocol_s_fill_pack(&ctx, p_data, data_len, (uint8_t *)(pack_head), seq, cmd);
+  protocol_s_fill_pack(&ctx, iov, iov_num, data_len, (uint8_t *)(pack_head), seq, cmd);
 
   //填充send_node
   send_node->session = ctx.s_a_r.session;
   send_node->p_data = &malloc_zone[pack_head_offset];
   send_node->len = malloc_size - PROTOCOL_SEND_NODE_SIZE;
   send_node->pre_timestamp = 0;
-  send_node->is_got_ack = 0;
-  send_node->is_first_send = 1;
+  send_node->deadline = 0;
+  send_node->enqueue_time = PROTOCOL_STATS_TIME_US();
+  send_node->heap_idx = PROTOCOL_HEAP_IDX_NONE;
+  send_node->send_cnt = 0;
   send_node->address = reciver;
   send_node->pack_type = pack_type;
-  send_node->is_ready_realse = 0;
   send_node->cmd = cmd;
   send_node->forward_src_obj = NULL;
 
@@ -158,6 +198,8 @@ uint32_t protocol_s_add_sendnode(uint8_t reciver, uint8_t session, uint8_t pack_
   cmd_info = protocol_get_send_cmd_info(cmd);
   if (cmd_info != NULL)
   {
+    priority = cmd_info->priority;
+    coalesce = cmd_info->coalesce;
     send_node->rest_cnt = cmd_info->resend_times;
     send_node->timeout = cmd_info->resend_timeout;
     send_node->ack_callback = cmd_info->ack_callback;
@@ -165,6 +207,8 @@ uint32_t protocol_s_add_sendnode(uint8_t reciver, uint8_t session, uint8_t pack_
   }
   else
   {
+    priority = PROTOCOL_PRIORITY_NORMAL;
+    coalesce = 0;
     send_node->rest_cnt = 1;
     send_node->timeout = 0;
     send_node->ack_callback = NULL;
@@ -176,7 +220,7 @@ uint32_t protocol_s_add_sendnode(uint8_t reciver, uint8_t session, uint8_t pack_
 
   if ((pack_type == PROTOCOL_PACK_NOR) && (session != 0))
   {
-    if (protocol_s_session_get_node(int_obj, reciver, session) != NULL)
+    if (protocol_s_session_node_noprotect(int_obj, reciver, session) != NULL)
     {
       status = PROTOCOL_ERR_SESSION_IS_USE;
       MUTEX_UNLOCK(int_obj->send.mutex_lock);
@@ -187,17 +231,39 @@ uint32_t protocol_s_add_sendnode(uint8_t reciver, uint8_t session, uint8_t pack_
 
   if (pack_type == PROTOCOL_PACK_NOR)
   {
-    list_add(&(send_node->send_list), &(int_obj->send.normal_list_header));
-    int_obj->send.normal_node_num++;
+    if (coalesce && (session == 0))
+    {
+      old_node = protocol_s_coalesce_replace(&(int_obj->send.normal_list_header[priority]), send_node);
+    }
+
+    if (old_node == NULL)
+    {
+      list_add(&(send_node->send_list), &(int_obj->send.normal_list_header[priority]));
+      int_obj->send.normal_node_num++;
+    }
+
+    if ((session != 0) && (session <= PROTOCOL_SESSION_MAX))
+    {
+      int_obj->send.session_node[session - 1] = send_node;
+    }
   }
   else
   {
     list_add(&(send_node->send_list), &(int_obj->send.ack_list_header));
     int_obj->send.ack_node_num++;
   }
+  PROTOCOL_STATS_MAX(int_obj, queue_max, (uint32_t)(int_obj->send.normal_node_num + int_obj->send.ack_node_num));
 
   MUTEX_UNLOCK(int_obj->send.mutex_lock);
 
+  if (old_node != NULL)
+  {
+    //旧帧已被替换，不再发送
+    protocol_p_free(old_node);
+  }
+
+  PROTOCOL_TRACE(PROTOCOL_TRACE_SEND, cmd, reciver | (session << 8));
+
   if (pack_type == PROTOCOL_PACK_NOR)
   {
       PROTOCOL_SEND_DBG_PRINTF("Send pack, Address:0x%02X, Cmd:0x%04X, Session: %d Normal pack.",
@@ -213,10 +279,11 @@ uint32_t protocol_s_add_sendnode(uint8_t reciver, uint8_t session, uint8_t pack_
 }
 
 //广播包添加处理函数
-uint32_t protocol_s_broadcast_add_node(void *p_data, uint32_t data_len, uint16_t cmd)
+uint32_t protocol_s_broadcast_add_node(const struct protocol_iov *iov, uint8_t iov_num, uint16_t cmd)
 {
   send_ctx_t ctx;
   uint32_t status;
+  uint32_t data_len;
   uint32_t malloc_size;
   uint8_t *malloc_zone;
   uint32_t pack_head_offset;
@@ -225,6 +292,7 @@ uint32_t protocol_s_broadcast_add_node(void *p_data, uint32_t data_len, uint16_t
 
   status = PROTOCOL_SUCCESS;
 
+  data_len = protocol_s_iov_len(iov, iov_num);
   if (data_len > PROTOCOL_MAX_DATA_LEN)
   {
     status = PROTOCOL_ERR_DATA_TOO_LONG;
@@ -255,7 +323,7 @@ uint32_t protocol_s_broadcast_add_node(void *p_data, uint32_t data_len, uint16_t
   send_node = (send_list_node_t *)&malloc_zone[0];
 
   //填充帧数据部分
-  protocol_s_fill_pack(&ctx, p_data, data_len, (uint8_t *)(pack_head), 0, cmd);
+  protocol_s_fill_pack(&ctx, iov, iov_num, data_len, (uint8_t *)(pack_head), 0, cmd);
 
   //填充send_node
   send_node->session = 0;
@@ -264,11 +332,12 @@ uint32_t protocol_s_broadcast_add_node(void *p_data, uint32_t data_len, uint16_t
   send_node->rest_cnt = 1;
   send_node->pre_timestamp = 0;
   send_node->timeout = 0;
-  send_node->is_got_ack = 0;
-  send_node->is_first_send = 1;
+  send_node->deadline = 0;
+  send_node->enqueue_time = PROTOCOL_STATS_TIME_US();
+  send_node->heap_idx = PROTOCOL_HEAP_IDX_NONE;
+  send_node->send_cnt = 0;
   send_node->address = PROTOCOL_BROADCAST_ADDR;
   send_node->pack_type = PROTOCOL_PACK_NOR;
-  send_node->is_ready_realse = 0;
   send_node->cmd = cmd;
   send_node->forward_src_obj = NULL;
 
@@ -285,12 +354,27 @@ uint32_t protocol_s_broadcast_add_node(void *p_data, uint32_t data_len, uint16_t
   return status;
 }
 
-//帧填充
-uint32_t protocol_s_fill_pack(send_ctx_t *ctx, uint8_t *p_data,
+//计算数据片段总长度
+uint32_t protocol_s_iov_len(const struct protocol_iov *iov, uint8_t iov_num)
+{
+  uint32_t data_len = 0;
+
+  for (int i = 0; i < iov_num; i++)
+  {
+    data_len += iov[i].len;
+  }
+
+  return data_len;
+}
+
+//帧填充，数据片段直接写入帧内存，拷贝的同时计算CRC32
+uint32_t protocol_s_fill_pack(send_ctx_t *ctx, const struct protocol_iov *iov, uint8_t iov_num,
                               uint32_t data_len, uint8_t *pack_zone, uint16_t seq, uint16_t cmd)
 {
   uint32_t status = 0;
   protocol_pack_desc_t *p_pack_head;
+  uint8_t *p_write;
+  uint32_t crc32;
 
   p_pack_head = (protocol_pack_desc_t *)pack_zone;
 
@@ -302,47 +386,55 @@ uint32_t protocol_s_fill_pack(send_ctx_t *ctx, uint8_t *p_data,
   p_pack_head->reciver = ctx->reciver;
   p_pack_head->S_A_R_c = ctx->S_A_R_c;
   p_pack_head->seq_num = seq;
-  p_pack_head->ver_data_len = p_pack_head->ver_data_len;
   p_pack_head->res1 = 0;
 
-  /* cpy data */
   if (ctx->s_a_r.pack_type == PROTOCOL_PACK_ACK)
   {
     p_pack_head->data_len = data_len + PROTOCOL_PACK_HEAD_TAIL_SIZE;
-    memcpy(pack_zone + PROTOCOL_PACK_HEAD_SIZE, p_data, data_len);
+    p_write = pack_zone + PROTOCOL_PACK_HEAD_SIZE;
   }
   else
   {
     p_pack_head->data_len = data_len + PROTOCOL_PACK_HEAD_TAIL_SIZE + PROTOCOL_PACK_CMD_SIZE;
     *((uint16_t *)(pack_zone + PROTOCOL_PACK_HEAD_SIZE)) = cmd;
-    memcpy(pack_zone + PROTOCOL_PACK_HEAD_SIZE + PROTOCOL_PACK_CMD_SIZE, p_data, data_len);
+    p_write = pack_zone + PROTOCOL_PACK_HEAD_SIZE + PROTOCOL_PACK_CMD_SIZE;
   }
 
   /* crc */
   append_crc16(pack_zone, 12);
 
-  if (ctx->s_a_r.pack_type == PROTOCOL_PACK_ACK)
-  {
-    append_crc32(pack_zone, data_len + PROTOCOL_PACK_HEAD_TAIL_SIZE);
-  }
-  else
+  crc32 = get_crc32(pack_zone, p_write - pack_zone, get_crc32_init());
+
+  /* cpy data */
+  for (int i = 0; i < iov_num; i++)
   {
-    append_crc32(pack_zone, data_len + PROTOCOL_PACK_HEAD_TAIL_SIZE + PROTOCOL_PACK_CMD_SIZE);
+    crc32 = copy_crc32(p_write, (const uint8_t *)iov[i].base, iov[i].len, crc32);
+    p_write += iov[i].len;
   }
 
+  p_write[0] = (uint8_t)(crc32 & 0xff);
+  p_write[1] = (uint8_t)((crc32 >> 8) & 0xff);
+  p_write[2] = (uint8_t)((crc32 >> 16) & 0xff);
+  p_write[3] = (uint8_t)((crc32 >> 24) & 0xff);
+
   return status;
 }
 
 //通过接口发送数据
 uint32_t protocol_s_interface_send_data(send_list_node_t *cur_send_node, struct perph_interface *obj)
 {
+  if (cur_send_node->send_cnt == 0)
+  {
+    //首次发送，统计从加入发送列表到发出的延迟
+    PROTOCOL_STATS_HIST(obj, tx_lat_hist, protocol_p_get_time_us() - cur_send_node->enqueue_time);
+  }
 
 #if (PROTOCOL_AUTO_LOOKBACK == PROTOCOL_ENABLE)
 
   if (cur_send_node->address != protocol_local_info.address)
   {
     //发送地址与本地地址不相同，外发
-    protocol_interface_send_data(obj, cur_send_node->p_data, cur_send_node->len);
+    protocol_s_interface_batch_send(obj, cur_send_node->p_data, cur_send_node->len);
   }
   else
   {
@@ -365,98 +457,434 @@ uint32_t protocol_s_interface_send_data(send_list_node_t *cur_send_node, struct
   return PROTOCOL_SUCCESS;
 }
 
-//清空发送列表
-uint32_t protocol_s_interface_normal_send_flush(struct perph_interface *obj)
+//合并发送，帧先放入接口合并缓冲区，放不下时先发出已合并的数据
+uint32_t protocol_s_interface_batch_send(struct perph_interface *obj, uint8_t *p_data, uint16_t len)
+{
+  PROTOCOL_STATS_ADD(obj, tx_frames, 1);
+  PROTOCOL_STATS_ADD(obj, tx_bytes, len);
+
+#if (PROTOCOL_TX_BATCH_ENABLE == PROTOCOL_ENABLE)
+
+  if (obj->send.batch_len + len > PROTOCOL_TX_BATCH_SIZE)
+  {
+    protocol_s_interface_batch_flush(obj);
+  }
+
+  if (len > PROTOCOL_TX_BATCH_SIZE)
+  {
+    //超过合并缓冲区的帧直接发送
+    protocol_interface_send_data(obj, p_data, len);
+  }
+  else
+  {
+    memcpy(obj->send.batch_buf + obj->send.batch_len, p_data, len);
+    obj->send.batch_len += len;
+  }
+
+#else
+
+  protocol_interface_send_data(obj, p_data, len);
+
+#endif
+
+  return PROTOCOL_SUCCESS;
+}
+
+//发出合并缓冲区中的数据
+uint32_t protocol_s_interface_batch_flush(struct perph_interface *obj)
+{
+#if (PROTOCOL_TX_BATCH_ENABLE == PROTOCOL_ENABLE)
+
+  if (obj->send.batch_len > 0)
+  {
+    protocol_interface_send_data(obj, obj->send.batch_buf, obj->send.batch_len);
+    obj->send.batch_len = 0;
+  }
+
+#endif
+
+  return PROTOCOL_SUCCESS;
+}
+
+//获取命令的发送优先级，未配置的命令为普通优先级
+uint8_t protocol_s_get_cmd_priority(uint16_t cmd)
+{
+  struct send_cmd_info *cmd_info;
+
+  cmd_info = protocol_get_send_cmd_info(cmd);
+  if (cmd_info != NULL)
+  {
+    return cmd_info->priority;
+  }
+  return PROTOCOL_PRIORITY_NORMAL;
+}
+
+//命令是否为最新值语义，未配置的命令不合并
+uint8_t protocol_s_get_cmd_coalesce(uint16_t cmd)
+{
+  struct send_cmd_info *cmd_info;
+
+  cmd_info = protocol_get_send_cmd_info(cmd);
+  if (cmd_info != NULL)
+  {
+    return cmd_info->coalesce;
+  }
+  return 0;
+}
+
+#if (PROTOCOL_STATS_ENABLE == PROTOCOL_ENABLE)
+//延迟计入log2直方图，第i桶为[2^(i-1), 2^i)us
+void protocol_s_stats_hist(uint32_t *hist, uint32_t us)
+{
+  uint32_t idx;
+
+  idx = 32 - __CLZ(us);
+  if (idx >= PROTOCOL_STATS_HIST_NUM)
+  {
+    idx = PROTOCOL_STATS_HIST_NUM - 1;
+  }
+  hist[idx]++;
+}
+#endif
+
+//重发堆比较，deadline早的在前
+static uint8_t protocol_s_resend_before(send_list_node_t *a, send_list_node_t *b)
+{
+  return (int32_t)(a->deadline - b->deadline) < 0;
+}
+
+static void protocol_s_resend_heap_set(send_desc_t *send, uint8_t idx, send_list_node_t *node)
+{
+  send->resend_heap[idx] = node;
+  node->heap_idx = idx;
+}
+
+static void protocol_s_resend_heap_up(send_desc_t *send, uint8_t idx)
+{
+  send_list_node_t *node = send->resend_heap[idx];
+  uint8_t parent;
+
+  while (idx > 0)
+  {
+    parent = (idx - 1) / 2;
+    if (!protocol_s_resend_before(node, send->resend_heap[parent]))
+    {
+      break;
+    }
+    protocol_s_resend_heap_set(send, idx, send->resend_heap[parent]);
+    idx = parent;
+  }
+  protocol_s_resend_heap_set(send, idx, node);
+}
+
+static void protocol_s_resend_heap_down(send_desc_t *send, uint8_t idx)
+{
+  send_list_node_t *node = send->resend_heap[idx];
+  uint8_t child;
+
+  while ((child = idx * 2 + 1) < send->resend_num)
+  {
+    if ((child + 1 < send->resend_num) &&
+        protocol_s_resend_before(send->resend_heap[child + 1], send->resend_heap[child]))
+    {
+      child++;
+    }
+    if (!protocol_s_resend_before(send->resend_heap[child], node))
+    {
+      break;
+    }
+    protocol_s_resend_heap_set(send, idx, send->resend_heap[child]);
+    idx = child;
+  }
+  protocol_s_resend_heap_set(send, idx, node);
+}
+
+//加入重发堆，调用者需持有obj->send.mutex_lock
+void protocol_s_resend_heap_push(struct perph_interface *obj, send_list_node_t *node)
+{
+  uint8_t idx = obj->send.resend_num++;
+
+  protocol_s_resend_heap_set(&obj->send, idx, node);
+  protocol_s_resend_heap_up(&obj->send, idx);
+}
+
+//移出重发堆，调用者需持有obj->send.mutex_lock
+void protocol_s_resend_heap_remove(struct perph_interface *obj, send_list_node_t *node)
+{
+  uint8_t idx = node->heap_idx;
+  send_list_node_t *last;
+
+  if (idx >= obj->send.resend_num)
+  {
+    return;
+  }
+
+  node->heap_idx = PROTOCOL_HEAP_IDX_NONE;
+  last = obj->send.resend_heap[--obj->send.resend_num];
+  if (last == node)
+  {
+    return;
+  }
+
+  protocol_s_resend_heap_set(&obj->send, idx, last);
+  protocol_s_resend_heap_up(&obj->send, idx);
+  protocol_s_resend_heap_down(&obj->send, last->heap_idx);
+}
+
+//发送指定优先级列表中的新帧，需要ACK的帧发送后转入重发堆
+//RTT样本更新平滑RTT与偏差(RFC 6298)，并重新计算重发超时
+void protocol_s_rtt_sample(struct perph_interface *obj, uint32_t rtt_ms)
+{
+  struct protocol_rtt *rtt = &obj->send.rtt;
+  int32_t delta;
+  uint32_t rto;
+
+  if (rtt->sample_cnt == 0)
+  {
+    rtt->srtt = rtt_ms << 3;
+    rtt->rttvar = rtt_ms << 1;
+  }
+  else
+  {
+    //srtt = 7/8 srtt + 1/8 R, rttvar = 3/4 rttvar + 1/4 |srtt - R|
+    delta = (int32_t)rtt_ms - (int32_t)(rtt->srtt >> 3);
+    rtt->srtt += delta;
+    if (delta < 0)
+    {
+      delta = -delta;
+    }
+    rtt->rttvar += delta - (int32_t)(rtt->rttvar >> 2);
+  }
+  rtt->sample_cnt++;
+
+  //rto = srtt + max(G, 4 * rttvar)，时钟粒度G为1ms
+  rto = (rtt->srtt >> 3) + ((rtt->rttvar > 1) ? rtt->rttvar : 1);
+  if (rto < PROTOCOL_RTO_MIN)
+  {
+    rto = PROTOCOL_RTO_MIN;
+  }
+  else if (rto > PROTOCOL_RTO_MAX)
+  {
+    rto = PROTOCOL_RTO_MAX;
+  }
+  rtt->rto = rto;
+}
+
+//收到ACK，只对未重发过的帧采样(Karn算法)，并统计重发是否必要
+static void protocol_s_rtt_ack(struct perph_interface *obj, send_list_node_t *node, uint32_t now)
+{
+  struct protocol_rtt *rtt = &obj->send.rtt;
+  uint32_t elapsed;
+
+  if (node->send_cnt == 0)
+  {
+    return;
+  }
+
+  elapsed = now - node->pre_timestamp;
+  if (node->send_cnt == 1)
+  {
+    protocol_s_rtt_sample(obj, elapsed);
+    return;
+  }
+
+  //最后一次重发后不到半个RTT就收到ACK，确认的是之前的发送，这次重发是多余的
+  if ((rtt->sample_cnt > 0) && ((elapsed << 4) < rtt->srtt))
+  {
+    rtt->spurious_cnt++;
+    rtt->needed_cnt += node->send_cnt - 2;
+  }
+  else
+  {
+    rtt->needed_cnt += node->send_cnt - 1;
+  }
+}
+
+//节点本次发送后等待ACK的时间，自适应超时每次重发加倍
+uint32_t protocol_s_node_timeout(struct perph_interface *obj, send_list_node_t *node)
+{
+  uint32_t timeout;
+
+  if (node->timeout != PROTOCOL_RESEND_TIMEOUT_AUTO)
+  {
+    return node->timeout;
+  }
+
+  timeout = obj->send.rtt.rto;
+  if (node->send_cnt > 1)
+  {
+    timeout = (node->send_cnt > 8) ? PROTOCOL_RTO_MAX : (timeout << (node->send_cnt - 1));
+  }
+  if (timeout > PROTOCOL_RTO_MAX)
+  {
+    timeout = PROTOCOL_RTO_MAX;
+  }
+  return timeout;
+}
+
+uint32_t protocol_s_interface_normal_send_flush(struct perph_interface *obj, uint8_t priority)
 {
   list_t *head_node;
   list_t *cur_node;
-  list_t *store_list;
   send_list_node_t *cur_send_node;
-  uint32_t timeout;
+  uint32_t now;
 
-  head_node = &(obj->send.normal_list_header);
-  list_for_each_prev_safe(cur_node, store_list, head_node)
+  head_node = &(obj->send.normal_list_header[priority]);
+  while (1)
   {
+    //先从链表尾取下节点再发送，发送期间新加入的最新值帧不会替换正在发送的帧
+    MUTEX_LOCK(obj->send.mutex_lock);
+    if (list_empty(head_node))
+    {
+      MUTEX_UNLOCK(obj->send.mutex_lock);
+      break;
+    }
+    cur_node = head_node->prev;
+    list_del(cur_node);
+    MUTEX_UNLOCK(obj->send.mutex_lock);
 
     cur_send_node = (send_list_node_t *)cur_node;
 
-    MUTEX_LOCK(obj->send.mutex_lock);
-    //得到ACK，删除
-    if (cur_send_node->is_got_ack)
+    //发送数据
+    protocol_s_interface_send_data(cur_send_node, obj);
+    cur_send_node->send_cnt++;
+    if (cur_send_node->rest_cnt > 0)
     {
-      list_del(cur_node);
-      protocol_p_free(cur_send_node);
-      obj->send.normal_node_num--;
+      cur_send_node->rest_cnt--;
+    }
 
-      protocol_release_session(obj, cur_send_node->session);
+    MUTEX_LOCK(obj->send.mutex_lock);
 
+    if (cur_send_node->session == 0)
+    {
+      //session为0,不需要重发和ACK回复
+      obj->send.normal_node_num--;
       MUTEX_UNLOCK(obj->send.mutex_lock);
+      protocol_p_free(cur_send_node);
       continue;
     }
 
-    //超过重发次数释放
-    if (cur_send_node->is_ready_realse)
+    //session不为0,等待ACK，超时后重发
+    now = protocol_p_get_time();
+    cur_send_node->pre_timestamp = now;
+    cur_send_node->deadline = now + protocol_s_node_timeout(obj, cur_send_node) + 1;
+    protocol_s_resend_heap_push(obj, cur_send_node);
+
+    MUTEX_UNLOCK(obj->send.mutex_lock);
+  }
+
+  return 0;
+}
+
+//处理到期的重发帧，只访问堆顶已到期的节点
+uint32_t protocol_s_interface_resend_flush(struct perph_interface *obj)
+{
+  send_list_node_t *cur_send_node;
+  uint32_t token;
+  uint32_t now;
+
+  now = protocol_p_get_time();
+
+  while (obj->send.resend_num > 0)
+  {
+    cur_send_node = obj->send.resend_heap[0];
+    if ((int32_t)(now - cur_send_node->deadline) < 0)
     {
-      list_del(cur_node);
+      break;
+    }
+
+    if (cur_send_node->rest_cnt == 0)
+    {
+      //超过重发次数释放
+      MUTEX_LOCK(obj->send.mutex_lock);
+      protocol_s_resend_heap_remove(obj, cur_send_node);
       obj->send.normal_node_num--;
+      token = protocol_s_session_detach(obj, cur_send_node);
+      protocol_release_session(obj, cur_send_node->session);
+      obj->send.rtt.no_ack_cnt++;
+      PROTOCOL_STATS_ADD(obj, ack_timeout, 1);
+      obj->send.rtt.needed_cnt += cur_send_node->send_cnt - 1;
+      MUTEX_UNLOCK(obj->send.mutex_lock);
 
+      PROTOCOL_TRACE(PROTOCOL_TRACE_NO_ACK, cur_send_node->cmd, cur_send_node->address);
       if (cur_send_node->no_ack_callback != NULL)
       {
         cur_send_node->no_ack_callback(cur_send_node->cmd);
       }
-
-      protocol_release_session(obj, cur_send_node->session);
+#if (PROTOCOL_WAIT_ENABLE == PROTOCOL_ENABLE)
+      protocol_wait_complete(token, PROTOCOL_ERR_NO_ACK);
+#endif
 
       protocol_p_free(cur_send_node);
-
-      MUTEX_UNLOCK(obj->send.mutex_lock);
       continue;
     }
-    else
-    {
-      MUTEX_UNLOCK(obj->send.mutex_lock);
-    }
 
-    timeout = protocol_p_get_time() - cur_send_node->pre_timestamp;
+    //超时重发
+    protocol_s_interface_send_data(cur_send_node, obj);
+    cur_send_node->send_cnt++;
+    cur_send_node->rest_cnt--;
+    PROTOCOL_STATS_ADD(obj, resend_cnt, 1);
+    PROTOCOL_TRACE(PROTOCOL_TRACE_RESEND, cur_send_node->cmd, cur_send_node->send_cnt);
 
-    //超时重发或者初次发送
-    if ((timeout > cur_send_node->timeout || cur_send_node->is_first_send) &&
-        cur_send_node->rest_cnt >= 1)
-    {
-      cur_send_node->is_first_send = 0;
+    MUTEX_LOCK(obj->send.mutex_lock);
+    cur_send_node->pre_timestamp = now;
+    cur_send_node->deadline = now + protocol_s_node_timeout(obj, cur_send_node) + 1;
+    protocol_s_resend_heap_down(&obj->send, 0);
+    MUTEX_UNLOCK(obj->send.mutex_lock);
+  }
 
-      cur_send_node->rest_cnt--;
+  return 0;
+}
 
-      //发送数据
-      protocol_s_interface_send_data(cur_send_node, obj);
+//收到ACK后立即释放对应的发送节点
+void protocol_s_session_complete(struct perph_interface *obj, send_list_node_t *node)
+{
+  uint32_t token;
+  uint32_t start;
 
-      if (cur_send_node->session == 0)
-      {
-        //session为0,不需要重发和ACK回复
-        MUTEX_LOCK(obj->send.mutex_lock);
-        list_del(cur_node);
-        obj->send.normal_node_num--;
-        protocol_p_free(cur_send_node);
-        MUTEX_UNLOCK(obj->send.mutex_lock);
-        continue;
-      }
-      else
-      {
-        //session不为0,需要重发和ACK确认
-        if (cur_send_node->rest_cnt == 0)
-        {
-          //发送次数用完
-          cur_send_node->is_ready_realse = 1;
-        }
-        else
-        {
-          cur_send_node->pre_timestamp = protocol_p_get_time();
-        }
-      }
-    }
+  MUTEX_LOCK(obj->send.mutex_lock);
+  start = PROTOCOL_STATS_CYCLES();
+
+  if (node->heap_idx != PROTOCOL_HEAP_IDX_NONE)
+  {
+    protocol_s_resend_heap_remove(obj, node);
   }
+  else
+  {
+    //尚未发出的节点仍在发送列表中
+    list_del(&(node->send_list));
+  }
+  obj->send.normal_node_num--;
 
-  return 0;
+  token = protocol_s_session_detach(obj, node);
+  protocol_release_session(obj, node->session);
+
+  PROTOCOL_STATS_MAX(obj, session_lock_max, PROTOCOL_STATS_CYCLES() - start);
+  MUTEX_UNLOCK(obj->send.mutex_lock);
+
+  protocol_p_free(node);
+
+#if (PROTOCOL_WAIT_ENABLE == PROTOCOL_ENABLE)
+  protocol_wait_complete(token, PROTOCOL_SUCCESS);
+#endif
+}
+
+//距最早重发时刻的时间，没有等待重发的帧时返回PROTOCOL_WAIT_FOREVER
+uint32_t protocol_s_interface_resend_wait_time(struct perph_interface *obj, uint32_t now)
+{
+  int32_t wait;
+
+  if (obj->send.resend_num == 0)
+  {
+    return PROTOCOL_WAIT_FOREVER;
+  }
+
+  wait = (int32_t)(obj->send.resend_heap[0]->deadline - now);
+  if (wait <= 0)
+  {
+    return 0;
+  }
+  return (uint32_t)wait;
 }
 
 //清空ACK帧发送列表
@@ -503,7 +931,7 @@ uint32_t protocol_s_broadcast_send_flush(void)
     {
       if (cur_send_node->forward_src_obj == protocol_local_info.interface + i)
         continue;
-      if (!cur_send_node->forward_src_obj->is_valid)
+      if (!protocol_local_info.interface[i].is_valid)
         continue;
       if (!protocol_local_info.interface[i].broadcast_output_enable)
         continue;
@@ -542,33 +970,126 @@ struct perph_interface *protocol_s_get_route(uint8_t tar_add)
   }
 }
 
+//获得指定地址和session的节点，调用者需持有obj->send.mutex_lock
+send_list_node_t *protocol_s_session_node_noprotect(struct perph_interface *obj,
+                                                    uint8_t address, uint8_t session)
+{
+  send_list_node_t *session_node;
+
+  if ((session == 0) || (session > PROTOCOL_SESSION_MAX))
+  {
+    return NULL;
+  }
+
+  session_node = obj->send.session_node[session - 1];
+  if ((session_node != NULL) && (session_node->address == address))
+  {
+    return session_node;
+  }
+  return NULL;
+}
+
 //获得指定地址和session的节点
 send_list_node_t *protocol_s_session_get_node(struct perph_interface *obj,
                                               uint8_t address, uint8_t session)
 {
-  list_t *head_node;
-  list_t *cur_node;
-  list_t *store_list;
-  send_list_node_t *cur_send_node;
-
-  head_node = &(obj->send.normal_list_header);
+  send_list_node_t *session_node;
+  uint32_t start;
 
   MUTEX_LOCK(protocol_local_info.mutex_lock);
-  list_for_each_prev_safe(cur_node, store_list, head_node)
+  start = PROTOCOL_STATS_CYCLES();
+  session_node = protocol_s_session_node_noprotect(obj, address, session);
+  PROTOCOL_STATS_MAX(obj, session_lock_max, PROTOCOL_STATS_CYCLES() - start);
+  MUTEX_UNLOCK(protocol_local_info.mutex_lock);
+
+  return session_node;
+}
+
+//发送节点释放前解除session索引，返回该session上等待结果的可靠发送令牌，调用者需持有obj->send.mutex_lock
+uint32_t protocol_s_session_detach(struct perph_interface *obj, send_list_node_t *node)
+{
+  uint32_t token = PROTOCOL_WAIT_TOKEN_NONE;
+
+  if ((node->session == 0) || (node->session > PROTOCOL_SESSION_MAX))
   {
-    cur_send_node = (send_list_node_t *)cur_node;
+    return token;
+  }
 
-    if ((cur_send_node->session == session) &&
-        (cur_send_node->address == address))
+  if (obj->send.session_node[node->session - 1] == node)
+  {
+    obj->send.session_node[node->session - 1] = NULL;
+#if (PROTOCOL_WAIT_ENABLE == PROTOCOL_ENABLE)
+    token = obj->send.session_wait[node->session - 1];
+    obj->send.session_wait[node->session - 1] = PROTOCOL_WAIT_TOKEN_NONE;
+#endif
+  }
+
+  return token;
+}
+
+#if (PROTOCOL_CUT_THROUGH_ENABLE == PROTOCOL_ENABLE)
+
+//接口是否有尚未发出的帧，normal_node_num包含已发出等待ACK的节点，不能用来判断
+static uint8_t protocol_s_interface_queue_empty(struct perph_interface *obj)
+{
+  if (obj->send.ack_node_num > 0)
+  {
+    return 0;
+  }
+
+  for (uint8_t prio = 0; prio < PROTOCOL_PRIORITY_NUM; prio++)
+  {
+    if (!list_empty(&(obj->send.normal_list_header[prio])))
     {
-      MUTEX_UNLOCK(protocol_local_info.mutex_lock);
-      return cur_send_node;
+      return 0;
     }
   }
-  MUTEX_UNLOCK(protocol_local_info.mutex_lock);
-  return NULL;
+  return 1;
 }
 
+//直通转发，已校验的帧直接从接收缓冲区写入目标接口，目标接口有排队的帧时返回0，由调用者排队转发
+static uint8_t protocol_s_pack_cut_through(protocol_pack_desc_t *p_pack, struct perph_interface *src_obj,
+                                           struct perph_interface *tar_inter)
+{
+  struct perph_interface *obj;
+
+  if (p_pack->reciver != PROTOCOL_BROADCAST_ADDR)
+  {
+    //排队的帧先发，保证同一目标的帧顺序与优先级
+    if (!protocol_s_interface_queue_empty(tar_inter))
+    {
+      return 0;
+    }
+
+    protocol_s_interface_batch_send(tar_inter, (uint8_t *)p_pack, p_pack->data_len);
+
+    PROTOCOL_RCV_DBG_PRINTF("Pack cut through to address 0x%02x, Next jump is %s.",
+                             p_pack->reciver, tar_inter->object_name);
+    return 1;
+  }
+
+  if (boardcast_object.send_node_num > 0)
+  {
+    return 0;
+  }
+
+  //广播帧从同一接收缓冲区依次写入各输出接口
+  for (uint8_t i = 0; i < PROTOCOL_INTERFACE_MAX; i++)
+  {
+    obj = protocol_local_info.interface + i;
+    if ((obj == src_obj) || (!obj->is_valid) || (!obj->broadcast_output_enable))
+    {
+      continue;
+    }
+    protocol_s_interface_batch_send(obj, (uint8_t *)p_pack, p_pack->data_len);
+  }
+
+  PROTOCOL_RCV_DBG_PRINTF("Broadcast pack cut through.");
+  return 1;
+}
+
+#endif
+
 //包转发函数
 uint32_t protocol_s_pack_forward(protocol_pack_desc_t *p_pack, struct perph_interface *src_obj)
 {
@@ -578,6 +1099,9 @@ uint32_t protocol_s_pack_forward(protocol_pack_desc_t *p_pack, struct perph_inte
   uint32_t status;
   uint32_t pack_head_offset;
   send_list_node_t *send_node;
+  send_list_node_t *old_node = NULL;
+  uint8_t priority = PROTOCOL_PRIORITY_NORMAL;
+  uint8_t coalesce = 0;
 
   status = PROTOCOL_SUCCESS;
 
@@ -593,11 +1117,25 @@ uint32_t protocol_s_pack_forward(protocol_pack_desc_t *p_pack, struct perph_inte
       return PROTOCOL_ERR_ROUTE_NOT_FOUND;
     }
   }
+  else
+  {
+    tar_inter = NULL;
+  }
+
+#if (PROTOCOL_CUT_THROUGH_ENABLE == PROTOCOL_ENABLE)
+  if (protocol_s_pack_cut_through(p_pack, src_obj, tar_inter))
+  {
+    PROTOCOL_TRACE(PROTOCOL_TRACE_FORWARD, p_pack->data_len, p_pack->reciver | (1u << 8));
+    return status;
+  }
+#endif
+  PROTOCOL_TRACE(PROTOCOL_TRACE_FORWARD, p_pack->data_len, p_pack->reciver);
 
   //分配转发包所需的内存
   malloc_zone = protocol_p_malloc(p_pack->data_len + PROTOCOL_SEND_NODE_SIZE);
   if (malloc_zone == NULL)
   {
+    PROTOCOL_STATS_ADD((tar_inter != NULL) ? tar_inter : src_obj, alloc_fail, 1);
     status = PROTOCOL_ERR_NOT_ENOUGH_MEM;
     PROTOCOL_ERR_INFO_PRINTF(status, __FILE__, __LINE__);
     return status;
@@ -612,23 +1150,50 @@ uint32_t protocol_s_pack_forward(protocol_pack_desc_t *p_pack, struct perph_inte
   send_node->rest_cnt = 1;
   send_node->pre_timestamp = 0;
   send_node->timeout = 0;
-  send_node->is_got_ack = 0;
-  send_node->is_first_send = 1;
+  send_node->deadline = 0;
+  send_node->enqueue_time = PROTOCOL_STATS_TIME_US();
+  send_node->heap_idx = PROTOCOL_HEAP_IDX_NONE;
+  send_node->send_cnt = 0;
   send_node->address = p_pack->reciver;
   send_node->pack_type = PROTOCOL_PACK_ACK; //把转发包当做ACK包发送更快捷
-  send_node->is_ready_realse = 0;
   send_node->cmd = 0;
   send_node->forward_src_obj = src_obj;
 
   memcpy(send_node->p_data, p_pack, p_pack->data_len);
+  if (p_pack->pack_type == PROTOCOL_PACK_NOR)
+  {
+    priority = protocol_s_get_cmd_priority(*(uint16_t *)(p_pack->pdata));
+    coalesce = (p_pack->session == 0) && protocol_s_get_cmd_coalesce(*(uint16_t *)(p_pack->pdata));
+  }
   if (p_pack->reciver != PROTOCOL_BROADCAST_ADDR)
   {
-    //非广播包处理
+    //非广播包处理，ACK包进入ACK列表，正常包按命令优先级排队
     MUTEX_LOCK(tar_inter->send.mutex_lock);
-    list_add(&(send_node->send_list), &(tar_inter->send.ack_list_header)); //把转发包当做ACK包发送更快捷
-    tar_inter->send.ack_node_num++;
+    if (p_pack->pack_type == PROTOCOL_PACK_ACK)
+    {
+      list_add(&(send_node->send_list), &(tar_inter->send.ack_list_header)); //把转发包当做ACK包发送更快捷
+      tar_inter->send.ack_node_num++;
+    }
+    else
+    {
+      if (coalesce)
+      {
+        old_node = protocol_s_coalesce_replace(&(tar_inter->send.normal_list_header[priority]), send_node);
+      }
+      if (old_node == NULL)
+      {
+        list_add(&(send_node->send_list), &(tar_inter->send.normal_list_header[priority]));
+        tar_inter->send.normal_node_num++;
+      }
+    }
+    PROTOCOL_STATS_MAX(tar_inter, queue_max, (uint32_t)(tar_inter->send.normal_node_num + tar_inter->send.ack_node_num));
     MUTEX_UNLOCK(tar_inter->send.mutex_lock);
 
+    if (old_node != NULL)
+    {
+      protocol_p_free(old_node);
+    }
+
     PROTOCOL_RCV_DBG_PRINTF("Pack forward to address 0x%02x, Next jump is %s.",
                              p_pack->reciver, tar_inter->object_name);
   }
@@ -679,30 +1244,37 @@ uint32_t protocol_s_unpack_data_handle(struct perph_interface *obj)
                                                p_pack->sender,
                                                p_pack->session);
 
-    if (session_node == NULL)
+    //Ack回送原帧序号，序号不符的是session被重新使用前旧帧迟到的Ack
+    if ((session_node == NULL) ||
+        (((protocol_pack_desc_t *)session_node->p_data)->seq_num != p_pack->seq_num))
     {
       status = PROTOCOL_ERR_SESSION_NOT_FOUND;
       PROTOCOL_ERR_INFO_PRINTF(status, __FILE__, __LINE__);
 
       return status;
     }
-    session_node->is_got_ack = 1;
-
     cmd = session_node->cmd;
 
+    PROTOCOL_TRACE(PROTOCOL_TRACE_ACK_RCV, cmd, p_pack->sender | (p_pack->session << 8));
     PROTOCOL_RCV_DBG_PRINTF("Rcv pack, Address:0x%02X, Cmd:0x%04X, Session:%d Ack pack.",
                              p_pack->sender, cmd, p_pack->session);
 
+    protocol_s_rtt_ack(obj, session_node, protocol_p_get_time());
+
     if (session_node->ack_callback != NULL)
     {
       session_node->ack_callback(*(int32_t *)(p_pack->pdata));
     }
+
+    protocol_s_session_complete(obj, session_node);
   }
   else
   {
     cmd = *((uint16_t *)(p_pack->pdata));
+    PROTOCOL_TRACE(PROTOCOL_TRACE_RCV, cmd, p_pack->sender | (p_pack->session << 8));
     PROTOCOL_RCV_DBG_PRINTF("Rcv pack, Address:0x%02X, Cmd:0x%04X, Normal pack.",
                              p_pack->sender, cmd);
+    PROTOCOL_STATS_HIST(obj, rx_lat_hist, protocol_p_get_time_us() - obj->rcvd.frame_time_us);
     if (protocol_local_info.rcv_nor_callBack != NULL)
     {
       protocol_local_info.rcv_nor_callBack((uint8_t *)p_pack,
@@ -720,6 +1292,7 @@ uint32_t protocol_s_extract(struct perph_interface *obj)
 {
   uint32_t status = 0;
   rcvd_desc_t *rcvd;
+  int used;
 
   rcvd = &obj->rcvd;
   if (fifo_s_isempty(&rcvd->fifo))
@@ -734,9 +1307,13 @@ uint32_t protocol_s_extract(struct perph_interface *obj)
     {
     case UNPACK_PACK_STAGE_FIND_SOF:
 
+      used = fifo_s_used(&rcvd->fifo);
       status = protocol_s_find_pack_header(rcvd);
+      PROTOCOL_STATS_ADD(obj, resync_bytes, used - fifo_s_used(&rcvd->fifo));
       if (status == PROTOCOL_SUCCESS)
       {
+        //帧头所在数据已到达，之后到达的数据不改变本帧的时间戳
+        rcvd->frame_time_us = rcvd->rcv_time_us;
         rcvd->state = UNPACK_PACK_STAGE_AUTH_HEADER;
       }
       break;
@@ -746,21 +1323,15 @@ uint32_t protocol_s_extract(struct perph_interface *obj)
       status = protocol_s_auth_pack_header(rcvd);
 
       if (status == PROTOCOL_SUCCESS)
-      { /* malloc memory size equal to header size adding data size */
+      {
         rcvd->state = UNPACK_PACK_STAGE_RECV_DATA;
-        rcvd->p_data = protocol_p_malloc(rcvd->total_num);
-        if (rcvd->p_data == NULL)
-        {
-          status = PROTOCOL_ERR_NOT_ENOUGH_MEM;
-          PROTOCOL_ERR_INFO_PRINTF(status, __FILE__, __LINE__);
-          return status;
-        }
-        memset(rcvd->p_data, 0, rcvd->rcvd_num);
       }
       else if (status == PROTOCOL_ERR_AUTH_FAILURE)
       {
 
-        fifo_s_get(&rcvd->fifo);
+        fifo_s_discard(&rcvd->fifo, 1);
+        PROTOCOL_STATS_ADD(obj, crc16_err, 1);
+        PROTOCOL_TRACE(PROTOCOL_TRACE_RCV_ERR, obj->idx, 0);
         /* this is a pseudo header, remove this from fifo */
         rcvd->state = UNPACK_PACK_STAGE_FIND_SOF;
 
@@ -770,15 +1341,7 @@ uint32_t protocol_s_extract(struct perph_interface *obj)
 
     case UNPACK_PACK_STAGE_RECV_DATA:
 
-      if (rcvd->p_data)
-      {
-        status = protocol_s_fetch_pack_data(rcvd);
-      }
-      else
-      {
-        status = PROTOCOL_ERR_NOT_ENOUGH_MEM;
-        PROTOCOL_ERR_INFO_PRINTF(status, __FILE__, __LINE__);
-      }
+      status = protocol_s_fetch_pack_data(rcvd);
 
       if (status == PROTOCOL_SUCCESS)
       {
@@ -795,10 +1358,10 @@ uint32_t protocol_s_extract(struct perph_interface *obj)
       }
       else
       {
-        rcvd->rcvd_num = 0;
-        rcvd->total_num = 0;
-        protocol_p_free(rcvd->p_data);
+        protocol_s_release_pack_data(rcvd);
         rcvd->state = UNPACK_PACK_STAGE_FIND_SOF;
+        PROTOCOL_STATS_ADD(obj, crc32_err, 1);
+        PROTOCOL_TRACE(PROTOCOL_TRACE_RCV_ERR, obj->idx, 1);
 
         PROTOCOL_RCV_ERR_PRINTF("Pack data auth failure.");
       }
@@ -806,9 +1369,10 @@ uint32_t protocol_s_extract(struct perph_interface *obj)
 
     case UNPACK_PACK_STAGE_DATA_HANDLE:
 
+      PROTOCOL_STATS_ADD(obj, rx_frames, 1);
       status = protocol_s_unpack_data_handle(obj);
 
-      protocol_p_free(rcvd->p_data);
+      protocol_s_release_pack_data(rcvd);
       rcvd->state = UNPACK_PACK_STAGE_FIND_SOF;
       break;
 
@@ -827,29 +1391,27 @@ uint32_t protocol_s_extract(struct perph_interface *obj)
   return status;
 }
 
-//找帧头
+//找帧头，按FIFO连续内存段整段查找，帧头之前的无效数据一次移出FIFO
 uint32_t protocol_s_find_pack_header(rcvd_desc_t *rcvd)
 {
-  uint32_t status;
+  char *span;
+  char *sof;
+  int span_len;
 
-  while (fifo_s_isempty(&rcvd->fifo) == 0)
-  { // if fifo not empty, loop
-    if ((uint8_t)(fifo_s_preread(&rcvd->fifo, 0)) == PROTOCOL_HEADER)
-    {
-      status = PROTOCOL_SUCCESS;
-      goto END;
-    }
-    else
+  while ((span_len = fifo_s_peek_span(&rcvd->fifo, 0, &span)) > 0)
+  {
+    sof = memchr(span, PROTOCOL_HEADER, span_len);
+    if (sof != NULL)
     {
-      fifo_s_get(&rcvd->fifo); //remove one byte from fifo
+      fifo_s_discard(&rcvd->fifo, sof - span);
+      return PROTOCOL_SUCCESS;
     }
-  }
-  //if fifo not empty, loop
 
-  status = PROTOCOL_ERR_NOT_FIND_HEADER;
+    //本段无帧头，整段丢弃后继续查找回绕后的数据
+    fifo_s_discard(&rcvd->fifo, span_len);
+  }
 
-END:
-  return status;
+  return PROTOCOL_ERR_NOT_FIND_HEADER;
 }
 
 //校验包头
@@ -862,7 +1424,7 @@ uint32_t protocol_s_auth_pack_header(rcvd_desc_t *rcvd)
   if (fifo_s_prereads(&rcvd->fifo, (char *)auth_array, 0, 12) == 12)
   {
     ver_len = protocol_s_get_ver_datalen(auth_array);
-    if (ver_len.data_len - PROTOCOL_PACK_HEAD_TAIL_SIZE > PROTOCOL_MAX_DATA_LEN)
+    if (ver_len.data_len - PROTOCOL_PACK_HEAD_TAIL_SIZE > PROTOCOL_MAX_DATA_LEN + PROTOCOL_PACK_CMD_SIZE)
     {
       status = PROTOCOL_ERR_AUTH_FAILURE;
     }
@@ -888,28 +1450,37 @@ uint32_t protocol_s_auth_pack_header(rcvd_desc_t *rcvd)
   return status;
 }
 
-//获取包数据
+//获取包数据，整帧在FIFO中连续时直接引用FIFO内存，跨越回绕时拷贝到回弹缓冲区
 uint32_t protocol_s_fetch_pack_data(rcvd_desc_t *rcvd)
 {
-  uint32_t status;
-  uint32_t length;
-  uint32_t want_len;
+  char *span;
 
-  want_len = rcvd->total_num - rcvd->rcvd_num;
-  length = fifo_s_gets(&rcvd->fifo,
-                       (char *)rcvd->p_data + rcvd->rcvd_num,
-                       want_len);
-  rcvd->rcvd_num += length;
+  if (fifo_s_used(&rcvd->fifo) < rcvd->total_num)
+  {
+    return PROTOCOL_ERR_DATA_NOT_ENOUGH;
+  }
 
-  if (rcvd->rcvd_num < rcvd->total_num)
+  if (fifo_s_peek_span(&rcvd->fifo, 0, &span) >= rcvd->total_num)
   {
-    status = PROTOCOL_ERR_DATA_NOT_ENOUGH;
+    rcvd->p_data = (uint8_t *)span;
   }
   else
   {
-    status = PROTOCOL_SUCCESS;
+    fifo_s_prereads(&rcvd->fifo, (char *)protocol_rcv_bounce_buf, 0, rcvd->total_num);
+    rcvd->p_data = (uint8_t *)protocol_rcv_bounce_buf;
   }
-  return status;
+  rcvd->rcvd_num = rcvd->total_num;
+
+  return PROTOCOL_SUCCESS;
+}
+
+//处理完成后将当前帧移出FIFO
+void protocol_s_release_pack_data(rcvd_desc_t *rcvd)
+{
+  fifo_s_discard(&rcvd->fifo, rcvd->total_num);
+  rcvd->p_data = NULL;
+  rcvd->rcvd_num = 0;
+  rcvd->total_num = 0;
 }
 
 //获取版本号和数据长度
@@ -988,6 +1559,21 @@ void protocol_s_error_info_printf(uint32_t status, char *file, int line)
   case PROTOCOL_ERR_REGISTER_FAILED:
     err_info = "PROTOCOL_ERR_REGISTER_FAILED";
     break;
+  case PROTOCOL_ERR_STREAM_TIMEOUT:
+    err_info = "PROTOCOL_ERR_STREAM_TIMEOUT";
+    break;
+  case PROTOCOL_ERR_NO_ACK:
+    err_info = "PROTOCOL_ERR_NO_ACK";
+    break;
+  case PROTOCOL_ERR_WAIT_PENDING:
+    err_info = "PROTOCOL_ERR_WAIT_PENDING";
+    break;
+  case PROTOCOL_ERR_TOKEN_INVALID:
+    err_info = "PROTOCOL_ERR_TOKEN_INVALID";
+    break;
+  case PROTOCOL_ERR_WAIT_FULL:
+    err_info = "PROTOCOL_ERR_WAIT_FULL";
+    break;
   default:
     err_info = "PROTOCOL_ERR_NOT_FOUND";
   }
@@ -30,21 +30,54 @@
 uint8_t protocol_get_session(struct perph_interface * interface);
 int32_t protocol_release_session(struct perph_interface * interface, uint8_t id);
 struct send_cmd_info *protocol_get_send_cmd_info(uint16_t cmd);
+struct rcv_cmd_info *protocol_get_rcv_cmd_info(uint16_t cmd);
 //添加发送节点
 uint32_t protocol_s_add_sendnode(uint8_t reciver, uint8_t session, uint8_t pack_type,
-                                 void *p_data, uint32_t data_len, uint16_t cmd, uint16_t ack_seq);
+                                 const struct protocol_iov *iov, uint8_t iov_num,
+                                 uint16_t cmd, uint16_t ack_seq);
 
 //广播包添加发送节点
-uint32_t protocol_s_broadcast_add_node(void *p_data, uint32_t data_len, uint16_t cmd);
+uint32_t protocol_s_broadcast_add_node(const struct protocol_iov *iov, uint8_t iov_num, uint16_t cmd);
 
-//通过接口发送数据
-uint32_t protocol_s_fill_pack(send_ctx_t *ctx, uint8_t *p_data,
+//计算数据片段总长度
+uint32_t protocol_s_iov_len(const struct protocol_iov *iov, uint8_t iov_num);
+
+//帧填充
+uint32_t protocol_s_fill_pack(send_ctx_t *ctx, const struct protocol_iov *iov, uint8_t iov_num,
                               uint32_t data_len, uint8_t *pack_zone, uint16_t seq, uint16_t cmd);
 
 uint32_t protocol_s_interface_send_data(send_list_node_t *cur_send_node, struct perph_interface *obj);
 
+//合并发送
+uint32_t protocol_s_interface_batch_send(struct perph_interface *obj, uint8_t *p_data, uint16_t len);
+uint32_t protocol_s_interface_batch_flush(struct perph_interface *obj);
+
 //清空正常发送列表
-uint32_t protocol_s_interface_normal_send_flush(struct perph_interface *obj);
+uint32_t protocol_s_interface_normal_send_flush(struct perph_interface *obj, uint8_t priority);
+
+//重发堆，按重发时刻排序等待ACK的帧
+void protocol_s_resend_heap_push(struct perph_interface *obj, send_list_node_t *node);
+void protocol_s_resend_heap_remove(struct perph_interface *obj, send_list_node_t *node);
+
+//RTT采样与自适应重发超时
+void protocol_s_rtt_sample(struct perph_interface *obj, uint32_t rtt_ms);
+uint32_t protocol_s_node_timeout(struct perph_interface *obj, send_list_node_t *node);
+
+//处理到期的重发帧
+uint32_t protocol_s_interface_resend_flush(struct perph_interface *obj);
+
+//距最早重发时刻的时间
+uint32_t protocol_s_interface_resend_wait_time(struct perph_interface *obj, uint32_t now);
+
+//收到ACK，释放发送节点
+void protocol_s_session_complete(struct perph_interface *obj, send_list_node_t *node);
+
+//获取命令发送优先级与最新值语义
+uint8_t protocol_s_get_cmd_priority(uint16_t cmd);
+uint8_t protocol_s_get_cmd_coalesce(uint16_t cmd);
+
+//延迟计入log2直方图
+void protocol_s_stats_hist(uint32_t *hist, uint32_t us);
 
 //清空ACK帧发送列表
 uint32_t protocol_s_interface_ack_send_flush(struct perph_interface *obj);
@@ -64,6 +97,11 @@ uint32_t protocol_s_unpack_data_handle(struct perph_interface *obj);
 //获得session的node
 send_list_node_t *protocol_s_session_get_node(struct perph_interface *obj,
                                               uint8_t address, uint8_t session);
+send_list_node_t *protocol_s_session_node_noprotect(struct perph_interface *obj,
+                                                    uint8_t address, uint8_t session);
+
+//解除session与node的索引，返回等待该session结果的令牌
+uint32_t protocol_s_session_detach(struct perph_interface *obj, send_list_node_t *node);
 
 //解包处理
 uint32_t protocol_s_extract(struct perph_interface *obj);
@@ -77,6 +115,9 @@ uint32_t protocol_s_auth_pack_header(rcvd_desc_t *rcvd);
 //获取包数据
 uint32_t protocol_s_fetch_pack_data(rcvd_desc_t *rcvd);
 
+//释放当前帧
+void protocol_s_release_pack_data(rcvd_desc_t *rcvd);
+
 //获取帧长度和版本
 ver_data_len_t protocol_s_get_ver_datalen(void *pack);
 
@@ -0,0 +1,314 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "protocol.h"
+#include "protocol_wait.h"
+#include "protocol_transmit.h"
+#include "protocol_log.h"
+
+#if (PROTOCOL_WAIT_ENABLE == PROTOCOL_ENABLE)
+
+/*
+ * 可靠发送令牌
+ *
+ * protocol_send_reliable为每帧分配一个等待槽并返回令牌，帧的session与令牌绑定，收到Ack
+ * 或重发次数用尽时在解包/发送任务中记录结果，并用任务通知(PROTOCOL_WAIT_SIGNAL)唤醒等待
+ * 的任务。应用任务可以连续发出多帧后再逐个等待，等待期间阻塞而不是轮询标志。
+ * 令牌的低8位为槽号加1，高位为槽的分配计数，槽被重新分配后旧令牌失效。
+ * 每个令牌必须通过protocol_wait、protocol_poll取回结果或调用protocol_wait_release释放。
+ */
+
+/* Private define ------------------------------------------------------------*/
+#define WAIT_TOKEN(idx, gen) (((gen) << 8) | ((idx) + 1))
+#define WAIT_TOKEN_IDX(token) (((token) & 0xFFu) - 1)
+
+/* Private typedef -----------------------------------------------------------*/
+struct wait_slot
+{
+  uint8_t used;
+  uint8_t done;     /*!< Ack Received Or Resend Given Up */
+  uint32_t token;
+  uint32_t status;  /*!< PROTOCOL_SUCCESS Or PROTOCOL_ERR_NO_ACK */
+  void *thread;     /*!< Task Blocked In protocol_wait, NULL For None */
+};
+
+/* Private variables ---------------------------------------------------------*/
+static struct wait_slot wait_slot[PROTOCOL_WAIT_MAX];
+static uint32_t wait_gen;
+static MUTEX_DECLARE(wait_mutex);
+
+extern local_info_t protocol_local_info;
+
+/* Private functions ---------------------------------------------------------*/
+
+//按令牌查找等待槽，令牌无效或已失效时返回NULL，调用者需持有wait_mutex
+static struct wait_slot *protocol_wait_slot_get(uint32_t token)
+{
+  uint32_t idx;
+
+  idx = WAIT_TOKEN_IDX(token);
+  if ((token == PROTOCOL_WAIT_TOKEN_NONE) || (idx >= PROTOCOL_WAIT_MAX))
+  {
+    return NULL;
+  }
+
+  if ((wait_slot[idx].used == 0) || (wait_slot[idx].token != token))
+  {
+    return NULL;
+  }
+
+  return &wait_slot[idx];
+}
+
+//分配等待槽，没有空闲槽时返回PROTOCOL_WAIT_TOKEN_NONE
+static uint32_t protocol_wait_alloc(void)
+{
+  uint32_t token = PROTOCOL_WAIT_TOKEN_NONE;
+
+  MUTEX_LOCK(wait_mutex);
+  for (int i = 0; i < PROTOCOL_WAIT_MAX; i++)
+  {
+    if (wait_slot[i].used == 0)
+    {
+      wait_gen = (wait_gen + 1) & 0x00FFFFFFu;
+      token = WAIT_TOKEN(i, wait_gen);
+      wait_slot[i].used = 1;
+      wait_slot[i].done = 0;
+      wait_slot[i].token = token;
+      wait_slot[i].status = PROTOCOL_ERR_WAIT_PENDING;
+      wait_slot[i].thread = NULL;
+      break;
+    }
+  }
+  MUTEX_UNLOCK(wait_mutex);
+
+  return token;
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  可靠发送令牌初始化，在protocol_local_init中调用
+  * @param  void
+  * @retval void
+  */
+void protocol_wait_init(void)
+{
+  MUTEX_INIT(wait_mutex);
+  memset(wait_slot, 0, sizeof(wait_slot));
+}
+
+/**
+  * @brief  可靠发送收到Ack或放弃重发时调用，记录结果并唤醒阻塞在protocol_wait中的任务
+  * @param  token protocol_s_session_detach取出的令牌，PROTOCOL_WAIT_TOKEN_NONE时直接返回
+  *         status PROTOCOL_SUCCESS或PROTOCOL_ERR_NO_ACK
+  * @retval void
+  */
+void protocol_wait_complete(uint32_t token, uint32_t status)
+{
+  struct wait_slot *slot;
+  void *thread = NULL;
+
+  if (token == PROTOCOL_WAIT_TOKEN_NONE)
+  {
+    return;
+  }
+
+  MUTEX_LOCK(wait_mutex);
+  slot = protocol_wait_slot_get(token);
+  if (slot != NULL)
+  {
+    slot->done = 1;
+    slot->status = status;
+    thread = slot->thread;
+  }
+  MUTEX_UNLOCK(wait_mutex);
+
+  if (thread != NULL)
+  {
+    protocol_p_signal(thread);
+  }
+}
+
+/**
+  * @brief  发送要求Ack的正常帧并返回令牌，不论命令是否配置了ack_enable都分配session。
+  *         重发超时与次数使用protocol_send_cmd_config对cmd的配置，完成后令牌的结果由protocol_wait
+  *         或protocol_poll取回。命令配置的ack_callback/no_ack_callback仍会被调用。
+  * @param  reciver 接收设备地址，不支持广播
+  *         cmd 命令值
+  *         p_data 发送数据指针
+  *         data_len 发送数据长度
+  * @retval 令牌，失败时返回PROTOCOL_WAIT_TOKEN_NONE
+  */
+uint32_t protocol_send_reliable(uint8_t reciver, uint16_t cmd, void *p_data, uint32_t data_len)
+{
+  struct perph_interface *int_obj;
+  struct protocol_iov iov;
+  uint32_t status;
+  uint32_t token;
+  uint8_t session;
+
+  if (data_len > PROTOCOL_MAX_DATA_LEN)
+  {
+    PROTOCOL_ERR_INFO_PRINTF(PROTOCOL_ERR_DATA_TOO_LONG, __FILE__, __LINE__);
+    return PROTOCOL_WAIT_TOKEN_NONE;
+  }
+
+  if (reciver == PROTOCOL_BROADCAST_ADDR)
+  {
+    PROTOCOL_ERR_INFO_PRINTF(PROTOCOL_ERR_SESSION_ERROR, __FILE__, __LINE__);
+    return PROTOCOL_WAIT_TOKEN_NONE;
+  }
+
+  int_obj = protocol_s_get_route(reciver);
+  if (int_obj == NULL)
+  {
+    PROTOCOL_ERR_INFO_PRINTF(PROTOCOL_ERR_ROUTE_NOT_FOUND, __FILE__, __LINE__);
+    return PROTOCOL_WAIT_TOKEN_NONE;
+  }
+
+  token = protocol_wait_alloc();
+  if (token == PROTOCOL_WAIT_TOKEN_NONE)
+  {
+    PROTOCOL_ERR_INFO_PRINTF(PROTOCOL_ERR_WAIT_FULL, __FILE__, __LINE__);
+    return PROTOCOL_WAIT_TOKEN_NONE;
+  }
+
+  //节点加入发送列表前绑定令牌，Ack不会早于绑定到达
+  MUTEX_LOCK(int_obj->send.mutex_lock);
+  session = protocol_get_session(int_obj);
+  if (session != 0)
+  {
+    int_obj->send.session_wait[session - 1] = token;
+  }
+  MUTEX_UNLOCK(int_obj->send.mutex_lock);
+
+  if (session == 0)
+  {
+    protocol_wait_release(token);
+    PROTOCOL_ERR_INFO_PRINTF(PROTOCOL_ERR_SESSION_FULL, __FILE__, __LINE__);
+    return PROTOCOL_WAIT_TOKEN_NONE;
+  }
+
+  iov.base = p_data;
+  iov.len = data_len;
+
+  status = protocol_s_add_sendnode(reciver, session, PROTOCOL_PACK_NOR, &iov,
+                                   1, cmd, 0);
+  if (status != PROTOCOL_SUCCESS)
+  {
+    MUTEX_LOCK(int_obj->send.mutex_lock);
+    int_obj->send.session_wait[session - 1] = PROTOCOL_WAIT_TOKEN_NONE;
+    protocol_release_session(int_obj, session);
+    MUTEX_UNLOCK(int_obj->send.mutex_lock);
+    protocol_wait_release(token);
+    return PROTOCOL_WAIT_TOKEN_NONE;
+  }
+
+  if (protocol_local_info.send_list_add_callBack != NULL)
+  {
+    protocol_local_info.send_list_add_callBack();
+  }
+
+  return token;
+}
+
+/**
+  * @brief  等待可靠发送完成，阻塞期间由任务通知唤醒。完成后令牌被释放，不可以再次使用。
+  *         同一令牌同时只能由一个任务等待，该任务的PROTOCOL_WAIT_SIGNAL信号位不可以另作他用。
+  * @param  token protocol_send_reliable返回的令牌
+  *         timeout 最长等待时间(ms)，0时不阻塞，PROTOCOL_WAIT_FOREVER时一直等待
+  * @retval PROTOCOL_SUCCESS 已收到Ack
+  *         PROTOCOL_ERR_NO_ACK 重发次数用尽仍未收到Ack
+  *         PROTOCOL_ERR_WAIT_PENDING 超时仍未完成，令牌仍然有效
+  *         PROTOCOL_ERR_TOKEN_INVALID 令牌无效或结果已被取回
+  */
+uint32_t protocol_wait(uint32_t token, uint32_t timeout)
+{
+  struct wait_slot *slot;
+  uint32_t status;
+  uint32_t start;
+  uint32_t elapsed;
+
+  start = protocol_p_get_time();
+
+  while (1)
+  {
+    elapsed = protocol_p_get_time() - start;
+
+    MUTEX_LOCK(wait_mutex);
+    slot = protocol_wait_slot_get(token);
+    if (slot == NULL)
+    {
+      MUTEX_UNLOCK(wait_mutex);
+      return PROTOCOL_ERR_TOKEN_INVALID;
+    }
+
+    if (slot->done)
+    {
+      status = slot->status;
+      slot->used = 0;
+      MUTEX_UNLOCK(wait_mutex);
+      return status;
+    }
+
+    if ((timeout != PROTOCOL_WAIT_FOREVER) && (elapsed >= timeout))
+    {
+      slot->thread = NULL;
+      MUTEX_UNLOCK(wait_mutex);
+      return PROTOCOL_ERR_WAIT_PENDING;
+    }
+
+    //完成发生在登记之后、阻塞之前时，信号位已置位，等待立即返回
+    slot->thread = protocol_p_get_thread();
+    MUTEX_UNLOCK(wait_mutex);
+
+    //其他令牌遗留的信号会提前唤醒，重新检查后继续等待剩余时间
+    protocol_p_signal_wait((timeout == PROTOCOL_WAIT_FOREVER) ? PROTOCOL_WAIT_FOREVER : (timeout - elapsed));
+  }
+}
+
+/**
+  * @brief  不阻塞地查询可靠发送结果，完成时释放令牌
+  * @param  token protocol_send_reliable返回的令牌
+  * @retval 同protocol_wait，未完成时返回PROTOCOL_ERR_WAIT_PENDING
+  */
+uint32_t protocol_poll(uint32_t token)
+{
+  return protocol_wait(token, 0);
+}
+
+/**
+  * @brief  放弃令牌，不再取回结果。未完成的帧仍会发送和重发，结果被丢弃
+  * @param  token protocol_send_reliable返回的令牌
+  * @retval void
+  */
+void protocol_wait_release(uint32_t token)
+{
+  struct wait_slot *slot;
+
+  MUTEX_LOCK(wait_mutex);
+  slot = protocol_wait_slot_get(token);
+  if (slot != NULL)
+  {
+    slot->used = 0;
+  }
+  MUTEX_UNLOCK(wait_mutex);
+}
+
+#endif /* PROTOCOL_WAIT_ENABLE */
@@ -72,15 +72,15 @@ int32_t motor_canstd_send(enum device_can can, struct can_msg msg)
   /* by rzf test motor can   */
 	//if (can == DEVICE_CAN1)
 	if (1)
-    can_msg_bytes_send(&hcan1, msg.data, 8, msg.id);
+    can_msg_rt_send(&hcan1, msg.data, 8, msg.id);
   else if (can == DEVICE_CAN2)
-    can_msg_bytes_send(&hcan2, msg.data, 8, msg.id);
+    can_msg_rt_send(&hcan2, msg.data, 8, msg.id);
   return 0;
 }
 
 int32_t gyro_can_std_send(uint32_t std_id, uint8_t *can_rx_data)
 {
-  can_msg_bytes_send(&hcan1, can_rx_data, 8, std_id);
+  can_msg_rt_send(&hcan1, can_rx_data, 8, std_id);
   return RM_OK;
 }
 
@@ -138,12 +138,40 @@ float get_time_ms_us(void)
   return get_time_ms() + get_time_us() / 1000.0f;
 }
 
+/* ms and us of the TIM5 timebase as one us count, wraps about every 71 minutes */
+uint32_t get_time_stamp_us(void)
+{
+  uint32_t ms;
+  uint32_t us;
+
+  /* TIM5 wraps every ms, read again when the tick moves during the read */
+  do
+  {
+    ms = get_time_ms();
+    us = get_time_us();
+    /* with interrupts off TIM5 may have wrapped before the tick is counted */
+    if (TIM5->SR & TIM_SR_UIF)
+    {
+      us = get_time_us() + 1000;
+    }
+  } while (ms != get_time_ms());
+
+  return ms * 1000 + us;
+}
+
 int32_t motor_can1_output_1ms(void *argc)
 {
   motor_device_can_output(DEVICE_CAN1);
   return 0;
 }
 
+int32_t can_health_check_1ms(void *argc)
+{
+  can_health_process(&can1_manage);
+  can_health_process(&can2_manage);
+  return 0;
+}
+
 void board_config(void)
 {
 	/* by rzf  这些初始化都是跟端口 还有定时器 计数器 中断 串口 can硬件配置的函数    */
@@ -165,6 +193,8 @@ void board_config(void)
 	
 	/* by rzf  电机的定时器 1ms（不一定 软件定时器） 定时触发一次  */
   soft_timer_register(motor_can1_output_1ms, NULL, 1);
+  /* can error state, bus load and timed bus off recovery */
+  soft_timer_register(can_health_check_1ms, NULL, 1);
 	/* by rzf  蜂鸣器 定时器触发  */
   soft_timer_register(beep_ctrl_times, NULL, 1);
 	/* by rzf  led 闪烁的定时器 300ms 在调用 led_r_of的时候就应该调用了这个延时 */   
@@ -174,6 +204,6 @@ void board_config(void)
 	/* by rzf  单陀螺仪 can 发送 寄存器（函数）  */
   single_gyro_can_send_register(gyro_can_std_send);
 
-  can_fifo0_rx_callback_register(&can1_manage, can1_motor_msg_rec);
-  can_fifo0_rx_callback_register(&can2_manage, can2_single_gyro_rec);
+  can_fifo0_rx_callback_register_id(&can1_manage, can1_motor_msg_rec, 0x201, 0x208);
+  can_fifo0_rx_callback_register_id(&can2_manage, can2_single_gyro_rec, 0x401, 0x401);
 }
@@ -19,16 +19,512 @@
 #include "drv_can.h"
 #include "stm32f4xx_hal_uart.h"
 #include "usart.h"
+#include "sys.h"
 struct can_manage_obj can1_manage;
 struct can_manage_obj can2_manage;
 
 static uint8_t can1_tx_fifo_buff[CAN1_TX_FIFO_SIZE];
 static uint8_t can2_tx_fifo_buff[CAN2_TX_FIFO_SIZE];
 
+static can_manage_obj_t can_get_manage(CAN_HandleTypeDef *hcan)
+{
+  if (hcan == &hcan1)
+  {
+    return &can1_manage;
+  }
+  else if (hcan == &hcan2)
+  {
+    return &can2_manage;
+  }
+  return NULL;
+}
+
+static void can_tx_stats_update(struct can_tx_stats *stats, uint32_t time_us)
+{
+  uint32_t now = get_time_stamp_us();
+  uint32_t latency = 0;
+
+  /* a stamp taken by an ISR that preempted this read is ahead of now */
+  if ((int32_t)(now - time_us) > 0)
+  {
+    latency = now - time_us;
+  }
+
+  stats->sent++;
+  stats->latency_sum_us += latency;
+  if (latency > stats->latency_max_us)
+  {
+    stats->latency_max_us = latency;
+  }
+}
+
+/* bits of a std data frame on the bus, with worst case bit stuffing */
+static uint32_t can_frame_bits(uint32_t dlc)
+{
+  return 47 + 8 * dlc + (34 + 8 * dlc - 1) / 4;
+}
+
+static void can_load_add(can_manage_obj_t m_obj, uint32_t dlc)
+{
+  FIFO_CPU_SR_TYPE cpu_sr;
+  cpu_sr = FIFO_GET_CPU_SR();
+  FIFO_ENTER_CRITICAL();
+  m_obj->load_bits += can_frame_bits(dlc);
+  FIFO_RESTORE_CPU_SR(cpu_sr);
+}
+
+/* refresh tec, rec and the error state from ESR, count every entry into a worse state.
+   call with interrupts disabled. */
+static void can_health_update(can_manage_obj_t m_obj, uint32_t now)
+{
+  struct can_health *health = &(m_obj->health);
+  uint32_t esr;
+  uint8_t state;
+
+  esr = m_obj->hcan->Instance->ESR;
+  health->tec = (esr & CAN_ESR_TEC) >> CAN_ESR_TEC_Pos;
+  health->rec = (esr & CAN_ESR_REC) >> CAN_ESR_REC_Pos;
+  if (health->tec > health->tec_max)
+  {
+    health->tec_max = health->tec;
+  }
+  if (health->rec > health->rec_max)
+  {
+    health->rec_max = health->rec;
+  }
+
+  if (esr & CAN_ESR_BOFF)
+  {
+    state = CAN_BUS_OFF;
+  }
+  else if (esr & CAN_ESR_EPVF)
+  {
+    state = CAN_BUS_PASSIVE;
+  }
+  else if (esr & CAN_ESR_EWGF)
+  {
+    state = CAN_BUS_WARNING;
+  }
+  else
+  {
+    state = CAN_BUS_ACTIVE;
+  }
+
+  if ((state >= CAN_BUS_WARNING) && (health->state < CAN_BUS_WARNING))
+  {
+    health->warning_cnt++;
+  }
+  if ((state >= CAN_BUS_PASSIVE) && (health->state < CAN_BUS_PASSIVE))
+  {
+    health->passive_cnt++;
+  }
+  if ((state == CAN_BUS_OFF) && (health->state != CAN_BUS_OFF))
+  {
+    health->busoff_cnt++;
+    m_obj->busoff_time_ms = now;
+  }
+  health->state = state;
+}
+
+/* leave bus off: enter and leave init mode, the controller rejoins after 128 x 11 recessive bits.
+   automatic bus off management is disabled so a faulty node does not rejoin every 1.4 ms. */
+static void can_bus_restart(can_manage_obj_t m_obj)
+{
+  CAN_TypeDef *can = m_obj->hcan->Instance;
+
+  SET_BIT(can->MCR, CAN_MCR_INRQ);
+  for (int i = 0; (i < 1000) && ((can->MSR & CAN_MSR_INAK) == 0); i++)
+  {
+  }
+  CLEAR_BIT(can->MCR, CAN_MCR_INRQ);
+}
+
+static void can_tx_add_mailbox(can_manage_obj_t m_obj, uint32_t std_id, uint8_t *data, uint8_t dlc)
+{
+  CAN_TxHeaderTypeDef header;
+  uint32_t send_mail_box;
+
+  header.StdId = std_id;
+  header.DLC = dlc;
+  header.IDE = CAN_ID_STD;
+  header.RTR = CAN_RTR_DATA;
+
+  HAL_CAN_AddTxMessage(m_obj->hcan, &header, data, &send_mail_box);
+}
+
+/* fill the free mailboxes, realtime frames by ascending std id first, then bulk
+   frames in order while more than CAN_TX_RT_MAILBOX_NUM mailboxes are free.
+   call with interrupts disabled. */
+static void can_tx_schedule(can_manage_obj_t m_obj)
+{
+  struct can_std_msg msg;
+  struct can_rt_slot *slot;
+  uint32_t free_num;
+
+  free_num = HAL_CAN_GetTxMailboxesFreeLevel(m_obj->hcan);
+
+  while (free_num > 0)
+  {
+    slot = NULL;
+    for (int i = 0; i < CAN_TX_RT_SLOT_NUM; i++)
+    {
+      if ((m_obj->rt_slot[i].valid) && ((slot == NULL) || (m_obj->rt_slot[i].std_id < slot->std_id)))
+      {
+        slot = &(m_obj->rt_slot[i]);
+      }
+    }
+
+    if (slot == NULL)
+    {
+      break;
+    }
+
+    can_tx_add_mailbox(m_obj, slot->std_id, slot->data, slot->dlc);
+    can_tx_stats_update(&(m_obj->tx_stats[CAN_TX_CLASS_RT]), slot->time_us);
+    slot->valid = 0;
+    free_num--;
+  }
+
+  while ((free_num > CAN_TX_RT_MAILBOX_NUM) && (!(fifo_is_empty(&(m_obj->tx_fifo)))))
+  {
+    fifo_get_noprotect(&(m_obj->tx_fifo), &msg);
+    can_tx_add_mailbox(m_obj, msg.std_id, msg.data, msg.dlc);
+    can_tx_stats_update(&(m_obj->tx_stats[CAN_TX_CLASS_BULK]), msg.time_us);
+    free_num--;
+  }
+}
+
+static uint32_t can_rx_hash(uint16_t std_id)
+{
+  return (std_id ^ (std_id >> 5)) & (CAN_RX_HASH_SIZE - 1);
+}
+
+/* callbacks of a std id outside the direct table, an entry with no callback ends the probe chain */
+static uint8_t can_rx_hash_find(can_manage_obj_t m_obj, uint16_t std_id)
+{
+  struct can_rx_hash_entry *entry;
+
+  for (uint32_t i = can_rx_hash(std_id);; i = (i + 1) & (CAN_RX_HASH_SIZE - 1))
+  {
+    entry = &(m_obj->rx_hash[i]);
+    if (entry->callback_mask == 0)
+    {
+      return 0;
+    }
+    if (entry->std_id == std_id)
+    {
+      return entry->callback_mask;
+    }
+  }
+}
+
+static int32_t can_rx_hash_add(can_manage_obj_t m_obj, uint16_t std_id, uint8_t callback_mask)
+{
+  struct can_rx_hash_entry *entry;
+
+  for (uint32_t i = can_rx_hash(std_id);; i = (i + 1) & (CAN_RX_HASH_SIZE - 1))
+  {
+    entry = &(m_obj->rx_hash[i]);
+    if (entry->callback_mask == 0)
+    {
+      if (m_obj->rx_hash_num >= CAN_RX_HASH_LOAD)
+      {
+        return -1;
+      }
+      m_obj->rx_hash_num++;
+      entry->std_id = std_id;
+      entry->callback_mask = callback_mask;
+      return 0;
+    }
+    if (entry->std_id == std_id)
+    {
+      entry->callback_mask |= callback_mask;
+      return 0;
+    }
+  }
+}
+
+/* route std ids first_id..last_id to the callback bits in callback_mask */
+static void can_rx_route_add(can_manage_obj_t m_obj, uint16_t first_id, uint16_t last_id, uint8_t callback_mask)
+{
+  uint32_t hash_ids = 0;
+
+  for (uint32_t id = first_id; id <= last_id; id++)
+  {
+    if ((id >= CAN_RX_DIRECT_BASE) && (id < CAN_RX_DIRECT_BASE + CAN_RX_DIRECT_NUM))
+    {
+      m_obj->rx_direct[id - CAN_RX_DIRECT_BASE] |= callback_mask;
+    }
+    else
+    {
+      hash_ids++;
+    }
+  }
+
+  if (hash_ids == 0)
+  {
+    return;
+  }
+
+  /* wide ranges outside the direct table see every frame and check the id themselves */
+  if (m_obj->rx_hash_num + hash_ids > CAN_RX_HASH_LOAD)
+  {
+    m_obj->rx_any_mask |= callback_mask;
+    return;
+  }
+
+  for (uint32_t id = first_id; id <= last_id; id++)
+  {
+    if ((id < CAN_RX_DIRECT_BASE) || (id >= CAN_RX_DIRECT_BASE + CAN_RX_DIRECT_NUM))
+    {
+      can_rx_hash_add(m_obj, id, callback_mask);
+    }
+  }
+}
+
+/* one filter slot: 'size' ids from 'id', size is a power of two and id is aligned to it */
+struct can_filter_block
+{
+  uint16_t id;
+  uint16_t size;
+};
+
+#define CAN_FILTER_LIST_MAX (CAN_FILTER_BANK_NUM * 4)
+#define CAN_FILTER_MASK_MAX (CAN_FILTER_BANK_NUM * 2)
+
+/* 16 bit filter format: stdid[10:0] rtr ide exid[17:15], only std data frames match */
+#define CAN_FILTER_ID16(id) ((uint32_t)(id) << 5)
+#define CAN_FILTER_MASK16(size) (((~((uint32_t)(size) - 1) & CAN_STD_ID_MAX) << 5) | 0x18)
+
+static void can_filter_bank_config(can_manage_obj_t m_obj, uint8_t bank, uint32_t mode, uint32_t *val)
+{
+  CAN_FilterTypeDef can_filter_st;
+
+  can_filter_st.FilterActivation = ENABLE;
+  can_filter_st.FilterMode = mode;
+  can_filter_st.FilterScale = CAN_FILTERSCALE_16BIT;
+  can_filter_st.FilterIdLow = val[0];
+  can_filter_st.FilterMaskIdLow = val[1];
+  can_filter_st.FilterIdHigh = val[2];
+  can_filter_st.FilterMaskIdHigh = val[3];
+  can_filter_st.FilterBank = m_obj->filter_bank_start + bank;
+  can_filter_st.FilterFIFOAssignment = CAN_RX_FIFO0;
+  can_filter_st.SlaveStartFilterBank = CAN_FILTER_BANK_NUM;
+  HAL_CAN_ConfigFilter(m_obj->hcan, &can_filter_st);
+}
+
+static void can_filter_bank_disable(can_manage_obj_t m_obj, uint8_t bank)
+{
+  CAN_FilterTypeDef can_filter_st = {0};
+
+  can_filter_st.FilterActivation = DISABLE;
+  can_filter_st.FilterBank = m_obj->filter_bank_start + bank;
+  can_filter_st.SlaveStartFilterBank = CAN_FILTER_BANK_NUM;
+  HAL_CAN_ConfigFilter(m_obj->hcan, &can_filter_st);
+}
+
+/* banks needed for mask_num mask slots and list_num list slots, a spare mask slot takes one id */
+static uint32_t can_filter_bank_count(uint32_t mask_num, uint32_t list_num)
+{
+  if ((mask_num & 1) && (list_num > 0))
+  {
+    list_num--;
+  }
+  return (mask_num + 1) / 2 + (list_num + 3) / 4;
+}
+
+/* compile the accepted id ranges into the fewest 16 bit list/mask banks, -1 when they do not fit */
+static int32_t can_filter_compile(can_manage_obj_t m_obj, uint32_t bank_val[][4], uint32_t *bank_mode)
+{
+  struct can_id_range range[CAN_RX_ID_RANGE_MAX];
+  struct can_filter_block block;
+  struct can_filter_block mask[CAN_FILTER_MASK_MAX];
+  uint16_t list[CAN_FILTER_LIST_MAX];
+  uint32_t mask_num = 0, list_num = 0, range_num = 0;
+  uint32_t expand, expand_ids, best, best_banks, banks;
+  uint32_t bank_num, slot, i, j;
+  uint32_t first, last;
+
+  /* sort and merge overlapping or adjacent ranges */
+  for (i = 0; i < m_obj->rx_range_num; i++)
+  {
+    for (j = range_num; (j > 0) && (range[j - 1].first > m_obj->rx_range[i].first); j--)
+    {
+      range[j] = range[j - 1];
+    }
+    range[j] = m_obj->rx_range[i];
+    range_num++;
+  }
+  for (i = 1, j = 0; i < range_num; i++)
+  {
+    if (range[i].first <= range[j].last + 1)
+    {
+      if (range[i].last > range[j].last)
+      {
+        range[j].last = range[i].last;
+      }
+    }
+    else
+    {
+      range[++j] = range[i];
+    }
+  }
+  range_num = (range_num > 0) ? (j + 1) : 0;
+
+  /* split every range into aligned power of two blocks */
+  for (i = 0; i < range_num; i++)
+  {
+    first = range[i].first;
+    last = range[i].last;
+    while (first <= last)
+    {
+      block.id = first;
+      block.size = 1;
+      while (((first & (block.size * 2 - 1)) == 0) && (first + block.size * 2 - 1 <= last))
+      {
+        block.size *= 2;
+      }
+      first += block.size;
+
+      if (block.size == 1)
+      {
+        if (list_num == CAN_FILTER_LIST_MAX)
+        {
+          return -1;
+        }
+        list[list_num++] = block.id;
+      }
+      else
+      {
+        if (mask_num == CAN_FILTER_MASK_MAX)
+        {
+          return -1;
+        }
+        /* keep masks sorted by size so the smallest are expanded into list slots first */
+        for (j = mask_num; (j > 0) && (mask[j - 1].size > block.size); j--)
+        {
+          mask[j] = mask[j - 1];
+        }
+        mask[j] = block;
+        mask_num++;
+      }
+    }
+  }
+
+  /* a mask of two or four ids may be cheaper as list entries */
+  best = 0;
+  best_banks = can_filter_bank_count(mask_num, list_num);
+  for (expand = 1, expand_ids = 0; expand <= mask_num; expand++)
+  {
+    expand_ids += mask[expand - 1].size;
+    if (list_num + expand_ids > CAN_FILTER_LIST_MAX)
+    {
+      break;
+    }
+    banks = can_filter_bank_count(mask_num - expand, list_num + expand_ids);
+    if (banks < best_banks)
+    {
+      best = expand;
+      best_banks = banks;
+    }
+  }
+  if (best_banks > CAN_FILTER_BANK_NUM)
+  {
+    return -1;
+  }
+  for (i = 0; i < best; i++)
+  {
+    for (j = 0; j < mask[i].size; j++)
+    {
+      list[list_num++] = mask[i].id + j;
+    }
+  }
+
+  /* mask banks hold two id/mask pairs, list banks four ids, spare slots repeat an entry */
+  bank_num = 0;
+  for (i = best; i < mask_num; i += 2)
+  {
+    bank_mode[bank_num] = CAN_FILTERMODE_IDMASK;
+    bank_val[bank_num][0] = CAN_FILTER_ID16(mask[i].id);
+    bank_val[bank_num][1] = CAN_FILTER_MASK16(mask[i].size);
+    if (i + 1 < mask_num)
+    {
+      bank_val[bank_num][2] = CAN_FILTER_ID16(mask[i + 1].id);
+      bank_val[bank_num][3] = CAN_FILTER_MASK16(mask[i + 1].size);
+    }
+    else if (list_num > 0)
+    {
+      bank_val[bank_num][2] = CAN_FILTER_ID16(list[--list_num]);
+      bank_val[bank_num][3] = CAN_FILTER_MASK16(1);
+    }
+    else
+    {
+      bank_val[bank_num][2] = bank_val[bank_num][0];
+      bank_val[bank_num][3] = bank_val[bank_num][1];
+    }
+    bank_num++;
+  }
+  for (i = 0; i < list_num; i += 4)
+  {
+    bank_mode[bank_num] = CAN_FILTERMODE_IDLIST;
+    for (slot = 0; slot < 4; slot++)
+    {
+      bank_val[bank_num][slot] = CAN_FILTER_ID16(list[(i + slot < list_num) ? (i + slot) : i]);
+    }
+    bank_num++;
+  }
+
+  return bank_num;
+}
+
+/* reprogram the filter banks of a bus from its accepted id ranges, accept all when they do not fit */
+static void can_filter_update(can_manage_obj_t m_obj)
+{
+  uint32_t bank_val[CAN_FILTER_BANK_NUM][4];
+  uint32_t bank_mode[CAN_FILTER_BANK_NUM];
+  uint32_t accept_all[4] = {0, 0, 0, 0};
+  int32_t bank_num;
+
+  bank_num = can_filter_compile(m_obj, bank_val, bank_mode);
+  if (bank_num < 0)
+  {
+    bank_num = 1;
+    bank_mode[0] = CAN_FILTERMODE_IDMASK;
+    memcpy(bank_val[0], accept_all, sizeof(accept_all));
+  }
+
+  for (int i = 0; i < bank_num; i++)
+  {
+    can_filter_bank_config(m_obj, i, bank_mode[i], bank_val[i]);
+  }
+  for (int i = bank_num; i < m_obj->filter_bank_used; i++)
+  {
+    can_filter_bank_disable(m_obj, i);
+  }
+  m_obj->filter_bank_used = bank_num;
+}
+
 void can_manage_init(void)
 {
-  can1_manage.is_sending = 0;
+  /* cycle counter for the rx isr statistics */
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
   can1_manage.hcan = &hcan1;
+  can1_manage.filter_bank_start = 0;
+  can1_manage.filter_bank_used = 0;
+  can1_manage.rx_range_num = 0;
+  memset(can1_manage.rt_slot, 0, sizeof(can1_manage.rt_slot));
+  memset(can1_manage.tx_stats, 0, sizeof(can1_manage.tx_stats));
+  memset(can1_manage.rx_direct, 0, sizeof(can1_manage.rx_direct));
+  memset(can1_manage.rx_hash, 0, sizeof(can1_manage.rx_hash));
+  memset(&(can1_manage.rx_stats), 0, sizeof(can1_manage.rx_stats));
+  can1_manage.rx_hash_num = 0;
+  can1_manage.rx_any_mask = 0;
+  memset(&(can1_manage.health), 0, sizeof(can1_manage.health));
+  can1_manage.busoff_time_ms = 0;
+  can1_manage.load_bits = 0;
+  can1_manage.load_window_ms = get_time_ms();
 
   for (int i = 0; i < MAX_CAN_REGISTER_NUM; i++)
   {
@@ -41,19 +537,14 @@ void can_manage_init(void)
             sizeof(struct can_std_msg),
             CAN1_TX_FIFO_UNIT_NUM);
 
-  CAN_FilterTypeDef can_filter_st;
-  can_filter_st.FilterActivation = ENABLE;
-  can_filter_st.FilterMode = CAN_FILTERMODE_IDMASK;
-  can_filter_st.FilterScale = CAN_FILTERSCALE_32BIT;
-  can_filter_st.FilterIdHigh = 0x0000;
-  can_filter_st.FilterIdLow = 0x0000;
-  can_filter_st.FilterMaskIdHigh = 0x0000;
-  can_filter_st.FilterMaskIdLow = 0x0000;
-  can_filter_st.FilterBank = 0;
-  can_filter_st.FilterFIFOAssignment = CAN_RX_FIFO0;
-  HAL_CAN_ConfigFilter(&hcan1, &can_filter_st);
+  /* no filter bank is active until a receiver registers its ids */
+  /* still in init mode, bus off recovery is timed by can_health_process */
+  hcan1.Init.AutoBusOff = DISABLE;
+  CLEAR_BIT(hcan1.Instance->MCR, CAN_MCR_ABOM);
+
   HAL_CAN_Start(&hcan1);
   HAL_CAN_ActivateNotification(&hcan1, CAN_IT_RX_FIFO0_MSG_PENDING);
+  HAL_CAN_ActivateNotification(&hcan1, CAN_IT_RX_FIFO0_OVERRUN);
   HAL_CAN_ActivateNotification(&hcan1, CAN_IT_TX_MAILBOX_EMPTY);
 
   HAL_CAN_ActivateNotification(&hcan1, CAN_IT_ERROR);
@@ -62,19 +553,34 @@ void can_manage_init(void)
   HAL_CAN_ActivateNotification(&hcan1, CAN_IT_ERROR_PASSIVE);
   HAL_CAN_ActivateNotification(&hcan1, CAN_IT_LAST_ERROR_CODE);
 
-  can2_manage.is_sending = 0;
   can2_manage.hcan = &hcan2;
+  can2_manage.filter_bank_start = CAN_FILTER_BANK_NUM;
+  can2_manage.filter_bank_used = 0;
+  can2_manage.rx_range_num = 0;
+  memset(can2_manage.rt_slot, 0, sizeof(can2_manage.rt_slot));
+  memset(can2_manage.tx_stats, 0, sizeof(can2_manage.tx_stats));
+  memset(can2_manage.rx_direct, 0, sizeof(can2_manage.rx_direct));
+  memset(can2_manage.rx_hash, 0, sizeof(can2_manage.rx_hash));
+  memset(&(can2_manage.rx_stats), 0, sizeof(can2_manage.rx_stats));
+  can2_manage.rx_hash_num = 0;
+  can2_manage.rx_any_mask = 0;
+  memset(&(can2_manage.health), 0, sizeof(can2_manage.health));
+  can2_manage.busoff_time_ms = 0;
+  can2_manage.load_bits = 0;
+  can2_manage.load_window_ms = get_time_ms();
 
   fifo_init(&(can2_manage.tx_fifo),
             can2_tx_fifo_buff,
             sizeof(struct can_std_msg),
             CAN2_TX_FIFO_UNIT_NUM);
 
-  can_filter_st.SlaveStartFilterBank = 14;
-  can_filter_st.FilterBank = 14;
-  HAL_CAN_ConfigFilter(&hcan2, &can_filter_st);
+  /* still in init mode, bus off recovery is timed by can_health_process */
+  hcan2.Init.AutoBusOff = DISABLE;
+  CLEAR_BIT(hcan2.Instance->MCR, CAN_MCR_ABOM);
+
   HAL_CAN_Start(&hcan2);
   HAL_CAN_ActivateNotification(&hcan2, CAN_IT_RX_FIFO0_MSG_PENDING);
+  HAL_CAN_ActivateNotification(&hcan2, CAN_IT_RX_FIFO0_OVERRUN);
   HAL_CAN_ActivateNotification(&hcan2, CAN_IT_TX_MAILBOX_EMPTY);
 
   HAL_CAN_ActivateNotification(&hcan2, CAN_IT_ERROR);
@@ -97,27 +603,26 @@ uint32_t can_msg_bytes_send(CAN_HandleTypeDef *hcan,
 
   send_ptr = data;
   msg.std_id = std_id;
+  msg.time_us = get_time_stamp_us();
   send_num = 0;
 
-  if (hcan == &hcan1)
-  {
-    m_obj = &can1_manage;
-  }
-  else if (hcan == &hcan2)
-  {
-    m_obj = &can2_manage;
-  }
-  else
+  m_obj = can_get_manage(hcan);
+  if (m_obj == NULL)
   {
     return 0;
   }
 
+  FIFO_CPU_SR_TYPE cpu_sr;
+  cpu_sr = FIFO_GET_CPU_SR();
+  FIFO_ENTER_CRITICAL();
+
   while (send_num < len)
   {
     if (fifo_is_full(&(m_obj->tx_fifo)))
     {
       //can is error
-      m_obj->is_sending = 0;
+      m_obj->tx_stats[CAN_TX_CLASS_BULK].drop += (len - send_num + 7) / 8;
+      m_obj->health.tx_fifo_full++;
       break;
     }
 
@@ -137,158 +642,400 @@ uint32_t can_msg_bytes_send(CAN_HandleTypeDef *hcan,
     send_ptr += msg.dlc;
     send_num += msg.dlc;
 
-    fifo_put(&(m_obj->tx_fifo), &msg);
+    fifo_put_noprotect(&(m_obj->tx_fifo), &msg);
   }
 
-  if ((m_obj->is_sending) == 0 && (!(fifo_is_empty(&(m_obj->tx_fifo)))))
+  can_tx_schedule(m_obj);
+
+  FIFO_RESTORE_CPU_SR(cpu_sr);
+
+  return send_num;
+}
+
+/* queue a single realtime frame, an unsent frame with the same std id is replaced */
+int32_t can_msg_rt_send(CAN_HandleTypeDef *hcan,
+                        uint8_t *data, uint8_t dlc, uint16_t std_id)
+{
+  can_manage_obj_t m_obj;
+  struct can_rt_slot *slot = NULL;
+
+  m_obj = can_get_manage(hcan);
+  if ((m_obj == NULL) || (dlc > 8))
   {
-    CAN_TxHeaderTypeDef header;
-    uint32_t send_mail_box;
+    return -1;
+  }
 
-    header.StdId = std_id;
-    header.IDE = CAN_ID_STD;
-    header.RTR = CAN_RTR_DATA;
+  FIFO_CPU_SR_TYPE cpu_sr;
+  cpu_sr = FIFO_GET_CPU_SR();
+  FIFO_ENTER_CRITICAL();
 
-    while (HAL_CAN_GetTxMailboxesFreeLevel(m_obj->hcan) && (!(fifo_is_empty(&(m_obj->tx_fifo)))))
+  for (int i = 0; i < CAN_TX_RT_SLOT_NUM; i++)
+  {
+    if ((m_obj->rt_slot[i].valid) && (m_obj->rt_slot[i].std_id == std_id))
     {
-      fifo_get(&(m_obj->tx_fifo), &msg);
-      header.DLC = msg.dlc;
-      HAL_CAN_AddTxMessage(m_obj->hcan, &header, msg.data, &send_mail_box);
-
-      m_obj->is_sending = 1;
+      slot = &(m_obj->rt_slot[i]);
+      m_obj->tx_stats[CAN_TX_CLASS_RT].drop++;
+      break;
+    }
+    if ((slot == NULL) && (m_obj->rt_slot[i].valid == 0))
+    {
+      slot = &(m_obj->rt_slot[i]);
     }
   }
 
-  return send_num;
+  if (slot == NULL)
+  {
+    m_obj->tx_stats[CAN_TX_CLASS_RT].drop++;
+    FIFO_RESTORE_CPU_SR(cpu_sr);
+    return -1;
+  }
+
+  slot->std_id = std_id;
+  slot->dlc = dlc;
+  slot->time_us = get_time_stamp_us();
+  memcpy(slot->data, data, dlc);
+  slot->valid = 1;
+
+  can_tx_schedule(m_obj);
+
+  FIFO_RESTORE_CPU_SR(cpu_sr);
+
+  return 0;
 }
 
-int32_t can_fifo0_rx_callback_register(can_manage_obj_t m_obj, can_stdmsg_rx_callback_t fun)
+int32_t can_tx_stats_get(can_manage_obj_t m_obj, enum can_tx_class tx_class, struct can_tx_stats *stats)
 {
-  for (int i = 0; i < MAX_CAN_REGISTER_NUM; i++)
+  if (tx_class >= CAN_TX_CLASS_NUM)
   {
-    if (m_obj->can_rec_callback[i] == NULL)
-    {
-      m_obj->can_rec_callback[i] = fun;
-      return i;
-    }
+    return -1;
   }
-  return -1;
+
+  FIFO_CPU_SR_TYPE cpu_sr;
+  cpu_sr = FIFO_GET_CPU_SR();
+  FIFO_ENTER_CRITICAL();
+  *stats = m_obj->tx_stats[tx_class];
+  FIFO_RESTORE_CPU_SR(cpu_sr);
+
+  return 0;
 }
-static void can_tx_mailbox_complete_hanle(can_manage_obj_t m_obj)
-{
-  struct can_std_msg msg;
-  CAN_TxHeaderTypeDef header;
-  uint32_t send_mail_box;
 
+void can_tx_stats_reset(can_manage_obj_t m_obj)
+{
   FIFO_CPU_SR_TYPE cpu_sr;
   cpu_sr = FIFO_GET_CPU_SR();
   FIFO_ENTER_CRITICAL();
+  memset(m_obj->tx_stats, 0, sizeof(m_obj->tx_stats));
+  FIFO_RESTORE_CPU_SR(cpu_sr);
+}
 
-  if (!fifo_is_empty(&(m_obj->tx_fifo)))
-  {
-    while (!fifo_is_empty(&(m_obj->tx_fifo)))
-    {
-      if (HAL_CAN_GetTxMailboxesFreeLevel(m_obj->hcan))
-      {
+/* the callback sees every std id */
+int32_t can_fifo0_rx_callback_register(can_manage_obj_t m_obj, can_stdmsg_rx_callback_t fun)
+{
+  return can_fifo0_rx_callback_register_id(m_obj, fun, 0, CAN_STD_ID_MAX);
+}
 
-        fifo_get_noprotect(&(m_obj->tx_fifo), &msg);
+/* the callback wants std ids first_id..last_id, the bus filters drop ids nobody registered.
+   a callback registered several times is called once per frame. */
+int32_t can_fifo0_rx_callback_register_id(can_manage_obj_t m_obj, can_stdmsg_rx_callback_t fun,
+                                          uint16_t first_id, uint16_t last_id)
+{
+  int32_t idx = -1;
 
-        header.StdId = msg.std_id;
-        header.DLC = msg.dlc;
-        header.IDE = CAN_ID_STD;
-        header.RTR = CAN_RTR_DATA;
+  if ((first_id > last_id) || (last_id > CAN_STD_ID_MAX) || (m_obj->rx_range_num >= CAN_RX_ID_RANGE_MAX))
+  {
+    return -1;
+  }
 
-        HAL_CAN_AddTxMessage(m_obj->hcan, &header, msg.data, &send_mail_box);
-      }
-      else
-      {
-        m_obj->is_sending = 0;
-      }
+  for (int i = 0; i < MAX_CAN_REGISTER_NUM; i++)
+  {
+    if (m_obj->can_rec_callback[i] == fun)
+    {
+      idx = i;
+      break;
+    }
+    if ((idx < 0) && (m_obj->can_rec_callback[i] == NULL))
+    {
+      idx = i;
     }
   }
-  else
+  if (idx < 0)
   {
-    m_obj->is_sending = 0;
+    return -1;
   }
+  m_obj->can_rec_callback[idx] = fun;
+
+  m_obj->rx_range[m_obj->rx_range_num].first = first_id;
+  m_obj->rx_range[m_obj->rx_range_num].last = last_id;
+  m_obj->rx_range_num++;
+
+  FIFO_CPU_SR_TYPE cpu_sr;
+  cpu_sr = FIFO_GET_CPU_SR();
+  FIFO_ENTER_CRITICAL();
+  can_rx_route_add(m_obj, first_id, last_id, 1 << idx);
+  FIFO_RESTORE_CPU_SR(cpu_sr);
+
+  can_filter_update(m_obj);
+
+  return idx;
+}
+static void can_tx_mailbox_complete_hanle(can_manage_obj_t m_obj)
+{
+  FIFO_CPU_SR_TYPE cpu_sr;
+  cpu_sr = FIFO_GET_CPU_SR();
+  FIFO_ENTER_CRITICAL();
+
+  can_tx_schedule(m_obj);
 
   FIFO_RESTORE_CPU_SR(cpu_sr);
 
   return;
 }
 
-void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan)
+/* a mailbox finished, count its frame into the bus load and refill the mailboxes */
+static void can_tx_mailbox_sent(CAN_HandleTypeDef *hcan, uint32_t mailbox)
 {
-  if (hcan == &hcan1)
+  can_manage_obj_t m_obj;
+
+  m_obj = can_get_manage(hcan);
+  if (m_obj == NULL)
   {
-    can_tx_mailbox_complete_hanle(&can1_manage);
+    return;
   }
-  else if (hcan == &hcan2)
+
+  can_load_add(m_obj, hcan->Instance->sTxMailBox[mailbox].TDTR & CAN_TDT0R_DLC);
+  can_tx_mailbox_complete_hanle(m_obj);
+}
+
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan)
+{
+  can_tx_mailbox_sent(hcan, 0);
+}
+
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan)
+{
+  can_tx_mailbox_sent(hcan, 1);
+}
+
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan)
+{
+  can_tx_mailbox_sent(hcan, 2);
+}
+
+/* HAL error code bits of each ESR last error code */
+static const uint32_t can_lec_error[CAN_LEC_NUM] =
+{
+  HAL_CAN_ERROR_NONE,
+  HAL_CAN_ERROR_STF,
+  HAL_CAN_ERROR_FOR,
+  HAL_CAN_ERROR_ACK,
+  HAL_CAN_ERROR_BR,
+  HAL_CAN_ERROR_BD,
+  HAL_CAN_ERROR_CRC,
+};
+
+void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan)
+{
+  can_manage_obj_t m_obj;
+  struct can_health *health;
+  uint32_t error;
+
+  m_obj = can_get_manage(hcan);
+  if (m_obj != NULL)
   {
-    can_tx_mailbox_complete_hanle(&can2_manage);
+    health = &(m_obj->health);
+    error = HAL_CAN_GetError(hcan);
+
+    for (int i = 1; i < CAN_LEC_NUM; i++)
+    {
+      if (error & can_lec_error[i])
+      {
+        health->lec_cnt[i]++;
+        health->last_error_code = i;
+      }
+    }
+    if (error & (HAL_CAN_ERROR_TX_ALST0 | HAL_CAN_ERROR_TX_ALST1 | HAL_CAN_ERROR_TX_ALST2))
+    {
+      health->arb_lost++;
+    }
+    if (error & HAL_CAN_ERROR_RX_FOV0)
+    {
+      health->rx_overrun++;
+    }
+    can_health_update(m_obj, get_time_ms());
+
+    /* a mailbox aborted by an error is free again */
+    can_tx_mailbox_complete_hanle(m_obj);
   }
+  HAL_CAN_ResetError(hcan);
 }
 
-void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan)
+/* call every millisecond: refresh the error state, restart a bus that has been off for
+   CAN_BUSOFF_RECOVER_MS and close the load window every CAN_LOAD_WINDOW_MS */
+void can_health_process(can_manage_obj_t m_obj)
 {
-  if (hcan == &hcan1)
+  struct can_health *health = &(m_obj->health);
+  uint32_t now, elapsed, tsr, load;
+
+  now = get_time_ms();
+
+  FIFO_CPU_SR_TYPE cpu_sr;
+  cpu_sr = FIFO_GET_CPU_SR();
+  FIFO_ENTER_CRITICAL();
+
+  can_health_update(m_obj, now);
+
+  /* with automatic retransmission a lost arbitration only shows on a mailbox still pending */
+  tsr = m_obj->hcan->Instance->TSR;
+  if (((tsr & CAN_TSR_TME0) == 0) && (tsr & CAN_TSR_ALST0))
   {
-    can_tx_mailbox_complete_hanle(&can1_manage);
+    health->arb_lost++;
   }
-  else if (hcan == &hcan2)
+  if (((tsr & CAN_TSR_TME1) == 0) && (tsr & CAN_TSR_ALST1))
   {
-    can_tx_mailbox_complete_hanle(&can2_manage);
+    health->arb_lost++;
   }
-}
-void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan)
-{
-  if (hcan == &hcan1)
+  if (((tsr & CAN_TSR_TME2) == 0) && (tsr & CAN_TSR_ALST2))
   {
-    can_tx_mailbox_complete_hanle(&can1_manage);
+    health->arb_lost++;
   }
-  else if (hcan == &hcan2)
+
+  if ((health->state == CAN_BUS_OFF) && ((uint32_t)(now - m_obj->busoff_time_ms) >= CAN_BUSOFF_RECOVER_MS))
   {
-    can_tx_mailbox_complete_hanle(&can2_manage);
+    can_bus_restart(m_obj);
+    m_obj->busoff_time_ms = now;
+    health->recover_cnt++;
   }
+
+  elapsed = now - m_obj->load_window_ms;
+  if (elapsed >= CAN_LOAD_WINDOW_MS)
+  {
+    load = m_obj->load_bits / (elapsed * CAN_BITRATE_KBPS / 1000);
+    if (load > 1000)
+    {
+      load = 1000;
+    }
+    health->load_permille = load;
+    if (load > health->load_max_permille)
+    {
+      health->load_max_permille = load;
+    }
+    m_obj->load_bits = 0;
+    m_obj->load_window_ms = now;
+  }
+
+  FIFO_RESTORE_CPU_SR(cpu_sr);
 }
 
-void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan)
+int32_t can_health_get(can_manage_obj_t m_obj, struct can_health *health)
 {
-  if (hcan == &hcan1)
+  FIFO_CPU_SR_TYPE cpu_sr;
+  cpu_sr = FIFO_GET_CPU_SR();
+  FIFO_ENTER_CRITICAL();
+  *health = m_obj->health;
+  FIFO_RESTORE_CPU_SR(cpu_sr);
+
+  return 0;
+}
+
+/* clear the counters and peaks, tec, rec and the bus state stay */
+void can_health_reset(can_manage_obj_t m_obj)
+{
+  struct can_health *health = &(m_obj->health);
+
+  FIFO_CPU_SR_TYPE cpu_sr;
+  cpu_sr = FIFO_GET_CPU_SR();
+  FIFO_ENTER_CRITICAL();
+  health->tec_max = health->tec;
+  health->rec_max = health->rec;
+  health->last_error_code = 0;
+  health->load_max_permille = health->load_permille;
+  memset(health->lec_cnt, 0, sizeof(health->lec_cnt));
+  health->warning_cnt = 0;
+  health->passive_cnt = 0;
+  health->busoff_cnt = 0;
+  health->recover_cnt = 0;
+  health->arb_lost = 0;
+  health->tx_fifo_full = 0;
+  health->rx_overrun = 0;
+  FIFO_RESTORE_CPU_SR(cpu_sr);
+}
+
+int32_t can_rx_stats_get(can_manage_obj_t m_obj, struct can_rx_stats *stats)
+{
+  FIFO_CPU_SR_TYPE cpu_sr;
+  cpu_sr = FIFO_GET_CPU_SR();
+  FIFO_ENTER_CRITICAL();
+  *stats = m_obj->rx_stats;
+  FIFO_RESTORE_CPU_SR(cpu_sr);
+
+  return 0;
+}
+
+void can_rx_stats_reset(can_manage_obj_t m_obj)
+{
+  FIFO_CPU_SR_TYPE cpu_sr;
+  cpu_sr = FIFO_GET_CPU_SR();
+  FIFO_ENTER_CRITICAL();
+  memset(&(m_obj->rx_stats), 0, sizeof(m_obj->rx_stats));
+  FIFO_RESTORE_CPU_SR(cpu_sr);
+}
+
+/* run only the callbacks registered for the std id of the frame */
+static void can_rx_dispatch(can_manage_obj_t m_obj, CAN_RxHeaderTypeDef *header, uint8_t *data)
+{
+  uint32_t id_offset;
+  uint8_t callback_mask;
+
+  callback_mask = m_obj->rx_any_mask;
+
+  if (header->IDE == CAN_ID_STD)
   {
-    can_tx_mailbox_complete_hanle(&can1_manage);
+    id_offset = header->StdId - CAN_RX_DIRECT_BASE;
+    if (id_offset < CAN_RX_DIRECT_NUM)
+    {
+      callback_mask |= m_obj->rx_direct[id_offset];
+    }
+    else
+    {
+      callback_mask |= can_rx_hash_find(m_obj, header->StdId);
+    }
   }
-  else if (hcan == &hcan2)
+
+  for (int i = 0; callback_mask != 0; i++, callback_mask >>= 1)
   {
-    can_tx_mailbox_complete_hanle(&can2_manage);
+    if (callback_mask & 1)
+    {
+      (*(m_obj->can_rec_callback[i]))(header, data);
+    }
   }
-  HAL_CAN_ResetError(hcan);
 }
 
 void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
 {
   CAN_RxHeaderTypeDef rx_header;
   uint8_t rx_data[8];
+  can_manage_obj_t m_obj;
+  uint32_t start;
+  uint32_t cycles;
+
+  start = DWT->CYCCNT;
 
   HAL_CAN_GetRxMessage(hcan, CAN_RX_FIFO0, &rx_header, rx_data);
 
-  if (hcan == &hcan1)
+  m_obj = can_get_manage(hcan);
+  if (m_obj == NULL)
   {
-    for (int i = 0; i < MAX_CAN_REGISTER_NUM; i++)
-    {
-      if (can1_manage.can_rec_callback[i] != NULL)
-      {
-        (*(can1_manage.can_rec_callback[i]))(&rx_header, rx_data);
-      }
-    }
+    return;
   }
-  else if (hcan == &hcan2)
+
+  can_rx_dispatch(m_obj, &rx_header, rx_data);
+  can_load_add(m_obj, rx_header.DLC);
+
+  cycles = DWT->CYCCNT - start;
+  m_obj->rx_stats.frames++;
+  m_obj->rx_stats.cycles_sum += cycles;
+  if (cycles > m_obj->rx_stats.cycles_max)
   {
-    for (int i = 0; i < MAX_CAN_REGISTER_NUM; i++)
-    {
-      if (can2_manage.can_rec_callback[i] != NULL)
-      {
-        (*(can2_manage.can_rec_callback[i]))(&rx_header, rx_data);
-      }
-    }
+    m_obj->rx_stats.cycles_max = cycles;
   }
 }
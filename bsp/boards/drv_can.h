@@ -34,22 +34,134 @@ typedef int32_t (*can_stdmsg_rx_callback_t)(CAN_RxHeaderTypeDef *header, uint8_t
 #define CAN2_TX_FIFO_UNIT_NUM (64)
 #define CAN2_TX_FIFO_SIZE (CAN2_TX_FIFO_UNIT_NUM * sizeof(struct can_std_msg))
 
+/* realtime frames pending at once, one per std id */
+#define CAN_TX_RT_SLOT_NUM (8)
+/* tx mailboxes bulk frames never take, so a realtime frame always finds one */
+#define CAN_TX_RT_MAILBOX_NUM (1)
+
 #define MAX_CAN_REGISTER_NUM 5
 
+/* filter banks per bus, can1 owns 0..13 and can2 14..27 */
+#define CAN_FILTER_BANK_NUM (14)
+/* std id ranges a bus accepts, the driver compiles them into filter banks */
+#define CAN_RX_ID_RANGE_MAX (16)
+#define CAN_STD_ID_MAX (0x7FF)
+
+/* rx dispatch: std ids 0x200..0x2FF index a table directly, other ids go through a small hash */
+#define CAN_RX_DIRECT_BASE (0x200)
+#define CAN_RX_DIRECT_NUM (0x100)
+#define CAN_RX_HASH_SIZE (32) /* power of 2 */
+#define CAN_RX_HASH_LOAD (24) /* ids stored at most, keeps probe chains short */
+
+/* health: bus off is left only by the driver, CAN_BUSOFF_RECOVER_MS after it happened */
+#define CAN_BUSOFF_RECOVER_MS (10)
+/* bus load is the bit time of the frames seen in the last window */
+#define CAN_LOAD_WINDOW_MS (100)
+#define CAN_BITRATE_KBPS (1000)
+/* ESR last error code 1..6, 0 is no error */
+#define CAN_LEC_NUM (7)
+
 typedef struct can_manage_obj *can_manage_obj_t;
 
+enum can_tx_class
+{
+  CAN_TX_CLASS_RT = 0, /* motor and gyro commands, newest frame per std id wins */
+  CAN_TX_CLASS_BULK,   /* byte streams, sent in order behind realtime frames */
+  CAN_TX_CLASS_NUM,
+};
+
+struct can_tx_stats
+{
+  uint32_t sent;           /* frames loaded into a mailbox */
+  uint32_t drop;           /* rt: replaced before sent or no slot, bulk: tx fifo full */
+  uint32_t latency_max_us; /* queue to mailbox */
+  uint32_t latency_sum_us; /* average is latency_sum_us / sent */
+};
+
+struct can_rt_slot
+{
+  uint8_t valid;
+  uint8_t dlc;
+  uint16_t std_id;
+  uint32_t time_us;
+  uint8_t data[8];
+};
+
+struct can_rx_stats
+{
+  uint32_t frames;
+  uint32_t cycles_max; /* rx isr cycles, DWT cycle counter */
+  uint64_t cycles_sum; /* average is cycles_sum / frames */
+};
+
+enum can_bus_state
+{
+  CAN_BUS_ACTIVE = 0,
+  CAN_BUS_WARNING, /* tec or rec reached 96 */
+  CAN_BUS_PASSIVE, /* tec or rec above 127 */
+  CAN_BUS_OFF,     /* tec above 255, nothing is sent or received until recovery */
+};
+
+struct can_health
+{
+  uint8_t state; /* enum can_bus_state */
+  uint8_t tec;
+  uint8_t rec;
+  uint8_t tec_max;
+  uint8_t rec_max;
+  uint8_t last_error_code; /* 1 stuff 2 form 3 ack 4 bit recessive 5 bit dominant 6 crc */
+  uint16_t load_permille;  /* last CAN_LOAD_WINDOW_MS, frames this node sent or accepted */
+  uint16_t load_max_permille;
+  uint32_t lec_cnt[CAN_LEC_NUM]; /* error interrupts by last error code */
+  uint32_t warning_cnt;  /* entered warning or worse */
+  uint32_t passive_cnt;  /* entered passive or worse */
+  uint32_t busoff_cnt;
+  uint32_t recover_cnt;  /* restarts after bus off */
+  uint32_t arb_lost;     /* pending mailboxes seen after losing arbitration */
+  uint32_t tx_fifo_full; /* can_msg_bytes_send calls that found the tx fifo full */
+  uint32_t rx_overrun;   /* rx fifo 0 overrun events */
+};
+
+struct can_rx_hash_entry
+{
+  uint16_t std_id;
+  uint8_t callback_mask;
+};
+
+struct can_id_range
+{
+  uint16_t first;
+  uint16_t last;
+};
+
 struct can_manage_obj
 {
   CAN_HandleTypeDef *hcan;
+  uint8_t filter_bank_start;
+  uint8_t filter_bank_used;
+  uint8_t rx_range_num;
+  struct can_id_range rx_range[CAN_RX_ID_RANGE_MAX];
+  /* bit i set: can_rec_callback[i] handles the id */
+  uint8_t rx_direct[CAN_RX_DIRECT_NUM];
+  struct can_rx_hash_entry rx_hash[CAN_RX_HASH_SIZE];
+  uint8_t rx_hash_num;
+  uint8_t rx_any_mask; /* callbacks with ranges too wide for the hash, called for every frame */
+  struct can_rx_stats rx_stats;
   fifo_t tx_fifo;
   uint8_t *tx_fifo_buffer;
-  uint8_t is_sending;
+  struct can_rt_slot rt_slot[CAN_TX_RT_SLOT_NUM];
+  struct can_tx_stats tx_stats[CAN_TX_CLASS_NUM];
   can_stdmsg_rx_callback_t can_rec_callback[MAX_CAN_REGISTER_NUM];
+  struct can_health health;
+  uint32_t busoff_time_ms;
+  uint32_t load_bits;      /* bits of the current load window */
+  uint32_t load_window_ms; /* start of the current load window */
 };
 
 struct can_std_msg
 {
   uint32_t std_id;
+  uint32_t time_us;
   uint8_t dlc;
   uint8_t data[8];
 };
@@ -59,8 +171,19 @@ extern struct can_manage_obj can2_manage;
 
 void can_manage_init(void);
 int32_t can_fifo0_rx_callback_register(can_manage_obj_t m_obj, can_stdmsg_rx_callback_t fun);
+int32_t can_fifo0_rx_callback_register_id(can_manage_obj_t m_obj, can_stdmsg_rx_callback_t fun,
+                                          uint16_t first_id, uint16_t last_id);
 
 uint32_t can_msg_bytes_send(CAN_HandleTypeDef *hcan,
                             uint8_t *data, uint16_t len, uint16_t std_id);
+int32_t can_msg_rt_send(CAN_HandleTypeDef *hcan,
+                        uint8_t *data, uint8_t dlc, uint16_t std_id);
+int32_t can_tx_stats_get(can_manage_obj_t m_obj, enum can_tx_class tx_class, struct can_tx_stats *stats);
+void can_tx_stats_reset(can_manage_obj_t m_obj);
+int32_t can_rx_stats_get(can_manage_obj_t m_obj, struct can_rx_stats *stats);
+void can_rx_stats_reset(can_manage_obj_t m_obj);
+void can_health_process(can_manage_obj_t m_obj);
+int32_t can_health_get(can_manage_obj_t m_obj, struct can_health *health);
+void can_health_reset(can_manage_obj_t m_obj);
 
 #endif // __DRV_CAN_H__
@@ -114,5 +114,6 @@
 uint32_t get_time_ms(void);
 uint32_t get_time_us(void);
 float get_time_ms_us(void);
+uint32_t get_time_stamp_us(void);
 
 #endif // __INCLUDES_H__
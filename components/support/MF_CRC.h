@@ -25,6 +25,22 @@
 #define __TRUE    (1)
 #endif
 
+/*
+**  CRC32 计算方式，编译时选择
+*/
+#define CRC32_ENGINE_TABLE    (0)   /* 逐字节查表 */
+#define CRC32_ENGINE_SLICE4   (1)   /* slice-by-4查表，额外3KB RAM */
+#define CRC32_ENGINE_SLICE8   (2)   /* slice-by-8查表，额外7KB RAM */
+#define CRC32_ENGINE_HW       (3)   /* STM32F4 CRC外设，按字计算，尾部字节查表 */
+
+#ifndef CRC32_ENGINE
+#ifdef USE_HAL_DRIVER
+#define CRC32_ENGINE          CRC32_ENGINE_HW
+#else
+#define CRC32_ENGINE          CRC32_ENGINE_SLICE8
+#endif
+#endif
+
 
 uint8_t     get_crc8(uint8_t *pchMessage,uint32_t dwLength,uint8_t ucCRC8);
 uint32_t    verify_crc8(uint8_t *pchMessage, uint32_t dwLength);
@@ -33,6 +49,8 @@ uint16_t    get_crc16(uint8_t *pchMessage, uint32_t dwLength,uint16_t wCRC);
 uint32_t    verify_crc16(uint8_t *pchMessage, uint32_t dwLength);
 void        append_crc16(uint8_t* pchMessage,uint32_t dwLength);
 uint32_t    get_crc32(uint8_t *pchMessage, uint32_t dwLength,uint32_t wCRC);
+uint32_t    get_crc32_init(void);
+uint32_t    copy_crc32(uint8_t *pchDest, const uint8_t *pchSrc, uint32_t dwLength, uint32_t wCRC);
 uint32_t    verify_crc32(uint8_t *pchMessage, uint32_t dwLength);
 void        append_crc32(uint8_t* pchMessage,uint32_t dwLength);
 
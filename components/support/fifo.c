@@ -558,6 +558,56 @@ end:
   return (-1);
 }
 
+//******************************************************************************************
+//
+//! \brief  Get the contiguous readable memory of FIFO at offset (in single mode).
+//!
+//! \param  [in]  p_fifo is the pointer of valid FIFO.
+//! \param  [in]  offset is the offset from current read pointer.
+//! \param  [out] pp_span receives the address of the element at offset.
+//!
+//! \retval The number of elements that can be read in place, without rollback.
+//
+//******************************************************************************************
+int fifo_s_peek_span(fifo_s_t *p_fifo, int offset, char **pp_span)
+{
+  FIFO_CPU_SR_TYPE cpu_sr;
+  char *tmp_read_addr;
+  int len_to_end;
+  int len;
+
+  ASSERT(p_fifo);
+  ASSERT(pp_span);
+
+  //Interrupt Off;
+  cpu_sr = FIFO_GET_CPU_SR();
+  FIFO_ENTER_CRITICAL();
+
+  if (offset >= p_fifo->used_num)
+  {
+    *pp_span = NULL;
+    len = 0;
+  }
+  else
+  {
+    tmp_read_addr = p_fifo->p_read_addr + offset;
+    if (tmp_read_addr > p_fifo->p_end_addr)
+      tmp_read_addr = tmp_read_addr - p_fifo->p_end_addr + p_fifo->p_start_addr - 1;
+
+    len = p_fifo->used_num - offset;
+    len_to_end = p_fifo->p_end_addr - tmp_read_addr + 1;
+    if (len > len_to_end)
+      len = len_to_end;
+
+    *pp_span = tmp_read_addr;
+  }
+
+  //Interrupt On
+  FIFO_RESTORE_CPU_SR(cpu_sr);
+
+  return len;
+}
+
 //******************************************************************************************
 //
 //! \brief  FIFO is empty (in single mode)?
@@ -180,6 +180,21 @@
   char fifo_s_preread(fifo_s_t * p_fifo, int offset);
   int fifo_s_prereads(fifo_s_t * p_fifo, char *p_dest, int offset, int len);
 
+  //******************************************************************************************
+  //
+  //! \brief  Get the contiguous readable memory of FIFO at offset (in single mode).
+  //!
+  //! \param  [in]  p_fifo is the pointer of valid FIFO.
+  //! \param  [in]  offset is the offset from current read pointer.
+  //! \param  [out] pp_span receives the address of the element at offset.
+  //!
+  //! \retval The number of elements that can be read in place, without rollback.
+  //!
+  //! \note   The elements stay in FIFO until they are removed by get or discard.
+  //
+  //******************************************************************************************
+  int fifo_s_peek_span(fifo_s_t * p_fifo, int offset, char **pp_span);
+
   //******************************************************************************************
   //
   //! \brief  FIFO is empty (in single mode)?
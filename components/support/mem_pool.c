@@ -0,0 +1,212 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#include "mem_pool.h"
+
+/*
+ * Fixed block size-classed memory pool.
+ *
+ * Every class owns a contiguous storage area cut into equal sized blocks which
+ * are chained in a singly linked free list, so allocation and release are
+ * O(1) and the pool never fragments.  A request is served by the smallest
+ * class whose block size is large enough; if that class is exhausted the next
+ * larger class is tried.
+ */
+
+/*-----------------------------------------------------------*/
+
+void mem_pool_init(struct mem_pool *pool)
+{
+  memset(pool, 0, sizeof(struct mem_pool));
+  MUTEX_INIT(pool->mutex_lock);
+}
+/*-----------------------------------------------------------*/
+
+int32_t mem_pool_add_class(struct mem_pool *pool, void *buffer, uint16_t block_size, uint16_t block_num)
+{
+  struct mem_pool_class *cls;
+  pool_block_t *block;
+  uint8_t *addr;
+
+  if ((buffer == NULL) || (block_num == 0) || (pool->cls_num >= MEM_POOL_CLASS_MAX))
+  {
+    return -1;
+  }
+
+  /* The storage must be aligned and blocks must keep that alignment. */
+  if ((((uint32_t)buffer) & MEM_POOL_ALIGNMENT_MASK) != 0)
+  {
+    return -1;
+  }
+
+  block_size = MEM_POOL_BLOCK_SIZE(block_size);
+  if (block_size < sizeof(pool_block_t))
+  {
+    return -1;
+  }
+
+  /* Classes are searched from the smallest one. */
+  if ((pool->cls_num > 0) && (pool->cls[pool->cls_num - 1].block_size >= block_size))
+  {
+    return -1;
+  }
+
+  cls = &pool->cls[pool->cls_num];
+  cls->start_addr = (uint8_t *)buffer;
+  cls->end_addr = cls->start_addr + (uint32_t)block_size * block_num;
+  cls->block_size = block_size;
+  cls->block_num = block_num;
+  cls->used_num = 0;
+  cls->max_used_num = 0;
+  cls->alloc_cnt = 0;
+  cls->fail_cnt = 0;
+  cls->free_list = NULL;
+
+  /* Chain blocks from the end so the free list starts at the lowest address. */
+  for (addr = cls->end_addr - block_size; addr >= cls->start_addr; addr -= block_size)
+  {
+    block = (pool_block_t *)addr;
+    block->next_free = cls->free_list;
+    cls->free_list = block;
+    if (addr == cls->start_addr)
+    {
+      break;
+    }
+  }
+
+  MUTEX_LOCK(pool->mutex_lock);
+  pool->cls_num++;
+  MUTEX_UNLOCK(pool->mutex_lock);
+
+  return pool->cls_num - 1;
+}
+/*-----------------------------------------------------------*/
+
+void *mem_pool_alloc(struct mem_pool *pool, uint32_t wanted_size)
+{
+  struct mem_pool_class *cls;
+  pool_block_t *block = NULL;
+
+  if (wanted_size == 0)
+  {
+    return NULL;
+  }
+
+  MUTEX_LOCK(pool->mutex_lock);
+
+  for (int i = 0; i < pool->cls_num; i++)
+  {
+    cls = &pool->cls[i];
+
+    if (cls->block_size < wanted_size)
+    {
+      continue;
+    }
+
+    block = cls->free_list;
+    if (block == NULL)
+    {
+      /* Class exhausted, fall through to the next larger one. */
+      cls->fail_cnt++;
+      continue;
+    }
+
+    cls->free_list = block->next_free;
+    cls->used_num++;
+    cls->alloc_cnt++;
+    if (cls->used_num > cls->max_used_num)
+    {
+      cls->max_used_num = cls->used_num;
+    }
+    break;
+  }
+
+  MUTEX_UNLOCK(pool->mutex_lock);
+
+  return (void *)block;
+}
+/*-----------------------------------------------------------*/
+
+int32_t mem_pool_free(struct mem_pool *pool, void *pv)
+{
+  struct mem_pool_class *cls;
+  pool_block_t *block;
+  uint8_t *puc = (uint8_t *)pv;
+
+  if (pv == NULL)
+  {
+    return -1;
+  }
+
+  for (int i = 0; i < pool->cls_num; i++)
+  {
+    cls = &pool->cls[i];
+
+    if ((puc < cls->start_addr) || (puc >= cls->end_addr))
+    {
+      continue;
+    }
+
+    /* Reject pointers which are not at a block boundary. */
+    if (((uint32_t)(puc - cls->start_addr) % cls->block_size) != 0)
+    {
+      return -1;
+    }
+
+    block = (pool_block_t *)puc;
+
+    MUTEX_LOCK(pool->mutex_lock);
+    block->next_free = cls->free_list;
+    cls->free_list = block;
+    cls->used_num--;
+    MUTEX_UNLOCK(pool->mutex_lock);
+
+    return 0;
+  }
+
+  /* Not allocated from this pool. */
+  return -1;
+}
+/*-----------------------------------------------------------*/
+
+uint8_t mem_pool_is_owner(struct mem_pool *pool, void *pv)
+{
+  uint8_t *puc = (uint8_t *)pv;
+
+  for (int i = 0; i < pool->cls_num; i++)
+  {
+    if ((puc >= pool->cls[i].start_addr) && (puc < pool->cls[i].end_addr))
+    {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+/*-----------------------------------------------------------*/
+
+void mem_pool_reset_stats(struct mem_pool *pool)
+{
+  MUTEX_LOCK(pool->mutex_lock);
+  for (int i = 0; i < pool->cls_num; i++)
+  {
+    pool->cls[i].max_used_num = pool->cls[i].used_num;
+    pool->cls[i].alloc_cnt = 0;
+    pool->cls[i].fail_cnt = 0;
+  }
+  MUTEX_UNLOCK(pool->mutex_lock);
+}
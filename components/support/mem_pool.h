@@ -0,0 +1,75 @@
+/****************************************************************************
+ *  Copyright (C) 2019 RoboMaster.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ***************************************************************************/
+
+#ifndef MEM_POOL_H
+#define MEM_POOL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "macro_mutex.h"
+
+/* must be power of 2, at least 8 */
+#define MEM_POOL_ALIGNMENT (8)
+#define MEM_POOL_ALIGNMENT_MASK (MEM_POOL_ALIGNMENT - 1)
+
+#define MEM_POOL_CLASS_MAX (8)
+
+/* round a block size up to the pool alignment */
+#define MEM_POOL_BLOCK_SIZE(size) (((size) + MEM_POOL_ALIGNMENT_MASK) & ~MEM_POOL_ALIGNMENT_MASK)
+
+/* Declare 8-byte aligned storage for 'num' blocks of 'size' bytes. */
+#define MEM_POOL_STORAGE_DECLARE(name, size, num) \
+  uint64_t name[(MEM_POOL_BLOCK_SIZE(size) * (num)) / sizeof(uint64_t)]
+
+typedef struct _pool_block
+{
+  struct _pool_block *next_free; /*<< The next free block in the class. */
+} pool_block_t;
+
+/* One size class: a set of equal sized blocks chained in a free list. */
+struct mem_pool_class
+{
+  uint8_t *start_addr;   /*<< First byte of the class storage. */
+  uint8_t *end_addr;     /*<< One past the last byte of the class storage. */
+  pool_block_t *free_list;
+  uint16_t block_size;
+  uint16_t block_num;
+  uint16_t used_num;     /*<< Blocks currently handed out. */
+  uint16_t max_used_num; /*<< High-water mark of used_num. */
+  uint32_t alloc_cnt;    /*<< Successful allocations served by this class. */
+  uint32_t fail_cnt;     /*<< Requests that fit this class but found it empty. */
+};
+
+/* Size classes must be added in ascending block size. */
+struct mem_pool
+{
+  struct mem_pool_class cls[MEM_POOL_CLASS_MAX];
+  uint8_t cls_num;
+  MUTEX_DECLARE(mutex_lock);
+};
+
+void mem_pool_init(struct mem_pool *pool);
+int32_t mem_pool_add_class(struct mem_pool *pool, void *buffer, uint16_t block_size, uint16_t block_num);
+void *mem_pool_alloc(struct mem_pool *pool, uint32_t wanted_size);
+int32_t mem_pool_free(struct mem_pool *pool, void *pv);
+uint8_t mem_pool_is_owner(struct mem_pool *pool, void *pv);
+void mem_pool_reset_stats(struct mem_pool *pool);
+
+#endif
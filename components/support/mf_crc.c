@@ -10,8 +10,14 @@
 **   head file
 */
 
+#include <string.h>
 #include "mf_crc.h"
 
+#if (CRC32_ENGINE == CRC32_ENGINE_HW)
+#include "stm32f4xx.h"
+#include "macro_mutex.h"
+#endif
+
 
 
 /*******************************************************************************
@@ -307,25 +313,270 @@ static const uint32_t CRC32_Table[] = {
 static const uint16_t CRC32_INIT = 0x3aa3;
 
 /*
-**  Descriptions: CRC16 checksum function
+**  Descriptions: byte-wise CRC32 update
 **  Input:        Data to check,Stream length, initialized checksum
 **  Output:       CRC checksum
 */
-uint32_t get_crc32(uint8_t *pchMessage,uint32_t dwLength,uint32_t wCRC)
+static uint32_t get_crc32_table(const uint8_t *pchMessage, uint32_t dwLength, uint32_t wCRC)
 {
     uint8_t chData;
+
+    while(dwLength--)
+    {
+        chData = *pchMessage++;
+        (wCRC) = ((uint32_t)(wCRC) >> 8)  ^ CRC32_Table[((uint32_t)(wCRC) ^ (uint32_t)(chData)) & 0x000000ff];
+    }
+
+    return wCRC;
+}
+
+#if (CRC32_ENGINE == CRC32_ENGINE_SLICE4) || (CRC32_ENGINE == CRC32_ENGINE_SLICE8)
+
+#if (CRC32_ENGINE == CRC32_ENGINE_SLICE8)
+#define CRC32_SLICE_NUM     (8)
+#else
+#define CRC32_SLICE_NUM     (4)
+#endif
+
+/*
+**  CRC32_Slice[k][i]为字节i后接k个0字节的CRC，由CRC32_Table在首次使用时生成
+*/
+static uint32_t CRC32_Slice[CRC32_SLICE_NUM - 1][256];
+static uint8_t  CRC32_Slice_Ready = 0;
+
+static void crc32_slice_init(void)
+{
+    uint32_t wCRC;
+
+    for (int i = 0; i < 256; i++)
+    {
+        wCRC = CRC32_Table[i];
+        for (int k = 0; k < CRC32_SLICE_NUM - 1; k++)
+        {
+            wCRC = (wCRC >> 8) ^ CRC32_Table[wCRC & 0xff];
+            CRC32_Slice[k][i] = wCRC;
+        }
+    }
+
+    CRC32_Slice_Ready = 1;
+}
+
+static uint32_t crc32_load_le(const uint8_t *p)
+{
+    uint32_t word;
+    memcpy(&word, p, 4);
+    return word;
+}
+
+/*
+**  Descriptions: slice-by-4/8 CRC32 update, little endian only
+**  Input:        Data to check,Stream length, initialized checksum
+**  Output:       CRC checksum
+*/
+static uint32_t get_crc32_slice(const uint8_t *pchMessage, uint32_t dwLength, uint32_t wCRC)
+{
+    uint32_t one;
+
+    if (!CRC32_Slice_Ready)
+    {
+        crc32_slice_init();
+    }
+
+    while (dwLength >= CRC32_SLICE_NUM)
+    {
+        one = crc32_load_le(pchMessage) ^ wCRC;
+#if (CRC32_SLICE_NUM == 8)
+        {
+            uint32_t two = crc32_load_le(pchMessage + 4);
+            wCRC = CRC32_Slice[6][one & 0xff] ^
+                   CRC32_Slice[5][(one >> 8) & 0xff] ^
+                   CRC32_Slice[4][(one >> 16) & 0xff] ^
+                   CRC32_Slice[3][one >> 24] ^
+                   CRC32_Slice[2][two & 0xff] ^
+                   CRC32_Slice[1][(two >> 8) & 0xff] ^
+                   CRC32_Slice[0][(two >> 16) & 0xff] ^
+                   CRC32_Table[two >> 24];
+        }
+#else
+        wCRC = CRC32_Slice[2][one & 0xff] ^
+               CRC32_Slice[1][(one >> 8) & 0xff] ^
+               CRC32_Slice[0][(one >> 16) & 0xff] ^
+               CRC32_Table[one >> 24];
+#endif
+        pchMessage += CRC32_SLICE_NUM;
+        dwLength -= CRC32_SLICE_NUM;
+    }
+
+    return get_crc32_table(pchMessage, dwLength, wCRC);
+}
+
+#endif
+
+#if (CRC32_ENGINE == CRC32_ENGINE_HW)
+
+/*
+**  STM32F4 CRC外设固定为非反射的0x04C11DB7多项式、初值0xFFFFFFFF、按32位字计算。
+**  本文件的CRC32为同一多项式的反射形式，因此输入字和结果都做位反转(RBIT)；
+**  任意初值通过复位后先写入一个预置字得到。
+*/
+#ifndef CRC32_HW_RESET
+#define CRC32_HW_RESET()      (CRC->CR = CRC_CR_RESET)
+#define CRC32_HW_WRITE(word)  (CRC->DR = (word))
+#define CRC32_HW_READ()       (CRC->DR)
+#define CRC32_HW_RBIT(word)   __RBIT(word)
+#define CRC32_HW_CLK_ENABLE() \
+    do                        \
+    {                         \
+        if ((RCC->AHB1ENR & RCC_AHB1ENR_CRCEN) == 0) \
+        {                     \
+            RCC->AHB1ENR |= RCC_AHB1ENR_CRCEN; \
+            (void)RCC->AHB1ENR; \
+        }                     \
+    } while (0)
+#endif
+
+#define CRC32_HW_POLY         (0x04C11DB7u)
+#define CRC32_HW_MIN_LEN      (8)
+
+/*
+**  Descriptions: word to write after reset so that the CRC unit holds 'state'
+**  Input:        wanted state, non-reflected
+**  Output:       preload word
+*/
+static uint32_t crc32_hw_preload(uint32_t state)
+{
+    /* 外设写入字w后状态为(0xFFFFFFFF ^ w) * x^32 mod P，这里乘以x^-32求逆 */
+    for (int i = 0; i < 32; i++)
+    {
+        if (state & 1)
+        {
+            state = ((state ^ CRC32_HW_POLY) >> 1) | 0x80000000u;
+        }
+        else
+        {
+            state >>= 1;
+        }
+    }
+
+    return ~state;
+}
+
+/*
+**  Descriptions: CRC32 update on the CRC unit, tail bytes by table
+**  Input:        Data to check,Stream length, initialized checksum
+**  Output:       CRC checksum
+*/
+static uint32_t get_crc32_hw(const uint8_t *pchMessage, uint32_t dwLength, uint32_t wCRC)
+{
+    static uint32_t init_preload = 0;
+    static uint8_t init_preload_ready = 0;
+    uint32_t preload;
+    uint32_t word;
+    MUTEX_DECLARE(crc_lock);
+
+    if (dwLength < CRC32_HW_MIN_LEN)
+    {
+        return get_crc32_table(pchMessage, dwLength, wCRC);
+    }
+
+    if (wCRC == CRC32_INIT)
+    {
+        if (!init_preload_ready)
+        {
+            init_preload = crc32_hw_preload(CRC32_HW_RBIT(wCRC));
+            init_preload_ready = 1;
+        }
+        preload = init_preload;
+    }
+    else
+    {
+        preload = crc32_hw_preload(CRC32_HW_RBIT(wCRC));
+    }
+
+    CRC32_HW_CLK_ENABLE();
+
+    /* 外设为全局共享资源，计算期间关中断 */
+    MUTEX_LOCK(crc_lock);
+
+    CRC32_HW_RESET();
+    CRC32_HW_WRITE(preload);
+
+    while (dwLength >= 4)
+    {
+        memcpy(&word, pchMessage, 4);
+        CRC32_HW_WRITE(CRC32_HW_RBIT(word));
+        pchMessage += 4;
+        dwLength -= 4;
+    }
+
+    wCRC = CRC32_HW_RBIT(CRC32_HW_READ());
+
+    MUTEX_UNLOCK(crc_lock);
+
+    return get_crc32_table(pchMessage, dwLength, wCRC);
+}
+
+#endif
+
+/*
+**  Descriptions: CRC32 checksum function
+**  Input:        Data to check,Stream length, initialized checksum
+**  Output:       CRC checksum
+*/
+uint32_t get_crc32(uint8_t *pchMessage,uint32_t dwLength,uint32_t wCRC)
+{
     if (pchMessage == NULL)
     {
         return 0xFFFF;
     }
 
+#if (CRC32_ENGINE == CRC32_ENGINE_HW)
+    return get_crc32_hw(pchMessage, dwLength, wCRC);
+#elif (CRC32_ENGINE == CRC32_ENGINE_SLICE4) || (CRC32_ENGINE == CRC32_ENGINE_SLICE8)
+    return get_crc32_slice(pchMessage, dwLength, wCRC);
+#else
+    return get_crc32_table(pchMessage, dwLength, wCRC);
+#endif
+}
+
+/*
+**  Descriptions: initialized CRC32 checksum, used to start a checksum over several buffers
+**  Input:        None
+**  Output:       CRC checksum
+*/
+uint32_t get_crc32_init(void)
+{
+    return CRC32_INIT;
+}
+
+/*
+**  Descriptions: copy data and update CRC32 checksum in one pass
+**  Input:        Destination, Source, Stream length, checksum of the previous data
+**  Output:       CRC checksum
+*/
+uint32_t copy_crc32(uint8_t *pchDest, const uint8_t *pchSrc, uint32_t dwLength, uint32_t wCRC)
+{
+    uint8_t chData;
+    if ((pchDest == NULL) || (pchSrc == NULL))
+    {
+        return wCRC;
+    }
+
+#if (CRC32_ENGINE == CRC32_ENGINE_TABLE)
     while(dwLength--)
     {
-        chData = *pchMessage++;
+        chData = *pchSrc++;
+        *pchDest++ = chData;
         (wCRC) = ((uint32_t)(wCRC) >> 8)  ^ CRC32_Table[((uint32_t)(wCRC) ^ (uint32_t)(chData)) & 0x000000ff];
     }
 
     return wCRC;
+#else
+    /* 快速计算方式按字读取，先拷贝再在目标内存上计算 */
+    (void)chData;
+    memcpy(pchDest, pchSrc, dwLength);
+    return get_crc32(pchDest, dwLength, wCRC);
+#endif
 }
 
 /*
@@ -0,0 +1,200 @@
+/*
+ * Host benchmark of the CAN receive isr, runs HAL_CAN_RxFifo0MsgPendingCallback of
+ * bsp/boards/drv_can.c unchanged on the stub HAL of tools/can_tx_sim.
+ *
+ * The callbacks are registered with the ids the firmware uses (board.c, offline_check.c and
+ * communicate.c on the chassis board), each one checks the std id itself and counts, like
+ * the firmware callbacks do. Every frame kind is fed RX_NUM times in batches of RX_BATCH and
+ * each batch is timed with the host time stamp counter, the isr is the span the DWT cycle
+ * counter covers on target. The fastest batch gives cycles per frame. Host cycles are not
+ * Cortex-M4 cycles, compare the two drivers with each other only.
+ *
+ * Prints callback calls and cycles per frame of each kind, then feeds every std id to both
+ * buses and prints all callback calls against the frames the callbacks registered for. Exits
+ * non zero when a callback missed one of its ids.
+ *
+ * Build from the repository root against the current driver:
+ *
+ *   gcc -O2 -Itools/can_tx_sim -Ibsp/boards -Icomponents/support -o can_rx_bench \
+ *       tools/can_rx_bench/can_rx_bench.c bsp/boards/drv_can.c components/support/fifo.c
+ *
+ * or against an older driver, put its drv_can.c/.h in old/ and
+ *
+ *   gcc -O2 -Iold -Itools/can_tx_sim -Icomponents/support -o can_rx_bench_old \
+ *       tools/can_rx_bench/can_rx_bench.c old/drv_can.c components/support/fifo.c
+ *
+ * Run:
+ *
+ *   ./can_rx_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <x86intrin.h>
+#include "can.h"
+#include "drv_can.h"
+
+#define RX_NUM         (1000000)
+#define RX_BATCH       (1000)
+#define CAN2_RCV_ID    (0x600)
+
+enum
+{
+  CB_MOTOR,
+  CB_DETECT1,
+  CB_GYRO,
+  CB_DETECT2,
+  CB_UWB,
+  CB_PROTOCOL,
+  CB_NUM
+};
+
+struct frame_kind
+{
+  const char *name;
+  CAN_HandleTypeDef *hcan;
+  uint32_t std_id;
+};
+
+static CAN_TypeDef can1_reg;
+static CAN_TypeDef can2_reg;
+CAN_HandleTypeDef hcan1 = {&can1_reg};
+CAN_HandleTypeDef hcan2 = {&can2_reg};
+DWT_Type stub_dwt;
+CoreDebug_Type stub_cd;
+
+static CAN_RxHeaderTypeDef rx_next;
+static long calls[CB_NUM];
+static long hits[CB_NUM];
+
+uint32_t get_time_ms(void) { return 0; }
+uint32_t get_time_us(void) { return 0; }
+uint32_t get_time_stamp_us(void) { return 0; }
+
+int HAL_CAN_ConfigFilter(CAN_HandleTypeDef *h, CAN_FilterTypeDef *f) { return 0; }
+int HAL_CAN_Start(CAN_HandleTypeDef *h) { return 0; }
+int HAL_CAN_ActivateNotification(CAN_HandleTypeDef *h, uint32_t it) { return 0; }
+int HAL_CAN_ResetError(CAN_HandleTypeDef *h) { return 0; }
+uint32_t HAL_CAN_GetError(CAN_HandleTypeDef *h) { return 0; }
+int HAL_CAN_AddTxMessage(CAN_HandleTypeDef *h, CAN_TxHeaderTypeDef *hd, uint8_t *d, uint32_t *box) { return 0; }
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(CAN_HandleTypeDef *h) { return 3; }
+
+int HAL_CAN_GetRxMessage(CAN_HandleTypeDef *h, uint32_t fifo, CAN_RxHeaderTypeDef *hd, uint8_t *d)
+{
+  *hd = rx_next;
+  memset(d, 1, 8);
+  return 0;
+}
+
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan);
+
+static int32_t count(int cb, CAN_RxHeaderTypeDef *header, uint32_t id_min, uint32_t id_max)
+{
+  calls[cb]++;
+  if ((header->StdId >= id_min) && (header->StdId <= id_max))
+  {
+    hits[cb]++;
+  }
+  return 0;
+}
+
+static int32_t motor_rec(CAN_RxHeaderTypeDef *header, uint8_t *data) { return count(CB_MOTOR, header, 0x201, 0x208); }
+static int32_t detect1_rec(CAN_RxHeaderTypeDef *header, uint8_t *data) { return count(CB_DETECT1, header, 0x201, 0x207); }
+static int32_t gyro_rec(CAN_RxHeaderTypeDef *header, uint8_t *data) { return count(CB_GYRO, header, 0x401, 0x401); }
+static int32_t detect2_rec(CAN_RxHeaderTypeDef *header, uint8_t *data) { return count(CB_DETECT2, header, 0x401, 0x401); }
+static int32_t uwb_rec(CAN_RxHeaderTypeDef *header, uint8_t *data) { return count(CB_UWB, header, 0x259, 0x259); }
+static int32_t protocol_rec(CAN_RxHeaderTypeDef *header, uint8_t *data) { return count(CB_PROTOCOL, header, CAN2_RCV_ID, CAN2_RCV_ID); }
+
+static long calls_sum(void)
+{
+  long n = 0;
+
+  for (int i = 0; i < CB_NUM; i++)
+  {
+    n += calls[i];
+  }
+  return n;
+}
+
+static void bench(const struct frame_kind *kind)
+{
+  uint64_t cycles_min = UINT64_MAX;
+  long calls0 = calls_sum();
+
+  rx_next.StdId = kind->std_id;
+  rx_next.IDE = CAN_ID_STD;
+  rx_next.DLC = 8;
+  for (long n = 0; n < RX_NUM; n += RX_BATCH)
+  {
+    uint64_t t0 = __rdtsc();
+    uint64_t cycles;
+
+    for (int i = 0; i < RX_BATCH; i++)
+    {
+      HAL_CAN_RxFifo0MsgPendingCallback(kind->hcan);
+    }
+    cycles = __rdtsc() - t0;
+    if (cycles < cycles_min)
+    {
+      cycles_min = cycles;
+    }
+  }
+  printf("%-20s %.1f calls, %5.1f cycles per frame\n", kind->name,
+         (double)(calls_sum() - calls0) / RX_NUM, (double)cycles_min / RX_BATCH);
+}
+
+/* every std id on both buses, each callback must see exactly its own ids */
+static int check_routing(void)
+{
+  long want = 0;
+  int fail = 0;
+
+  memset(calls, 0, sizeof(calls));
+  memset(hits, 0, sizeof(hits));
+  for (uint32_t id = 0; id < 0x800; id++)
+  {
+    rx_next.StdId = id;
+    HAL_CAN_RxFifo0MsgPendingCallback(&hcan1);
+    HAL_CAN_RxFifo0MsgPendingCallback(&hcan2);
+  }
+  for (int i = 0; i < CB_NUM; i++)
+  {
+    want += hits[i];
+    if (hits[i] == 0)
+    {
+      printf("FAIL callback %d missed its ids\n", i);
+      fail = 1;
+    }
+  }
+  printf("routing: %ld callback calls for %ld own frames\n", calls_sum(), want);
+
+  return fail;
+}
+
+int main(void)
+{
+  const struct frame_kind kinds[] =
+  {
+    {"can1 motor 0x201", &hcan1, 0x201},
+    {"can1 motor 0x208", &hcan1, 0x208},
+    {"can1 other 0x300", &hcan1, 0x300},
+    {"can2 protocol 0x600", &hcan2, CAN2_RCV_ID},
+    {"can2 gyro 0x401", &hcan2, 0x401},
+    {"can2 uwb 0x259", &hcan2, 0x259},
+  };
+
+  can_manage_init();
+  can_fifo0_rx_callback_register_id(&can1_manage, motor_rec, 0x201, 0x208);
+  can_fifo0_rx_callback_register_id(&can2_manage, gyro_rec, 0x401, 0x401);
+  can_fifo0_rx_callback_register_id(&can1_manage, detect1_rec, 0x201, 0x207);
+  can_fifo0_rx_callback_register_id(&can2_manage, detect2_rec, 0x401, 0x401);
+  can_fifo0_rx_callback_register_id(&can2_manage, uwb_rec, 0x259, 0x259);
+  can_fifo0_rx_callback_register_id(&can2_manage, protocol_rec, CAN2_RCV_ID, CAN2_RCV_ID);
+
+  for (uint32_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++)
+  {
+    bench(&kinds[i]);
+  }
+
+  return check_routing();
+}
@@ -0,0 +1,3 @@
+/* host stub for can_tx_sim.c, only what drv_can.c uses */
+#include "stm32f4xx_hal.h"
+extern CAN_HandleTypeDef hcan1, hcan2;
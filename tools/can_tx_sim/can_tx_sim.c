@@ -0,0 +1,287 @@
+/*
+ * Host simulation of CAN1 transmit contention, runs bsp/boards/drv_can.c unchanged on stub HAL.
+ *
+ * One 1 Mbps bus with three mailboxes sent in fifo order, a 1 kHz motor frame (std id 0x200),
+ * bulk bursts of bulk_len bytes every bulk_period us (std id 0x300) and optional foreign
+ * traffic at ext_load of the bus with ids 0x201..0x204. Prints motor frame latency, enqueue
+ * to end of frame, over 20 s of simulated time.
+ *
+ * Build from the repository root against the current driver:
+ *
+ *   gcc -O2 -Itools/can_tx_sim -Ibsp/boards -Icomponents/support -o can_tx_sim \
+ *       tools/can_tx_sim/can_tx_sim.c bsp/boards/drv_can.c components/support/fifo.c
+ *
+ * or against an older driver without the realtime class, put its drv_can.c/.h in old/ and
+ *
+ *   gcc -O2 -DBASELINE -Iold -Itools/can_tx_sim -Icomponents/support -o can_tx_sim_old \
+ *       tools/can_tx_sim/can_tx_sim.c old/drv_can.c components/support/fifo.c
+ *
+ * Run:
+ *
+ *   ./can_tx_sim <bulk_period_us> <bulk_len> <ext_load>     e.g. ./can_tx_sim 1000 64 0.3
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "can.h"
+#include "drv_can.h"
+
+#define SIM_TIME_US    (20u * 1000 * 1000)
+#define MOTOR_ID       (0x200)
+#define BULK_ID        (0x300)
+#define EXT_ID_MAX     (0x204)
+#define EXT_FRAME_US   (121) /* mean foreign frame time used for the arrival rate */
+#define HIST_NUM       (64)
+#define HIST_STEP_US   (100)
+
+static CAN_TypeDef can1_reg, can2_reg;
+CAN_HandleTypeDef hcan1 = {&can1_reg}, hcan2 = {&can2_reg};
+DWT_Type stub_dwt;
+CoreDebug_Type stub_cd;
+
+static uint64_t now_us;
+
+/* three tx mailboxes, the lowest order goes on the bus first */
+static struct
+{
+  int used;
+  uint32_t id;
+  uint8_t dlc;
+  uint8_t data[8];
+  uint64_t order;
+} mb[3];
+
+static uint64_t order_cnt;
+static uint64_t busy_until;
+static int cur = -1; /* mailbox on the bus, -2 for a foreign frame, -1 idle */
+static int in_isr;
+static int pending_cb;
+static long ext_pending;
+static double ext_load;
+
+static long motor_sent;
+static double motor_sum;
+static uint64_t motor_max;
+static long hist[HIST_NUM];
+static long bulk_bytes;
+
+static void sim_tick(void);
+
+uint32_t get_time_ms(void) { return now_us / 1000; }
+uint32_t get_time_us(void) { return now_us % 1000; }
+uint32_t get_time_stamp_us(void) { return now_us; }
+
+int HAL_CAN_ConfigFilter(CAN_HandleTypeDef *h, CAN_FilterTypeDef *f) { return 0; }
+int HAL_CAN_Start(CAN_HandleTypeDef *h) { return 0; }
+int HAL_CAN_ActivateNotification(CAN_HandleTypeDef *h, uint32_t it) { return 0; }
+int HAL_CAN_GetRxMessage(CAN_HandleTypeDef *h, uint32_t fifo, CAN_RxHeaderTypeDef *hd, uint8_t *d) { return 0; }
+int HAL_CAN_ResetError(CAN_HandleTypeDef *h) { return 0; }
+uint32_t HAL_CAN_GetError(CAN_HandleTypeDef *h) { return 0; }
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan);
+
+static int mb_free_num(void)
+{
+  int n = 0;
+
+  for (int i = 0; i < 3; i++)
+  {
+    n += !mb[i].used;
+  }
+  return n;
+}
+
+/* standard data frame with worst case stuffing */
+static uint32_t frame_bits(int dlc)
+{
+  return 47 + 8 * dlc + (34 + 8 * dlc) / 8;
+}
+
+int HAL_CAN_AddTxMessage(CAN_HandleTypeDef *h, CAN_TxHeaderTypeDef *hd, uint8_t *d, uint32_t *box)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    if (!mb[i].used)
+    {
+      mb[i].used = 1;
+      mb[i].id = hd->StdId;
+      mb[i].dlc = hd->DLC;
+      memcpy(mb[i].data, d, 8);
+      mb[i].order = order_cnt++;
+      *box = i;
+      return 0;
+    }
+  }
+  return 1;
+}
+
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(CAN_HandleTypeDef *h)
+{
+  int n = mb_free_num();
+  long guard = 0;
+
+  /* a completion handler that waits for a free mailbox spins the bus forward here */
+  if ((n == 0) && in_isr)
+  {
+    while (((n = mb_free_num()) == 0) && (guard++ < 100000))
+    {
+      sim_tick();
+    }
+  }
+  return n;
+}
+
+static void frame_done(int box)
+{
+  uint64_t t0;
+  uint64_t latency;
+
+  if (mb[box].id == MOTOR_ID)
+  {
+    memcpy(&t0, mb[box].data, 8);
+    latency = now_us - t0;
+    motor_sent++;
+    motor_sum += latency;
+    if (latency > motor_max)
+    {
+      motor_max = latency;
+    }
+    hist[(latency / HIST_STEP_US < HIST_NUM - 1) ? latency / HIST_STEP_US : HIST_NUM - 1]++;
+  }
+  else if (mb[box].id == BULK_ID)
+  {
+    bulk_bytes += mb[box].dlc;
+  }
+  mb[box].used = 0;
+  pending_cb++;
+}
+
+static void sim_tick(void)
+{
+  int best = -1;
+
+  now_us++;
+  if ((cur != -1) && (now_us >= busy_until))
+  {
+    if (cur >= 0)
+    {
+      frame_done(cur);
+    }
+    cur = -1;
+  }
+
+  if ((double)rand() / RAND_MAX < ext_load / EXT_FRAME_US)
+  {
+    ext_pending++;
+  }
+
+  if (cur != -1)
+  {
+    return;
+  }
+
+  for (int i = 0; i < 3; i++)
+  {
+    if (mb[i].used && ((best < 0) || (mb[i].order < mb[best].order)))
+    {
+      best = i;
+    }
+  }
+
+  /* foreign frames win arbitration against anything above their ids */
+  if (ext_pending && ((best < 0) || (mb[best].id > EXT_ID_MAX)))
+  {
+    ext_pending--;
+    cur = -2;
+    busy_until = now_us + frame_bits(8);
+  }
+  else if (best >= 0)
+  {
+    cur = best;
+    busy_until = now_us + frame_bits(mb[best].dlc);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  int bulk_period;
+  int bulk_len;
+  uint8_t bulk[512];
+  uint8_t motor[8];
+  uint64_t next_bulk = 0;
+  long p99 = 0;
+  long acc = 0;
+
+  if (argc < 4)
+  {
+    printf("usage: %s <bulk_period_us> <bulk_len> <ext_load>\n", argv[0]);
+    return 1;
+  }
+  bulk_period = atoi(argv[1]);
+  bulk_len = atoi(argv[2]);
+  ext_load = atof(argv[3]);
+  if (bulk_len > (int)sizeof(bulk))
+  {
+    bulk_len = sizeof(bulk);
+  }
+
+  srand(1);
+  can_manage_init();
+  memset(bulk, 0x55, sizeof(bulk));
+
+  while (now_us < SIM_TIME_US)
+  {
+    sim_tick();
+    while (pending_cb > 0)
+    {
+      pending_cb--;
+      in_isr = 1;
+      HAL_CAN_TxMailbox0CompleteCallback(&hcan1);
+      in_isr = 0;
+    }
+
+    /* the motor frame carries its enqueue time */
+    if (now_us % 1000 == 0)
+    {
+      memcpy(motor, &now_us, 8);
+#ifdef BASELINE
+      can_msg_bytes_send(&hcan1, motor, 8, MOTOR_ID);
+#else
+      can_msg_rt_send(&hcan1, motor, 8, MOTOR_ID);
+#endif
+    }
+
+    if (now_us >= next_bulk)
+    {
+      can_msg_bytes_send(&hcan1, bulk, bulk_len, BULK_ID);
+      next_bulk += bulk_period;
+    }
+  }
+
+  for (int i = 0; i < HIST_NUM; i++)
+  {
+    acc += hist[i];
+    if (acc >= motor_sent * 0.99)
+    {
+      p99 = (i + 1) * HIST_STEP_US;
+      break;
+    }
+  }
+
+  printf("bulk %3dB/%4dus ext %.0f%%: motor sent %5ld/%u mean %6.0f us p99 <%5ld us max %7llu us | bulk %6.1f KB/s",
+         bulk_len, bulk_period, ext_load * 100, motor_sent, SIM_TIME_US / 1000,
+         motor_sent ? motor_sum / motor_sent : 0.0, p99, (unsigned long long)motor_max,
+         bulk_bytes / (SIM_TIME_US / 1e6) / 1000);
+#ifndef BASELINE
+  {
+    struct can_tx_stats rt, bk;
+
+    can_tx_stats_get(&can1_manage, CAN_TX_CLASS_RT, &rt);
+    can_tx_stats_get(&can1_manage, CAN_TX_CLASS_BULK, &bk);
+    printf(" | rt drop %ld max %u us, bulk drop %ld max %u us",
+           (long)rt.drop, rt.latency_max_us, (long)bk.drop, bk.latency_max_us);
+  }
+#endif
+  printf("\n");
+
+  return 0;
+}
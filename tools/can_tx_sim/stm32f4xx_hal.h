@@ -0,0 +1,85 @@
+/* host stub for can_tx_sim.c, only what drv_can.c uses */
+#ifndef STUB_HAL_H
+#define STUB_HAL_H
+#include <stdint.h>
+#include <string.h>
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
+static inline unsigned long __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(unsigned long x) { (void)x; }
+typedef struct { volatile uint32_t TIR, TDTR, TDLR, TDHR; } CAN_TxMailBox_TypeDef;
+typedef struct { volatile uint32_t MCR, MSR, TSR, ESR; CAN_TxMailBox_TypeDef sTxMailBox[3]; } CAN_TypeDef;
+typedef struct { uint32_t AutoBusOff; } CAN_InitTypeDef;
+typedef struct { CAN_TypeDef *Instance; CAN_InitTypeDef Init; uint32_t ErrorCode; } CAN_HandleTypeDef;
+typedef struct { uint32_t StdId, ExtId, IDE, RTR, DLC, Timestamp, FilterMatchIndex; } CAN_RxHeaderTypeDef;
+typedef struct { uint32_t StdId, ExtId, IDE, RTR, DLC; int TransmitGlobalTime; } CAN_TxHeaderTypeDef;
+typedef struct { uint32_t FilterIdHigh, FilterIdLow, FilterMaskIdHigh, FilterMaskIdLow, FilterFIFOAssignment, FilterBank, FilterMode, FilterScale, FilterActivation, SlaveStartFilterBank; } CAN_FilterTypeDef;
+#define SET_BIT(R, B) ((R) |= (B))
+#define CLEAR_BIT(R, B) ((R) &= ~(B))
+#define ENABLE 1
+#define DISABLE 0
+#define CAN_FILTERMODE_IDMASK 0
+#define CAN_FILTERMODE_IDLIST 1
+#define CAN_FILTERSCALE_16BIT 0
+#define CAN_FILTERSCALE_32BIT 1
+#define CAN_RX_FIFO0 0
+#define CAN_ID_STD 0
+#define CAN_RTR_DATA 0
+#define CAN_IT_RX_FIFO0_MSG_PENDING 1
+#define CAN_IT_TX_MAILBOX_EMPTY 2
+#define CAN_IT_ERROR 4
+#define CAN_IT_ERROR_WARNING 8
+#define CAN_IT_BUSOFF 16
+#define CAN_IT_ERROR_PASSIVE 32
+#define CAN_IT_LAST_ERROR_CODE 64
+#define CAN_IT_RX_FIFO0_OVERRUN 128
+#define CAN_MCR_INRQ 1u
+#define CAN_MCR_ABOM (1u << 6)
+#define CAN_MSR_INAK 1u
+#define CAN_TSR_ALST0 (1u << 2)
+#define CAN_TSR_ALST1 (1u << 10)
+#define CAN_TSR_ALST2 (1u << 18)
+#define CAN_TSR_TME0 (1u << 26)
+#define CAN_TSR_TME1 (1u << 27)
+#define CAN_TSR_TME2 (1u << 28)
+#define CAN_ESR_EWGF 1u
+#define CAN_ESR_EPVF 2u
+#define CAN_ESR_BOFF 4u
+#define CAN_ESR_TEC_Pos 16u
+#define CAN_ESR_TEC (0xFFu << 16)
+#define CAN_ESR_REC_Pos 24u
+#define CAN_ESR_REC (0xFFu << 24)
+#define CAN_TDT0R_DLC 0xFu
+#define HAL_CAN_ERROR_NONE 0u
+#define HAL_CAN_ERROR_EWG 1u
+#define HAL_CAN_ERROR_EPV 2u
+#define HAL_CAN_ERROR_BOF 4u
+#define HAL_CAN_ERROR_STF 8u
+#define HAL_CAN_ERROR_FOR 0x10u
+#define HAL_CAN_ERROR_ACK 0x20u
+#define HAL_CAN_ERROR_BR 0x40u
+#define HAL_CAN_ERROR_BD 0x80u
+#define HAL_CAN_ERROR_CRC 0x100u
+#define HAL_CAN_ERROR_RX_FOV0 0x200u
+#define HAL_CAN_ERROR_TX_ALST0 0x800u
+#define HAL_CAN_ERROR_TX_ALST1 0x2000u
+#define HAL_CAN_ERROR_TX_ALST2 0x8000u
+int HAL_CAN_ConfigFilter(CAN_HandleTypeDef *h, CAN_FilterTypeDef *f);
+int HAL_CAN_Start(CAN_HandleTypeDef *h);
+int HAL_CAN_ActivateNotification(CAN_HandleTypeDef *h, uint32_t it);
+int HAL_CAN_AddTxMessage(CAN_HandleTypeDef *h, CAN_TxHeaderTypeDef *hd, uint8_t *d, uint32_t *box);
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(CAN_HandleTypeDef *h);
+int HAL_CAN_GetRxMessage(CAN_HandleTypeDef *h, uint32_t fifo, CAN_RxHeaderTypeDef *hd, uint8_t *d);
+int HAL_CAN_ResetError(CAN_HandleTypeDef *h);
+uint32_t HAL_CAN_GetError(CAN_HandleTypeDef *h);
+#endif
+#ifndef STUB_DWT
+#define STUB_DWT
+typedef struct { volatile uint32_t CTRL, CYCCNT; } DWT_Type;
+typedef struct { volatile uint32_t DEMCR; } CoreDebug_Type;
+extern DWT_Type stub_dwt; extern CoreDebug_Type stub_cd;
+#define DWT (&stub_dwt)
+#define CoreDebug (&stub_cd)
+#define CoreDebug_DEMCR_TRCENA_Msk (1u << 24)
+#define DWT_CTRL_CYCCNTENA_Msk 1u
+#endif
@@ -0,0 +1 @@
+/* host stub for can_tx_sim.c, drv_can.c includes it but uses nothing from it */
@@ -0,0 +1,5 @@
+/* host stub for can_tx_sim.c, only what drv_can.c uses */
+#include <stdint.h>
+uint32_t get_time_ms(void);
+uint32_t get_time_us(void);
+uint32_t get_time_stamp_us(void);
@@ -0,0 +1,210 @@
+/*
+ * Host test of the CRC32 engines in components/support/mf_crc.c against the byte-wise table.
+ *
+ * mf_crc.c is included here built for one CRC32_ENGINE, so get_crc32 is that engine and the
+ * static get_crc32_table is the reference. For CRC32_ENGINE_HW the CRC unit is replaced by a
+ * bit-serial model of the STM32F4 peripheral (poly 0x04C11DB7, not reflected, reset to
+ * 0xFFFFFFFF, one 32-bit word per DR write), so the RBIT mapping and the x^-32 preload of
+ * crc32_hw_preload are checked against the same arithmetic as the silicon.
+ *
+ * Checks, every one against get_crc32_table:
+ *   - get_crc32 for every length 0..LEN_MAX at each of 8 buffer alignments, with the init
+ *     value, 0, 0xFFFFFFFF and SEED_NUM random seeds
+ *   - every single byte value at every position of messages up to 16 bytes, all seeds above
+ *   - copy_crc32 copies the data and gives the same crc, append_crc32 then verify_crc32
+ * then prints MB/s of the table and of the engine on 64 byte frames and on 64 KB.
+ * The HW figure is the model's and says nothing about the peripheral.
+ *
+ * Build and run from the repository root, once per engine:
+ *
+ *   for e in 1 2 3; do
+ *     gcc -O2 -DCRC32_ENGINE=$e -Itools/protocol_sim -Icomponents/support -o crc_test_$e \
+ *         tools/crc_test/crc_test.c && ./crc_test_$e
+ *   done
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#define LEN_MAX        (1024)
+#define SEED_NUM       (64)
+
+/* STM32F4 CRC unit model, used when CRC32_ENGINE is CRC32_ENGINE_HW */
+static uint32_t crc_hw_dr;
+
+static inline void crc_hw_write(uint32_t word)
+{
+  crc_hw_dr ^= word;
+  for (int i = 0; i < 32; i++)
+  {
+    crc_hw_dr = (crc_hw_dr & 0x80000000u) ? (crc_hw_dr << 1) ^ 0x04C11DB7u : crc_hw_dr << 1;
+  }
+}
+
+static inline uint32_t crc_rbit(uint32_t word)
+{
+  uint32_t out = 0;
+
+  for (int i = 0; i < 32; i++)
+  {
+    out = (out << 1) | ((word >> i) & 1);
+  }
+  return out;
+}
+
+#define CRC32_HW_RESET()      (crc_hw_dr = 0xFFFFFFFFu)
+#define CRC32_HW_WRITE(word)  crc_hw_write(word)
+#define CRC32_HW_READ()       (crc_hw_dr)
+#define CRC32_HW_RBIT(word)   crc_rbit(word)
+#define CRC32_HW_CLK_ENABLE() do {} while (0)
+
+#include "mf_crc.c"
+
+static const char *engine_name[] = {"table", "slice-by-4", "slice-by-8", "hw model"};
+
+static uint32_t seeds[SEED_NUM + 3];
+static long checked;
+static long failed;
+
+static void expect(uint32_t got, uint32_t want, const char *what, uint32_t len, uint32_t seed)
+{
+  checked++;
+  if (got != want)
+  {
+    if (failed++ < 10)
+    {
+      printf("FAIL %s len %u seed %08x: %08x, table %08x\n", what, len, seed, got, want);
+    }
+  }
+}
+
+static void check_lengths(void)
+{
+  static uint8_t buf[LEN_MAX + 8];
+
+  for (int i = 0; i < (int)sizeof(buf); i++)
+  {
+    buf[i] = rand();
+  }
+  for (int s = 0; s < SEED_NUM + 3; s++)
+  {
+    for (int align = 0; align < 8; align++)
+    {
+      for (uint32_t len = 0; len <= LEN_MAX; len++)
+      {
+        expect(get_crc32(buf + align, len, seeds[s]), get_crc32_table(buf + align, len, seeds[s]),
+               "get_crc32", len, seeds[s]);
+      }
+    }
+  }
+}
+
+static void check_single_bytes(void)
+{
+  uint8_t buf[16];
+
+  for (int s = 0; s < SEED_NUM + 3; s++)
+  {
+    for (uint32_t len = 1; len <= sizeof(buf); len++)
+    {
+      for (uint32_t pos = 0; pos < len; pos++)
+      {
+        for (int v = 0; v < 256; v++)
+        {
+          memset(buf, 0, sizeof(buf));
+          buf[pos] = v;
+          expect(get_crc32(buf, len, seeds[s]), get_crc32_table(buf, len, seeds[s]), "single byte", len, seeds[s]);
+        }
+      }
+    }
+  }
+}
+
+static void check_helpers(void)
+{
+  uint8_t src[LEN_MAX];
+  uint8_t dst[LEN_MAX];
+
+  for (int i = 0; i < LEN_MAX; i++)
+  {
+    src[i] = rand();
+  }
+  for (uint32_t len = 0; len <= LEN_MAX; len += 7)
+  {
+    memset(dst, 0, sizeof(dst));
+    expect(copy_crc32(dst, src, len, CRC32_INIT), get_crc32_table(src, len, CRC32_INIT), "copy_crc32", len, CRC32_INIT);
+    expect(memcmp(dst, src, len), 0, "copy_crc32 data", len, CRC32_INIT);
+  }
+  for (uint32_t len = 5; len <= LEN_MAX; len += 13)
+  {
+    memcpy(dst, src, len);
+    append_crc32(dst, len);
+    expect(verify_crc32(dst, len), __TRUE, "append/verify", len, CRC32_INIT);
+    dst[len / 2] ^= 0x10;
+    expect(verify_crc32(dst, len), __FALSE, "verify corrupted", len, CRC32_INIT);
+  }
+}
+
+static double now_s(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void bench(uint32_t len)
+{
+  static uint8_t buf[64 * 1024];
+  const long total = (CRC32_ENGINE == CRC32_ENGINE_HW) ? 16l << 20 : 256l << 20;
+  volatile uint32_t sink = 0;
+  double t0;
+  double table_s;
+  double engine_s;
+
+  for (uint32_t i = 0; i < len; i++)
+  {
+    buf[i] = rand();
+  }
+
+  t0 = now_s();
+  for (long n = 0; n < total; n += len)
+  {
+    sink ^= get_crc32_table(buf, len, CRC32_INIT);
+  }
+  table_s = now_s() - t0;
+
+  t0 = now_s();
+  for (long n = 0; n < total; n += len)
+  {
+    sink ^= get_crc32(buf, len, CRC32_INIT);
+  }
+  engine_s = now_s() - t0;
+
+  printf("%5u byte buffers: table %6.0f MB/s, %s %6.0f MB/s\n", len, total / table_s / 1e6,
+         engine_name[CRC32_ENGINE], total / engine_s / 1e6);
+}
+
+int main(void)
+{
+  srand(8);
+  seeds[0] = CRC32_INIT;
+  seeds[1] = 0;
+  seeds[2] = 0xFFFFFFFFu;
+  for (int s = 3; s < SEED_NUM + 3; s++)
+  {
+    seeds[s] = ((uint32_t)rand() << 16) ^ rand();
+  }
+
+  check_lengths();
+  check_single_bytes();
+  check_helpers();
+  printf("%s: %ld checks, %ld failed\n", engine_name[CRC32_ENGINE], checked, failed);
+
+  bench(64);
+  bench(64 * 1024);
+
+  return failed != 0;
+}
@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+# Generate host side decoders from application/infantry_cmd_schema.h.
+#
+#   python3 tools/gen_cmd_schema.py
+#
+# writes tools/infantry_cmd.py and tools/infantry_cmd.hpp next to this script.
+# Run it after editing the schema so the manifold side stays in step with the firmware.
+
+import os
+import re
+
+TOOLS_DIR = os.path.dirname(os.path.abspath(__file__))
+ROOT_DIR = os.path.dirname(TOOLS_DIR)
+CMD_HEADER = os.path.join(ROOT_DIR, 'application', 'infantry_cmd.h')
+SCHEMA_HEADER = os.path.join(ROOT_DIR, 'application', 'infantry_cmd_schema.h')
+
+# C type -> (struct format, size)
+TYPES = {
+    'int8_t': ('b', 1), 'uint8_t': ('B', 1),
+    'int16_t': ('h', 2), 'uint16_t': ('H', 2),
+    'int32_t': ('i', 4), 'uint32_t': ('I', 4),
+    'int64_t': ('q', 8), 'uint64_t': ('Q', 8),
+    'float': ('f', 4), 'double': ('d', 8),
+}
+
+HEADER_NOTE = 'Generated by tools/gen_cmd_schema.py from application/infantry_cmd_schema.h, do not edit.'
+
+
+def parse():
+    with open(CMD_HEADER, encoding='utf-8') as f:
+        cmd_ids = dict(re.findall(r'#define\s+(CMD_\w+)\s+\((0x[0-9A-Fa-f]+)u\)', f.read()))
+
+    with open(SCHEMA_HEADER, encoding='utf-8') as f:
+        text = f.read()
+
+    field_lists = {}
+    current = None
+    for line in text.splitlines():
+        m = re.match(r'#define\s+(\w+_FIELDS)\(F, S\)', line)
+        if m:
+            current = field_lists.setdefault(m.group(1), [])
+            continue
+        m = re.match(r'\s*F\(S,\s*(\w+),\s*(\w+),\s*(\d+)\)', line)
+        if m and current is not None:
+            ctype, field, scale = m.groups()
+            if ctype not in TYPES:
+                raise SystemExit('unsupported type %s of %s' % (ctype, field))
+            current.append((ctype, field, int(scale)))
+        if not line.rstrip().endswith('\\'):
+            current = None
+
+    messages = []
+    for cmd, name, fields in re.findall(r'^\s*M\((CMD_\w+),\s*(\w+),\s*(\w+)\)', text, re.M):
+        if cmd not in cmd_ids:
+            raise SystemExit('unknown command id %s' % cmd)
+        messages.append((cmd, int(cmd_ids[cmd], 16), name, field_lists[fields]))
+    return messages
+
+
+def gen_python(messages):
+    out = ['# %s' % HEADER_NOTE,
+           '"""Decoders of the fixed length infantry command payloads.',
+           '',
+           'decode(cmd, payload) returns (name, {field: value}) with scaled fields in physical',
+           'units, encode(cmd, **values) builds a payload from physical values.',
+           '"""',
+           '',
+           'import struct',
+           '']
+    for cmd, cmd_id, name, fields in messages:
+        out.append('%s = 0x%04X' % (cmd, cmd_id))
+    out += ['', '', '# cmd -> (name, layout, field names, scales)', 'MESSAGES = {']
+    for cmd, cmd_id, name, fields in messages:
+        fmt = '<' + ''.join(TYPES[t][0] for t, _, _ in fields)
+        out.append('    %s: (%r, struct.Struct(%r),' % (cmd, name, fmt))
+        out.append('        %r,' % (tuple(f for _, f, _ in fields),))
+        out.append('        %r),' % (tuple(s for _, _, s in fields),))
+    out += ['}',
+            '',
+            '',
+            'def decode(cmd, payload):',
+            '    """Return (name, values) or None for an unknown command or a length mismatch."""',
+            '    msg = MESSAGES.get(cmd)',
+            '    if msg is None or len(payload) != msg[1].size:',
+            '        return None',
+            '    name, layout, names, scales = msg',
+            '    raw = layout.unpack(payload)',
+            '    return name, {n: (v / s if s != 1 else v) for n, v, s in zip(names, raw, scales)}',
+            '',
+            '',
+            'def encode(cmd, **values):',
+            '    """Build the payload of cmd, missing fields are sent as 0."""',
+            '    name, layout, names, scales = MESSAGES[cmd]',
+            '    raw = [int(round(values.get(n, 0) * s)) if s != 1 else int(values.get(n, 0))',
+            '           for n, s in zip(names, scales)]',
+            '    return layout.pack(*raw)',
+            '']
+    return '\n'.join(out)
+
+
+def gen_cpp(messages):
+    out = ['// %s' % HEADER_NOTE,
+           '//',
+           '// Packed payload structs with compile time sizes and scales. dispatch() switches on the',
+           '// command once and hands the visitor a typed message, decode<CMD>() checks the length',
+           '// against a constant and copies the payload, so each path is specialised by the compiler.',
+           '',
+           '#ifndef INFANTRY_CMD_HPP',
+           '#define INFANTRY_CMD_HPP',
+           '',
+           '#include <cstddef>',
+           '#include <cstdint>',
+           '#include <cstring>',
+           '',
+           'namespace infantry_cmd',
+           '{',
+           '']
+    for cmd, cmd_id, name, fields in messages:
+        out.append('constexpr uint16_t %s = 0x%04X;' % (cmd, cmd_id))
+    out += ['', '#pragma pack(push, 1)', '']
+    for cmd, cmd_id, name, fields in messages:
+        out.append('struct %s' % name)
+        out.append('{')
+        for ctype, field, scale in fields:
+            out.append('  %s %s;' % (ctype, field))
+        out.append('};')
+        out.append('')
+    out += ['#pragma pack(pop)', '',
+            '// wire value = physical value * scale',
+            'template <uint16_t Cmd>',
+            'struct Message;',
+            '']
+    for cmd, cmd_id, name, fields in messages:
+        size = sum(TYPES[t][1] for t, _, _ in fields)
+        out.append('template <>')
+        out.append('struct Message<%s>' % cmd)
+        out.append('{')
+        out.append('  using type = %s;' % name)
+        out.append('  static constexpr const char *name = "%s";' % name)
+        out.append('  static constexpr std::size_t size = %d;' % size)
+        for ctype, field, scale in fields:
+            if scale != 1:
+                out.append('  static constexpr float %s_scale = %d;' % (field, scale))
+        out.append('};')
+        out.append('static_assert(sizeof(%s) == Message<%s>::size, "%s size differs from the schema");' % (name, cmd, name))
+        out.append('')
+    out += ['template <uint16_t Cmd>',
+            'inline bool decode(const uint8_t *data, std::size_t len, typename Message<Cmd>::type &msg)',
+            '{',
+            '  if (len != Message<Cmd>::size)',
+            '  {',
+            '    return false;',
+            '  }',
+            '  std::memcpy(&msg, data, Message<Cmd>::size);',
+            '  return true;',
+            '}',
+            '',
+            '// calls visitor(msg) with the typed payload, false for an unknown command or a bad length',
+            'template <class Visitor>',
+            'inline bool dispatch(uint16_t cmd, const uint8_t *data, std::size_t len, Visitor &&visitor)',
+            '{',
+            '  switch (cmd)',
+            '  {']
+    for cmd, cmd_id, name, fields in messages:
+        out += ['  case %s:' % cmd,
+                '  {',
+                '    %s msg;' % name,
+                '    if (!decode<%s>(data, len, msg))' % cmd,
+                '    {',
+                '      return false;',
+                '    }',
+                '    visitor(msg);',
+                '    return true;',
+                '  }']
+    out += ['  default:',
+            '    return false;',
+            '  }',
+            '}',
+            '',
+            '} // namespace infantry_cmd',
+            '',
+            '#endif // INFANTRY_CMD_HPP',
+            '']
+    return '\n'.join(out)
+
+
+def main():
+    messages = parse()
+    with open(os.path.join(TOOLS_DIR, 'infantry_cmd.py'), 'w', encoding='utf-8') as f:
+        f.write(gen_python(messages))
+    with open(os.path.join(TOOLS_DIR, 'infantry_cmd.hpp'), 'w', encoding='utf-8') as f:
+        f.write(gen_cpp(messages))
+    print('%d messages' % len(messages))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,347 @@
+// Generated by tools/gen_cmd_schema.py from application/infantry_cmd_schema.h, do not edit.
+//
+// Packed payload structs with compile time sizes and scales. dispatch() switches on the
+// command once and hands the visitor a typed message, decode<CMD>() checks the length
+// against a constant and copies the payload, so each path is specialised by the compiler.
+
+#ifndef INFANTRY_CMD_HPP
+#define INFANTRY_CMD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace infantry_cmd
+{
+
+constexpr uint16_t CMD_GET_CHASSIS_PARAM = 0x0204;
+constexpr uint16_t CMD_PUSH_CHASSIS_INFO = 0x0201;
+constexpr uint16_t CMD_PUSH_GIMBAL_INFO = 0x0301;
+constexpr uint16_t CMD_SET_GIMBAL_ANGLE = 0x0303;
+constexpr uint16_t CMD_SET_CHASSIS_SPEED = 0x0203;
+constexpr uint16_t CMD_SET_CHASSIS_SPD_ACC = 0x0205;
+constexpr uint16_t CMD_SET_FRICTION_SPEED = 0x0304;
+constexpr uint16_t CMD_SET_SHOOT_FREQUENTCY = 0x0305;
+constexpr uint16_t CMD_PUSH_CAN_HEALTH = 0x0404;
+
+#pragma pack(push, 1)
+
+struct cmd_chassis_param
+{
+  uint16_t wheel_perimeter;
+  uint16_t wheel_track;
+  uint16_t wheel_base;
+  int16_t rotate_x_offset;
+  int16_t rotate_y_offset;
+};
+
+struct cmd_chassis_info
+{
+  int16_t gyro_angle;
+  int16_t gyro_palstance;
+  int32_t position_x_mm;
+  int32_t position_y_mm;
+  int16_t angle_deg;
+  int16_t v_x_mm;
+  int16_t v_y_mm;
+  uint32_t time_us;
+};
+
+struct cmd_gimbal_info
+{
+  uint8_t mode;
+  int16_t pitch_ecd_angle;
+  int16_t yaw_ecd_angle;
+  int16_t pitch_gyro_angle;
+  int16_t yaw_gyro_angle;
+  int16_t yaw_rate;
+  int16_t pitch_rate;
+  uint32_t time_us;
+};
+
+struct cmd_gimbal_angle
+{
+  uint8_t ctrl;
+  int16_t pitch;
+  int16_t yaw;
+};
+
+struct cmd_chassis_speed
+{
+  int16_t vx;
+  int16_t vy;
+  int16_t vw;
+  int16_t rotate_x_offset;
+  int16_t rotate_y_offset;
+};
+
+struct cmd_chassis_spd_acc
+{
+  int16_t vx;
+  int16_t vy;
+  int16_t vw;
+  int16_t ax;
+  int16_t ay;
+  int16_t wz;
+  int16_t rotate_x_offset;
+  int16_t rotate_y_offset;
+};
+
+struct cmd_firction_speed
+{
+  uint16_t left;
+  uint16_t right;
+};
+
+struct cmd_shoot_num
+{
+  uint8_t shoot_cmd;
+  uint32_t shoot_add_num;
+  uint16_t shoot_freq;
+};
+
+struct cmd_can_health
+{
+  uint8_t bus;
+  uint8_t state;
+  uint8_t tec;
+  uint8_t rec;
+  uint8_t tec_max;
+  uint8_t rec_max;
+  uint8_t last_error_code;
+  uint16_t load;
+  uint16_t load_max;
+  uint32_t stuff_err;
+  uint32_t form_err;
+  uint32_t ack_err;
+  uint32_t bit_recessive_err;
+  uint32_t bit_dominant_err;
+  uint32_t crc_err;
+  uint32_t warning_cnt;
+  uint32_t passive_cnt;
+  uint32_t busoff_cnt;
+  uint32_t recover_cnt;
+  uint32_t arb_lost;
+  uint32_t tx_fifo_full;
+  uint32_t tx_bulk_drop;
+  uint32_t rx_overrun;
+};
+
+#pragma pack(pop)
+
+// wire value = physical value * scale
+template <uint16_t Cmd>
+struct Message;
+
+template <>
+struct Message<CMD_GET_CHASSIS_PARAM>
+{
+  using type = cmd_chassis_param;
+  static constexpr const char *name = "cmd_chassis_param";
+  static constexpr std::size_t size = 10;
+};
+static_assert(sizeof(cmd_chassis_param) == Message<CMD_GET_CHASSIS_PARAM>::size, "cmd_chassis_param size differs from the schema");
+
+template <>
+struct Message<CMD_PUSH_CHASSIS_INFO>
+{
+  using type = cmd_chassis_info;
+  static constexpr const char *name = "cmd_chassis_info";
+  static constexpr std::size_t size = 22;
+  static constexpr float gyro_angle_scale = 10;
+  static constexpr float gyro_palstance_scale = 10;
+  static constexpr float angle_deg_scale = 10;
+};
+static_assert(sizeof(cmd_chassis_info) == Message<CMD_PUSH_CHASSIS_INFO>::size, "cmd_chassis_info size differs from the schema");
+
+template <>
+struct Message<CMD_PUSH_GIMBAL_INFO>
+{
+  using type = cmd_gimbal_info;
+  static constexpr const char *name = "cmd_gimbal_info";
+  static constexpr std::size_t size = 17;
+  static constexpr float pitch_ecd_angle_scale = 10;
+  static constexpr float yaw_ecd_angle_scale = 10;
+  static constexpr float pitch_gyro_angle_scale = 10;
+  static constexpr float yaw_gyro_angle_scale = 10;
+  static constexpr float yaw_rate_scale = 10;
+  static constexpr float pitch_rate_scale = 10;
+};
+static_assert(sizeof(cmd_gimbal_info) == Message<CMD_PUSH_GIMBAL_INFO>::size, "cmd_gimbal_info size differs from the schema");
+
+template <>
+struct Message<CMD_SET_GIMBAL_ANGLE>
+{
+  using type = cmd_gimbal_angle;
+  static constexpr const char *name = "cmd_gimbal_angle";
+  static constexpr std::size_t size = 5;
+  static constexpr float pitch_scale = 10;
+  static constexpr float yaw_scale = 10;
+};
+static_assert(sizeof(cmd_gimbal_angle) == Message<CMD_SET_GIMBAL_ANGLE>::size, "cmd_gimbal_angle size differs from the schema");
+
+template <>
+struct Message<CMD_SET_CHASSIS_SPEED>
+{
+  using type = cmd_chassis_speed;
+  static constexpr const char *name = "cmd_chassis_speed";
+  static constexpr std::size_t size = 10;
+  static constexpr float vw_scale = 10;
+};
+static_assert(sizeof(cmd_chassis_speed) == Message<CMD_SET_CHASSIS_SPEED>::size, "cmd_chassis_speed size differs from the schema");
+
+template <>
+struct Message<CMD_SET_CHASSIS_SPD_ACC>
+{
+  using type = cmd_chassis_spd_acc;
+  static constexpr const char *name = "cmd_chassis_spd_acc";
+  static constexpr std::size_t size = 16;
+  static constexpr float vw_scale = 10;
+  static constexpr float wz_scale = 10;
+};
+static_assert(sizeof(cmd_chassis_spd_acc) == Message<CMD_SET_CHASSIS_SPD_ACC>::size, "cmd_chassis_spd_acc size differs from the schema");
+
+template <>
+struct Message<CMD_SET_FRICTION_SPEED>
+{
+  using type = cmd_firction_speed;
+  static constexpr const char *name = "cmd_firction_speed";
+  static constexpr std::size_t size = 4;
+};
+static_assert(sizeof(cmd_firction_speed) == Message<CMD_SET_FRICTION_SPEED>::size, "cmd_firction_speed size differs from the schema");
+
+template <>
+struct Message<CMD_SET_SHOOT_FREQUENTCY>
+{
+  using type = cmd_shoot_num;
+  static constexpr const char *name = "cmd_shoot_num";
+  static constexpr std::size_t size = 7;
+};
+static_assert(sizeof(cmd_shoot_num) == Message<CMD_SET_SHOOT_FREQUENTCY>::size, "cmd_shoot_num size differs from the schema");
+
+template <>
+struct Message<CMD_PUSH_CAN_HEALTH>
+{
+  using type = cmd_can_health;
+  static constexpr const char *name = "cmd_can_health";
+  static constexpr std::size_t size = 67;
+  static constexpr float load_scale = 10;
+  static constexpr float load_max_scale = 10;
+};
+static_assert(sizeof(cmd_can_health) == Message<CMD_PUSH_CAN_HEALTH>::size, "cmd_can_health size differs from the schema");
+
+template <uint16_t Cmd>
+inline bool decode(const uint8_t *data, std::size_t len, typename Message<Cmd>::type &msg)
+{
+  if (len != Message<Cmd>::size)
+  {
+    return false;
+  }
+  std::memcpy(&msg, data, Message<Cmd>::size);
+  return true;
+}
+
+// calls visitor(msg) with the typed payload, false for an unknown command or a bad length
+template <class Visitor>
+inline bool dispatch(uint16_t cmd, const uint8_t *data, std::size_t len, Visitor &&visitor)
+{
+  switch (cmd)
+  {
+  case CMD_GET_CHASSIS_PARAM:
+  {
+    cmd_chassis_param msg;
+    if (!decode<CMD_GET_CHASSIS_PARAM>(data, len, msg))
+    {
+      return false;
+    }
+    visitor(msg);
+    return true;
+  }
+  case CMD_PUSH_CHASSIS_INFO:
+  {
+    cmd_chassis_info msg;
+    if (!decode<CMD_PUSH_CHASSIS_INFO>(data, len, msg))
+    {
+      return false;
+    }
+    visitor(msg);
+    return true;
+  }
+  case CMD_PUSH_GIMBAL_INFO:
+  {
+    cmd_gimbal_info msg;
+    if (!decode<CMD_PUSH_GIMBAL_INFO>(data, len, msg))
+    {
+      return false;
+    }
+    visitor(msg);
+    return true;
+  }
+  case CMD_SET_GIMBAL_ANGLE:
+  {
+    cmd_gimbal_angle msg;
+    if (!decode<CMD_SET_GIMBAL_ANGLE>(data, len, msg))
+    {
+      return false;
+    }
+    visitor(msg);
+    return true;
+  }
+  case CMD_SET_CHASSIS_SPEED:
+  {
+    cmd_chassis_speed msg;
+    if (!decode<CMD_SET_CHASSIS_SPEED>(data, len, msg))
+    {
+      return false;
+    }
+    visitor(msg);
+    return true;
+  }
+  case CMD_SET_CHASSIS_SPD_ACC:
+  {
+    cmd_chassis_spd_acc msg;
+    if (!decode<CMD_SET_CHASSIS_SPD_ACC>(data, len, msg))
+    {
+      return false;
+    }
+    visitor(msg);
+    return true;
+  }
+  case CMD_SET_FRICTION_SPEED:
+  {
+    cmd_firction_speed msg;
+    if (!decode<CMD_SET_FRICTION_SPEED>(data, len, msg))
+    {
+      return false;
+    }
+    visitor(msg);
+    return true;
+  }
+  case CMD_SET_SHOOT_FREQUENTCY:
+  {
+    cmd_shoot_num msg;
+    if (!decode<CMD_SET_SHOOT_FREQUENTCY>(data, len, msg))
+    {
+      return false;
+    }
+    visitor(msg);
+    return true;
+  }
+  case CMD_PUSH_CAN_HEALTH:
+  {
+    cmd_can_health msg;
+    if (!decode<CMD_PUSH_CAN_HEALTH>(data, len, msg))
+    {
+      return false;
+    }
+    visitor(msg);
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+} // namespace infantry_cmd
+
+#endif // INFANTRY_CMD_HPP
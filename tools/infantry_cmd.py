@@ -0,0 +1,68 @@
+# Generated by tools/gen_cmd_schema.py from application/infantry_cmd_schema.h, do not edit.
+"""Decoders of the fixed length infantry command payloads.
+
+decode(cmd, payload) returns (name, {field: value}) with scaled fields in physical
+units, encode(cmd, **values) builds a payload from physical values.
+"""
+
+import struct
+
+CMD_GET_CHASSIS_PARAM = 0x0204
+CMD_PUSH_CHASSIS_INFO = 0x0201
+CMD_PUSH_GIMBAL_INFO = 0x0301
+CMD_SET_GIMBAL_ANGLE = 0x0303
+CMD_SET_CHASSIS_SPEED = 0x0203
+CMD_SET_CHASSIS_SPD_ACC = 0x0205
+CMD_SET_FRICTION_SPEED = 0x0304
+CMD_SET_SHOOT_FREQUENTCY = 0x0305
+CMD_PUSH_CAN_HEALTH = 0x0404
+
+
+# cmd -> (name, layout, field names, scales)
+MESSAGES = {
+    CMD_GET_CHASSIS_PARAM: ('cmd_chassis_param', struct.Struct('<HHHhh'),
+        ('wheel_perimeter', 'wheel_track', 'wheel_base', 'rotate_x_offset', 'rotate_y_offset'),
+        (1, 1, 1, 1, 1)),
+    CMD_PUSH_CHASSIS_INFO: ('cmd_chassis_info', struct.Struct('<hhiihhhI'),
+        ('gyro_angle', 'gyro_palstance', 'position_x_mm', 'position_y_mm', 'angle_deg', 'v_x_mm', 'v_y_mm', 'time_us'),
+        (10, 10, 1, 1, 10, 1, 1, 1)),
+    CMD_PUSH_GIMBAL_INFO: ('cmd_gimbal_info', struct.Struct('<BhhhhhhI'),
+        ('mode', 'pitch_ecd_angle', 'yaw_ecd_angle', 'pitch_gyro_angle', 'yaw_gyro_angle', 'yaw_rate', 'pitch_rate', 'time_us'),
+        (1, 10, 10, 10, 10, 10, 10, 1)),
+    CMD_SET_GIMBAL_ANGLE: ('cmd_gimbal_angle', struct.Struct('<Bhh'),
+        ('ctrl', 'pitch', 'yaw'),
+        (1, 10, 10)),
+    CMD_SET_CHASSIS_SPEED: ('cmd_chassis_speed', struct.Struct('<hhhhh'),
+        ('vx', 'vy', 'vw', 'rotate_x_offset', 'rotate_y_offset'),
+        (1, 1, 10, 1, 1)),
+    CMD_SET_CHASSIS_SPD_ACC: ('cmd_chassis_spd_acc', struct.Struct('<hhhhhhhh'),
+        ('vx', 'vy', 'vw', 'ax', 'ay', 'wz', 'rotate_x_offset', 'rotate_y_offset'),
+        (1, 1, 10, 1, 1, 10, 1, 1)),
+    CMD_SET_FRICTION_SPEED: ('cmd_firction_speed', struct.Struct('<HH'),
+        ('left', 'right'),
+        (1, 1)),
+    CMD_SET_SHOOT_FREQUENTCY: ('cmd_shoot_num', struct.Struct('<BIH'),
+        ('shoot_cmd', 'shoot_add_num', 'shoot_freq'),
+        (1, 1, 1)),
+    CMD_PUSH_CAN_HEALTH: ('cmd_can_health', struct.Struct('<BBBBBBBHHIIIIIIIIIIIIII'),
+        ('bus', 'state', 'tec', 'rec', 'tec_max', 'rec_max', 'last_error_code', 'load', 'load_max', 'stuff_err', 'form_err', 'ack_err', 'bit_recessive_err', 'bit_dominant_err', 'crc_err', 'warning_cnt', 'passive_cnt', 'busoff_cnt', 'recover_cnt', 'arb_lost', 'tx_fifo_full', 'tx_bulk_drop', 'rx_overrun'),
+        (1, 1, 1, 1, 1, 1, 1, 10, 10, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1)),
+}
+
+
+def decode(cmd, payload):
+    """Return (name, values) or None for an unknown command or a length mismatch."""
+    msg = MESSAGES.get(cmd)
+    if msg is None or len(payload) != msg[1].size:
+        return None
+    name, layout, names, scales = msg
+    raw = layout.unpack(payload)
+    return name, {n: (v / s if s != 1 else v) for n, v, s in zip(names, raw, scales)}
+
+
+def encode(cmd, **values):
+    """Build the payload of cmd, missing fields are sent as 0."""
+    name, layout, names, scales = MESSAGES[cmd]
+    raw = [int(round(values.get(n, 0) * s)) if s != 1 else int(values.get(n, 0))
+           for n, s in zip(names, scales)]
+    return layout.pack(*raw)
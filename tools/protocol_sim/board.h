@@ -0,0 +1 @@
+/* host stub for tools/protocol_sim, protocol.c includes it for nothing the host needs */
@@ -0,0 +1,20 @@
+#!/bin/sh
+# Build one host program of tools/protocol_sim against the protocol and support sources of a tree.
+#
+#   tools/protocol_sim/build.sh <name> [tree]
+#
+# <name> is a program in this directory without .c, the binary is written to ./<name>.
+# [tree] defaults to the repository root, give a checkout of an older commit
+# (git worktree add /tmp/base <commit>) to build the same program for a before/after run.
+# mem_mang4.c keeps heap addresses in uint32_t, so the program is linked without pie to keep
+# its static heap below 4 GB on a 64 bit host. Extra compiler flags are taken from $CFLAGS.
+
+set -e
+name=$1
+sim=$(cd "$(dirname "$0")" && pwd)
+tree=${2:-$sim/../..}
+p=$tree/application/protocol
+s=$tree/components/support
+
+gcc -O2 -std=gnu99 -fno-pie -no-pie -w $CFLAGS -I"$sim" -I"$p" -I"$s" -o "$name" "$sim/$name.c" "$sim/sim.c" \
+    $(ls "$p"/protocol*.c "$s"/mem_pool.c 2>/dev/null) "$s/fifo.c" "$s/mf_crc.c" "$s/mem_mang4.c" -lm
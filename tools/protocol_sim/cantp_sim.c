@@ -0,0 +1,599 @@
+/*
+ * Host harness of the segmented CAN transport, protocol_cantp.c. The node 0x01 has one
+ * CAN_TP_PORT interface c0, every CAN frame it sends goes into a queue read by the harness.
+ *
+ * As sender, against a scripted peer that reassembles the node's frames and answers each
+ * first frame with a chosen flow control (CTS, WAIT, overflow or nothing):
+ *
+ *   transfer: 1, 100, 500, 2000 and 4096 byte payloads (the larger ones through the frag
+ *             layer), CAN frames and flow controls per payload.
+ *   stall:    the driver refuses frames in the middle of a message, a later flush resumes.
+ *   burst:    a CTS in the rx isr sends one PROTOCOL_CANTP_TX_BURST, the flush the rest.
+ *   no fc:    the peer is silent, the send times out after PROTOCOL_CANTP_TIMEOUT.
+ *   overflow: the peer refuses the message, the next one still goes out.
+ *   peer wait: the peer answers PROTOCOL_CANTP_WAIT_MAX WAITs 15 ms apart, then CTS, the
+ *             message completes; one WAIT more aborts it.
+ *
+ * As receiver, the captured messages are re-addressed to the node and replayed as CAN frames:
+ *
+ *   clean:       every payload arrives byte exact.
+ *   dropped cf:  a consecutive frame lost, the message is dropped, the next copy arrives.
+ *   interleaved: half a message cut off by a new first frame, only the full one arrives.
+ *   loss:        2000 messages with 2 % of the CAN frames lost, exactly the messages with
+ *                no lost frame arrive and none is corrupt.
+ *   refused fc:  the driver refuses the node's flow control, the flush sends it.
+ *   wait resend: the receive FIFO stays full, the node repeats WAIT every CANTP_WAIT_PERIOD
+ *                up to PROTOCOL_CANTP_WAIT_MAX, then drops the message.
+ *
+ * End to end, the node's frames loop back into the node, so its own sender talks to its own
+ * receiver while the receive FIFO is held full for HOLD_MS, longer than the sender timeout.
+ * The message must arrive once the FIFO is drained.
+ *
+ * Prints one line per check and exits non zero when one fails.
+ *
+ * Build and run from the repository root:
+ *
+ *   tools/protocol_sim/build.sh cantp_sim && ./cantp_sim
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "protocol_transmit.h"
+#include "protocol_cantp.h"
+
+#define CAN_PORT       (2)
+#define TX_ID          (0x500)
+#define RX_ID          (0x600)
+#define CMD_DATA       (0x0700)
+#define FRAME_MAX      (100000)
+#define MSG_MAX        (4096)
+#define MSG_BUF_SIZE   (1 << 20)
+#define LOSS_MSGS      (2000)
+#define HOLD_MS        (60)
+
+#define PEER_SILENT    (0xFF)
+
+extern local_info_t protocol_local_info;
+
+/* CAN frames sent by the node */
+static uint8_t tx_frame[FRAME_MAX][8];
+static uint8_t tx_frame_len[FRAME_MAX];
+static int tx_num;
+static int tx_read;
+static int drv_accept = -1; /* frames the driver still takes, -1 for all */
+static int fc_out[3];       /* flow controls sent by the node, by flow status */
+static uint32_t fc_wait_time[32];
+
+/* scripted peer, reassembles the node's messages */
+static uint8_t peer_fs = PROTOCOL_CANTP_FS_CTS;
+static uint8_t peer_msg[MSG_MAX];
+static int peer_len;
+static int peer_off;
+static int peer_fc;
+
+/* messages the peer got, back to back */
+static uint8_t msg_buf[MSG_BUF_SIZE];
+static int msg_start[LOSS_MSGS + 64];
+static int msg_len[LOSS_MSGS + 64];
+static int msg_num;
+static int msg_buf_len;
+
+static uint8_t data[PROTOCOL_FRAG_MAX_LEN];
+static uint16_t expect_len;
+static long got;
+static long bad;
+static int fail;
+
+static struct perph_interface *obj;
+
+static int can_send(uint32_t id, uint8_t *p_data, uint32_t len)
+{
+  if (drv_accept == 0)
+  {
+    return 0;
+  }
+  if (drv_accept > 0)
+  {
+    drv_accept--;
+  }
+  if ((p_data[0] & 0xF0) == PROTOCOL_CANTP_PCI_FC)
+  {
+    if ((p_data[0] & 0x0F) == PROTOCOL_CANTP_FS_WAIT)
+    {
+      fc_wait_time[fc_out[PROTOCOL_CANTP_FS_WAIT] % 32] = stub_tick;
+    }
+    fc_out[(p_data[0] & 0x0F) % 3]++;
+  }
+  if (tx_num < FRAME_MAX)
+  {
+    memcpy(tx_frame[tx_num], p_data, len);
+    tx_frame_len[tx_num++] = len;
+  }
+  return len;
+}
+
+/* a payload of expect_len bytes from data, or a self checking one: length, seed, seed + i */
+static int32_t data_rcv(uint8_t *buf, uint16_t len)
+{
+  got++;
+  if (expect_len != 0)
+  {
+    bad += (len != expect_len) || memcmp(buf, data, len);
+    return 0;
+  }
+  if ((len < 2) || (buf[0] != (uint8_t)len))
+  {
+    bad++;
+    return 0;
+  }
+  for (int i = 2; i < len; i++)
+  {
+    if (buf[i] != (uint8_t)(buf[1] + i))
+    {
+      bad++;
+      break;
+    }
+  }
+  return 0;
+}
+
+static void check(int ok, const char *fmt, ...)
+{
+  va_list args;
+
+  printf("%s ", ok ? "ok  " : "FAIL");
+  va_start(args, fmt);
+  vprintf(fmt, args);
+  va_end(args);
+  printf("\n");
+  fail |= !ok;
+}
+
+static void peer_fc_send(uint8_t fs)
+{
+  uint8_t fc[3] = {PROTOCOL_CANTP_PCI_FC | fs, 0, 0};
+
+  peer_fc++;
+  protocol_can_rcv_data(CAN_PORT, RX_ID, fc, sizeof(fc));
+}
+
+static void peer_msg_done(void)
+{
+  msg_start[msg_num] = msg_buf_len;
+  msg_len[msg_num++] = peer_len;
+  memcpy(msg_buf + msg_buf_len, peer_msg, peer_len);
+  msg_buf_len += peer_len;
+}
+
+/* the scripted peer reads what the node sent */
+static void peer_run(void)
+{
+  while (tx_read < tx_num)
+  {
+    uint8_t *f = tx_frame[tx_read++];
+    int n;
+
+    switch (f[0] & 0xF0)
+    {
+    case PROTOCOL_CANTP_PCI_SF:
+      peer_len = f[0] & 0x0F;
+      memcpy(peer_msg, f + 1, peer_len);
+      peer_msg_done();
+      break;
+
+    case PROTOCOL_CANTP_PCI_FF:
+      peer_len = ((f[0] & 0x0F) << 8) | f[1];
+      memcpy(peer_msg, f + 2, 6);
+      peer_off = 6;
+      if (peer_fs != PEER_SILENT)
+      {
+        peer_fc_send(peer_fs);
+      }
+      break;
+
+    case PROTOCOL_CANTP_PCI_CF:
+      n = (peer_len - peer_off > 7) ? 7 : peer_len - peer_off;
+      memcpy(peer_msg + peer_off, f + 1, n);
+      peer_off += n;
+      if (peer_off >= peer_len)
+      {
+        peer_msg_done();
+      }
+      break;
+
+    default:
+      break;
+    }
+  }
+}
+
+static void pump(int rounds)
+{
+  for (int i = 0; i < rounds; i++)
+  {
+    protocol_send_flush();
+    peer_run();
+  }
+}
+
+static void tx_reset(void)
+{
+  tx_num = tx_read = 0;
+  msg_num = msg_buf_len = 0;
+  peer_fc = 0;
+  memset(fc_out, 0, sizeof(fc_out));
+}
+
+/* split one message into SF or FF + CF frames */
+static int make_frames(const uint8_t *msg, int len, uint8_t frame[][8], uint8_t *frame_len)
+{
+  int num = 1;
+  int off = 6;
+
+  if (len <= 7)
+  {
+    frame[0][0] = PROTOCOL_CANTP_PCI_SF | len;
+    memcpy(frame[0] + 1, msg, len);
+    frame_len[0] = len + 1;
+    return 1;
+  }
+  frame[0][0] = PROTOCOL_CANTP_PCI_FF | (len >> 8);
+  frame[0][1] = len & 0xFF;
+  memcpy(frame[0] + 2, msg, 6);
+  frame_len[0] = 8;
+  for (int sn = 1; off < len; sn++, num++)
+  {
+    int n = (len - off > 7) ? 7 : len - off;
+
+    frame[num][0] = PROTOCOL_CANTP_PCI_CF | (sn & 0x0F);
+    memcpy(frame[num] + 1, msg + off, n);
+    frame_len[num] = n + 1;
+    off += n;
+  }
+  return num;
+}
+
+/* the captured frames of every message now come from 0x02 to the node */
+static void readdress_msgs(void)
+{
+  for (int off = 0; off + PROTOCOL_PACK_HEAD_SIZE < msg_buf_len; off += sim_frame_len(msg_buf + off))
+  {
+    sim_frame_readdress(msg_buf + off, 0x02, 0x01);
+  }
+}
+
+/* replay message m, without frame skip and with the first cut frames sent once before */
+static int replay(int m, int skip, int cut)
+{
+  static uint8_t frame[MSG_MAX / 7 + 2][8];
+  static uint8_t frame_len[MSG_MAX / 7 + 2];
+  int num = make_frames(msg_buf + msg_start[m], msg_len[m], frame, frame_len);
+  int lost = 0;
+
+  for (int i = 0; i < cut; i++)
+  {
+    protocol_can_rcv_data(CAN_PORT, RX_ID, frame[i], frame_len[i]);
+  }
+  for (int i = 0; i < num; i++)
+  {
+    if ((i == skip) || ((skip < 0) && (rand() % 1000 < -skip)))
+    {
+      lost = 1;
+      continue;
+    }
+    protocol_can_rcv_data(CAN_PORT, RX_ID, frame[i], frame_len[i]);
+  }
+  protocol_unpack_flush();
+  return lost;
+}
+
+static void replay_all(int skip, int cut)
+{
+  for (int m = 0; m < msg_num; m++)
+  {
+    int num = (msg_len[m] + 7) / 7;
+
+    replay(m, (num > 3) ? skip : PROTOCOL_CANTP_MSG_MAX_LEN, (num > 3) ? cut * num / 2 : 0);
+  }
+}
+
+static void test_transfer(void)
+{
+  const int lens[] = {1, 100, 500, 2000, 4096};
+
+  for (int k = 0; k < 5; k++)
+  {
+    int frames;
+    int clean;
+    int dropped;
+    int after;
+    int interleaved;
+
+    tx_reset();
+    protocol_send(0x02, CMD_DATA, data, lens[k]);
+    pump(200);
+    frames = tx_num;
+
+    readdress_msgs();
+    expect_len = lens[k];
+    protocol_local_info.address = 0x01;
+    got = bad = 0;
+    replay_all(PROTOCOL_CANTP_MSG_MAX_LEN, 0);
+    clean = (got == 1) && (bad == 0);
+    got = bad = 0;
+    replay_all(2, 0);
+    dropped = got;
+    got = bad = 0;
+    replay_all(PROTOCOL_CANTP_MSG_MAX_LEN, 0);
+    after = (got == 1) && (bad == 0);
+    got = bad = 0;
+    replay_all(PROTOCOL_CANTP_MSG_MAX_LEN, 1);
+    interleaved = (got == 1) && (bad == 0);
+
+    check(clean && after && interleaved && ((lens[k] < 100) || (dropped == 0)),
+          "transfer %4d bytes: %d msgs, %4d can frames, %d fc; clean %d, dropped cf got %d, after %d, interleaved %d",
+          lens[k], msg_num, frames, peer_fc, clean, dropped, after, interleaved);
+  }
+  expect_len = 0;
+}
+
+static void test_loss(void)
+{
+  uint8_t payload[200];
+  long want = 0;
+
+  tx_reset();
+  for (int m = 0; m < LOSS_MSGS; m++)
+  {
+    int len = 2 + rand() % (sizeof(payload) - 2);
+
+    payload[0] = len;
+    payload[1] = rand();
+    for (int i = 2; i < len; i++)
+    {
+      payload[i] = payload[1] + i;
+    }
+    protocol_send(0x02, CMD_DATA, payload, len);
+    pump(1);
+  }
+  pump(10);
+  readdress_msgs();
+
+  got = bad = 0;
+  for (int m = 0; m < msg_num; m++)
+  {
+    want += !replay(m, -20, 0);
+  }
+  check((got == want) && (bad == 0) && (msg_num == LOSS_MSGS),
+        "loss 2%%: %d msgs, %ld without a lost frame, got %ld, corrupt %ld", msg_num, want, got, bad);
+}
+
+static void test_stall(void)
+{
+  int stalled;
+
+  tx_reset();
+  drv_accept = 40;
+  protocol_send(0x02, CMD_DATA, data, 2000);
+  pump(5);
+  stalled = (msg_num == 0);
+  drv_accept = -1;
+  pump(200);
+  check(stalled && (msg_num == 4), "stall: driver full after 40 frames, stalled %d, %d msgs after flush", stalled, msg_num);
+}
+
+static void test_burst(void)
+{
+  int before;
+  int in_isr;
+
+  tx_reset();
+  peer_fs = PEER_SILENT;
+  protocol_send(0x02, CMD_DATA, data, 400);
+  pump(1);
+  before = tx_num;
+  peer_fc_send(PROTOCOL_CANTP_FS_CTS);
+  in_isr = tx_num - before;
+  pump(1);
+  check((in_isr == PROTOCOL_CANTP_TX_BURST) && (msg_num == 1), "burst: %d frames sent in the cts isr, %d by the flush, %d msgs",
+        in_isr, tx_num - before - in_isr, msg_num);
+  peer_fs = PROTOCOL_CANTP_FS_CTS;
+}
+
+static void test_no_fc(void)
+{
+  struct protocol_cantp_stats before;
+  struct protocol_cantp_stats after;
+  uint32_t wait;
+
+  protocol_cantp_get_stats("c0", &before);
+  tx_reset();
+  peer_fs = PEER_SILENT;
+  protocol_send(0x02, CMD_DATA, data, 200);
+  pump(1);
+  wait = protocol_cantp_wait_time(protocol_p_get_time());
+  stub_tick += PROTOCOL_CANTP_TIMEOUT + 1;
+  pump(1);
+  protocol_cantp_get_stats("c0", &after);
+  check((wait == PROTOCOL_CANTP_TIMEOUT) && (after.tx_timeout == before.tx_timeout + 1),
+        "no fc: wait %u ms, tx_timeout +%u", wait, after.tx_timeout - before.tx_timeout);
+  peer_fs = PROTOCOL_CANTP_FS_CTS;
+}
+
+static void test_overflow(void)
+{
+  struct protocol_cantp_stats before;
+  struct protocol_cantp_stats after;
+
+  protocol_cantp_get_stats("c0", &before);
+  tx_reset();
+  peer_fs = PROTOCOL_CANTP_FS_OVFLW;
+  protocol_send(0x02, CMD_DATA, data, 200);
+  pump(5);
+  peer_fs = PROTOCOL_CANTP_FS_CTS;
+  protocol_send(0x02, CMD_DATA, data, 200);
+  pump(5);
+  protocol_cantp_get_stats("c0", &after);
+  check((after.tx_overflow == before.tx_overflow + 1) && (msg_num == 1),
+        "overflow: tx_overflow +%u, %d msgs after it", after.tx_overflow - before.tx_overflow, msg_num);
+}
+
+static void test_peer_wait(int waits)
+{
+  tx_reset();
+  peer_fs = PEER_SILENT;
+  protocol_send(0x02, CMD_DATA, data, 200);
+  pump(1);
+  for (int i = 0; i < waits; i++)
+  {
+    peer_fc_send(PROTOCOL_CANTP_FS_WAIT);
+    stub_tick += 15;
+    pump(1);
+  }
+  peer_fc_send(PROTOCOL_CANTP_FS_CTS);
+  pump(5);
+  check(msg_num == (waits <= PROTOCOL_CANTP_WAIT_MAX), "peer wait: %d waits over %d ms, %d msgs", waits, waits * 15, msg_num);
+  peer_fs = PROTOCOL_CANTP_FS_CTS;
+}
+
+static void test_refused_fc(void)
+{
+  uint8_t ff[8] = {PROTOCOL_CANTP_PCI_FF, 100, 1, 2, 3, 4, 5, 6};
+  uint8_t sf[2] = {PROTOCOL_CANTP_PCI_SF | 1, 0};
+  int refused;
+
+  tx_reset();
+  drv_accept = 0;
+  protocol_can_rcv_data(CAN_PORT, RX_ID, ff, sizeof(ff));
+  refused = fc_out[PROTOCOL_CANTP_FS_CTS];
+  drv_accept = -1;
+  protocol_cantp_flush();
+  check((refused == 0) && (fc_out[PROTOCOL_CANTP_FS_CTS] == 1),
+        "refused fc: %d cts while refused, %d after flush", refused, fc_out[PROTOCOL_CANTP_FS_CTS]);
+  protocol_can_rcv_data(CAN_PORT, RX_ID, sf, sizeof(sf)); /* end the message */
+}
+
+/* fill the receive FIFO so no message of len fits */
+static void rx_fifo_fill(int len)
+{
+  uint8_t junk[256];
+
+  memset(junk, 0x55, sizeof(junk));
+  while (fifo_s_free(&obj->rcvd.fifo) >= len)
+  {
+    fifo_s_puts(&obj->rcvd.fifo, (char *)junk, sizeof(junk));
+  }
+}
+
+static void test_wait_resend(void)
+{
+  uint8_t ff[8] = {PROTOCOL_CANTP_PCI_FF | (500 >> 8), 500 & 0xFF, 1, 2, 3, 4, 5, 6};
+  struct protocol_cantp_stats before;
+  struct protocol_cantp_stats after;
+  uint32_t t0 = stub_tick;
+  char times[128];
+  int pos = 0;
+
+  protocol_cantp_get_stats("c0", &before);
+  tx_reset();
+  rx_fifo_fill(500);
+  protocol_can_rcv_data(CAN_PORT, RX_ID, ff, sizeof(ff));
+  for (int ms = 0; ms < 200; ms++)
+  {
+    stub_tick++;
+    protocol_send_flush();
+  }
+  protocol_cantp_get_stats("c0", &after);
+  for (int i = 0; (i < fc_out[PROTOCOL_CANTP_FS_WAIT]) && (i < 32); i++)
+  {
+    pos += snprintf(times + pos, sizeof(times) - pos, "%s%u", i ? "," : "", fc_wait_time[i] - t0);
+  }
+  check((fc_out[PROTOCOL_CANTP_FS_WAIT] == PROTOCOL_CANTP_WAIT_MAX) && (after.rx_abort == before.rx_abort + 1),
+        "wait resend: %d waits at t=%s ms, rx_abort +%u", fc_out[PROTOCOL_CANTP_FS_WAIT], times,
+        after.rx_abort - before.rx_abort);
+  fifo_s_flush(&obj->rcvd.fifo);
+}
+
+/* the node's frames go straight back into the node */
+static void loop_run(void)
+{
+  while (tx_read < tx_num)
+  {
+    uint8_t *f = tx_frame[tx_read];
+    uint8_t len = tx_frame_len[tx_read++];
+
+    protocol_can_rcv_data(CAN_PORT, RX_ID, f, len);
+  }
+}
+
+static void test_loopback_hold(void)
+{
+  struct protocol_cantp_stats before;
+  struct protocol_cantp_stats after;
+
+  protocol_cantp_get_stats("c0", &before);
+  tx_reset();
+  expect_len = 500;
+  got = bad = 0;
+
+  protocol_local_info.address = 0x01;
+  protocol_send(0x02, CMD_DATA, data, 500);
+  protocol_send_flush();
+  protocol_local_info.address = 0x02;
+  rx_fifo_fill(600);
+
+  for (int ms = 0; ms < HOLD_MS; ms++)
+  {
+    loop_run();
+    stub_tick++;
+    protocol_send_flush();
+  }
+  fifo_s_flush(&obj->rcvd.fifo);
+  for (int ms = 0; ms < 50; ms++)
+  {
+    loop_run();
+    protocol_unpack_flush();
+    protocol_send_flush();
+    stub_tick++;
+  }
+  protocol_cantp_get_stats("c0", &after);
+  check((got == 1) && (bad == 0) && (after.tx_timeout == before.tx_timeout),
+        "loopback: fifo full %d ms, %d waits, got %ld, tx_timeout +%u, rx_abort +%u", HOLD_MS,
+        fc_out[PROTOCOL_CANTP_FS_WAIT], got, after.tx_timeout - before.tx_timeout, after.rx_abort - before.rx_abort);
+
+  protocol_local_info.address = 0x01;
+  expect_len = 0;
+}
+
+int main(void)
+{
+  srand(24);
+  for (int i = 0; i < (int)sizeof(data); i++)
+  {
+    data[i] = rand();
+  }
+  stub_tick = 1000;
+
+  protocol_local_init(0x01);
+  protocol_can_tp_interface_register("c0", 4096, 1, CAN_PORT, TX_ID, RX_ID, can_send);
+  protocol_set_route(0x02, "c0");
+  protocol_rcv_cmd_register(CMD_DATA, data_rcv);
+  obj = protocol_get_interface("c0");
+
+  test_transfer();
+  test_loss();
+  test_stall();
+  test_burst();
+  test_no_fc();
+  test_overflow();
+  test_peer_wait(PROTOCOL_CANTP_WAIT_MAX);
+  test_peer_wait(PROTOCOL_CANTP_WAIT_MAX + 1);
+  test_refused_fc();
+  test_wait_resend();
+  test_loopback_hold();
+
+  return fail;
+}
@@ -0,0 +1,14 @@
+/* host stub for tools/protocol_sim, the tick is stub_tick and signals only set bits */
+#ifndef STUB_OS_H
+#define STUB_OS_H
+#include <stdint.h>
+typedef void *osThreadId;
+extern uint32_t stub_tick;
+extern void *stub_thread;
+extern uint32_t stub_sig_bits;
+#define portTICK_PERIOD_MS 1
+#define osKernelSysTick() (stub_tick)
+#define osThreadGetId() (stub_thread)
+#define osSignalSet(t, s) (stub_sig_bits |= (s))
+#define osSignalWait(s, t) ((void)0)
+#endif
@@ -0,0 +1,111 @@
+/*
+ * Host micro-benchmark of command dispatch with 10, 50 and 200 registered commands.
+ *
+ * rcv: the receive callback of the node (protocol_rcv_pack_handle) on a small frame, for a
+ *      registered cmd picked at random and for a cmd that is not registered.
+ * send: protocol_get_send_cmd_info for a configured cmd picked at random.
+ *
+ * Commands are spread over the 0x02xx, 0x03xx and 0x04xx groups. A count above what the tree
+ * can hold is cut to the number that registered, printed as "reg". For 200, build against a
+ * copy of the tree with PROTOCOL_CMD_MAX_NUM (200) and PROTOCOL_CMD_HASH_BITS (9).
+ *
+ * Build and run from the repository root:
+ *
+ *   tools/protocol_sim/build.sh dispatch_bench && ./dispatch_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim.h"
+#include "protocol_transmit.h"
+
+#define LOOKUP_NUM     (4000000)
+#define PATTERN_NUM    (4096)
+
+extern local_info_t protocol_local_info;
+
+static uint16_t cmds[256];
+static int cmd_num;
+static uint16_t pattern[PATTERN_NUM];
+static uint8_t frame[64];
+static volatile long rcv_cnt;
+
+static int32_t cmd_rcv(uint8_t *buf, uint16_t len)
+{
+  rcv_cnt++;
+  return 0;
+}
+
+static uint16_t cmd_make(int i)
+{
+  return (uint16_t)(((0x02 + i % 3) << 8) | (i / 3 + 1));
+}
+
+static int cmd_add(uint16_t cmd)
+{
+  if (protocol_rcv_cmd_register(cmd, cmd_rcv) != PROTOCOL_SUCCESS)
+  {
+    return -1;
+  }
+#ifdef PROTOCOL_PRIORITY_NORMAL
+  return protocol_send_cmd_config(cmd, 0, 0, 0, PROTOCOL_PRIORITY_NORMAL, NULL, NULL);
+#else
+  return protocol_send_cmd_config(cmd, 0, 0, 0, NULL, NULL);
+#endif
+}
+
+static double rcv_ns(const uint16_t *cmd, int mask)
+{
+  double t0 = sim_now_ns();
+
+  for (long i = 0; i < LOOKUP_NUM; i++)
+  {
+    protocol_local_info.rcv_nor_callBack(frame, cmd[i & mask], 0, 0x02);
+  }
+  return (sim_now_ns() - t0) / LOOKUP_NUM;
+}
+
+static double send_ns(void)
+{
+  double t0 = sim_now_ns();
+  long found = 0;
+
+  for (long i = 0; i < LOOKUP_NUM; i++)
+  {
+    found += protocol_get_send_cmd_info(pattern[i & (PATTERN_NUM - 1)]) != NULL;
+  }
+  if (found != LOOKUP_NUM)
+  {
+    printf("send lookup missed %ld\n", LOOKUP_NUM - found);
+  }
+  return (sim_now_ns() - t0) / LOOKUP_NUM;
+}
+
+int main(void)
+{
+  const int want[] = {10, 50, 200};
+  protocol_pack_desc_t *head = (protocol_pack_desc_t *)frame;
+  uint16_t miss = 0x0500;
+
+  protocol_local_init(0x01);
+  head->data_len = PROTOCOL_PACK_HEAD_TAIL_SIZE + PROTOCOL_PACK_CMD_SIZE + 8;
+  srand(1);
+
+  for (int w = 0; w < 3; w++)
+  {
+    while ((cmd_num < want[w]) && (cmd_add(cmd_make(cmd_num)) == 0))
+    {
+      cmds[cmd_num] = cmd_make(cmd_num);
+      cmd_num++;
+    }
+    for (int i = 0; i < PATTERN_NUM; i++)
+    {
+      pattern[i] = cmds[rand() % cmd_num];
+    }
+
+    printf("%3d cmds (reg %3d): rcv hit %5.1f ns, rcv miss %5.1f ns, send lookup %5.1f ns\n",
+           want[w], cmd_num, rcv_ns(pattern, PATTERN_NUM - 1), rcv_ns(&miss, 0), send_ns());
+  }
+
+  return 0;
+}
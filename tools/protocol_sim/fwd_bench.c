@@ -0,0 +1,134 @@
+/*
+ * Host benchmark of frame forwarding. The node 0x01 has two uart interfaces, a (route to
+ * 0x02) and b (route to 0x03), and receives on a a 38 byte frame from 0x02 to 0x03, or to
+ * the broadcast address with the argument "broadcast".
+ *
+ * latency:     one frame at a time through protocol_rcv_data, protocol_unpack_flush and
+ *              protocol_send_flush, as the communicate task does after a receive signal.
+ *              ns from protocol_rcv_data to the send call of b.
+ * throughput:  bursts of 64 frames, then one unpack and one send flush.
+ * unpack only: frames that leave on b during protocol_unpack_flush, before any send flush.
+ * pending ack: the same with one reliable frame to 0x03 sent and waiting for its ack. It
+ *              must not hold the forwarded frames back.
+ *
+ * Build and run from the repository root:
+ *
+ *   tools/protocol_sim/build.sh fwd_bench && ./fwd_bench [broadcast]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "protocol_transmit.h"
+
+#define FRAME_NUM      (200000)
+#define BURST          (64)
+#define CMD_FWD        (0x0303)
+#define CMD_RELIABLE   (0x0401)
+
+static long out_frames;
+static double lat_sum;
+static long lat_num;
+static double t_in;
+
+static int a_send(uint8_t *p_data, uint32_t len)
+{
+  return len;
+}
+
+static int b_send(uint8_t *p_data, uint32_t len)
+{
+  uint32_t off = 0;
+
+  while (off + PROTOCOL_PACK_HEAD_SIZE <= len)
+  {
+    uint16_t frame_len = sim_frame_len(p_data + off);
+
+    if (frame_len == 0)
+    {
+      break;
+    }
+    out_frames++;
+    off += frame_len;
+  }
+  lat_sum += sim_now_ns() - t_in;
+  lat_num++;
+  return len;
+}
+
+static void build_frame(uint8_t *f, uint8_t reciver)
+{
+  protocol_pack_desc_t *head = (protocol_pack_desc_t *)f;
+  uint16_t cmd = CMD_FWD;
+
+  memset(f, 0, PROTOCOL_PACK_HEAD_SIZE + 2 + 20 + PROTOCOL_PACK_TAIL_SIZE);
+  head->sof = PROTOCOL_HEADER;
+  head->data_len = PROTOCOL_PACK_HEAD_SIZE + 2 + 20 + PROTOCOL_PACK_TAIL_SIZE;
+  memcpy(f + PROTOCOL_PACK_HEAD_SIZE, &cmd, sizeof(cmd));
+  sim_frame_readdress(f, 0x02, reciver);
+}
+
+static long unpack_only(struct perph_interface *a, const uint8_t *f)
+{
+  out_frames = 0;
+  for (int i = 0; i < 10; i++)
+  {
+    protocol_rcv_data((void *)f, sim_frame_len(f), a);
+  }
+  protocol_unpack_flush();
+  return out_frames;
+}
+
+int main(int argc, char **argv)
+{
+  uint8_t f[64];
+  uint8_t payload[4] = {0};
+  struct perph_interface *a;
+  struct perph_interface *b;
+  long pending;
+  double t0;
+
+  protocol_local_init(0x01);
+  protocol_uart_interface_register("a", 4096, 1, 0, a_send);
+  protocol_uart_interface_register("b", 4096, 1, 1, b_send);
+  protocol_set_route(0x02, "a");
+  protocol_set_route(0x03, "b");
+  a = protocol_get_interface("a");
+  b = protocol_get_interface("b");
+  build_frame(f, ((argc > 1) && !strcmp(argv[1], "broadcast")) ? PROTOCOL_BROADCAST_ADDR : 0x03);
+
+  for (int k = 0; k < FRAME_NUM; k++)
+  {
+    t_in = sim_now_ns();
+    protocol_rcv_data(f, sim_frame_len(f), a);
+    protocol_unpack_flush();
+    protocol_send_flush();
+  }
+  printf("latency:     %.0f ns per frame, %ld frames out\n", lat_sum / lat_num, out_frames);
+
+  out_frames = 0;
+  t0 = sim_now_ns();
+  for (int k = 0; k < FRAME_NUM / BURST; k++)
+  {
+    for (int j = 0; j < BURST; j++)
+    {
+      protocol_rcv_data(f, sim_frame_len(f), a);
+    }
+    protocol_unpack_flush();
+    protocol_send_flush();
+  }
+  printf("throughput:  %.2f M frames/s, %ld frames out\n", out_frames / (sim_now_ns() - t0) * 1e3, out_frames);
+
+  printf("unpack only: %ld/10 frames out\n", unpack_only(a, f));
+  protocol_send_flush();
+
+  protocol_send_cmd_config(CMD_RELIABLE, 3, 1000, 1, PROTOCOL_PRIORITY_NORMAL, NULL, NULL);
+  protocol_send(0x03, CMD_RELIABLE, payload, sizeof(payload));
+  protocol_send_flush();
+  pending = unpack_only(a, f);
+  printf("pending ack: %u waiting, %ld/10 frames out\n", b->send.resend_num, pending);
+  protocol_send_flush();
+
+  return 0;
+}
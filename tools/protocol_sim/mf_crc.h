@@ -0,0 +1,2 @@
+/* host stub for tools/protocol_sim, mf_crc.c includes its header in lower case */
+#include "MF_CRC.h"
@@ -0,0 +1,177 @@
+/*
+ * Host benchmark of the protocol allocator: protocol_p_malloc/free (size class pool with
+ * heap fallback) against heap_malloc/free alone, both on the real components/support code.
+ *
+ * The workload models one node for TICKS ticks of 1 ms. Each tick it packs 1..6 frames, of
+ * which 30% are reliable and stay allocated until their ack 1..20 ticks later. It also builds
+ * one ack reply and forwards one received frame per tick on average, and frees everything
+ * unreliable at the end of the tick, like protocol_send_flush. Payloads are 70% 4..24 bytes,
+ * 25% 25..200 bytes and 5% 201..PROTOCOL_MAX_DATA_LEN bytes. Block sizes use the STM32 send
+ * node size so the pool classes see the same sizes as on the target.
+ *
+ * Prints ns per malloc + free pair, failed allocations, the lowest free heap seen and how
+ * much of the pool traffic fell back to the heap.
+ *
+ * Build and run from the repository root:
+ *
+ *   tools/protocol_sim/build.sh pool_bench && ./pool_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim.h"
+
+#define TICKS          (200000)
+#define NODE_SIZE      (52) /* sizeof(send_list_node_t) on the STM32 */
+#define FRAME_SIZE(n)  (NODE_SIZE + PROTOCOL_PACK_HEAD_TAIL_SIZE + PROTOCOL_PACK_CMD_SIZE + (n))
+#define LIVE_MAX       (4096)
+
+struct alloc_ops
+{
+  const char *name;
+  void *(*malloc_fn)(uint32_t size);
+  void (*free_fn)(void *ptr);
+};
+
+static struct
+{
+  void *ptr;
+  uint32_t free_tick; /* freed at the end of this tick */
+} live[LIVE_MAX];
+static int live_num;
+
+static long alloc_num, fail_num;
+static uint32_t heap_free_min;
+
+static uint32_t payload_len(void)
+{
+  int r = rand() % 100;
+
+  if (r < 70)
+  {
+    return 4 + rand() % 21;
+  }
+  if (r < 95)
+  {
+    return 25 + rand() % 176;
+  }
+  return 201 + rand() % (PROTOCOL_MAX_DATA_LEN - 200);
+}
+
+static void frame_alloc(const struct alloc_ops *ops, uint32_t size, uint32_t free_tick)
+{
+  void *ptr;
+
+  alloc_num++;
+  ptr = ops->malloc_fn(size);
+  if ((ptr == NULL) || (live_num == LIVE_MAX))
+  {
+    fail_num++;
+    if (ptr != NULL)
+    {
+      ops->free_fn(ptr);
+    }
+    return;
+  }
+  live[live_num].ptr = ptr;
+  live[live_num].free_tick = free_tick;
+  live_num++;
+}
+
+/* free what is due at the end of tick t, everything when t is 0xFFFFFFFF */
+static void frame_release(const struct alloc_ops *ops, uint32_t t)
+{
+  int k = 0;
+
+  for (int i = 0; i < live_num; i++)
+  {
+    if (live[i].free_tick <= t)
+    {
+      ops->free_fn(live[i].ptr);
+    }
+    else
+    {
+      live[k++] = live[i];
+    }
+  }
+  live_num = k;
+}
+
+static void run(const struct alloc_ops *ops)
+{
+  struct mem_pool *pool = protocol_p_get_mem_pool();
+  long fallback = 0;
+  double t0;
+  double dt;
+
+  srand(1);
+  alloc_num = fail_num = 0;
+  heap_free_min = heap_get_free();
+  if (pool != NULL)
+  {
+    mem_pool_reset_stats(pool);
+  }
+
+  t0 = sim_now_ns();
+  for (uint32_t t = 1; t <= TICKS; t++)
+  {
+    int frames = 1 + rand() % 6;
+
+    for (int i = 0; i < frames; i++)
+    {
+      uint32_t len = payload_len();
+      uint32_t due = (rand() % 10 < 3) ? t + 1 + rand() % 20 : t;
+
+      frame_alloc(ops, FRAME_SIZE(len), due);
+    }
+    if (rand() % 2)
+    {
+      frame_alloc(ops, FRAME_SIZE(4), t);
+    }
+    if (rand() % 2)
+    {
+      frame_alloc(ops, FRAME_SIZE(payload_len()), t);
+    }
+    frame_release(ops, t);
+    if (heap_get_free() < heap_free_min)
+    {
+      heap_free_min = heap_get_free();
+    }
+  }
+  dt = sim_now_ns() - t0;
+  frame_release(ops, 0xFFFFFFFF);
+
+  if ((pool != NULL) && (ops->malloc_fn == protocol_p_malloc))
+  {
+    for (int i = 0; i < pool->cls_num; i++)
+    {
+      fallback += pool->cls[i].fail_cnt;
+    }
+  }
+
+  printf("%-22s %6.1f ns per malloc+free, %ld allocs, %ld failed, heap free min %5u of %u, %ld fell back to heap\n",
+         ops->name, dt / alloc_num, alloc_num, fail_num, heap_free_min, heap_get_free(), fallback);
+}
+
+int main(void)
+{
+  const struct alloc_ops heap_ops = {"heap_malloc", heap_malloc, heap_free};
+  const struct alloc_ops pool_ops = {"protocol_p_malloc", protocol_p_malloc, protocol_p_free};
+  struct mem_pool *pool;
+
+  protocol_p_mem_init();
+  /* the heap sets itself up on the first call */
+  heap_free(heap_malloc(8));
+
+  run(&heap_ops);
+  run(&pool_ops);
+
+  pool = protocol_p_get_mem_pool();
+  for (int i = 0; (pool != NULL) && (i < pool->cls_num); i++)
+  {
+    printf("  class %3u x %2u: max used %2u, allocs %7u, empty %5u\n", pool->cls[i].block_size,
+           pool->cls[i].block_num, pool->cls[i].max_used_num, pool->cls[i].alloc_cnt, pool->cls[i].fail_cnt);
+  }
+
+  return 0;
+}
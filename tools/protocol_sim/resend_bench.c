@@ -0,0 +1,168 @@
+/*
+ * Host check and benchmark of the resend scheduling in protocol_send_flush.
+ *
+ * resend: one reliable frame (3 sends, 10 ms timeout) to a peer that never acks. The clock
+ *         steps 1 ms at a time with a flush each step, and every send and the no_ack
+ *         callback are printed with their time.
+ * ack:    one reliable frame, then the peer's ack is built by the node itself as the peer
+ *         and received. The ack callback must run and the session must be free again.
+ * bench:  31 reliable frames waiting for their acks on each of 5 interfaces, 155 in all,
+ *         with a long timeout, then ns per protocol_send_flush when nothing is due.
+ *
+ * Where protocol_send_wait_time exists the wait it returns is printed after each send.
+ *
+ * Build and run from the repository root:
+ *
+ *   tools/protocol_sim/build.sh resend_bench && ./resend_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim.h"
+#include "protocol_transmit.h"
+
+#define FLUSH_NUM      (2000000)
+#define CMD_RESEND     (0x0500)
+#define CMD_BENCH      (0x0501)
+
+extern local_info_t protocol_local_info;
+
+static uint8_t cap[4096];
+static uint32_t cap_len;
+static long sends;
+static int acked;
+static int noack;
+
+static int com_send(uint8_t *p_data, uint32_t len)
+{
+  if (cap_len + len <= sizeof(cap))
+  {
+    memcpy(cap + cap_len, p_data, len);
+    cap_len += len;
+  }
+  sends++;
+  return len;
+}
+
+static void on_ack(int32_t result)
+{
+  acked++;
+}
+
+static void on_noack(uint16_t cmd)
+{
+  noack++;
+  printf("  t=%u no_ack\n", stub_tick);
+}
+
+static void print_wait(void)
+{
+#ifdef PROTOCOL_WAIT_FOREVER
+  uint32_t wait = protocol_send_wait_time();
+
+  if (wait == PROTOCOL_WAIT_FOREVER)
+  {
+    printf(", wait forever");
+  }
+  else
+  {
+    printf(", wait %u ms", wait);
+  }
+#endif
+  printf("\n");
+}
+
+static void test_resend(void)
+{
+  uint8_t payload[20] = {0};
+  long last = 0;
+
+  printf("resend:\n");
+  stub_tick = 100;
+  protocol_send(0x10, CMD_RESEND, payload, sizeof(payload));
+  for (; stub_tick < 160; stub_tick++)
+  {
+    protocol_send_flush();
+    if (sends != last)
+    {
+      printf("  t=%u send %ld", stub_tick, sends);
+      print_wait();
+      last = sends;
+    }
+  }
+  printf("  %ld sends, no_ack %d, %u nodes left\n", sends, noack,
+         protocol_local_info.interface[0].send.normal_node_num);
+}
+
+static void test_ack(void)
+{
+  uint8_t payload[20] = {0};
+  struct perph_interface *obj = protocol_get_interface("u0");
+  protocol_pack_desc_t head;
+  int32_t result = 0;
+
+  cap_len = 0;
+  protocol_send(0x10, CMD_RESEND, payload, sizeof(payload));
+  protocol_send_flush();
+  memcpy(&head, cap, sizeof(head));
+
+  /* the ack of the peer, captured and received by the node */
+  cap_len = 0;
+  protocol_local_info.address = 0x10;
+  protocol_ack(0x01, head.session, &result, sizeof(result), head.seq_num);
+  protocol_send_flush();
+  protocol_local_info.address = 0x01;
+  protocol_rcv_data(cap, cap_len, obj);
+  protocol_unpack_flush();
+  protocol_send_flush();
+
+  printf("ack: acked %d, session %u %s, %u nodes left\n", acked, head.session,
+         protocol_s_session_get_node(obj, 0x10, head.session) ? "busy" : "free",
+         obj->send.normal_node_num);
+}
+
+static void bench(void)
+{
+  uint8_t payload[20] = {0};
+  int out = 0;
+  double t0;
+
+  for (int i = 0; i < 5; i++)
+  {
+    for (int k = 0; k < 31; k++)
+    {
+      out += protocol_send(0x10 + i, CMD_BENCH, payload, sizeof(payload)) == 0;
+    }
+  }
+  protocol_send_flush();
+
+  t0 = sim_now_ns();
+  for (long n = 0; n < FLUSH_NUM; n++)
+  {
+    cap_len = 0;
+    protocol_send_flush();
+  }
+  printf("bench: %d outstanding, %.1f ns per idle flush\n", out, (sim_now_ns() - t0) / FLUSH_NUM);
+}
+
+int main(void)
+{
+  char name[3] = "u0";
+
+  protocol_local_init(0x01);
+  for (int i = 0; i < 5; i++)
+  {
+    name[1] = '0' + i;
+    protocol_uart_interface_register(name, 4096, 1, 0, com_send);
+    protocol_set_route(0x10 + i, name);
+  }
+  protocol_set_route(0x01, "u0"); /* for the ack sent as the peer */
+  protocol_send_cmd_config(CMD_RESEND, 3, 10, 1, PROTOCOL_PRIORITY_NORMAL, on_ack, on_noack);
+  protocol_send_cmd_config(CMD_BENCH, 3, 60000, 1, PROTOCOL_PRIORITY_NORMAL, NULL, NULL);
+
+  test_resend();
+  test_ack();
+  bench();
+
+  return (noack != 1) || (acked != 1);
+}
@@ -0,0 +1,323 @@
+/*
+ * Host fuzz and resync harness for the receive unpacker (protocol_s_find_pack_header and the
+ * header/frame checks behind it). Frames are built by the node itself, then the node takes
+ * address 0x02 and receives them on a uart interface with a 1024 byte receive FIFO.
+ *
+ * wrap:   a 60 byte frame placed at every offset across the FIFO end, fed whole and fed in
+ *         two parts cut at the wrap, with junk before it to move the write pointer.
+ * crc16:  every single bit flip in the 12 header bytes, each corrupted frame followed by a
+ *         good one, only the good one may arrive.
+ * crc32:  a bit flip in the cmd or payload, the frame is dropped and the next one arrives.
+ * fuzz:   a stream of frames with random bit flips, dropped bytes and inserted sof bytes.
+ *         No delivered payload may be corrupt, then clean frames after MAX frame of junk
+ *         must all arrive.
+ * bench:  16 MB of random noise in 512 byte chunks, and frames mixed with junk and pseudo
+ *         headers, as resync MB/s and frames/s.
+ *
+ * Every payload carries its length and a seed so the receiver can check it. Exits non zero
+ * when a check fails.
+ *
+ * Build and run from the repository root:
+ *
+ *   tools/protocol_sim/build.sh resync_fuzz && ./resync_fuzz
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim.h"
+#include "protocol_transmit.h"
+
+#define FIFO_SIZE      (1024)
+#define FRAME_NUM      (256)
+#define FUZZ_FRAMES    (200000)
+#define CMD_DATA       (0x0101)
+
+extern local_info_t protocol_local_info;
+
+static uint8_t frames[FRAME_NUM][PROTOCOL_FRAME_MAX_SIZE];
+static uint16_t frame_len[FRAME_NUM];
+
+static uint8_t *cap;
+static uint32_t cap_len;
+
+static long got;
+static long corrupt;
+static int fail;
+
+static struct perph_interface *obj;
+
+static int com_send(uint8_t *p_data, uint32_t len)
+{
+  memcpy(cap + cap_len, p_data, len);
+  cap_len += len;
+  return len;
+}
+
+/* payload: length, seed, then seed + i */
+static int32_t data_rcv(uint8_t *buf, uint16_t len)
+{
+  got++;
+  if ((len < 2) || (buf[0] != (uint8_t)len))
+  {
+    corrupt++;
+    return 0;
+  }
+  for (int i = 2; i < len; i++)
+  {
+    if (buf[i] != (uint8_t)(buf[1] + i))
+    {
+      corrupt++;
+      break;
+    }
+  }
+  return 0;
+}
+
+static void build_frames(void)
+{
+  uint8_t payload[PROTOCOL_MAX_DATA_LEN];
+
+  protocol_local_info.address = 0x01;
+  for (int n = 0; n < FRAME_NUM; n++)
+  {
+    int len = (n == 0) ? 40 : 2 + rand() % 200;
+
+    payload[0] = len;
+    payload[1] = rand();
+    for (int i = 2; i < len; i++)
+    {
+      payload[i] = payload[1] + i;
+    }
+    cap = frames[n];
+    cap_len = 0;
+    protocol_send(0x02, CMD_DATA, payload, len);
+    protocol_send_flush();
+    frame_len[n] = cap_len;
+  }
+  protocol_local_info.address = 0x02;
+}
+
+static void feed(const uint8_t *p, uint32_t len)
+{
+  protocol_rcv_data((void *)p, len, obj);
+  protocol_unpack_flush();
+}
+
+/* junk without a sof */
+static void feed_junk(uint32_t len)
+{
+  uint8_t junk[FIFO_SIZE];
+
+  for (uint32_t i = 0; i < len; i++)
+  {
+    junk[i] = rand() % 0xAA;
+  }
+  while (len > 0)
+  {
+    uint32_t n = (len > FIFO_SIZE / 2) ? FIFO_SIZE / 2 : len;
+
+    feed(junk, n);
+    len -= n;
+  }
+}
+
+static void check(const char *name, long want_got, long want_corrupt)
+{
+  printf("%-6s got %ld (want %ld), corrupt %ld\n", name, got, want_got, corrupt);
+  if ((got != want_got) || (corrupt > want_corrupt))
+  {
+    printf("FAIL %s\n", name);
+    fail = 1;
+  }
+  got = corrupt = 0;
+}
+
+static void test_wrap(void)
+{
+  const uint8_t *f = frames[0];
+  const uint32_t len = frame_len[0];
+  long sent = 0;
+
+  for (uint32_t split = 1; split < len; split++)
+  {
+    for (int cut = 0; cut < 2; cut++)
+    {
+      uint32_t pos = obj->rcvd.fifo.p_write_addr - obj->rcvd.fifo.p_start_addr;
+
+      /* move the write pointer so the frame starts split bytes before the end */
+      feed_junk((FIFO_SIZE - split - pos + FIFO_SIZE) % FIFO_SIZE);
+      if (cut)
+      {
+        feed(f, split);
+        feed(f + split, len - split);
+      }
+      else
+      {
+        feed(f, len);
+      }
+      sent++;
+    }
+  }
+  check("wrap", sent, 0);
+}
+
+static void test_crc16(void)
+{
+  uint8_t bad[PROTOCOL_FRAME_MAX_SIZE];
+  long sent = 0;
+
+  for (int byte = 1; byte < PROTOCOL_PACK_HEAD_SIZE; byte++)
+  {
+    for (int bit = 0; bit < 8; bit++)
+    {
+      memcpy(bad, frames[1], frame_len[1]);
+      bad[byte] ^= 1u << bit;
+      feed(bad, frame_len[1]);
+      feed(frames[2], frame_len[2]);
+      sent++;
+    }
+  }
+  check("crc16", sent, 0);
+}
+
+static void test_crc32(void)
+{
+  uint8_t bad[PROTOCOL_FRAME_MAX_SIZE];
+  long sent = 0;
+
+  for (uint32_t byte = PROTOCOL_PACK_HEAD_SIZE; byte < frame_len[3] - PROTOCOL_PACK_TAIL_SIZE; byte++)
+  {
+    memcpy(bad, frames[3], frame_len[3]);
+    bad[byte] ^= 1u << (byte % 8);
+    feed(bad, frame_len[3]);
+    feed(frames[4], frame_len[4]);
+    sent++;
+  }
+  check("crc32", sent, 0);
+}
+
+static void test_fuzz(void)
+{
+  static uint8_t buf[PROTOCOL_FRAME_MAX_SIZE * 2];
+  long damaged = 0;
+  long sent = 0;
+
+  for (long n = 0; n < FUZZ_FRAMES; n++)
+  {
+    const uint8_t *f = frames[rand() % FRAME_NUM];
+    uint32_t len = sim_frame_len(f);
+    uint32_t out = 0;
+    int hit = 0;
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+      int r = rand() % 4000;
+
+      if (r == 0)
+      {
+        continue; /* dropped */
+      }
+      buf[out++] = (r == 1) ? f[i] ^ (1u << (rand() % 8)) : f[i];
+      if (r == 2)
+      {
+        buf[out++] = PROTOCOL_HEADER;
+      }
+      hit |= (r < 3);
+    }
+    damaged += hit;
+    feed(buf, out);
+  }
+  printf("fuzz   %d frames, %ld damaged, got %ld, corrupt %ld\n", FUZZ_FRAMES, damaged, got, corrupt);
+  if ((corrupt != 0) || (got > FUZZ_FRAMES) || (got < FUZZ_FRAMES - 3 * damaged))
+  {
+    printf("FAIL fuzz\n");
+    fail = 1;
+  }
+  got = corrupt = 0;
+
+  /* a header that survived may still wait for up to one max frame of data */
+  feed_junk(PROTOCOL_FRAME_MAX_SIZE);
+  for (int n = 0; n < 100; n++)
+  {
+    feed(frames[n], frame_len[n]);
+    sent++;
+  }
+  check("after", sent, 0);
+}
+
+static void bench(void)
+{
+  const size_t noise_len = 16u << 20;
+  uint8_t *noise = malloc(noise_len);
+  uint8_t *mixed = malloc(noise_len);
+  size_t mixed_len = 0;
+  long mixed_frames = 0;
+  double t0;
+  double dt;
+
+  for (size_t i = 0; i < noise_len; i++)
+  {
+    noise[i] = rand();
+  }
+
+  t0 = sim_now_ns();
+  for (size_t off = 0; off < noise_len; off += 512)
+  {
+    feed(noise + off, 512);
+  }
+  dt = sim_now_ns() - t0;
+  printf("noise  %.0f MB/s resync, got %ld\n", noise_len / dt * 1e3, got);
+  got = corrupt = 0;
+
+  /* frames with up to 64 bytes of junk between them, a quarter of it sof */
+  while (mixed_len + 2 * PROTOCOL_FRAME_MAX_SIZE < noise_len)
+  {
+    int n = rand() % FRAME_NUM;
+    int k = rand() % 65;
+
+    memcpy(mixed + mixed_len, frames[n], frame_len[n]);
+    mixed_len += frame_len[n];
+    mixed_frames++;
+    for (int i = 0; i < k; i++)
+    {
+      mixed[mixed_len++] = (rand() % 4 == 0) ? PROTOCOL_HEADER : rand();
+    }
+  }
+
+  t0 = sim_now_ns();
+  for (size_t off = 0; off < mixed_len; off += 512)
+  {
+    feed(mixed + off, (mixed_len - off > 512) ? 512 : mixed_len - off);
+  }
+  dt = sim_now_ns() - t0;
+  printf("mixed  %.2f M frames/s, %.0f MB/s, got %ld/%ld, corrupt %ld\n", got / dt * 1e3, mixed_len / dt * 1e3,
+         got, mixed_frames, corrupt);
+  if ((got < mixed_frames * 99 / 100) || (corrupt != 0))
+  {
+    printf("FAIL mixed\n");
+    fail = 1;
+  }
+  got = corrupt = 0;
+
+  free(noise);
+  free(mixed);
+}
+
+int main(void)
+{
+  srand(5);
+  protocol_local_init(0x01);
+  protocol_uart_interface_register("u0", FIFO_SIZE, 1, 0, com_send);
+  protocol_set_route(0x02, "u0");
+  protocol_rcv_cmd_register(CMD_DATA, data_rcv);
+  obj = protocol_get_interface("u0");
+
+  build_frames();
+  test_wrap();
+  test_crc16();
+  test_crc32();
+  test_fuzz();
+  bench();
+
+  return fail;
+}
@@ -0,0 +1,157 @@
+/*
+ * Host benchmark of the receive path: a captured byte stream is fed through protocol_rcv_data
+ * in random chunks of 1..700 bytes, each chunk followed by protocol_unpack_flush, the way
+ * the usb and uart receive callbacks hand data to the protocol task.
+ *
+ * The stream is captured from the node itself: FRAMES frames of 1..200 random bytes sent to
+ * 0x02 through a uart interface whose send function appends to a buffer. Then the node takes
+ * address 0x02 and receives it REPS times. In the noisy run up to NOISE bytes of junk, a
+ * quarter of them 0xAA (the sof), go between frames. Every payload is checked.
+ *
+ * Build and run from the repository root:
+ *
+ *   tools/protocol_sim/build.sh rx_bench && ./rx_bench [frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim.h"
+#include "protocol_transmit.h"
+
+#define FRAMES_MAX     (100000)
+#define REPS           (10)
+#define NOISE          (32)
+#define CMD_DATA       (0x0101)
+
+extern local_info_t protocol_local_info;
+
+static uint8_t *cap;
+static size_t cap_len;
+static size_t cap_size;
+
+static uint8_t expect_seed[FRAMES_MAX];
+static uint16_t expect_len[FRAMES_MAX];
+static long got;
+static long bad;
+
+static int com_send(uint8_t *p_data, uint32_t len)
+{
+  if (cap_len + len > cap_size)
+  {
+    cap_size = (cap_len + len) * 2;
+    cap = realloc(cap, cap_size);
+  }
+  memcpy(cap + cap_len, p_data, len);
+  cap_len += len;
+  return len;
+}
+
+static int32_t data_rcv(uint8_t *buf, uint16_t len)
+{
+  if (len != expect_len[got])
+  {
+    bad++;
+  }
+  else
+  {
+    for (int i = 0; i < len; i++)
+    {
+      if (buf[i] != (uint8_t)(expect_seed[got] + i))
+      {
+        bad++;
+        break;
+      }
+    }
+  }
+  got++;
+  return 0;
+}
+
+static void capture(long frames, int noise)
+{
+  uint8_t payload[200];
+  uint8_t junk[NOISE];
+
+  protocol_local_info.address = 0x01;
+  cap_len = 0;
+  for (long n = 0; n < frames; n++)
+  {
+    int len = 1 + rand() % sizeof(payload);
+    uint8_t seed = rand();
+
+    for (int i = 0; i < len; i++)
+    {
+      payload[i] = seed + i;
+    }
+    expect_seed[n] = seed;
+    expect_len[n] = len;
+    protocol_send(0x02, CMD_DATA, payload, len);
+    protocol_send_flush();
+
+    if (noise)
+    {
+      int k = rand() % (noise + 1);
+
+      for (int i = 0; i < k; i++)
+      {
+        junk[i] = (rand() % 4 == 0) ? PROTOCOL_HEADER : rand();
+      }
+      com_send(junk, k);
+    }
+  }
+}
+
+static void run(const char *name, long frames, int noise)
+{
+  struct perph_interface *obj = protocol_get_interface("u0");
+  double t0;
+  double dt;
+
+  srand(1);
+  capture(frames, noise);
+  protocol_local_info.address = 0x02;
+
+  t0 = sim_now_ns();
+  for (int r = 0; r < REPS; r++)
+  {
+    size_t off = 0;
+
+    got = bad = 0;
+    while (off < cap_len)
+    {
+      size_t chunk = 1 + rand() % 700;
+
+      if (chunk > cap_len - off)
+      {
+        chunk = cap_len - off;
+      }
+      protocol_rcv_data(cap + off, chunk, obj);
+      protocol_unpack_flush();
+      off += chunk;
+    }
+  }
+  dt = (sim_now_ns() - t0) / 1e9;
+
+  printf("%-5s %.2f MB stream: got %ld/%ld bad %ld, %.2f M frames/s, %.1f MB/s\n", name, cap_len / 1e6,
+         got, frames, bad, got * REPS / dt / 1e6, cap_len * REPS / dt / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+  long frames = (argc > 1) ? atol(argv[1]) : 20000;
+
+  if (frames > FRAMES_MAX)
+  {
+    frames = FRAMES_MAX;
+  }
+
+  protocol_local_init(0x01);
+  protocol_uart_interface_register("u0", 4096, 1, 0, com_send);
+  protocol_set_route(0x02, "u0");
+  protocol_rcv_cmd_register(CMD_DATA, data_rcv);
+
+  run("clean", frames, 0);
+  run("noisy", frames, NOISE);
+
+  return 0;
+}
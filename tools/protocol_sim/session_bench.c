@@ -0,0 +1,109 @@
+/*
+ * Host benchmark of the ack session lookup, protocol_s_session_get_node. The whole call runs
+ * with interrupts masked on the target, so its length is the IRQ-off window of every
+ * received ack.
+ *
+ * N reliable frames (N up to PROTOCOL_SESSION_MAX) are sent to one peer and flushed so they
+ * wait for their acks, then Q unreliable frames are queued on the same interface without a
+ * flush. Sessions 1..31 are looked up in turn, a session with a frame in flight is a hit and
+ * any other is a miss. The miss is the longest walk of the old list scan.
+ *
+ * Build and run from the repository root:
+ *
+ *   tools/protocol_sim/build.sh session_bench && ./session_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim.h"
+#include "protocol_transmit.h"
+
+#define LOOKUP_NUM     (2000000)
+#define PEER_ADDR      (0x02)
+#define CMD_RELIABLE   (0x0501)
+#define CMD_PLAIN      (0x0502)
+
+#ifndef PROTOCOL_SESSION_MAX
+#define PROTOCOL_SESSION_MAX (31)
+#endif
+
+static int com_send(uint8_t *p_data, uint32_t len)
+{
+  return len;
+}
+
+static void cmd_config(uint16_t cmd, uint8_t ack)
+{
+#ifdef PROTOCOL_PRIORITY_NORMAL
+  protocol_send_cmd_config(cmd, ack ? 3 : 0, 60000, ack, PROTOCOL_PRIORITY_NORMAL, NULL, NULL);
+#else
+  protocol_send_cmd_config(cmd, ack ? 3 : 0, 60000, ack, NULL, NULL);
+#endif
+}
+
+static void run(struct perph_interface *obj, int n, int q)
+{
+  uint8_t payload[20] = {0};
+  uint8_t hit[PROTOCOL_SESSION_MAX + 1];
+  long hit_num = 0;
+  double hit_ns = 0;
+  double miss_ns = 0;
+
+  for (int i = 0; i < n; i++)
+  {
+    protocol_send(PEER_ADDR, CMD_RELIABLE, payload, sizeof(payload));
+  }
+  protocol_send_flush();
+  for (int i = 0; i < q; i++)
+  {
+    protocol_send(PEER_ADDR, CMD_PLAIN, payload, sizeof(payload));
+  }
+  for (int s = 1; s <= PROTOCOL_SESSION_MAX; s++)
+  {
+    hit[s] = protocol_s_session_get_node(obj, PEER_ADDR, s) != NULL;
+    hit_num += hit[s];
+  }
+
+  for (int s = 1; s <= PROTOCOL_SESSION_MAX; s++)
+  {
+    double t0 = sim_now_ns();
+
+    for (long i = 0; i < LOOKUP_NUM / PROTOCOL_SESSION_MAX; i++)
+    {
+      protocol_s_session_get_node(obj, PEER_ADDR, s);
+    }
+    if (hit[s])
+    {
+      hit_ns += sim_now_ns() - t0;
+    }
+    else
+    {
+      miss_ns += sim_now_ns() - t0;
+    }
+  }
+
+  printf("%2ld in flight, %3d queued: hit %6.1f ns, miss %6.1f ns\n", hit_num, q,
+         hit_num ? hit_ns / hit_num / (LOOKUP_NUM / PROTOCOL_SESSION_MAX) : 0.0,
+         (hit_num < PROTOCOL_SESSION_MAX) ? miss_ns / (PROTOCOL_SESSION_MAX - hit_num) / (LOOKUP_NUM / PROTOCOL_SESSION_MAX) : 0.0);
+}
+
+int main(void)
+{
+  const int cases[][2] = {{1, 0}, {8, 0}, {30, 0}, {8, 64}, {30, 64}};
+  char name[3] = "u0";
+
+  protocol_local_init(0x01);
+  cmd_config(CMD_RELIABLE, 1);
+  cmd_config(CMD_PLAIN, 0);
+
+  /* a fresh interface per case, so sessions and queues start empty */
+  for (int k = 0; k < 5; k++)
+  {
+    name[1] = '0' + k;
+    protocol_uart_interface_register(name, 4096, 1, k, com_send);
+    protocol_set_route(PEER_ADDR, name);
+    run(protocol_get_interface(name), cases[k][0], cases[k][1]);
+  }
+
+  return 0;
+}
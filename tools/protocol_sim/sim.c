@@ -0,0 +1,46 @@
+/*
+ * Shared glue of the host programs in tools/protocol_sim, see sim.h.
+ */
+
+#include <string.h>
+#include <time.h>
+#include "sim.h"
+
+uint32_t stub_tick;
+uint32_t stub_us;
+void *stub_thread = (void *)1;
+uint32_t stub_sig_bits;
+DWT_Type stub_dwt;
+CoreDebug_Type stub_coredebug;
+TIM_TypeDef stub_tim5;
+
+double sim_now_ns(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+uint16_t sim_frame_len(const uint8_t *p)
+{
+  return ((const protocol_pack_desc_t *)p)->data_len;
+}
+
+uint16_t sim_frame_cmd(const uint8_t *p)
+{
+  uint16_t cmd;
+
+  memcpy(&cmd, p + PROTOCOL_PACK_HEAD_SIZE, sizeof(cmd));
+  return cmd;
+}
+
+void sim_frame_readdress(uint8_t *p, uint8_t sender, uint8_t reciver)
+{
+  protocol_pack_desc_t *head = (protocol_pack_desc_t *)p;
+
+  head->sender = sender;
+  head->reciver = reciver;
+  append_crc16(p, PROTOCOL_PACK_HEAD_SIZE);
+  append_crc32(p, head->data_len);
+}
@@ -0,0 +1,26 @@
+/*
+ * Shared glue of the host programs in tools/protocol_sim: the stub clock and signal
+ * variables, a wall clock for benchmarks and a helper to re-address captured frames.
+ */
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include "protocol.h"
+
+extern uint32_t stub_tick; /* ms, read by get_time_ms() and osKernelSysTick() */
+extern uint32_t stub_us;   /* 0..999, read by get_time_us() */
+
+/* monotonic wall clock for benchmarks, ns */
+double sim_now_ns(void);
+
+/* length of the frame at p, from its header */
+uint16_t sim_frame_len(const uint8_t *p);
+
+/* command of the frame at p */
+uint16_t sim_frame_cmd(const uint8_t *p);
+
+/* rewrite sender and receiver of the frame at p and redo both crcs */
+void sim_frame_readdress(uint8_t *p, uint8_t sender, uint8_t reciver);
+
+#endif
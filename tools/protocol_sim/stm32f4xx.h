@@ -0,0 +1,2 @@
+/* host stub for tools/protocol_sim */
+#include "stm32f4xx_hal.h"
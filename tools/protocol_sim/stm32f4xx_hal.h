@@ -0,0 +1,22 @@
+/* host stub for tools/protocol_sim, only what the protocol and components/support use */
+#ifndef STUB_HAL_H
+#define STUB_HAL_H
+#include <stdint.h>
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
+static inline unsigned long __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(unsigned long x) { (void)x; }
+#define __CLZ(x) ((x) ? (uint32_t)__builtin_clz(x) : 32u)
+typedef struct { volatile uint32_t CTRL, CYCCNT; } DWT_Type;
+typedef struct { volatile uint32_t DEMCR; } CoreDebug_Type;
+typedef struct { volatile uint32_t CNT, SR; } TIM_TypeDef;
+extern DWT_Type stub_dwt;
+extern CoreDebug_Type stub_coredebug;
+extern TIM_TypeDef stub_tim5;
+#define DWT (&stub_dwt)
+#define CoreDebug (&stub_coredebug)
+#define TIM5 (&stub_tim5)
+#define DWT_CTRL_CYCCNTENA_Msk 1u
+#define CoreDebug_DEMCR_TRCENA_Msk (1u << 24)
+#define TIM_SR_UIF 1u
+#endif
@@ -0,0 +1,253 @@
+/*
+ * Host loopback simulation of the reliable stream (protocol_stream_send).
+ *
+ * The node sends 64 KB to 0x02 over a uart interface and is its own peer: every frame it
+ * sends goes through a simulated link and comes back re-addressed from 0x02, so the same
+ * node receives the chunks and the acks. The link has, per direction:
+ *
+ *   - LINK_RATE bytes per ms, frames wait for the line in the order they are sent
+ *   - LINK_DELAY ms of latency after the last byte
+ *   - a loss probability per frame, applied to data and acks alike
+ *
+ * The clock steps 1 ms at a time. In each step frames that are due are received, then
+ * protocol_send_flush runs when a send was signalled or protocol_send_wait_time is 0.
+ * The receiver checks every byte, the chunk offsets and the last flag.
+ *
+ * Prints the transfer time and KB/s for windows 1, 4, 8, 16, 32 at 0, 1 and 5 % loss.
+ * An optional argument sets the chunk resend timeout in ms through protocol_send_cmd_config,
+ * otherwise PROTOCOL_STREAM_TIMEOUT applies.
+ *
+ * Build and run from the repository root:
+ *
+ *   tools/protocol_sim/build.sh stream_sim && ./stream_sim [timeout]
+ *
+ * For a tree without protocol_stream_rcv_register, build with CFLAGS=-DSTREAM_BARE_RCV to
+ * check the bare chunks of rcv_callback instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim.h"
+#include "protocol_transmit.h"
+
+#define LINK_RATE      (100)
+#define LINK_DELAY     (5)
+#define LINK_QUEUE_MAX (4096)
+#define STREAM_LEN     (64 * 1024)
+#define CMD_BULK       (0x0600)
+
+struct link_frame
+{
+  uint32_t due;
+  uint16_t len;
+  uint8_t buf[PROTOCOL_FRAME_MAX_SIZE];
+};
+
+static struct link_frame link_queue[LINK_QUEUE_MAX];
+static int link_num;
+static uint32_t link_busy[2];
+static double link_loss;
+static long link_frames;
+static long link_drops;
+
+static uint8_t data[STREAM_LEN];
+static long rcvd;
+static int lasts;
+static int signalled;
+static int done;
+static uint32_t done_status;
+
+static int com_send(uint8_t *p_data, uint32_t len)
+{
+  uint32_t off = 0;
+
+  while (off < len)
+  {
+    uint8_t *frame = p_data + off;
+    uint16_t frame_len = sim_frame_len(frame);
+    int dir = (sim_frame_cmd(frame) == PROTOCOL_CMD_STREAM_ACK);
+    uint32_t start = ((int32_t)(link_busy[dir] - stub_tick) > 0) ? link_busy[dir] : stub_tick;
+
+    link_busy[dir] = start + (frame_len + LINK_RATE - 1) / LINK_RATE;
+    link_frames++;
+    off += frame_len;
+    if ((double)rand() / RAND_MAX < link_loss)
+    {
+      link_drops++;
+      continue;
+    }
+    if (link_num == LINK_QUEUE_MAX)
+    {
+      printf("link queue full\n");
+      exit(1);
+    }
+    link_queue[link_num].due = link_busy[dir] + LINK_DELAY;
+    link_queue[link_num].len = frame_len;
+    memcpy(link_queue[link_num].buf, frame, frame_len);
+    sim_frame_readdress(link_queue[link_num].buf, 0x02, 0x01);
+    link_num++;
+  }
+  return len;
+}
+
+/* receive the frames that are due, keep the rest in order */
+static int link_deliver(void)
+{
+  struct perph_interface *obj = protocol_get_interface("u0");
+  int n = 0;
+  int k = 0;
+
+  for (int i = 0; i < link_num; i++)
+  {
+    if ((int32_t)(link_queue[i].due - stub_tick) <= 0)
+    {
+      protocol_rcv_data(link_queue[i].buf, link_queue[i].len, obj);
+      n++;
+    }
+    else
+    {
+      if (k != i)
+      {
+        link_queue[k] = link_queue[i];
+      }
+      k++;
+    }
+  }
+  link_num = k;
+  return n;
+}
+
+static int32_t bulk_rcv(uint8_t *buf, uint16_t len)
+{
+  for (int i = 0; i < len; i++)
+  {
+    if (buf[i] != (uint8_t)(rcvd + i))
+    {
+      printf("FAIL data at %ld\n", rcvd + i);
+      exit(1);
+    }
+  }
+  rcvd += len;
+  return 0;
+}
+
+static int32_t bulk_stream_rcv(uint8_t *buf, uint16_t len, uint32_t offset, uint8_t is_last)
+{
+  if (offset != (uint32_t)rcvd)
+  {
+    printf("FAIL offset %u, expected %ld\n", offset, rcvd);
+    exit(1);
+  }
+  if (is_last)
+  {
+    lasts++;
+    if (rcvd + len != STREAM_LEN)
+    {
+      printf("FAIL last flag at %ld\n", rcvd + len);
+      exit(1);
+    }
+  }
+  return bulk_rcv(buf, len);
+}
+
+static void bulk_done(uint16_t cmd, uint32_t status)
+{
+  done = 1;
+  done_status = status;
+}
+
+static void send_signal(void)
+{
+  signalled = 1;
+}
+
+static void step(void)
+{
+  int any;
+
+  do
+  {
+    any = link_deliver();
+    if (any)
+    {
+      protocol_unpack_flush();
+    }
+    if (signalled || (protocol_send_wait_time() == 0))
+    {
+      signalled = 0;
+      protocol_send_flush();
+    }
+  } while (any);
+  stub_tick++;
+}
+
+static int run(int window, double loss)
+{
+  uint32_t t0 = stub_tick;
+  uint32_t ms;
+
+  srand(1);
+  link_loss = loss;
+  link_frames = link_drops = 0;
+  rcvd = 0;
+  lasts = 0;
+  done = 0;
+
+  protocol_stream_send(0x02, CMD_BULK, data, sizeof(data), window, bulk_done);
+  while (!done && (stub_tick - t0 < 600000))
+  {
+    step();
+  }
+  ms = stub_tick - t0;
+  printf("window %2d loss %3.0f%%: %6u ms %6.1f KB/s, %ld frames, %ld lost, status %u\n", window, loss * 100,
+         ms, (double)sizeof(data) / ms, link_frames, link_drops, done_status);
+
+  /* let the last acks and resends settle before the next run */
+  for (int k = 0; (k < 200) || (link_num > 0); k++)
+  {
+    step();
+  }
+
+#ifdef STREAM_BARE_RCV
+  return (done_status != 0) || (rcvd != STREAM_LEN);
+#else
+  return (done_status != 0) || (rcvd != STREAM_LEN) || (lasts != 1);
+#endif
+}
+
+int main(int argc, char **argv)
+{
+  const int windows[] = {1, 4, 8, 16, 32};
+  const double losses[] = {0, 0.01, 0.05};
+  int fail = 0;
+
+  for (int i = 0; i < STREAM_LEN; i++)
+  {
+    data[i] = i;
+  }
+
+  protocol_local_init(0x01);
+  protocol_uart_interface_register("u0", 4096, 1, 0, com_send);
+  protocol_set_route(0x02, "u0");
+#ifdef STREAM_BARE_RCV
+  protocol_rcv_cmd_register(CMD_BULK, bulk_rcv);
+#else
+  protocol_stream_rcv_register(CMD_BULK, bulk_stream_rcv);
+#endif
+  if (argc > 1)
+  {
+    protocol_send_cmd_config(CMD_BULK, 10, atoi(argv[1]), 0, PROTOCOL_PRIORITY_BULK, NULL, NULL);
+  }
+  protocol_send_list_add_callback_reg(send_signal);
+
+  stub_tick = 1000;
+  for (int l = 0; l < 3; l++)
+  {
+    for (int w = 0; w < 5; w++)
+    {
+      fail |= run(windows[w], losses[l]);
+    }
+  }
+
+  return fail;
+}
@@ -0,0 +1,13 @@
+/* host stub for tools/protocol_sim, board time is stub_tick ms + stub_us */
+#ifndef STUB_SYS_H
+#define STUB_SYS_H
+#include "stm32f4xx_hal.h"
+#define var_cpu_sr() unsigned long cpu_sr
+#define enter_critical() do { cpu_sr = __get_PRIMASK(); __disable_irq(); } while (0)
+#define exit_critical() do { __set_PRIMASK(cpu_sr); } while (0)
+extern uint32_t stub_tick;
+extern uint32_t stub_us;
+static inline uint32_t get_time_ms(void) { return stub_tick; }
+static inline uint32_t get_time_us(void) { return stub_us; }
+static inline uint32_t get_time_stamp_us(void) { return stub_tick * 1000 + stub_us; }
+#endif
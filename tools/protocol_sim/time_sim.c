@@ -0,0 +1,214 @@
+/*
+ * Host simulation of the two-way clock synchronisation in protocol_time.c.
+ *
+ * The node 0x01 syncs to master 0x00 every 200 ms over a uart interface. The simulation
+ * keeps a true time T in us and derives both clocks from it:
+ *
+ *   client (the node, through stub_tick and stub_us):  T * (1 + 80 ppm) + 123456789 us
+ *   master:                                             T * (1 - 30 ppm)
+ *
+ * The master is played by the link: it stamps each TIME_REQ on arrival (t2), replies 50 us
+ * later (t3), and the reply comes back to the node. Each way takes 400 us plus exponential
+ * jitter, requests and replies are lost with the given probability.
+ *
+ * The clock steps 100 us at a time for 120 s. Every ms the error of protocol_time_now_us
+ * against the master clock is taken, every 10 s the sync state is printed. The result line
+ * gives the time from which the error stayed below 1 ms and the worst error after 30 s. The
+ * program exits non zero when that worst error reaches 1 ms.
+ *
+ * Build and run from the repository root:
+ *
+ *   tools/protocol_sim/build.sh time_sim && ./time_sim [loss] [jitter_us]
+ *
+ * loss defaults to 0.2 and jitter to 300 us.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "sim.h"
+#include "protocol_transmit.h"
+#include "protocol_time.h"
+
+#define CLIENT_DRIFT   (80e-6)
+#define CLIENT_OFFSET  (123456789.0)
+#define MASTER_DRIFT   (-30e-6)
+#define LINK_DELAY     (400.0)
+#define MASTER_TURN    (50.0)
+#define STEP_US        (100)
+#define RUN_S          (120)
+#define SETTLE_S       (30)
+#define LINK_QUEUE_MAX (256)
+
+struct link_frame
+{
+  double due;
+  uint16_t len;
+  uint8_t buf[128];
+};
+
+static struct link_frame link_queue[LINK_QUEUE_MAX];
+static int link_num;
+static double link_loss = 0.2;
+static double link_jitter = 300;
+
+static double true_us;
+
+static double master_us(double t)
+{
+  return t * (1 + MASTER_DRIFT);
+}
+
+static void set_client_clock(void)
+{
+  uint64_t local = (uint64_t)(true_us * (1 + CLIENT_DRIFT) + CLIENT_OFFSET);
+
+  stub_tick = (uint32_t)(local / 1000);
+  stub_us = (uint32_t)(local % 1000);
+}
+
+static double rand_uniform(void)
+{
+  return (rand() + 1.0) / (RAND_MAX + 2.0);
+}
+
+static double link_latency(void)
+{
+  return LINK_DELAY - link_jitter * log(rand_uniform());
+}
+
+/* the master's side: answer every request that gets through */
+static int com_send(uint8_t *p_data, uint32_t len)
+{
+  uint32_t off = 0;
+
+  while (off < len)
+  {
+    uint8_t *frame = p_data + off;
+    uint16_t frame_len = sim_frame_len(frame);
+
+    off += frame_len;
+    if ((sim_frame_cmd(frame) != PROTOCOL_CMD_TIME_REQ) || (rand_uniform() < link_loss))
+    {
+      continue;
+    }
+
+    double arrive = true_us + link_latency();
+    struct protocol_time_req req;
+    struct protocol_time_resp resp;
+    uint16_t cmd = PROTOCOL_CMD_TIME_RESP;
+    uint8_t *reply = link_queue[link_num].buf;
+
+    memcpy(&req, frame + PROTOCOL_PACK_HEAD_SIZE + 2, sizeof(req));
+    resp.t1 = req.t1;
+    resp.t2 = (uint64_t)master_us(arrive);
+    resp.t3 = (uint64_t)master_us(arrive + MASTER_TURN);
+
+    memcpy(reply, frame, PROTOCOL_PACK_HEAD_SIZE);
+    ((protocol_pack_desc_t *)reply)->data_len = PROTOCOL_PACK_HEAD_SIZE + 2 + sizeof(resp) + PROTOCOL_PACK_TAIL_SIZE;
+    ((protocol_pack_desc_t *)reply)->session = 0;
+    memcpy(reply + PROTOCOL_PACK_HEAD_SIZE, &cmd, sizeof(cmd));
+    memcpy(reply + PROTOCOL_PACK_HEAD_SIZE + 2, &resp, sizeof(resp));
+    sim_frame_readdress(reply, 0x00, 0x01);
+
+    if ((rand_uniform() >= link_loss) && (link_num < LINK_QUEUE_MAX))
+    {
+      link_queue[link_num].due = arrive + MASTER_TURN + link_latency();
+      link_queue[link_num].len = sim_frame_len(reply);
+      link_num++;
+    }
+  }
+  return len;
+}
+
+static void link_deliver(void)
+{
+  struct perph_interface *obj = protocol_get_interface("u0");
+  int k = 0;
+
+  for (int i = 0; i < link_num; i++)
+  {
+    if (link_queue[i].due <= true_us)
+    {
+      protocol_rcv_data(link_queue[i].buf, link_queue[i].len, obj);
+    }
+    else
+    {
+      link_queue[k++] = link_queue[i];
+    }
+  }
+  if (k != link_num)
+  {
+    link_num = k;
+    protocol_unpack_flush();
+  }
+}
+
+int main(int argc, char **argv)
+{
+  const long steps = RUN_S * 1000000L / STEP_US;
+  const long steps_ms = 1000 / STEP_US;
+  long within_ms = -1;
+  double worst = 0;
+
+  if (argc > 1)
+  {
+    link_loss = atof(argv[1]);
+  }
+  if (argc > 2)
+  {
+    link_jitter = atof(argv[2]);
+  }
+
+  srand(7);
+  true_us = 1e6;
+  set_client_clock();
+  protocol_local_init(0x01);
+  protocol_uart_interface_register("u0", 4096, 1, 0, com_send);
+  protocol_set_route(0x00, "u0");
+  protocol_time_sync_start(0x00, 200);
+
+  for (long step = 0; step < steps; step++)
+  {
+    true_us += STEP_US;
+    set_client_clock();
+    link_deliver();
+    if (protocol_send_wait_time() == 0)
+    {
+      protocol_send_flush();
+    }
+    if (step % steps_ms != 0)
+    {
+      continue;
+    }
+
+    double err = (double)(int64_t)(protocol_time_now_us() - (uint64_t)master_us(true_us));
+
+    if (fabs(err) >= 1000)
+    {
+      within_ms = -1;
+    }
+    else if (within_ms < 0)
+    {
+      within_ms = step / steps_ms;
+    }
+    if ((step >= SETTLE_S * 1000 * steps_ms) && (fabs(err) > worst))
+    {
+      worst = fabs(err);
+    }
+    if (step % (10000 * steps_ms) == 0)
+    {
+      struct protocol_time_info info;
+
+      protocol_time_get_info(&info);
+      printf("t=%3lds err %8.1f us, drift %7d ppb (true %.0f), delay %5u us, samples %4u, rejected %4u, steps %u\n",
+             step / steps_ms / 1000, err, info.drift_ppb, ((1 + MASTER_DRIFT) / (1 + CLIENT_DRIFT) - 1) * 1e9,
+             info.delay, info.sample_cnt, info.reject_cnt, info.step_cnt);
+    }
+  }
+
+  printf("loss %.0f%%, jitter %.0f us: within 1 ms from t=%ld ms, worst error after %d s %.1f us\n",
+         link_loss * 100, link_jitter, within_ms, SETTLE_S, worst);
+
+  return (within_ms < 0) || (worst >= 1000);
+}
@@ -0,0 +1,105 @@
+/*
+ * Host loopback benchmark of the transmit batch: one node sends a telemetry tick of 8 frames
+ * of 12..33 bytes, then protocol_send_flush, for TICKS ticks. This is done once to a peer
+ * behind a uart interface (stands in for usb cdc) and once to a peer behind a can interface.
+ *
+ * Prints send calls, bytes per call, can frames (8 bytes each, as can_msg_bytes_send splits
+ * a call) and frames/s of send + flush. The usb capture is then received by the node as the
+ * peer, to check every frame still decodes.
+ *
+ * Build and run from the repository root:
+ *
+ *   tools/protocol_sim/build.sh tx_coalesce && ./tx_coalesce
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim.h"
+#include "protocol_transmit.h"
+
+#define TICKS          (1000)
+#define TICK_FRAMES    (8)
+#define CMD_BASE       (0x0200)
+
+extern local_info_t protocol_local_info;
+
+static long calls;
+static long bytes;
+static long can_frames;
+
+static uint8_t cap[TICKS * TICK_FRAMES * 64];
+static uint32_t cap_len;
+
+static long got;
+
+static int usb_send(uint8_t *p_data, uint32_t len)
+{
+  calls++;
+  bytes += len;
+  memcpy(cap + cap_len, p_data, len);
+  cap_len += len;
+  return len;
+}
+
+static int can_send(uint32_t id, uint8_t *p_data, uint32_t len)
+{
+  calls++;
+  bytes += len;
+  can_frames += (len + 7) / 8;
+  return len;
+}
+
+static int32_t tele_rcv(uint8_t *buf, uint16_t len)
+{
+  got++;
+  return 0;
+}
+
+static void run(const char *name, uint8_t reciver)
+{
+  uint8_t payload[64] = {0};
+  double t0;
+  double dt;
+
+  calls = bytes = can_frames = 0;
+  t0 = sim_now_ns();
+  for (int t = 0; t < TICKS; t++)
+  {
+    for (int k = 0; k < TICK_FRAMES; k++)
+    {
+      protocol_send(reciver, CMD_BASE + k, payload, 12 + k * 3);
+    }
+    protocol_send_flush();
+  }
+  dt = sim_now_ns() - t0;
+
+  printf("%-3s %d frames: %5ld send calls, %6.1f bytes/call, %5ld can frames, %.2f M frames/s\n",
+         name, TICKS * TICK_FRAMES, calls, (double)bytes / calls, can_frames, TICKS * TICK_FRAMES / dt * 1e3);
+}
+
+int main(void)
+{
+  protocol_local_init(0x01);
+  protocol_uart_interface_register("usb", 4096, 1, 0, usb_send);
+  protocol_can_interface_register("can", 4096, 1, 1, 0x100, 0x101, can_send);
+  protocol_set_route(0x02, "usb");
+  protocol_set_route(0x03, "can");
+  for (int k = 0; k < TICK_FRAMES; k++)
+  {
+    protocol_rcv_cmd_register(CMD_BASE + k, tele_rcv);
+  }
+
+  run("usb", 0x02);
+  run("can", 0x03);
+
+  /* loop the usb capture back as the peer */
+  protocol_local_info.address = 0x02;
+  for (uint32_t off = 0; off < cap_len; off += 256)
+  {
+    protocol_rcv_data(cap + off, (cap_len - off > 256) ? 256 : cap_len - off, protocol_get_interface("usb"));
+    protocol_unpack_flush();
+  }
+  printf("usb loopback: %ld/%d frames decoded\n", got, TICKS * TICK_FRAMES);
+
+  return got != TICKS * TICK_FRAMES;
+}
@@ -0,0 +1,6 @@
+/* host stub for tools/protocol_sim, protocol logs are dropped so they do not skew timings */
+#include <stdio.h>
+#define log_d(...) do {} while (0)
+#define log_i(...) do {} while (0)
+#define log_e(...) do {} while (0)
+#define log_printf(...) printf(__VA_ARGS__)